@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <stdbool.h>            /* boolean datatypes */
 #include <stddef.h>
+#include <stdint.h>             /* fixed width syntax tree nodes */
+#include <setjmp.h>             /* jmp_buf for opal_abort() */
 
 /// __VERSION_NUM for program
 #ifndef __VERSION_NUM
@@ -21,9 +23,10 @@
  * function, followed the formatted string & status like PASS, FAIL etc
  * ==================================
  */
-/// Macro function to call opal_log() with source file, line & function name
+/// Macro function to call opal_log() with source file, line & function name.
+/// Expects the compiler context pointer 'ctx' to be in scope.
 #define logger(tag, ...) \
-  opal_log(tag, __FILE__, __LINE__, __func__, __VA_ARGS__)
+  opal_log(ctx, tag, __FILE__, __LINE__, __func__, __VA_ARGS__)
 #define _PASS (logger(RESULT, " - PASS"))   ///< Macro function to log PASS
 #define _FAIL (logger(RESULT, " - FAIL"))   ///< Macro function to log FAIL
 #define _DONE (logger(RESULT, " .. DONE"))  ///< Macro function to log DONE
@@ -34,37 +37,24 @@
  * ==================================
  */
 
-char *source_fn = NULL;         ///< Input source file name
-char *dest_fn = NULL;           ///< Destination file name
-char *log_fn = NULL;            ///< Log file name
-char *report_fn = NULL;         ///< Report file name
-char *golden_fn = NULL;         ///< Golden syntax tree printout file name
-
-char *css_fn = "res/styles.css";        ///< HTML CSS file name
-
-FILE *source_fp = NULL;         ///< Source file pointer
-FILE *dest_fp = NULL;           ///< Destination file pointer
-FILE *log_fp = NULL;            ///< Log file pointer
-FILE *report_fp = NULL;         ///< Report file pointer
-FILE *golden_fp = NULL;         ///< Golden syntax tree printout file pointer
-
-short retVal = 0;               ///< Function return value
-
-int next_char = ' ';            ///< Next character in source file
-int char_col = 0;               ///< Column number of character in source file
-int char_line = 0;              ///< Line number of character in source file
-
 /// Log level name enum for opal_log function
 typedef enum log_level
 {
   NONE, ERROR, INFO, DEBUG, RESULT
 } log_level_e;
-short LOG_LEVEL = ERROR;        ///< Current log level
 
 /// Buffer used to populate error message string for perror()
 #define perror_msg_len 1024
-/// Message string for perror()
-char perror_msg[perror_msg_len] = { 0 };
+
+/// Output of a compiler stage, kept in a growable memory buffer or a tmp file
+typedef struct stage_buf
+{
+  char *fn;         ///< tmp file name, NULL to keep stage output in memory
+  char *data;       ///< growable buffer managed by open_memstream()
+  size_t len;       ///< number of bytes in data
+  FILE *fp;         ///< stream currently open on the stage output
+  struct stage_buf *next;   ///< next stage of the context, see stage_new()
+} stage_buf_s;
 
 /*
  * ==================================
@@ -116,26 +106,24 @@ typedef struct keyword
 } keyword;
 
 /// Array for supported keywords
-keyword keyword_arr[] =
-    {
-        {"if", lx_If},
-        {"else", lx_Else},
-        {"while", lx_While},
-        {"print", lx_Print},
-        {"input", lx_Input}
-    };
+extern const keyword keyword_arr[];
+/// Number of supported keywords
+extern const int keyword_arr_len;
+
+/// Slots in keyword_hash_arr, a power of two
+#define keyword_hash_len 8
+/// Shortest and longest keyword
+#define keyword_min_len 2
+#define keyword_max_len 5
+/// Perfect hash of a keyword from its first character and length
+#define keyword_hash(first, len) (((first) + (len)) & (keyword_hash_len - 1))
+/// Perfect hash table of keywords
+extern const unsigned char keyword_hash_arr[];
 
 /// Lexeme type names for logging
-const char op_name[][16] =
-  { "No_operation", "End_of_file", "Identifier", "Integer", "String",
-      "Op_Assign", "Op_Add", "Op_Subtract", "Op_Negate", "Op_Multiply",
-      "Op_Divide", "Op_Mod", "Op_Equal", "Op_NotEqual", "Op_Less", "Op_Greater",
-      "Op_LessEqual", "Op_GreaterEqual", "Op_And", "Op_Or", "Op_Not",
-      "Keyword_If", "Keyword_Else", "Keyword_While", "LeftParen", "RightParen",
-      "LeftBrace", "RightBrace", "Semicolon", "Comma", "Keyword_print",
-      "Keyword_input" };
-
-/// Struct for lexeme in the symbol table linked list
+extern const char op_name[][16];
+
+/// Struct for a lexeme read by the lexer, or a token of the symbol table
 typedef struct lexeme
 {
   lexeme_type_e type;    ///< type of lexeme
@@ -143,19 +131,39 @@ typedef struct lexeme
   int column;            ///< column number in source file
   int int_val;           ///< holds value for integer lexemes
   char *char_val;        ///< holds value for string an identifier lexemes
-  struct lexeme *next;   ///< pointer for next lexeme in list
+  int sym;               ///< interned symbol of string and identifier lexemes
 } lexeme_s;
 
-/// Struct to hold next lexeme
-lexeme_s next_lexeme = { 0 };
+/**
+ * Symbol table of tokens, stored as one array per field and indexed by
+ * position. Token 0 is a No_operation token for the start of input and the
+ * last token is End_of_input.
+ */
+typedef struct token_table
+{
+  lexeme_type_e *type;   ///< type of each token
+  int *line;             ///< line number of each token
+  int *column;           ///< column number of each token
+  int *value;            ///< integer value, or interned symbol of strings and
+                         ///< identifiers
+  unsigned int len;      ///< number of tokens
+  unsigned int cap;      ///< capacity of each array
+} token_table_s;
+
+/// Tokens held by ASTRO when parsing while lexing, a power of two
+#define TOKEN_RING_LEN 4
+
+/// Identifier or string interned by ALEX, one per distinct name and kind
+typedef struct intern_sym
+{
+  char *name;            ///< identifier name or string text
+  unsigned hash;         ///< hash of name and kind
+  bool is_str;           ///< string literal rather than identifier
+  int slot;              ///< index in vars or strs given by GENIE, or -1
+} intern_sym_s;
 
 /// A buffer to hold string value of lexeme
 #define lexeme_str_len 1024
-/// Holds stringified contents of lexeme for printing
-char lexeme_str[lexeme_str_len] = { 0 };
-
-/// Extended regular expression pattern for integers
-char *int_regex_pattern = "^[-+]?[0-9]+$";
 
 
 /*
@@ -198,24 +206,34 @@ typedef enum ast_node_type
 } ast_node_type_e;
 
 /// Syntax tree node type names for logging
-const char node_name[][16] =
-  { "No_operation", "End_of_file", "Identifier", "Integer", "String",
-      "Op_Assign", "Op_Add", "Op_Subtract", "Op_Negate", "Op_Multiply",
-      "Op_Divide", "Op_Mod", "Op_Equal", "Op_NotEqual", "Op_Less", "Op_Greater",
-      "Op_LessEqual", "Op_GreaterEqual", "Op_And", "Op_Or", "Op_Not",
-      "Keyword_If", "Keyword_Else", "Keyword_While", "Print_String",
-      "Print_Integer", "Code_sequence", "Keyword_input" };
-
-/// Struct for abstract syntax tree node
+extern const char node_name[][16];
+
+/// Index of a node in the syntax tree node pool, 0 for no node
+typedef uint32_t node_id;
+
+/**
+ * Struct for abstract syntax tree node, 16 bytes. Nodes live in the node
+ * pool of the context and refer to each other by index, so the pool holds
+ * no pointers and can be written out as it is.
+ */
 typedef struct node
 {
-  ast_node_type_e node_type;  ///< type of node in tree
-  struct node *left;          ///< pointer this node's left child
-  struct node *right;         ///< pointer this node's right child
-  char *char_val;             ///< holds value of String and Identifier nodes
-  int int_val;                ///< holds value of Integer nodes
+  node_id left;               ///< index of this node's left child, or 0
+  node_id right;              ///< index of this node's right child, or 0
+  int32_t value;              ///< interned symbol of String and Identifier
+                              ///< nodes, value of Integer nodes
+  uint8_t node_type;          ///< type of node in tree, an ast_node_type_e
 } node_s;
 
+/// Explicit stack of a syntax tree walk, so walks do not recurse
+typedef struct walk_stack
+{
+  void *items;                ///< entries, size bytes each
+  size_t size;                ///< size of an entry
+  unsigned len;               ///< entries on the stack
+  unsigned cap;               ///< entries the stack has room for
+} walk_stack_s;
+
 /// Language grammar
 typedef struct attributes
 {
@@ -229,47 +247,8 @@ typedef struct attributes
   ast_node_type_e node_type;   ///< corresponding node for abstract syntax tree
 } attributes_s;
 
-/**
- * Language grammar
- * Ref: https://en.wikipedia.org/wiki/Operators_in_C_and_C
- */
-const attributes_s grammar[] =
-  {
-    { "NOP", "No_Operation", lx_NOP, FALSE, FALSE, FALSE, -1, nd_NOP },
-    { "EOF", "End_of_file", lx_EOF, FALSE, FALSE, FALSE, -1, -1 },
-    { "Identifier", "Identifier", lx_Ident, FALSE, FALSE, FALSE, -1, nd_Ident },
-    { "Integer", "Integer", lx_Integer, FALSE, FALSE, FALSE, -1, nd_Integer },
-    { "String", "String", lx_String, FALSE, FALSE, FALSE, -1, nd_String },
-    { "=", "Op_assign", lx_Assign, FALSE, FALSE, FALSE, -1, nd_Assign },
-    { "+", "Op_add", lx_Add, FALSE, TRUE, FALSE, 12, nd_Add },
-    { "-", "Op_subtract", lx_Sub, FALSE, TRUE, FALSE, 12, nd_Sub },
-    { "-", "Op_negate", lx_Negate, FALSE, FALSE, TRUE, 14, nd_Negate },
-    { "*", "Op_multiply", lx_Mul, FALSE, TRUE, FALSE, 13, nd_Mul },
-    { "/", "Op_divide", lx_Div, FALSE, TRUE, FALSE, 13, nd_Div },
-    { "%", "Op_mod", lx_Mod, FALSE, TRUE, FALSE, 13, nd_Mod },
-    { "==", "Op_equal", lx_Eq, FALSE, TRUE, FALSE, 9, nd_Eq },
-    { "!=", "Op_notequal", lx_Neq, FALSE, TRUE, FALSE, 9, nd_Neq },
-    { "<", "Op_less", lx_Lss, FALSE, TRUE, FALSE, 10, nd_Lss },
-    { ">", "Op_greater", lx_Gtr, FALSE, TRUE, FALSE, 10, nd_Gtr },
-    { "<=", "Op_lessequal", lx_Leq, FALSE, TRUE, FALSE, 10, nd_Leq },
-    { ">=", "Op_greaterequal", lx_Geq, FALSE, TRUE, FALSE, 10, nd_Geq },
-    { "&&", "Op_and", lx_And, FALSE, TRUE, FALSE, 5, nd_And },
-    { "||", "Op_or", lx_Or, FALSE, TRUE, FALSE, 4, nd_Or },
-    { "!", "Op_not", lx_Not, FALSE, FALSE, TRUE, 14, nd_Not },
-    { "if", "Keyword_if", lx_If, FALSE, FALSE, FALSE, -1, nd_If },
-    { "else", "Keyword_else", lx_Else, FALSE, FALSE, FALSE, -1, -1 },
-    { "while", "Keyword_while", lx_While, FALSE, FALSE, FALSE, -1, nd_While },
-    { "(", "LeftParen", lx_Lparen, FALSE, FALSE, FALSE, -1, -1 },
-    { ")", "RightParen", lx_Rparen, FALSE, FALSE, FALSE, -1, -1 },
-    { "{", "LeftBrace", lx_Lbrace, FALSE, FALSE, FALSE, -1, -1 },
-    { "}", "RightBrace", lx_Rbrace, FALSE, FALSE, FALSE, -1, -1 },
-    { ";", "Semicolon", lx_Semi, FALSE, FALSE, FALSE, -1, -1 },
-    { ",", "Comma", lx_Comma, FALSE, FALSE, FALSE, -1, -1 },
-    { "print", "Keyword_print", lx_Print, FALSE, FALSE, FALSE, -1, -1 },
-  };
-
-/// Lexeme currently being processed by build_syntax_tree()
-lexeme_s *ast_curr_lexeme = NULL;
+/// Language grammar, indexed by lexeme type
+extern const attributes_s grammar[];
 
 /*
  * ==================================
@@ -312,6 +291,13 @@ typedef enum asm_code
   asm_HALT,
   asm_Label,
   asm_Input,
+  asm_Tee,          ///< Store top of stack in variable, keep it on stack
+  asm_Jeq,          ///< Pop b and a, jump if a == b
+  asm_Jneq,         ///< Pop b and a, jump if a != b
+  asm_Jlss,         ///< Pop b and a, jump if a < b
+  asm_Jgtr,         ///< Pop b and a, jump if a > b
+  asm_Jleq,         ///< Pop b and a, jump if a <= b
+  asm_Jgeq,         ///< Pop b and a, jump if a >= b
 } asm_code_e;
 
 /// Struct for assembly code list
@@ -323,51 +309,348 @@ typedef struct asm_cmd
 }asm_cmd_e;
 
 /// 0-address assembly commands
-const char asm_cmds[][16] =
-  { "NOP", "_EOF_", "_IDENT_", "_INT_", "_STR_", "_ASSIGN_", "O_ADD", "O_SUB",
-      "O_NEGATE", "O_MUL", "O_DIV", "O_MOD", "O_EQ", "O_NEQ", "O_LSS", "O_GTR",
-      "O_LEQ", "O_GEQ", "O_AND", "O_OR", "O_NOT", "_FETCH_", "_STORE_", "PUSH",
-      "JMP", "O_JZ", "O_JNZ", "O_PRTS", "O_PRTI", "HALT", "_LABEL_", "_INPUT_"
-};
+extern const char asm_cmds[][16];
+
+/// Rules of the peephole optimizer, bit numbers of opal_ctx_s.peephole
+typedef enum peephole_rule
+{
+  ph_StoreFetch = 0,    ///< Merge or drop _STORE_/_FETCH_ pairs of a variable
+  ph_InvertJump,        ///< O_NOT, O_JZ to O_JNZ; Jcc L1, JMP L2, L1: to J!cc L2
+  ph_DeadLabel,         ///< Drop labels no jump refers to
+  ph_JumpNext,          ///< Drop JMP to a label that directly follows it
+  ph_FuseCompare,       ///< Comparison, O_JZ/O_JNZ to fused compare and branch
+  ph_Rules,             ///< Number of rules
+} peephole_rule_e;
+
+/// Mask of all peephole rules, the default
+#define PEEPHOLE_ALL ((1u << ph_Rules) - 1)
+
+/// Names of peephole rules, as given to --peephole
+extern const char peephole_names[][16];
+
+/**
+ * Register code of the top-of-stack caching mode of GENIE. The compiler
+ * tracks how many values of the top of the stack are held in registers: RAX
+ * holds the top, RBX the value below it. Commands work on the registers and
+ * only spill to the machine stack when a third value is pushed, or before
+ * labels, jumps and the print, input and halt macros, which expect all
+ * values on the machine stack.
+ */
+typedef enum reg_code
+{
+  reg_Cmd = 0,      ///< Stack command cmd_list[arg], emitted as macro
+  reg_PushRax,      ///< PUSH RAX
+  reg_PushRbx,      ///< PUSH RBX
+  reg_PopRax,       ///< POP  RAX
+  reg_PopRbx,       ///< POP  RBX
+  reg_MovRbxRax,    ///< MOV  RBX, RAX
+  reg_MovRaxRbx,    ///< MOV  RAX, RBX
+  reg_LoadImm,      ///< MOV  RAX, arg
+  reg_LoadVar,      ///< MOV  RAX, [data+8*arg]
+  reg_StoreVar,     ///< MOV  [data+8*arg], RAX
+  reg_Op,           ///< RAX = RBX op RAX, or op RAX, for stack command arg
+  reg_Test,         ///< TEST RAX, RAX
+  reg_Jz,           ///< JE   label of cmd_list[arg]
+  reg_Jnz,          ///< JNE  label of cmd_list[arg]
+  reg_Cmp,          ///< CMP  RBX, RAX
+  reg_Jcc,          ///< Jcc  label of fused compare and branch cmd_list[arg]
+} reg_code_e;
+
+/// Register code command
+typedef struct reg_cmd
+{
+  reg_code_e cmd;   ///< Register command type
+  long arg;         ///< Immediate, variable index, or index in cmd_list
+} reg_cmd_s;
+
+/// Smallest capacity of assembly command, string and variable tables
+#define MIN_ASM_ARRAY 16
+
+/*
+ * ==================================
+ * Native backend data structures
+ * ==================================
+ */
+
+/// Load address of code segment of natively generated executables
+#define NATIVE_TEXT_ADDR 0x400000
+/// End of addresses natively generated executables may use, as code
+/// encodes addresses of data as sign extended 32 bit values
+#define NATIVE_ADDR_END 0x80000000UL
+/// Size of output buffer 'obuf' of header.asm, and of the interpreter
+#define OBUF_SIZE 4096
+/// Size of input buffer 'ibuf' of header.asm, and of the interpreter
+#define IBUF_SIZE 65536
+/// Seconds an executable run by verify_native_bin() may take
+#define VERIFY_TIMEOUT 10
+
+/// Growable buffer of x86-64 machine code or data bytes
+typedef struct x64_buf
+{
+  unsigned char *data;  ///< bytes emitted so far
+  size_t len;           ///< number of bytes emitted
+  size_t cap;           ///< allocated size of data
+  size_t *relocs;       ///< offsets of 32 bit data segment addresses
+  size_t relocs_len;    ///< number of relocs
+  size_t relocs_cap;    ///< allocated number of relocs
+} x64_buf_s;
+
+/// Offsets of runtime data in the data segment, mirrors header.asm; code
+/// and data hold them as relocations until the segment address is known
+typedef struct x64_layout
+{
+  unsigned pairs_addr;  ///< 'pairs', two digit table of O_PRTI
+  unsigned strs_addr;   ///< 'strs', string address table
+  unsigned lens_addr;   ///< 'lens', string length table
+  unsigned data_addr;   ///< 'data', integer variables
+  unsigned olen_addr;   ///< 'olen', number of bytes in output buffer
+  unsigned ipos_addr;   ///< 'ipos', index of next byte in input buffer
+  unsigned iend_addr;   ///< 'iend', number of bytes in input buffer
+  unsigned obuf_addr;   ///< 'obuf', output buffer of OBUF_SIZE bytes
+  unsigned ibuf_addr;   ///< 'ibuf', input buffer of IBUF_SIZE bytes
+  unsigned file_len;    ///< bytes of data segment stored in the file
+  unsigned mem_len;     ///< bytes of data segment in memory
+} x64_layout_s;
 
-/// Maximum ASM commands
-#define MAX_ASM_CMD 4096
+/*
+ * ==================================
+ * Interpreter data structures
+ * ==================================
+ */
 
-/// Maximum strings in program
-#define MAX_STR 4096
+/// Interpreter instruction, with label of a jump resolved to an index
+typedef struct vm_insn
+{
+  const void *op;   ///< Address of handler in vm_run(), once threaded
+  long arg;         ///< Integer, variable index or jump target index
+  asm_code_e cmd;   ///< Command of instruction
+} vm_insn_s;
 
-/// Maximum variables
-#define MAX_VAR 4096
+/// Program loaded for the interpreter from an assembly code list
+typedef struct vm_prog
+{
+  vm_insn_s *code;      ///< Instructions, without labels, ending in HALT
+  unsigned code_len;    ///< Number of instructions
+  char **strs;          ///< Strings as printed, with NULL counted in length
+  long *str_lens;       ///< Length of each string
+  unsigned strs_len;    ///< Number of strings
+  unsigned vars_len;    ///< Number of variables
+  unsigned stack_len;   ///< Maximum stack depth, found by vm_load()
+  bool threaded;        ///< Handler addresses of code are set
+} vm_prog_s;
+
+/// Input buffer of interpreter, 'ibuf', 'ipos' and 'iend' of header.asm
+typedef struct vm_in
+{
+  int fd;                       ///< File descriptor read by refills
+  long pos;                     ///< Index of next byte in buffer
+  long end;                     ///< Number of bytes in buffer
+  unsigned char buf[IBUF_SIZE]; ///< Bytes read and not yet converted
+} vm_in_s;
+
+/// Output buffer of interpreter, 'obuf' and 'olen' of header.asm
+typedef struct vm_out
+{
+  int fd;                       ///< File descriptor written by flushes
+  long len;                     ///< Number of bytes in buffer
+  unsigned char buf[OBUF_SIZE]; ///< Bytes printed and not yet written
+} vm_out_s;
 
-asm_cmd_e asm_cmd_list[MAX_ASM_CMD] = { {0} }; ///< Assembly commands list
-unsigned int asm_cmd_list_len = 0;  ///< Assembly commands list length
+/*
+ * ==================================
+ * Compilation arena
+ * ==================================
+ */
 
-char *strs[MAX_STR] = { 0 };   ///< Strings used in program
-unsigned int strs_len = 0;  ///< Strings used count
+/// Bytes in an arena chunk, bigger requests get a chunk of their own
+#define ARENA_CHUNK_SIZE 65536
 
-char *vars[MAX_VAR] = { 0 };   ///< Vars used in program
-unsigned int vars_len = 0;  ///< Vars used count
+/// Alignment of arena allocations
+#define ARENA_ALIGN 8
 
-unsigned int int_count = 0; ///< Integers used
-unsigned int usr_vars = 0;  ///< User input varss used count
+/// Chunk of the compilation arena, allocations are bumped off its front
+typedef struct arena_chunk
+{
+  struct arena_chunk *next;     ///< Chunk filled before this one
+  size_t used;                  ///< Bytes handed out
+  size_t cap;                   ///< Bytes in data
+  unsigned char data[];         ///< Memory handed out by arena_alloc()
+} arena_chunk_s;
+
+/*
+ * ==================================
+ * Binary IR files
+ * ==================================
+ */
+
+/// Version of .otk and .oast files, bumped when their layout changes
+#define IR_VERSION 1
+/// Magic number of token stream files saved by ALEX
+#define OTK_MAGIC "OTK"
+/// Magic number of syntax tree files saved by ASTRO
+#define OAST_MAGIC "OAST"
+
+/// Kind of a binary IR file
+typedef enum ir_kind
+{
+  ir_None = 0,      ///< Not a binary IR file, eg - OPaL source
+  ir_Tokens,        ///< .otk token stream, the symbol table of ALEX
+  ir_Ast,           ///< .oast abstract syntax tree of ASTRO
+} ir_kind_e;
+
+/**
+ * Header of .otk and .oast files. It is followed by one word per interned
+ * symbol, its name length shifted left by one with the low bit set for
+ * strings, then the token arrays (type, line, column, value) or the node
+ * pool, then the NUL terminated symbol names. Words are in host byte order,
+ * so a file of a host of other byte order fails the version check. Files are
+ * mapped back in, and the token arrays or node pool used where they lie.
+ */
+typedef struct ir_header
+{
+  char magic[4];        ///< OTK_MAGIC or OAST_MAGIC, NUL padded
+  uint32_t version;     ///< IR_VERSION
+  uint32_t syms_len;    ///< Interned symbols
+  uint32_t names_len;   ///< Bytes of symbol names, with their NULs
+  uint32_t len;         ///< Tokens, or nodes counting node 0
+  uint32_t root;        ///< Root node of the syntax tree, 0 in .otk files
+  uint32_t tokens;      ///< Tokens the syntax tree was parsed from
+  uint32_t reserved;    ///< Zero
+} ir_header_s;
+
+/*
+ * ==================================
+ * Compiler context
+ * ==================================
+ */
+
+/**
+ * Compiler context, owns all state of one compilation: file names and
+ * pointers, lexer position, parser cursor, generated code tables and logging.
+ * Every libopal API takes the context as its first argument, so separate
+ * contexts can compile separate programs in parallel threads of one process.
+ */
+typedef struct opal_ctx
+{
+  char *source_fn;              ///< Input source file name
+  char *dest_fn;                ///< Destination file name
+  char *log_fn;                 ///< Log file name
+  char *report_fn;              ///< Report file name
+  const char *css_fn;           ///< HTML CSS file name
+
+  FILE *source_fp;              ///< Source file pointer
+  FILE *dest_fp;                ///< Destination file pointer
+  FILE *log_fp;                 ///< Log file pointer
+  FILE *report_fp;              ///< Report file pointer
+
+  short retVal;                 ///< Function return value
+  short log_level;              ///< Current log level
+  char perror_msg[perror_msg_len];  ///< Message string for perror()
+  jmp_buf *abort_jmp;           ///< Return point for opal_abort(), or NULL
+  stage_buf_s *stages;          ///< Stages of stage_new(), see opal_ctx_free()
+
+  int next_char;                ///< Next character in source file
+  int char_col;                 ///< Column number of character in source file
+  int char_line;                ///< Line number of character in source file
+  char *src_buf;                ///< Source read whole for the lexer
+  size_t src_len;               ///< Source length in bytes
+  size_t src_pos;               ///< Offset of next character in src_buf
+  size_t src_line;              ///< Offset of start of current line in src_buf
+  size_t src_eof_reads;         ///< Reads past end of src_buf, in the column
+  lexeme_s next_lexeme;         ///< Struct to hold next lexeme
+  char lexeme_str[lexeme_str_len];  ///< Stringified lexeme for printing
+  intern_sym_s *syms;           ///< Identifiers and strings interned by ALEX
+  unsigned int syms_len;        ///< Interned symbols count
+  unsigned int syms_cap;        ///< Interned symbols capacity
+  unsigned int *sym_index;      ///< Hash index of syms, holds index + 1 or 0
+  unsigned int sym_index_cap;   ///< Hash index capacity, a power of two
+
+  token_table_s *ast_tokens;    ///< Symbol table being parsed by ASTRO
+  unsigned int ast_pos;         ///< Position of token being parsed by ASTRO
+  unsigned int ast_mask;        ///< Mask of ast_pos into ast_tokens, all
+                                ///< ones unless streaming through a ring
+  node_s *nodes;                ///< Syntax tree node pool, node 0 unused
+  unsigned int nodes_len;       ///< Nodes in pool, counting node 0
+  unsigned int nodes_cap;       ///< Node pool capacity
+  bool nodes_mapped;            ///< Node pool lies in ir_map, not owned
+  void *ir_map;                 ///< Binary IR file mapped in, or NULL
+  size_t ir_map_len;            ///< Length of ir_map
+
+  asm_cmd_e *asm_cmd_list;              ///< Assembly commands list
+  unsigned int asm_cmd_list_len;        ///< Assembly commands list length
+  unsigned int asm_cmd_list_cap;        ///< Assembly commands list capacity
+  char **strs;                  ///< Strings used in program
+  unsigned int strs_len;        ///< Strings used count
+  unsigned int strs_cap;        ///< Strings capacity
+  char **vars;                  ///< Vars used in program
+  unsigned int vars_len;        ///< Vars used count
+  unsigned int vars_cap;        ///< Vars capacity
+  arena_chunk_s *arena;         ///< Arena of lexemes, nodes, strings, tables
+  size_t arena_used;            ///< Bytes handed out by the arena
+  size_t arena_size;            ///< Bytes held in arena chunks
+  unsigned int arena_chunks;    ///< Chunks held by the arena
+  bool tos_cache;               ///< Keep top of stack in registers
+  bool branchless;              ///< Set comparison results with SETcc
+  unsigned peephole;            ///< Mask of enabled peephole rules
+  unsigned peephole_hits[ph_Rules]; ///< Rewrites made by each peephole rule
+} opal_ctx_s;
 
 /*
  * ==================================
  * COMMON FUNCTION DECLARATIONS
  * ==================================
  */
+/// Allocate compiler context with default settings
+opal_ctx_s* opal_ctx_new (void);
+/// Free compiler context
+void opal_ctx_free (opal_ctx_s*);
+/// Allocate zeroed memory from compilation arena
+void* arena_alloc (opal_ctx_s*, size_t);
+/// Resize memory allocated from compilation arena
+void* arena_realloc (opal_ctx_s*, void*, size_t, size_t);
+/// Copy string into compilation arena
+char* arena_strdup (opal_ctx_s*, const char*);
+/// Format high-water mark of compilation arena
+void arena_summary (opal_ctx_s*, char*, size_t);
+/// Free compilation arena, with everything allocated from it
+void free_arena (opal_ctx_s*);
+/// Read rest of stream into a NUL terminated buffer
+char* read_stream (opal_ctx_s*, FILE*, size_t*);
+/// Push zeroed entry on walk stack
+void* walk_push (opal_ctx_s*, walk_stack_s*);
+/// Pop top entry of walk stack
+void* walk_pop (walk_stack_s*);
+/// Free entries of walk stack
+void walk_free (walk_stack_s*);
+/// Kind of binary IR file, by its magic number
+ir_kind_e ir_file_kind (const char*);
 /// Print formatted message to log file
-void opal_log (log_level_e, const char*, int, const char*, const char*, ...);
+void opal_log (opal_ctx_s*, log_level_e, const char*, int, const char*,
+               const char*, ...);
 /// Print a banner with stars above and below given string
-void banner (const char*);
+void banner (opal_ctx_s*, const char*);
 /// Close open files, flush buffers and exit
-short opal_exit (short);
+short opal_exit (opal_ctx_s*, short);
+/// Log error, close open files and exit
+short opal_error (opal_ctx_s*, short, char*, int, char*, ...);
+/// Close open files and exit, or return to caller's opal_ctx_s.abort_jmp
+void opal_abort (opal_ctx_s*, short);
 /// Read next character from source file
-int read_next_char(void);
+int read_next_char (opal_ctx_s*);
 /// Initialize HTML report
-short init_report (FILE*);
+short init_report (opal_ctx_s*, FILE*);
 /// Close HTML report
-short close_report(FILE*);
+short close_report (opal_ctx_s*, FILE*);
+/// Create stage output owned by the context
+stage_buf_s* stage_new (opal_ctx_s*, const char*);
+/// Open stage output for writing
+FILE* stage_open_write (opal_ctx_s*, stage_buf_s*);
+/// Open stage output for reading
+FILE* stage_open_read (opal_ctx_s*, stage_buf_s*);
+/// Close stream open on stage output
+short stage_close (opal_ctx_s*, stage_buf_s*);
+/// Close stage stream and free stage buffer
+void stage_free (opal_ctx_s*, stage_buf_s*);
 
 /*
  * ==================================
@@ -375,11 +658,11 @@ short close_report(FILE*);
  * ==================================
  */
 /// Read source, remove comments, write to destination
-short rem_comments(FILE*, FILE*);
+short rem_comments (opal_ctx_s*, FILE*, FILE*);
 /// Process include files, write to destination
-short proc_includes(FILE*, FILE*);
+short proc_includes (opal_ctx_s*, FILE*, FILE*);
 /// Append MARC output to HTML report file
-short print_marc_html(FILE*, FILE*);
+short print_marc_html (opal_ctx_s*, FILE*, FILE*);
 
 /*
  * ==================================
@@ -387,27 +670,40 @@ short print_marc_html(FILE*, FILE*);
  * ==================================
  */
 /// Get lexeme for a string literal
-lexeme_s get_string_literal_lexeme(int, int);
+lexeme_s get_string_literal_lexeme (opal_ctx_s*, int, int);
 /// Get lexeme for binary or unary operator
-lexeme_type_e binary_unary (char, lexeme_type_e, lexeme_type_e, int, int);
+lexeme_type_e binary_unary (opal_ctx_s*, char, lexeme_type_e, lexeme_type_e,
+                            int, int);
 /// Get identifier lexeme
-lexeme_s get_identifier_lexeme (int, int);
+lexeme_s get_identifier_lexeme (opal_ctx_s*, int, int);
 /// Get the next lexeme
-lexeme_s get_next_lexeme(void);
+lexeme_s get_next_lexeme (opal_ctx_s*);
 /// Stringify lexeme
 short get_lexeme_str(const lexeme_s*, char*, int);
+/// Get interned symbol of identifier or string, add if missing
+int intern_symbol (opal_ctx_s*, const char*, size_t, bool);
+/// Read source file pointer into the lexer buffer
+short open_lexer (opal_ctx_s*);
+/// Release the lexer buffer
+void close_lexer (opal_ctx_s*);
+/// Lex next token into next_lexeme
+short lex_token (opal_ctx_s*);
+/// Lex next token into slot of a token ring
+short stream_token (opal_ctx_s*, token_table_s*, unsigned);
 /// Populate symbol table with lexemes in source file pointer
-short build_symbol_table (lexeme_s*, int*);
+short build_symbol_table (opal_ctx_s*, token_table_s*, int*);
+/// Get lexeme for token at position in symbol table
+lexeme_s get_token (opal_ctx_s*, const token_table_s*, unsigned);
 /// Print symbol table to destination file pointer
-short print_symbol_table (lexeme_s*, FILE*);
-/// Determine if regular expression is an integer
-bool match(const char *str, const char *pattern);
+short print_symbol_table (opal_ctx_s*, token_table_s*, FILE*);
 /// Print symbol table to HTML report
-short print_symbol_table_html (lexeme_s*, FILE*);
-/// Free symbol table linked list
-void free_symbol_table (lexeme_s*);
+short print_symbol_table_html (opal_ctx_s*, token_table_s*, FILE*);
+/// Save symbol table and interned symbols to .otk file
+short save_tokens (opal_ctx_s*, const token_table_s*, const char*);
+/// Map symbol table and interned symbols in from .otk file
+short load_tokens (opal_ctx_s*, token_table_s*, const char*);
 /// Traverse syntax tree for output file generation
-void traverse_ast (node_s *node, FILE *dest_fp);
+void traverse_ast (opal_ctx_s*, node_id node, FILE *dest_fp);
 
 /*
  * ==================================
@@ -415,27 +711,31 @@ void traverse_ast (node_s *node, FILE *dest_fp);
  * ==================================
  */
 /// Build abstract syntax tree from symbol table
-node_s* build_syntax_tree (lexeme_s*);
+node_id build_syntax_tree (opal_ctx_s*, token_table_s*);
+/// Build syntax tree node with given child nodes
+node_id make_ast_node (opal_ctx_s*, ast_node_type_e, node_id, node_id);
 /// Build and return statement node
-node_s* make_statement_node(void);
+node_id make_statement_node (opal_ctx_s*);
 /// Build and return expression inside parantheses
-node_s *make_parentheses_expression(void);
+node_id make_parentheses_expression (opal_ctx_s*);
 /// Build expression node
-node_s *make_expression_node(int);
+node_id make_expression_node (opal_ctx_s*, int);
 /// Check if lexeme is expected type, else print error and exit
-void expect_lexeme(lexeme_type_e);
+void expect_lexeme (opal_ctx_s*, lexeme_type_e);
 /// Build and return leaf nodes for identifier/integer/strings
-node_s *make_leaf_node(ast_node_type_e, lexeme_s*);
+node_id make_leaf_node (opal_ctx_s*, ast_node_type_e, unsigned);
 /// Optimize the abstract syntax tree
-node_s* optimize_syntax_tree(node_s*);
+node_id optimize_syntax_tree (opal_ctx_s*, node_id);
 /// Print abstract syntax tree to destination file
-short print_ast (node_s*, FILE*);
+short print_ast (opal_ctx_s*, node_id, FILE*);
 /// Traverse abstract syntax tree pre-order
-void traversePreOrder_grah (node_s*, FILE*, int);
+void traversePreOrder_graph (opal_ctx_s*, node_id, FILE*, int);
 /// Print abstract syntax tree to HTML report
-short print_ast_html (node_s*, FILE*);
-/// Free syntax tree
-void free_syntax_tree (node_s*);
+short print_ast_html (opal_ctx_s*, node_id, FILE*);
+/// Save syntax tree node pool and interned symbols to .oast file
+short save_ast (opal_ctx_s*, node_id, int, const char*);
+/// Map syntax tree node pool and interned symbols in from .oast file
+node_id load_ast (opal_ctx_s*, const char*, int*);
 
 /*
  * ==================================
@@ -443,19 +743,27 @@ void free_syntax_tree (node_s*);
  * ==================================
  */
 /// Append ASM code to array
-void add_asm_code (asm_code_e, int, char*);
+void add_asm_code (opal_ctx_s*, asm_code_e, int, char*);
 /// Build assembly code list from abstract syntax tree
-void gen_asm_code(node_s*);
+void gen_asm_code (opal_ctx_s*, node_id);
+/// Rewrite assembly code list with enabled peephole rules
+void peephole_asm_code (opal_ctx_s*);
+/// Parse comma separated list of peephole rules into a mask
+short parse_peephole_rules (const char*, unsigned*);
+/// Format hit count of each peephole rule
+void peephole_summary (opal_ctx_s*, char*, size_t);
+/// Build register code from assembly code list, caching top of stack
+int gen_reg_code (opal_ctx_s*, asm_cmd_e[], reg_cmd_s**);
 /// Print assembly code list
-short print_asm_code(asm_cmd_e[], FILE*);
+short print_asm_code (opal_ctx_s*, asm_cmd_e[], FILE*);
 /// Print assembly code list to HTML report file
-short print_asm_code_html(asm_cmd_e[], FILE*);
+short print_asm_code_html (opal_ctx_s*, asm_cmd_e[], FILE*);
 /// Create Identifier array
-int add_var(char*);
+int add_var (opal_ctx_s*, int);
 /// Create String array
-int add_str(char*);
-/// Free memory used by ASM arrays
-short free_asm_arrays();
+int add_str (opal_ctx_s*, int);
+/// Size ASM arrays for the lexeme count and interned symbols of ALEX
+void reserve_asm_arrays (opal_ctx_s*, int);
 
 /*
  * ==================================
@@ -463,8 +771,24 @@ short free_asm_arrays();
  * ==================================
  */
 /// Assemble object using NASM
-short gen_obj(char*, char*);
+short gen_obj (opal_ctx_s*, char*, char*);
 /// Link object using LD
-short gen_bin(char*, char*);
+short gen_bin (opal_ctx_s*, char*, char*);
+/// Write static ELF executable from assembly code list, without NASM or LD
+short gen_native_bin (opal_ctx_s*, asm_cmd_e[], char*);
+/// Run native and NASM built executables on same input, compare behaviour
+short verify_native_bin (opal_ctx_s*, char*, char*, char*);
+
+/*
+ * ==================================
+ * INTERPRETER FUNCTION DECLARATIONS
+ * ==================================
+ */
+/// Load assembly code list into a program for the interpreter
+vm_prog_s* vm_load (opal_ctx_s*, asm_cmd_e[]);
+/// Execute program, return its exit status
+int vm_run (opal_ctx_s*, vm_prog_s*, int, int);
+/// Free program loaded by vm_load()
+void vm_free (vm_prog_s*);
 
 #endif /* OPAL_H_ */
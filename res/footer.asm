@@ -1,9 +1,23 @@
   ;=== User code end ===;
 
 SECTION .bss
-  bss0 RESB 255          ; reserve 255 bytes for user input
+  olen RESQ 1            ; number of bytes in output buffer
+  ipos RESQ 1            ; index of next byte in input buffer
+  iend RESQ 1            ; number of bytes in input buffer
+  obuf RESB OBUF_SIZE    ; output buffer of O_PRTS and O_PRTI
+  ibuf RESB IBUF_SIZE    ; input buffer of _INPUT_
 
 SECTION .data
-  char  DB 0             ; Used for user input
+  ; Two ASCII digits of each number from 0 to 99, used by O_PRTI
+  pairs DB "00010203040506070809"
+        DB "10111213141516171819"
+        DB "20212223242526272829"
+        DB "30313233343536373839"
+        DB "40414243444546474849"
+        DB "50515253545556575859"
+        DB "60616263646566676869"
+        DB "70717273747576777879"
+        DB "80818283848586878889"
+        DB "90919293949596979899"
 
   ;=== User variables ===;
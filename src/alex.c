@@ -36,6 +36,8 @@ static struct argp_option options[] =       ///< The options we understand
     { "output", 'o', "FILE", 0, "Output to FILE instead of standard ouput" },
     { "report", 'r', "FILE", 0,
         "Output report to FILE instead of 'report/oc_report.html'" },
+    { "ir", 'i', "FILE", 0,
+        "Also save tokens to FILE in binary .otk format, for astro and genie" },
     { 0 }
   };
 
@@ -43,9 +45,11 @@ static struct argp_option options[] =       ///< The options we understand
 struct arguments
 {
   char *args[1];     ///< Source file
+  bool debug;        ///< Log debug messages
   char *logfile;     ///< filename for logger
   char *destfile;    ///< filename for destination file
   char *report;      ///< filename for html report
+  char *ir;          ///< filename for binary .otk tokens
 };
 
 static error_t
@@ -60,7 +64,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
     {
 
     case 'd':
-      LOG_LEVEL = DEBUG;
+      arguments->debug = true;
       break;
 
     case 'l':
@@ -75,6 +79,10 @@ parse_opt (int key, char *arg, struct argp_state *state)
       arguments->report = arg;
       break;
 
+    case 'i':
+      arguments->ir = arg;
+      break;
+
     case ARGP_KEY_ARG:
       if (state->arg_num >= 1)      // Too many arguments
         argp_usage (state);
@@ -116,96 +124,106 @@ main (int argc, char **argv)
 
   /// Create structure to process command line arguments
   struct arguments arguments =
-    { .destfile = NULL, .logfile = NULL, .report = NULL };
+    { .destfile = NULL, .logfile = NULL, .report = NULL, .ir = NULL };
 
   /// Parse arguments
   argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
+  /// Create compilation context, else exit program
+  opal_ctx_s *ctx = opal_ctx_new ();
+  if (ctx == NULL)
+    {
+      perror ("opal_ctx_new()");
+      return (EXIT_FAILURE);
+    }
+  if (arguments.debug)
+    ctx->log_level = DEBUG;
+
   /// Populate variables for source, destination, log, report files
-  source_fn = strdup (arguments.args[0]);
-  dest_fn = arguments.destfile ? strdup (arguments.destfile) : NULL;
-  log_fn =
+  ctx->source_fn = strdup (arguments.args[0]);
+  ctx->dest_fn = arguments.destfile ? strdup (arguments.destfile) : NULL;
+  ctx->log_fn =
       arguments.logfile ? strdup (arguments.logfile) : strdup ("log/oc_log");
-  report_fn =
+  ctx->report_fn =
       arguments.report ?
           strdup (arguments.report) : strdup ("report/oc_report.html");
 
   /// Open log file in append mode, else exit program
-  sprintf (perror_msg, "log_fp = fopen(%s, 'a')", log_fn);
+  sprintf (ctx->perror_msg, "log_fp = fopen(%s, 'a')", ctx->log_fn);
   errno = EXIT_SUCCESS;
-  log_fp = fopen (log_fn, "a");
+  ctx->log_fp = fopen (ctx->log_fn, "a");
   if (errno != EXIT_SUCCESS)
     {
       _FAIL;
-      perror (perror_msg);
-      return (opal_exit (EXIT_FAILURE));
+      perror (ctx->perror_msg);
+      return (opal_exit (ctx, EXIT_FAILURE));
     }
 
-  banner ("Main start.");
-  logger(DEBUG, "Log: %s", log_fn);
-  logger(DEBUG, "source_fn: '%s'", source_fn);
-  logger(DEBUG, "report_fn: '%s'", report_fn);
+  banner (ctx, "Main start.");
+  logger(DEBUG, "Log: %s", ctx->log_fn);
+  logger(DEBUG, "source_fn: '%s'", ctx->source_fn);
+  logger(DEBUG, "report_fn: '%s'", ctx->report_fn);
 
   /// If source file does not exist, print error and exit
-  sprintf (perror_msg, "access('%s', F_OK)", source_fn);
-  logger(DEBUG, perror_msg);
-  if (access (source_fn, F_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, F_OK) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// If source file can not be read, print error and exit
-  sprintf (perror_msg, "access('%s', R_OK)", source_fn);
-  logger(DEBUG, perror_msg);
-  if (access (source_fn, R_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', R_OK)", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, R_OK) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// If destination is file
-  if (dest_fn)
+  if (ctx->dest_fn)
     {
-      logger(DEBUG, "dest_fn: %s", dest_fn);
+      logger(DEBUG, "dest_fn: %s", ctx->dest_fn);
 
       /// Check if destination file exists
-      sprintf (perror_msg, "access('%s', F_OK)", dest_fn);
-      logger(DEBUG, perror_msg);
-      if (access (dest_fn, F_OK) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->dest_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (access (ctx->dest_fn, F_OK) == EXIT_SUCCESS)
         {
           _PASS;
 
           /// If destination file can't be written, print error and exit
-          sprintf (perror_msg, "access('%s', W_OK)", dest_fn);
-          logger(DEBUG, perror_msg);
-          if (access (dest_fn, W_OK) == EXIT_SUCCESS)
+          sprintf (ctx->perror_msg, "access('%s', W_OK)", ctx->dest_fn);
+          logger(DEBUG, ctx->perror_msg);
+          if (access (ctx->dest_fn, W_OK) == EXIT_SUCCESS)
             _PASS;
           else
             {
               _FAIL;
-              perror (perror_msg);
+              perror (ctx->perror_msg);
               return (errno);
             }
         }
 
       /// Open destination file in 'wb' mode
-      sprintf (perror_msg, "dest_fp = fopen('%s', 'wb')", dest_fn);
-      logger(DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "dest_fp = fopen('%s', 'wb')", ctx->dest_fn);
+      logger(DEBUG, ctx->perror_msg);
       errno = EXIT_SUCCESS;
-      dest_fp = fopen (dest_fn, "wb");
+      ctx->dest_fp = fopen (ctx->dest_fn, "wb");
       if (errno == EXIT_SUCCESS)
         _PASS;
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
@@ -213,70 +231,70 @@ main (int argc, char **argv)
   else
     {
       logger(DEBUG, "Destination: STDOUT");
-      dest_fp = stdout;
+      ctx->dest_fp = stdout;
     }
 
   /// Open source file in read-only mode
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", source_fn);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "source_fp = fopen('%s', 'r')", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  source_fp = fopen (source_fn, "r");
+  ctx->source_fp = fopen (ctx->source_fn, "r");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Check if report file exists
-  sprintf (perror_msg, "access('%s', F_OK)", report_fn);
-  logger(DEBUG, perror_msg);
-  if (access (report_fn, F_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->report_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->report_fn, F_OK) == EXIT_SUCCESS)
     {
       /// Truncate report file
-      sprintf (perror_msg, "ftruncate(report_fn, 0)");
-      logger(DEBUG, perror_msg);
-      if (truncate (report_fn, 0) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "ftruncate(report_fn, 0)");
+      logger(DEBUG, ctx->perror_msg);
+      if (truncate (ctx->report_fn, 0) == EXIT_SUCCESS)
         _PASS;
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// If report file can not be written, print error and exit
-  sprintf (perror_msg, "report_fp = fopen('%s', 'a')", report_fn);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "report_fp = fopen('%s', 'a')", ctx->report_fn);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  report_fp = fopen (report_fn, "a");
+  ctx->report_fp = fopen (ctx->report_fn, "a");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Initialize HTML report file
-  retVal = init_report(report_fp);
-  if (retVal != EXIT_SUCCESS)
-    opal_exit(retVal);
+  ctx->retVal = init_report(ctx, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    opal_exit(ctx, ctx->retVal);
 
   /// Call MARC functions to pre-process source file
-  banner ("MARC start.");
+  banner (ctx, "MARC start.");
 
   /// Create and open temp destination file for remove_comments()
   char *rc_tmp = "tmp/marc_rc.tmp";
   logger(DEBUG, "rc_tmp: '%s'", rc_tmp);
 
   /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   FILE *rc_fp = fopen (rc_tmp, "wb");
   if (errno == EXIT_SUCCESS)
@@ -284,36 +302,36 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Remove comments from source with rem_comments(), write to rc_tmp
-  retVal = rem_comments (source_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  ctx->retVal = rem_comments (ctx, ctx->source_fp, rc_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Close source file pointer source_fp if not NULL
-  sprintf (perror_msg, "fclose(source_fp)");
-  logger(DEBUG, perror_msg);
-  if (source_fp)
+  sprintf (ctx->perror_msg, "fclose(source_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (ctx->source_fp)
     {
-      if (fclose (source_fp) == EXIT_SUCCESS)
+      if (fclose (ctx->source_fp) == EXIT_SUCCESS)
         {
           _PASS;
-          source_fp = NULL;
+          ctx->source_fp = NULL;
         }
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// Close rem_comments() temp file pointer rc_fp if not NULL
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(rc_fp)");
+  logger(DEBUG, ctx->perror_msg);
   if (rc_fp)
     {
       if (fclose (rc_fp) == EXIT_SUCCESS)
@@ -324,14 +342,14 @@ main (int argc, char **argv)
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// Open rem_comments() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   rc_fp = fopen (rc_tmp, "r");
   if (errno == EXIT_SUCCESS)
@@ -339,7 +357,7 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
@@ -348,8 +366,8 @@ main (int argc, char **argv)
   logger(DEBUG, "pi_tmp: '%s'", pi_tmp);
 
   /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   FILE *pi_fp = fopen (pi_tmp, "wb");
   if (errno == EXIT_SUCCESS)
@@ -357,22 +375,22 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Process #include directives from source with proc_includes()
-  retVal = proc_includes (rc_fp, pi_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = proc_includes (ctx, rc_fp, pi_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Close rem_comments temp file pointer if not NULL
   if (rc_fp)
     {
-      sprintf (perror_msg, "fclose(rc_fp)");
-      logger(DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "fclose(rc_fp)");
+      logger(DEBUG, ctx->perror_msg);
 
       if (fclose (rc_fp) == EXIT_SUCCESS)
         {
@@ -382,7 +400,7 @@ main (int argc, char **argv)
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
@@ -390,8 +408,8 @@ main (int argc, char **argv)
   /// Close proc_includes() temp file pointer if not NULL
   if (pi_fp)
     {
-      sprintf (perror_msg, "fclose(pi_fp)");
-      logger(DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "fclose(pi_fp)");
+      logger(DEBUG, ctx->perror_msg);
 
       if (fclose (pi_fp) == EXIT_SUCCESS)
         {
@@ -401,14 +419,14 @@ main (int argc, char **argv)
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// Open proc_includes() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   pi_fp = fopen (pi_tmp, "r");
   if (errno == EXIT_SUCCESS)
@@ -416,13 +434,13 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Open rem_comments() temp file in write mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   rc_fp = fopen (rc_tmp, "wb");
   if (errno == EXIT_SUCCESS)
@@ -430,20 +448,20 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Remove comments from includs files with rem_comments(), write to rc_tmp
-  retVal = rem_comments (pi_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = rem_comments (ctx, pi_fp, rc_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Close proc_includes() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(pi_fp)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(pi_fp)");
+  logger(DEBUG, ctx->perror_msg);
   if (fclose (pi_fp) == EXIT_SUCCESS)
     {
       _PASS;
@@ -452,13 +470,13 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Close rem_comments() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(rc_fp)");
+  logger(DEBUG, ctx->perror_msg);
   if (fclose (rc_fp) == EXIT_SUCCESS)
     {
       _PASS;
@@ -467,13 +485,13 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Open rem_comments() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   rc_fp = fopen (rc_tmp, "r");
   if (errno == EXIT_SUCCESS)
@@ -481,20 +499,20 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Append MARC output to HTML report
-  retVal = print_marc_html(rc_fp, report_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = print_marc_html(ctx, rc_fp, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Close rem_comments() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(rc_fp)");
+  logger(DEBUG, ctx->perror_msg);
   if (fclose (rc_fp) == EXIT_SUCCESS)
     {
       _PASS;
@@ -503,38 +521,38 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Start lexical analyzer code
-  banner ("ALEX start.");
+  banner (ctx, "ALEX start.");
 
   /// Open rem_comments() temp file as source_fp, else print error and exit
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "source_fp = fopen('%s', 'r')", rc_tmp);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  source_fp = fopen (rc_tmp, "r");
+  ctx->source_fp = fopen (rc_tmp, "r");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
-  /// Create symbol table linked list
-  logger(DEBUG, "Create symbol_table linked list node.");
-  lexeme_s *symbol_table = (lexeme_s*) calloc (1, sizeof(lexeme_s));
+  /// Create symbol table of tokens
+  logger(DEBUG, "Create symbol_table token arrays.");
+  token_table_s *symbol_table = arena_alloc (ctx, sizeof(token_table_s));
 
   int symbol_count = 0;                ///< Numbber of lexemes identified
 
   /// Build symbol table using rem_comments() temp file as source
-  retVal = build_symbol_table (symbol_table, &symbol_count);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = build_symbol_table (ctx, symbol_table, &symbol_count);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   logger(DEBUG, "assert(symbol_ct [%d] > 0)", symbol_count);
@@ -542,29 +560,39 @@ main (int argc, char **argv)
   _PASS;
 
   /// Print symbol table with print_symbol_table() to destination
-  retVal = print_symbol_table (symbol_table, dest_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = print_symbol_table (ctx, symbol_table, ctx->dest_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Print symbol table HTML report with print_symbol_table_html()
-  retVal = print_symbol_table_html (symbol_table, report_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = print_symbol_table_html (ctx, symbol_table, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    {
+      return (opal_exit (ctx, ctx->retVal));
+    }
+
+  /// Save symbol table to binary .otk file with save_tokens()
+  if (arguments.ir)
     {
-      return (opal_exit (retVal));
+      ctx->retVal = save_tokens (ctx, symbol_table, arguments.ir);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Close HTML report file
-  retVal = close_report(report_fp);
-  if (retVal != EXIT_SUCCESS)
-    opal_exit(retVal);
+  ctx->retVal = close_report(ctx, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    opal_exit(ctx, ctx->retVal);
 
-  /// Free memory used by symbol_table
-  free_symbol_table (symbol_table);
-  symbol_table = NULL;
+  /// Free lexemes with the arena holding them
+  char arena_mark[128] = { 0 };
+  arena_summary (ctx, arena_mark, sizeof(arena_mark));
+  logger(INFO, "Arena high-water mark: %s.", arena_mark);
+  free_arena (ctx);
 
   /// source_fp, dest_fp, log_fp & report_fp closed by opal_exit()
-  return (opal_exit (EXIT_SUCCESS));
+  return (opal_exit (ctx, EXIT_SUCCESS));
 }
 
@@ -27,7 +27,9 @@ const char *argp_program_bug_address =
     "https://github.com/mckerracher/OPaL/issues";
 
 /// Program documentation
-static char doc[] = "genie - OPaL Compiler - Code generator";
+static char doc[] = "genie - OPaL Compiler - Code generator"
+    "\vFILE is OPaL source, tokens saved by 'alex --ir' (.otk) or a syntax "
+    "tree saved by 'astro --ir' (.oast).";
 static char args_doc[] = "FILE";            ///< Arguments we accept
 static struct argp_option options[] =       ///< The options we understand
   {
@@ -36,6 +38,14 @@ static struct argp_option options[] =       ///< The options we understand
     { "output", 'o', "FILE", 0, "Output to FILE instead of standard ouput" },
     { "report", 'r', "FILE", 0,
         "Output report to FILE instead of 'report/oc_report.html'" },
+    { "tos-cache", 't', 0, 0,
+        "Keep top of stack in registers instead of using stack macros" },
+    { "branchless", 'B', 0, 0,
+        "Set results of comparison and logical operators with SETcc "
+        "instead of conditional jumps" },
+    { "peephole", 'p', "RULES", 0,
+        "Comma separated peephole rules to apply: store-fetch, invert-jump, "
+        "dead-label, jump-next, fuse-compare, 'all' (default) or 'none'" },
     { 0 }
   };
 
@@ -43,9 +53,13 @@ static struct argp_option options[] =       ///< The options we understand
 struct arguments
 {
   char *args[1];     ///< Source file
+  bool debug;        ///< Log debug messages
   char *logfile;     ///< filename for logger
   char *destfile;    ///< filename for destination file
   char *report;      ///< filename for html report
+  bool tos_cache;    ///< Generate code caching top of stack in registers
+  bool branchless;   ///< Generate comparisons without conditional jumps
+  unsigned peephole; ///< Mask of peephole rules to apply
 };
 
 static error_t
@@ -60,7 +74,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
     {
 
     case 'd':
-      LOG_LEVEL = DEBUG;
+      arguments->debug = true;
       break;
 
     case 'l':
@@ -75,6 +89,19 @@ parse_opt (int key, char *arg, struct argp_state *state)
       arguments->report = arg;
       break;
 
+    case 't':
+      arguments->tos_cache = true;
+      break;
+
+    case 'B':
+      arguments->branchless = true;
+      break;
+
+    case 'p':
+      if (parse_peephole_rules (arg, &arguments->peephole) != EXIT_SUCCESS)
+        argp_error (state, "invalid peephole rules: '%s'", arg);
+      break;
+
     case ARGP_KEY_ARG:
       if (state->arg_num >= 1)      // Too many arguments
         argp_usage (state);
@@ -101,7 +128,9 @@ static struct argp argp =
  * to process the user input file. Calls the build_symbol_table() to build
  * symbol table and writes to the destination. Calls build_syntax_tree()
  * to build the abstract syntax tree and writes to destination. Calls gen_asm()
- * to build the assembly code table and write to destination.
+ * to build the assembly code table and write to destination. A binary .otk
+ * or .oast input is mapped in with load_tokens() or load_ast() instead of
+ * running the stages that saved it.
  *
  * @param[in]   argc    Number of command line arguments
  * @param[in]   argv    Vector of individual command line argument strings
@@ -118,95 +147,109 @@ main (int argc, char **argv)
 
   /// Create structure to process command line arguments
   struct arguments arguments =
-    { .destfile = NULL, .logfile = NULL, .report = NULL };
+    { .destfile = NULL, .logfile = NULL, .report = NULL,
+      .peephole = PEEPHOLE_ALL };
 
   /// Parse arguments
   argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
+  /// Create compilation context, else exit program
+  opal_ctx_s *ctx = opal_ctx_new ();
+  if (ctx == NULL)
+    {
+      perror ("opal_ctx_new()");
+      return (EXIT_FAILURE);
+    }
+  if (arguments.debug)
+    ctx->log_level = DEBUG;
+  ctx->tos_cache = arguments.tos_cache;
+  ctx->branchless = arguments.branchless;
+  ctx->peephole = arguments.peephole;
+
   /// Populate variables for source, destination, log, report files
-  source_fn = strdup (arguments.args[0]);
-  dest_fn = arguments.destfile ? strdup (arguments.destfile) : NULL;
-  log_fn =
+  ctx->source_fn = strdup (arguments.args[0]);
+  ctx->dest_fn = arguments.destfile ? strdup (arguments.destfile) : NULL;
+  ctx->log_fn =
       arguments.logfile ? strdup (arguments.logfile) : strdup ("log/oc_log");
-  report_fn =
+  ctx->report_fn =
       arguments.report ?
           strdup (arguments.report) : strdup ("report/oc_report.html");
 
   /// Open log file in append mode, else exit program
-  sprintf (perror_msg, "log_fp = fopen(%s, 'a')", log_fn);
+  sprintf (ctx->perror_msg, "log_fp = fopen(%s, 'a')", ctx->log_fn);
   errno = EXIT_SUCCESS;
-  log_fp = fopen (log_fn, "a");
+  ctx->log_fp = fopen (ctx->log_fn, "a");
   if (errno != EXIT_SUCCESS)
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      return (opal_exit (EXIT_FAILURE));
+      return (opal_exit (ctx, EXIT_FAILURE));
     }
 
-  banner ("Main start.");
-  logger(DEBUG, "Log: %s", log_fn);
-  logger(DEBUG, "source_fn: '%s'", source_fn);
-  logger(DEBUG, "report_fn: '%s'", report_fn);
+  banner (ctx, "Main start.");
+  logger(DEBUG, "Log: %s", ctx->log_fn);
+  logger(DEBUG, "source_fn: '%s'", ctx->source_fn);
+  logger(DEBUG, "report_fn: '%s'", ctx->report_fn);
 
   /// If source file does not exist, print error and exit
-  sprintf (perror_msg, "access('%s', F_OK)", source_fn);
-  logger(DEBUG, perror_msg);
-  if (access (source_fn, F_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, F_OK) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
   /// If source file can not be read, print error and exit
-  sprintf (perror_msg, "access('%s', R_OK)", source_fn);
-  logger(DEBUG, perror_msg);
-  if (access (source_fn, R_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', R_OK)", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, R_OK) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
   /// If destination is file
-  if (dest_fn)
+  if (ctx->dest_fn)
     {
-      logger(DEBUG, "dest_fn: %s", dest_fn);
+      logger(DEBUG, "dest_fn: %s", ctx->dest_fn);
 
       /// Check if destination file exists
-      sprintf (perror_msg, "access('%s', F_OK)", dest_fn);
-      logger(DEBUG, perror_msg);
-      if (access (dest_fn, F_OK) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->dest_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (access (ctx->dest_fn, F_OK) == EXIT_SUCCESS)
         {
           _PASS;
 
           /// If destination file can't be written, print error and exit
-          sprintf (perror_msg, "access('%s', W_OK)", dest_fn);
-          logger(DEBUG, perror_msg);
-          if (access (dest_fn, W_OK) == EXIT_SUCCESS)
+          sprintf (ctx->perror_msg, "access('%s', W_OK)", ctx->dest_fn);
+          logger(DEBUG, ctx->perror_msg);
+          if (access (ctx->dest_fn, W_OK) == EXIT_SUCCESS)
             _PASS;
           else
             {
-              perror (perror_msg);
+              perror (ctx->perror_msg);
               _FAIL;
               return (errno);
             }
         }
 
       /// Open destination file in 'wb' mode
-      sprintf (perror_msg, "dest_fp = fopen('%s', 'wb')", dest_fn);
-      logger(DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "dest_fp = fopen('%s', 'wb')", ctx->dest_fn);
+      logger(DEBUG, ctx->perror_msg);
       errno = EXIT_SUCCESS;
-      dest_fp = fopen (dest_fn, "wb");
+      ctx->dest_fp = fopen (ctx->dest_fn, "wb");
       if (errno == EXIT_SUCCESS)
         _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
@@ -215,186 +258,266 @@ main (int argc, char **argv)
   else
     {
       logger(DEBUG, "Destination: STDOUT");
-      dest_fp = stdout;
+      ctx->dest_fp = stdout;
     }
 
-  /// Open source file in read-only mode
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", source_fn);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  source_fp = fopen (source_fn, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
+  /// A binary IR file saved by alex or astro skips the stages that made it
+  ir_kind_e input_kind = ir_file_kind (ctx->source_fn);
+
+  /// Open source file in read-only mode, unless it is a binary IR file
+  if (input_kind == ir_None)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      sprintf (ctx->perror_msg, "source_fp = fopen('%s', 'r')", ctx->source_fn);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      ctx->source_fp = fopen (ctx->source_fn, "r");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
     }
 
   /// Check if report file exists
-  sprintf (perror_msg, "access('%s', F_OK)", report_fn);
-  logger(DEBUG, perror_msg);
-  if (access (report_fn, F_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->report_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->report_fn, F_OK) == EXIT_SUCCESS)
     {
       /// Truncate report file
-      sprintf (perror_msg, "ftruncate(report_fn, 0)");
-      logger(DEBUG, perror_msg);
-      if (truncate (report_fn, 0) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "ftruncate(report_fn, 0)");
+      logger(DEBUG, ctx->perror_msg);
+      if (truncate (ctx->report_fn, 0) == EXIT_SUCCESS)
         _PASS;
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// If report file can not be written, print error and exit
-  sprintf (perror_msg, "report_fp = fopen('%s', 'a')", report_fn);
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "report_fp = fopen('%s', 'a')", ctx->report_fn);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  report_fp = fopen (report_fn, "a");
+  ctx->report_fp = fopen (ctx->report_fn, "a");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
   /// Initialize HTML report file
-  retVal = init_report(report_fp);
-  if (retVal != EXIT_SUCCESS)
-    opal_exit(retVal);
+  ctx->retVal = init_report(ctx, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    opal_exit(ctx, ctx->retVal);
 
-  /// Call MARC functions to pre-process source file
-  banner ("MARC start.");
+  /// Create symbol table of tokens
+  logger(DEBUG, "Create symbol_table token arrays.");
+  token_table_s *symbol_table = arena_alloc (ctx, sizeof(token_table_s));
 
-  /// Create and open temp destination file for remove_comments()
-  char *rc_tmp = "tmp/marc_rc.tmp";
-  logger(DEBUG, "rc_tmp: '%s'", rc_tmp);
+  int symbol_count = 0;                ///< Number of lexemes identified
 
-  /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  FILE *rc_fp = fopen (rc_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
+  /// Map in the symbol table saved by alex with load_tokens()
+  if (input_kind == ir_Tokens)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      banner (ctx, "ALEX tokens mapped in.");
+      ctx->retVal = load_tokens (ctx, symbol_table, ctx->source_fn);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+      symbol_count = symbol_table->len - 1;
+
+      /// Print symbol table HTML report with print_symbol_table_html()
+      ctx->retVal = print_symbol_table_html (ctx, symbol_table,
+                                             ctx->report_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
     }
+  /// ... or run MARC and ALEX on OPaL source
+  else if (input_kind == ir_None)
+    {
+      /// Call MARC functions to pre-process source file
+      banner (ctx, "MARC start.");
 
-  /// Remove comments from source with rem_comments(), write to rc_tmp
-  retVal = rem_comments (source_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+      /// Create and open temp destination file for remove_comments()
+      char *rc_tmp = "tmp/marc_rc.tmp";
+      logger(DEBUG, "rc_tmp: '%s'", rc_tmp);
 
-  /// Close source file pointer source_fp if not NULL
-  sprintf (perror_msg, "fclose(source_fp)");
-  logger(DEBUG, perror_msg);
-  if (source_fp)
-    {
-      if (fclose (source_fp) == EXIT_SUCCESS)
-        {
-          _PASS;
-          source_fp = NULL;
-        }
+      /// If temp file can not be written, print error and exit
+      sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      FILE *rc_fp = fopen (rc_tmp, "wb");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
-    }
 
-  /// Close rem_comments() temp file pointer rc_fp if not NULL
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
-  if (rc_fp)
-    {
-      if (fclose (rc_fp) == EXIT_SUCCESS)
+      /// Remove comments from source with rem_comments(), write to rc_tmp
+      ctx->retVal = rem_comments (ctx, ctx->source_fp, rc_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      /// Close source file pointer source_fp if not NULL
+      sprintf (ctx->perror_msg, "fclose(source_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (ctx->source_fp)
         {
-          _PASS;
-          rc_fp = NULL;
+          if (fclose (ctx->source_fp) == EXIT_SUCCESS)
+            {
+              _PASS;
+              ctx->source_fp = NULL;
+            }
+          else
+            {
+              perror (ctx->perror_msg);
+              _FAIL;
+              return (errno);
+            }
+        }
+
+      /// Close rem_comments() temp file pointer rc_fp if not NULL
+      sprintf (ctx->perror_msg, "fclose(rc_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (rc_fp)
+        {
+          if (fclose (rc_fp) == EXIT_SUCCESS)
+            {
+              _PASS;
+              rc_fp = NULL;
+            }
+          else
+            {
+              perror (ctx->perror_msg);
+              _FAIL;
+              return (errno);
+            }
         }
+
+      /// Open rem_comments() temp file in read mode, else print error and exit
+      sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      rc_fp = fopen (rc_tmp, "r");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
-    }
 
-  /// Open rem_comments() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  rc_fp = fopen (rc_tmp, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Create and open temp destination file for proc_includes()
+      char *pi_tmp = "tmp/marc_pi.tmp";
+      logger(DEBUG, "pi_tmp: '%s'", pi_tmp);
 
-  /// Create and open temp destination file for proc_includes()
-  char *pi_tmp = "tmp/marc_pi.tmp";
-  logger(DEBUG, "pi_tmp: '%s'", pi_tmp);
+      /// If temp file can not be written, print error and exit
+      sprintf (ctx->perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      FILE *pi_fp = fopen (pi_tmp, "wb");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
 
-  /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  FILE *pi_fp = fopen (pi_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Process #include directives from source with proc_includes()
+      ctx->retVal = proc_includes (ctx, rc_fp, pi_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        {
+          return (opal_exit (ctx, ctx->retVal));
+        }
 
-  /// Process #include directives from source with proc_includes()
-  retVal = proc_includes (rc_fp, pi_fp);
-  if (retVal != EXIT_SUCCESS)
-    {
-      return (opal_exit (retVal));
-    }
+      /// Close rem_comments temp file pointer if not NULL
+      if (rc_fp)
+        {
+          sprintf (ctx->perror_msg, "fclose(rc_fp)");
+          logger(DEBUG, ctx->perror_msg);
 
-  /// Close rem_comments temp file pointer if not NULL
-  if (rc_fp)
-    {
-      sprintf (perror_msg, "fclose(rc_fp)");
-      logger(DEBUG, perror_msg);
+          if (fclose (rc_fp) == EXIT_SUCCESS)
+            {
+              _PASS;
+              rc_fp = NULL;
+            }
+          else
+            {
+              perror (ctx->perror_msg);
+              _FAIL;
+              return (errno);
+            }
+        }
 
-      if (fclose (rc_fp) == EXIT_SUCCESS)
+      /// Close proc_includes() temp file pointer if not NULL
+      if (pi_fp)
         {
-          _PASS;
-          rc_fp = NULL;
+          sprintf (ctx->perror_msg, "fclose(pi_fp)");
+          logger(DEBUG, ctx->perror_msg);
+
+          if (fclose (pi_fp) == EXIT_SUCCESS)
+            {
+              _PASS;
+              pi_fp = NULL;
+            }
+          else
+            {
+              perror (ctx->perror_msg);
+              _FAIL;
+              return (errno);
+            }
         }
+
+      /// Open proc_includes() temp file in read mode, else print error and exit
+      sprintf (ctx->perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      pi_fp = fopen (pi_tmp, "r");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
-    }
 
-  /// Close proc_includes() temp file pointer if not NULL
-  if (pi_fp)
-    {
-      sprintf (perror_msg, "fclose(pi_fp)");
-      logger(DEBUG, perror_msg);
+      /// Open rem_comments() temp file in write mode, else print error and exit
+      sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      rc_fp = fopen (rc_tmp, "wb");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
 
+      /// Remove comments from includes files with rem_comments(), write to
+      /// rc_tmp
+      ctx->retVal = rem_comments (ctx, pi_fp, rc_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      /// Close proc_includes() temp file pointer, else print error and exit
+      sprintf (ctx->perror_msg, "fclose(pi_fp)");
+      logger(DEBUG, ctx->perror_msg);
       if (fclose (pi_fp) == EXIT_SUCCESS)
         {
           _PASS;
@@ -402,248 +525,201 @@ main (int argc, char **argv)
         }
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
-    }
 
-  /// Open proc_includes() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  pi_fp = fopen (pi_tmp, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Close rem_comments() temp file pointer, else print error and exit
+      sprintf (ctx->perror_msg, "fclose(rc_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fclose (rc_fp) == EXIT_SUCCESS)
+        {
+          _PASS;
+          rc_fp = NULL;
+        }
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
 
-  /// Open rem_comments() temp file in write mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  rc_fp = fopen (rc_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Open rem_comments() temp file in read mode, else print error and exit
+      sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      rc_fp = fopen (rc_tmp, "r");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
 
-  /// Remove comments from includes files with rem_comments(), write to rc_tmp
-  retVal = rem_comments (pi_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+      /// Append MARC output to HTML report
+      ctx->retVal = print_marc_html(ctx, rc_fp, ctx->report_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
 
-  /// Close proc_includes() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(pi_fp)");
-  logger(DEBUG, perror_msg);
-  if (fclose (pi_fp) == EXIT_SUCCESS)
-    {
-      _PASS;
-      pi_fp = NULL;
-    }
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Close rem_comments() temp file pointer, else print error and exit
+      sprintf (ctx->perror_msg, "fclose(rc_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fclose (rc_fp) == EXIT_SUCCESS)
+        {
+          _PASS;
+          rc_fp = NULL;
+        }
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
 
-  /// Close rem_comments() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
-  if (fclose (rc_fp) == EXIT_SUCCESS)
-    {
-      _PASS;
-      rc_fp = NULL;
-    }
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Start lexical analyzer code
+      banner (ctx, "ALEX start.");
 
-  /// Open rem_comments() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  rc_fp = fopen (rc_tmp, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+      /// Open rem_comments() temp file as source_fp, else print error and exit
+      sprintf (ctx->perror_msg, "source_fp = fopen('%s', 'r')", rc_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      ctx->source_fp = fopen (rc_tmp, "r");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
 
-  /// Append MARC output to HTML report
-  retVal = print_marc_html(rc_fp, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+      /// Build symbol table using rem_comments() temp file as source
+      ctx->retVal = build_symbol_table (ctx, symbol_table, &symbol_count);
+      if (ctx->retVal != EXIT_SUCCESS)
+          return (opal_exit (ctx, ctx->retVal));
 
-  /// Close rem_comments() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
-  if (fclose (rc_fp) == EXIT_SUCCESS)
-    {
+      logger(DEBUG, "assert(symbol_ct [%d] > 0)", symbol_count);
+      assert(symbol_count > 0);
       _PASS;
-      rc_fp = NULL;
-    }
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
-
-  /// Start lexical analyzer code
-  banner ("ALEX start.");
-
-  /// Open rem_comments() temp file as source_fp, else print error and exit
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  source_fp = fopen (rc_tmp, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
 
-  /// Create symbol table linked list
-  logger(DEBUG, "Create symbol_table linked list node.");
-  lexeme_s *symbol_table = (lexeme_s*) calloc (1, sizeof(lexeme_s));
-
-  int symbol_count = 0;                ///< Number of lexemes identified
+      /// Create and open temp destination file for print_symbol_table()
+      char *alex_tmp = "tmp/alex.tmp";
+      logger(DEBUG, "alex_tmp: '%s'", alex_tmp);
 
-  /// Build symbol table using rem_comments() temp file as source
-  retVal = build_symbol_table (symbol_table, &symbol_count);
-  if (retVal != EXIT_SUCCESS)
-      return (opal_exit (retVal));
-
-  logger(DEBUG, "assert(symbol_ct [%d] > 0)", symbol_count);
-  assert(symbol_count > 0);
-  _PASS;
-
-  /// Create and open temp destination file for print_symbol_table()
-  char *alex_tmp = "tmp/alex.tmp";
-  logger(DEBUG, "alex_tmp: '%s'", alex_tmp);
-
-  /// If alex temp file can not be written, print error and exit
-  sprintf (perror_msg, "alex_fp = fopen('%s', 'wb')", alex_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  FILE *alex_fp = fopen (alex_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
-
-  /// Print symbol table with print_symbol_table() to alex temp file
-  retVal = print_symbol_table (symbol_table, alex_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
-
-  /// Print symbol table HTML report with print_symbol_table_html()
-  retVal = print_symbol_table_html (symbol_table, report_fp);
-  if (retVal != EXIT_SUCCESS)
-      return (opal_exit (retVal));
-
-  if (alex_fp)
-    {
-      sprintf (perror_msg, "fclose(alex_fp)");
-      logger(DEBUG, perror_msg);
-      if (fclose (alex_fp) == EXIT_SUCCESS)
-        {
-          _PASS;
-          alex_fp = NULL;
-        }
+      /// If alex temp file can not be written, print error and exit
+      sprintf (ctx->perror_msg, "alex_fp = fopen('%s', 'wb')", alex_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      FILE *alex_fp = fopen (alex_tmp, "wb");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
+
+      /// Print symbol table with print_symbol_table() to alex temp file
+      ctx->retVal = print_symbol_table (ctx, symbol_table, alex_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      /// Print symbol table HTML report with print_symbol_table_html()
+      ctx->retVal = print_symbol_table_html (ctx, symbol_table, ctx->report_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+          return (opal_exit (ctx, ctx->retVal));
+
+      if (alex_fp)
+        {
+          sprintf (ctx->perror_msg, "fclose(alex_fp)");
+          logger(DEBUG, ctx->perror_msg);
+          if (fclose (alex_fp) == EXIT_SUCCESS)
+            {
+              _PASS;
+              alex_fp = NULL;
+            }
+          else
+            {
+              perror (ctx->perror_msg);
+              _FAIL;
+              return (errno);
+            }
+        }
     }
 
   /// Start syntax analyzer code
-  banner ("ASTRO start.");
+  banner (ctx, "ASTRO start.");
 
-  /// Build abstract syntax tree using symbol table
-  node_s *syntax_tree = build_syntax_tree (symbol_table);
+  /// Build abstract syntax tree using symbol table, or map in the one
+  /// saved by astro with load_ast()
+  node_id syntax_tree = 0;
+  if (input_kind == ir_Ast)
+    {
+      syntax_tree = load_ast (ctx, ctx->source_fn, &symbol_count);
+      if (!syntax_tree)
+        return (opal_exit (ctx, EXIT_FAILURE));
+    }
+  else
+    syntax_tree = build_syntax_tree (ctx, symbol_table);
 
   logger(DEBUG, "assert(syntax_tree)");
   assert(syntax_tree);
   _PASS;
 
   /// Print abstract syntax tree HTML report with print_ast_html()
-  fprintf (report_fp, "<h3>Output by syntax analyzer <code>ASTRO</code></h3>\n"
+  fprintf (ctx->report_fp, "<h3>Output by syntax analyzer <code>ASTRO</code></h3>\n"
            "<hr>\n");
-  retVal = print_ast_html(syntax_tree, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  ctx->retVal = print_ast_html(ctx, syntax_tree, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Optimize the abstract syntax tree
-  node_s *syntax_tree_pass1 = optimize_syntax_tree(syntax_tree);
-  node_s *syntax_tree_pass2 = optimize_syntax_tree(syntax_tree_pass1);
+  syntax_tree = optimize_syntax_tree (ctx, syntax_tree);
 
   /// Print optimized syntax tree HTML report with print_ast_html()
-  fprintf (report_fp, "<h3>Optimized abstract syntax tree: </h3>\n<hr>\n");
-  retVal = print_ast_html(syntax_tree_pass2, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  fprintf (ctx->report_fp, "<h3>Optimized abstract syntax tree: </h3>\n<hr>\n");
+  ctx->retVal = print_ast_html(ctx, syntax_tree, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Start code generator
-  banner ("GENIE start.");
+  banner (ctx, "GENIE start.");
+
+  /// Size assembly code tables from the lexemes ALEX found
+  reserve_asm_arrays (ctx, symbol_count);
 
   /// Build assembly code table using
-  gen_asm_code (syntax_tree_pass2);
-  add_asm_code (asm_HALT, 0, NULL);
+  gen_asm_code (ctx, syntax_tree);
+  add_asm_code (ctx, asm_HALT, 0, NULL);
+
+  /// Rewrite assembly code list with peephole optimizer
+  peephole_asm_code (ctx);
 
   /// Print symbol table with print_symbol_table() to destination file
-  retVal = print_asm_code (asm_cmd_list, dest_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  ctx->retVal = print_asm_code (ctx, ctx->asm_cmd_list, ctx->dest_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Print assembly code with print_asm_code_html()
-  retVal = print_asm_code_html (asm_cmd_list, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  ctx->retVal = print_asm_code_html (ctx, ctx->asm_cmd_list, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Close HTML report file
-  retVal = close_report(report_fp);
-  if (retVal != EXIT_SUCCESS)
-    opal_exit(retVal);
-
-  /// Free memory used by symbol_table
-  free_symbol_table (symbol_table);
-  symbol_table = NULL;
-
-  /// Free memory used by syntax_tree
-  free_syntax_tree (syntax_tree);
-  syntax_tree = NULL;
+  ctx->retVal = close_report(ctx, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    opal_exit(ctx, ctx->retVal);
 
-  /// Free memory used by ASM array
-  retVal = free_asm_arrays();
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  /// Free lexemes, syntax tree and code tables with the arena holding them
+  char arena_mark[128] = { 0 };
+  arena_summary (ctx, arena_mark, sizeof(arena_mark));
+  logger(INFO, "Arena high-water mark: %s.", arena_mark);
+  free_arena (ctx);
 
   /// source_fp, dest_fp, log_fp & report_fp closed by opal_exit()
-  return (opal_exit (EXIT_SUCCESS));
+  return (opal_exit (ctx, EXIT_SUCCESS));
 }
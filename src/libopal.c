@@ -5,33 +5,646 @@
 #include <assert.h>             /* assert() */
 #include <ctype.h>              /* isspace(), isalnum() */
 #include <errno.h>              /* errno macros and codes */
-#include <regex.h> 				/* ReGex functions */
 #include <stdarg.h>             /* variadic functions */
 #include <stdio.h>
 #include <stdlib.h>             /* fopen, fclose, exit() */
 #include <string.h>             /* memset() */
 #include <strings.h>
 #include <unistd.h>
+#include <sys/wait.h>           /* WEXITSTATUS() */
+#include <elf.h>                /* ELF64 headers for native backend */
+#include <fcntl.h>              /* open() */
 #include <libgen.h>             /* basename(), dirname() */
+#include <setjmp.h>             /* longjmp() */
+#include <signal.h>             /* SIGFPE */
+#include <stdint.h>             /* INT64_MAX */
+#include <sys/mman.h>           /* mmap() of binary IR files */
+#include <sys/stat.h>           /* fstat() */
+#ifdef __SSE2__
+#include <emmintrin.h>          /* SSE2 intrinsics for lexer scans */
+#endif
 #include "../include/libopal.h"
 
+/*
+ * ==================================
+ * START CONSTANT TABLE DEFINITIONS
+ * ==================================
+ */
+
+/// Array for supported keywords
+const keyword keyword_arr[] =
+    {
+        {"if", lx_If},
+        {"else", lx_Else},
+        {"while", lx_While},
+        {"print", lx_Print},
+        {"input", lx_Input}
+    };
+
+/// Number of entries in keyword_arr
+const int keyword_arr_len = sizeof (keyword_arr) / sizeof (keyword_arr[0]);
+
+/**
+ * Perfect hash of keyword_arr, holding index + 1 of the keyword in each slot
+ * given by keyword_hash(), or 0. A new keyword must land on a free slot.
+ */
+const unsigned char keyword_hash_arr[keyword_hash_len] =
+  {
+    [keyword_hash('i', 2)] = 1,
+    [keyword_hash('e', 4)] = 2,
+    [keyword_hash('w', 5)] = 3,
+    [keyword_hash('p', 5)] = 4,
+    [keyword_hash('i', 5)] = 5
+  };
+
+/// Lexeme type names for logging
+const char op_name[][16] =
+  { "No_operation", "End_of_file", "Identifier", "Integer", "String",
+      "Op_Assign", "Op_Add", "Op_Subtract", "Op_Negate", "Op_Multiply",
+      "Op_Divide", "Op_Mod", "Op_Equal", "Op_NotEqual", "Op_Less", "Op_Greater",
+      "Op_LessEqual", "Op_GreaterEqual", "Op_And", "Op_Or", "Op_Not",
+      "Keyword_If", "Keyword_Else", "Keyword_While", "LeftParen", "RightParen",
+      "LeftBrace", "RightBrace", "Semicolon", "Comma", "Keyword_print",
+      "Keyword_input" };
+
+/// Syntax tree node type names for logging
+const char node_name[][16] =
+  { "No_operation", "End_of_file", "Identifier", "Integer", "String",
+      "Op_Assign", "Op_Add", "Op_Subtract", "Op_Negate", "Op_Multiply",
+      "Op_Divide", "Op_Mod", "Op_Equal", "Op_NotEqual", "Op_Less", "Op_Greater",
+      "Op_LessEqual", "Op_GreaterEqual", "Op_And", "Op_Or", "Op_Not",
+      "Keyword_If", "Keyword_Else", "Keyword_While", "Print_String",
+      "Print_Integer", "Code_sequence", "Keyword_input" };
+
+/**
+ * Language grammar
+ * Ref: https://en.wikipedia.org/wiki/Operators_in_C_and_C
+ */
+const attributes_s grammar[] =
+  {
+    { "NOP", "No_Operation", lx_NOP, FALSE, FALSE, FALSE, -1, nd_NOP },
+    { "EOF", "End_of_file", lx_EOF, FALSE, FALSE, FALSE, -1, -1 },
+    { "Identifier", "Identifier", lx_Ident, FALSE, FALSE, FALSE, -1, nd_Ident },
+    { "Integer", "Integer", lx_Integer, FALSE, FALSE, FALSE, -1, nd_Integer },
+    { "String", "String", lx_String, FALSE, FALSE, FALSE, -1, nd_String },
+    { "=", "Op_assign", lx_Assign, FALSE, FALSE, FALSE, -1, nd_Assign },
+    { "+", "Op_add", lx_Add, FALSE, TRUE, FALSE, 12, nd_Add },
+    { "-", "Op_subtract", lx_Sub, FALSE, TRUE, FALSE, 12, nd_Sub },
+    { "-", "Op_negate", lx_Negate, FALSE, FALSE, TRUE, 14, nd_Negate },
+    { "*", "Op_multiply", lx_Mul, FALSE, TRUE, FALSE, 13, nd_Mul },
+    { "/", "Op_divide", lx_Div, FALSE, TRUE, FALSE, 13, nd_Div },
+    { "%", "Op_mod", lx_Mod, FALSE, TRUE, FALSE, 13, nd_Mod },
+    { "==", "Op_equal", lx_Eq, FALSE, TRUE, FALSE, 9, nd_Eq },
+    { "!=", "Op_notequal", lx_Neq, FALSE, TRUE, FALSE, 9, nd_Neq },
+    { "<", "Op_less", lx_Lss, FALSE, TRUE, FALSE, 10, nd_Lss },
+    { ">", "Op_greater", lx_Gtr, FALSE, TRUE, FALSE, 10, nd_Gtr },
+    { "<=", "Op_lessequal", lx_Leq, FALSE, TRUE, FALSE, 10, nd_Leq },
+    { ">=", "Op_greaterequal", lx_Geq, FALSE, TRUE, FALSE, 10, nd_Geq },
+    { "&&", "Op_and", lx_And, FALSE, TRUE, FALSE, 5, nd_And },
+    { "||", "Op_or", lx_Or, FALSE, TRUE, FALSE, 4, nd_Or },
+    { "!", "Op_not", lx_Not, FALSE, FALSE, TRUE, 14, nd_Not },
+    { "if", "Keyword_if", lx_If, FALSE, FALSE, FALSE, -1, nd_If },
+    { "else", "Keyword_else", lx_Else, FALSE, FALSE, FALSE, -1, -1 },
+    { "while", "Keyword_while", lx_While, FALSE, FALSE, FALSE, -1, nd_While },
+    { "(", "LeftParen", lx_Lparen, FALSE, FALSE, FALSE, -1, -1 },
+    { ")", "RightParen", lx_Rparen, FALSE, FALSE, FALSE, -1, -1 },
+    { "{", "LeftBrace", lx_Lbrace, FALSE, FALSE, FALSE, -1, -1 },
+    { "}", "RightBrace", lx_Rbrace, FALSE, FALSE, FALSE, -1, -1 },
+    { ";", "Semicolon", lx_Semi, FALSE, FALSE, FALSE, -1, -1 },
+    { ",", "Comma", lx_Comma, FALSE, FALSE, FALSE, -1, -1 },
+    { "print", "Keyword_print", lx_Print, FALSE, FALSE, FALSE, -1, -1 },
+  };
+
+/// 0-address assembly commands
+const char asm_cmds[][16] =
+  { "NOP", "_EOF_", "_IDENT_", "_INT_", "_STR_", "_ASSIGN_", "O_ADD", "O_SUB",
+      "O_NEGATE", "O_MUL", "O_DIV", "O_MOD", "O_EQ", "O_NEQ", "O_LSS", "O_GTR",
+      "O_LEQ", "O_GEQ", "O_AND", "O_OR", "O_NOT", "_FETCH_", "_STORE_", "PUSH",
+      "JMP", "O_JZ", "O_JNZ", "O_PRTS", "O_PRTI", "HALT", "_LABEL_", "_INPUT_",
+      "_TEE_", "O_JEQ", "O_JNEQ", "O_JLSS", "O_JGTR", "O_JLEQ", "O_JGEQ"
+};
+
+const char peephole_names[][16] =
+  { "store-fetch", "invert-jump", "dead-label", "jump-next", "fuse-compare" };
+
+/*
+ * ==================================
+ * END CONSTANT TABLE DEFINITIONS
+ * ==================================
+ */
+
 /*
  * ==================================
  * START COMMON FUNCTION DEFINITIONS
  * ==================================
  */
 
+/**
+ * @brief       Allocate a fresh compilation context
+ *
+ * @details     Every piece of mutable compiler state lives in the returned
+ * context, so independent compilations can run side by side (eg - one per
+ * thread) without sharing anything but the constant tables.
+ *
+ * @retval      Pointer to zero-initialised context with defaults set, or
+ * NULL if allocation failed
+ */
+opal_ctx_s*
+opal_ctx_new (void)
+{
+  opal_ctx_s *ctx = calloc (1, sizeof(opal_ctx_s));
+  if (ctx == NULL)
+    return NULL;
+
+  ctx->next_char = ' ';
+  ctx->log_level = ERROR;
+  ctx->css_fn = "res/styles.css";
+  ctx->peephole = PEEPHOLE_ALL;
+
+  return ctx;
+}
+
+/**
+ * @brief       Forget the stream of a stage that is read as the source file
+ *
+ * @details     The stream is then closed once, as ctx->source_fp.
+ *
+ * @param[in]   ctx     Compilation context
+ */
+static void
+stage_forget_source (opal_ctx_s *ctx)
+{
+  for (stage_buf_s *stage = ctx->stages; stage; stage = stage->next)
+    if (ctx->source_fp && stage->fp == ctx->source_fp)
+      stage->fp = NULL;
+}
+
+/**
+ * @brief       Free a compilation context
+ *
+ * @details     Files and names owned by the context are normally released
+ * via opal_exit() before this is called. Those still held, as when a
+ * compilation returned early on an error, are closed and freed here without
+ * logging, as the log may be among them or never have been opened. Stages
+ * of stage_new(), whose buffers a compilation aborted by opal_abort() could
+ * not free, the arena, if still held, and the context itself are freed too.
+ *
+ * @param[in]   ctx     Context returned by opal_ctx_new()
+ */
+void
+opal_ctx_free (opal_ctx_s *ctx)
+{
+  stage_forget_source (ctx);
+  if (ctx->source_fp && ctx->source_fp != stdin)
+    fclose (ctx->source_fp);
+  if (ctx->dest_fp && ctx->dest_fp != stdout)
+    fclose (ctx->dest_fp);
+  if (ctx->report_fp)
+    fclose (ctx->report_fp);
+  if (ctx->log_fp && ctx->log_fp != stdout)
+    fclose (ctx->log_fp);
+  free (ctx->source_fn);
+  free (ctx->dest_fn);
+  free (ctx->report_fn);
+  free (ctx->log_fn);
+
+  while (ctx->stages)
+    {
+      stage_buf_s *next = ctx->stages->next;
+      if (ctx->stages->fp)
+        fclose (ctx->stages->fp);
+      free (ctx->stages->data);
+      free (ctx->stages->fn);
+      free (ctx->stages);
+      ctx->stages = next;
+    }
+
+  free_arena (ctx);
+  free (ctx->src_buf);
+  free (ctx);
+}
+
+/**
+ * @brief       Allocate zeroed memory from compilation arena
+ *
+ * @details     Memory is bumped off the newest chunk and released only by
+ * free_arena(), all at once. Chunks come zeroed from calloc() and are never
+ * reused, so handed out memory is zero. A request bigger than a quarter
+ * chunk gets a chunk of its own, linked behind the newest one so the free
+ * room of that one is kept.
+ *
+ * @param[in]   size    Bytes to allocate
+ *
+ * @return      Memory aligned to ARENA_ALIGN bytes
+ */
+void*
+arena_alloc (opal_ctx_s *ctx, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  arena_chunk_s *chunk = ctx->arena;
+
+  if (chunk == NULL || chunk->cap - chunk->used < size)
+    {
+      bool own = size > ARENA_CHUNK_SIZE / 4;
+      size_t cap = own ? size : ARENA_CHUNK_SIZE;
+      arena_chunk_s *fresh = calloc (1, sizeof(arena_chunk_s) + cap);
+      if (fresh == NULL)
+        {
+          perror ("calloc(arena)");
+          opal_abort (ctx, errno);
+        }
+      fresh->cap = cap;
+      ctx->arena_size += cap;
+      ctx->arena_chunks++;
+
+      if (own && chunk)
+        {
+          fresh->next = chunk->next;
+          chunk->next = fresh;
+        }
+      else
+        {
+          fresh->next = chunk;
+          ctx->arena = fresh;
+        }
+      chunk = fresh;
+    }
+
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  ctx->arena_used += size;
+  return ptr;
+}
+
+/**
+ * @brief       Resize memory allocated from compilation arena
+ *
+ * @details     The newest allocation grows in place while its chunk has
+ * room. Otherwise contents are copied to a new allocation, and the old one
+ * stays in the arena until it is freed.
+ *
+ * @param[in]   ptr         Memory from arena_alloc(), or NULL
+ * @param[in]   old_size    Bytes requested for ptr
+ * @param[in]   new_size    Bytes to resize to
+ *
+ * @return      Resized memory, zeroed past old_size
+ */
+void*
+arena_realloc (opal_ctx_s *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+  arena_chunk_s *chunk = ctx->arena;
+  old_size = (old_size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  new_size = (new_size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+  if (ptr && chunk && (unsigned char*) ptr + old_size == chunk->data
+      + chunk->used && new_size >= old_size
+      && chunk->cap - chunk->used >= new_size - old_size)
+    {
+      chunk->used += new_size - old_size;
+      ctx->arena_used += new_size - old_size;
+      return ptr;
+    }
+
+  void *grown = arena_alloc (ctx, new_size);
+  if (ptr)
+    memcpy (grown, ptr, old_size < new_size ? old_size : new_size);
+  return grown;
+}
+
+/**
+ * @brief       Copy string into compilation arena
+ *
+ * @param[in]   str     String to copy
+ *
+ * @return      Copy of str
+ */
+char*
+arena_strdup (opal_ctx_s *ctx, const char *str)
+{
+  size_t len = strlen (str) + 1;
+  return memcpy (arena_alloc (ctx, len), str, len);
+}
+
+/**
+ * @brief       Format high-water mark of compilation arena
+ *
+ * @details     The arena only grows until it is freed, so the bytes it holds
+ * are its high-water mark.
+ *
+ * @param[out]  buf     Buffer for the summary
+ * @param[in]   len     Size of buf
+ */
+void
+arena_summary (opal_ctx_s *ctx, char *buf, size_t len)
+{
+  snprintf (buf, len, "%zu bytes in %u chunks, %zu bytes used",
+            ctx->arena_size, ctx->arena_chunks, ctx->arena_used);
+}
+
+/**
+ * @brief       Free compilation arena, with everything allocated from it
+ *
+ * @details     Lexemes, strings and the symbol, assembly code, variable and
+ * string tables all live in the arena, so a compilation is torn down by
+ * freeing its chunks. The syntax tree node pool is freed, and a binary IR
+ * file unmapped, with them. Tables pointing into the arena are emptied,
+ * leaving the context ready for another compilation.
+ */
+void
+free_arena (opal_ctx_s *ctx)
+{
+  while (ctx->arena)
+    {
+      arena_chunk_s *next = ctx->arena->next;
+      free (ctx->arena);
+      ctx->arena = next;
+    }
+  ctx->arena_used = ctx->arena_size = 0;
+  ctx->arena_chunks = 0;
+
+  ctx->syms = NULL;
+  ctx->syms_len = ctx->syms_cap = 0;
+  ctx->sym_index = NULL;
+  ctx->sym_index_cap = 0;
+  ctx->asm_cmd_list = NULL;
+  ctx->asm_cmd_list_len = ctx->asm_cmd_list_cap = 0;
+  ctx->strs = ctx->vars = NULL;
+  ctx->strs_len = ctx->strs_cap = 0;
+  ctx->vars_len = ctx->vars_cap = 0;
+
+  if (!ctx->nodes_mapped)
+    free (ctx->nodes);
+  ctx->nodes = NULL;
+  ctx->nodes_len = ctx->nodes_cap = 0;
+  ctx->nodes_mapped = FALSE;
+
+  if (ctx->ir_map)
+    munmap (ctx->ir_map, ctx->ir_map_len);
+  ctx->ir_map = NULL;
+  ctx->ir_map_len = 0;
+}
+
+/**
+ * @brief       Push a zeroed entry on an explicit walk stack
+ *
+ * @details     Syntax tree walks keep their pending nodes here rather than
+ * on the C stack, so trees as deep as the program is long can be walked.
+ * The stack doubles as it fills and is freed by the walk with walk_free().
+ *
+ * @param[in,out]   stack   Stack with its entry size set
+ *
+ * @return      New top entry
+ */
+void*
+walk_push (opal_ctx_s *ctx, walk_stack_s *stack)
+{
+  if (stack->len == stack->cap)
+    {
+      unsigned cap = stack->cap ? 2 * stack->cap : 64;
+      void *grown = realloc (stack->items, cap * stack->size);
+      if (grown == NULL)
+        {
+          perror ("realloc(walk_stack)");
+          opal_abort (ctx, errno);
+        }
+      stack->items = grown;
+      stack->cap = cap;
+    }
+
+  void *top = (char*) stack->items + stack->len++ * stack->size;
+  return memset (top, 0, stack->size);
+}
+
+/**
+ * @brief       Pop the top entry of an explicit walk stack
+ *
+ * @details     The entry stays valid until the next walk_push().
+ *
+ * @param[in,out]   stack   Stack that is not empty
+ *
+ * @return      Entry popped
+ */
+void*
+walk_pop (walk_stack_s *stack)
+{
+  return (char*) stack->items + --stack->len * stack->size;
+}
+
+/**
+ * @brief       Free the entries of an explicit walk stack
+ *
+ * @param[in,out]   stack   Stack to empty
+ */
+void
+walk_free (walk_stack_s *stack)
+{
+  free (stack->items);
+  stack->items = NULL;
+  stack->len = stack->cap = 0;
+}
+
+/**
+ * @brief       Tell the kind of a binary IR file by its magic number
+ *
+ * @param[in]   fn      File name
+ *
+ * @return      Kind of file
+ *
+ * @retval      ir_Tokens   For a .otk file
+ * @retval      ir_Ast      For a .oast file
+ * @retval      ir_None     For any other file, or one that can not be read
+ */
+ir_kind_e
+ir_file_kind (const char *fn)
+{
+  char magic[4] = { 0 };
+  size_t got = 0;
+
+  FILE *fp = fopen (fn, "rb");
+  if (fp == NULL)
+    return ir_None;
+  got = fread (magic, 1, sizeof(magic), fp);
+  fclose (fp);
+
+  if (got == sizeof(magic) && memcmp (magic, OTK_MAGIC, sizeof(magic)) == 0)
+    return ir_Tokens;
+  if (got == sizeof(magic) && memcmp (magic, OAST_MAGIC, sizeof(magic)) == 0)
+    return ir_Ast;
+  return ir_None;
+}
+
+/**
+ * @brief       Write a binary IR file
+ *
+ * @details     The header and the word of each interned symbol are followed
+ * by the arrays, each written with a single fwrite(), then the names.
+ *
+ * @param[in]       fn          File to write
+ * @param[in,out]   header      Header with magic, len, root and tokens set
+ * @param[in]       arrays      Arrays of header->len items
+ * @param[in]       arrays_len  Number of arrays
+ * @param[in]       item_size   Size of an item of the arrays
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      errno           On system call failure
+ */
+static short
+ir_write (opal_ctx_s *ctx, const char *fn, ir_header_s *header,
+          const void *const *arrays, unsigned arrays_len, size_t item_size)
+{
+  uint32_t *sym_words = arena_alloc (ctx, ctx->syms_len * sizeof(uint32_t));
+  unsigned i = 0;
+
+  header->version = IR_VERSION;
+  header->syms_len = ctx->syms_len;
+  header->names_len = 0;
+  for (i = 0; i < ctx->syms_len; i++)
+    {
+      uint32_t len = strlen (ctx->syms[i].name);
+      sym_words[i] = len << 1 | ctx->syms[i].is_str;
+      header->names_len += len + 1;
+    }
+
+  sprintf (ctx->perror_msg, "ir_fp = fopen('%s', 'wb')", fn);
+  logger(DEBUG, ctx->perror_msg);
+  FILE *ir_fp = fopen (fn, "wb");
+  if (ir_fp)
+    _PASS;
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+      return (errno);
+    }
+
+  fwrite (header, sizeof(ir_header_s), 1, ir_fp);
+  fwrite (sym_words, sizeof(uint32_t), ctx->syms_len, ir_fp);
+  for (i = 0; i < arrays_len; i++)
+    fwrite (arrays[i], item_size, header->len, ir_fp);
+  for (i = 0; i < ctx->syms_len; i++)
+    fwrite (ctx->syms[i].name, 1, (sym_words[i] >> 1) + 1, ir_fp);
+
+  /// Write errors are sticky, so checking once after the last write will do
+  sprintf (ctx->perror_msg, "fwrite('%s')", fn);
+  logger(DEBUG, ctx->perror_msg);
+  errno = EXIT_SUCCESS;
+  bool failed = ferror (ir_fp);
+  if (fclose (ir_fp) == EXIT_SUCCESS && !failed)
+    _PASS;
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+      return (errno ? errno : EXIT_FAILURE);
+    }
+
+  logger(DEBUG, "Wrote %u symbols and %u items to '%s'.", header->syms_len,
+         header->len, fn);
+  return (EXIT_SUCCESS);
+}
+
+/**
+ * @brief       Map a binary IR file in and intern its symbols
+ *
+ * @details     The file is mapped private and writable, so its arrays are
+ * used, and may be changed, where they lie. It stays mapped until
+ * free_arena(). Symbols are interned in file order so they keep their
+ * indices, hence the context must hold no symbols yet.
+ *
+ * @param[in]   fn          File to map
+ * @param[in]   magic       Magic number the file must have
+ * @param[in]   arrays_len  Number of arrays after the symbol words
+ * @param[in]   item_size   Size of an item of the arrays
+ *
+ * @return      Header of mapped file, the arrays follow the symbol words
+ *
+ * @retval      ir_header_s*    On success
+ * @retval      NULL            On error
+ */
+static ir_header_s*
+ir_map_file (opal_ctx_s *ctx, const char *fn, const char *magic,
+             unsigned arrays_len, size_t item_size)
+{
+  struct stat st = { 0 };
+  ir_header_s *header = NULL;
+  unsigned i = 0;
+
+  /// Map the whole file, else print error and return
+  sprintf (ctx->perror_msg, "mmap('%s')", fn);
+  logger(DEBUG, ctx->perror_msg);
+  int fd = open (fn, O_RDONLY);
+  if (fd >= 0 && fstat (fd, &st) == EXIT_SUCCESS
+      && (size_t) st.st_size >= sizeof(ir_header_s))
+    header = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                   0);
+  if (fd >= 0)
+    close (fd);
+  if (header && header != MAP_FAILED)
+    _PASS;
+  else
+    {
+      if (fd >= 0 && header == NULL)
+        fprintf (stderr, "%s: not an OPaL %s file\n", fn, magic);
+      else
+        perror (ctx->perror_msg);
+      _FAIL;
+      return NULL;
+    }
+
+  if (ctx->ir_map)
+    munmap (ctx->ir_map, ctx->ir_map_len);
+  ctx->ir_map = header;
+  ctx->ir_map_len = st.st_size;
+
+  /// The magic number, version and the lengths of the parts must add up
+  size_t names_at = sizeof(ir_header_s) + header->syms_len * sizeof(uint32_t)
+      + arrays_len * item_size * header->len;
+  if (memcmp (header->magic, magic, sizeof(header->magic)) != 0
+      || header->version != IR_VERSION
+      || names_at + header->names_len != ctx->ir_map_len
+      || ctx->syms_len != 0)
+    {
+      fprintf (stderr, "%s: not an OPaL %s file of version %d\n", fn, magic,
+               IR_VERSION);
+      return NULL;
+    }
+
+  /// Intern the symbols, checking that each name fits and is terminated
+  const uint32_t *sym_words = (const uint32_t*) (header + 1);
+  const char *name = (const char*) header + names_at;
+  const char *end = (const char*) header + ctx->ir_map_len;
+  for (i = 0; i < header->syms_len; i++)
+    {
+      size_t len = sym_words[i] >> 1;
+      if ((size_t) (end - name) <= len || name[len] != '\0'
+          || intern_symbol (ctx, name, len, sym_words[i] & 1) != (int) i)
+        {
+          fprintf (stderr, "%s: damaged symbol %u\n", fn, i);
+          return NULL;
+        }
+      name += len + 1;
+    }
+
+  logger(DEBUG, "Mapped %u symbols and %u items from '%s'.",
+         header->syms_len, header->len, fn);
+  return header;
+}
+
+
 /**
  * @brief       Print formatted message to log file
  *
- * @details     Helper function to log messages. Function writes to global
- * variable log_fp. Usually called by a macro logger. Eg:
+ * @details     Helper function to log messages. Function writes to the log
+ * file of the context, ctx->log_fp. Usually called by a macro logger. Eg:
  *
  * ```
  * logger (ERROR, "Cannot read file: %s", file_name);
  * logger (DEBUG, "access('%s', F_OK)", source_fn);
  * ```
  *
+ * @param[in]   ctx     Compilation context
  * @param[in]   tag     Log level of message
  * @param[in]   file    Source file name
  * @param[in]   line    Source file line number
@@ -42,12 +655,17 @@
  *
  */
 void
-opal_log (log_level_e tag, const char *file, int line, const char *func,
-          const char *fmt, ...)
+opal_log (opal_ctx_s *ctx, log_level_e tag, const char *file, int line,
+          const char *func, const char *fmt, ...)
 {
 
   /// Assert log file pointer is not null
-  assert(log_fp);
+  assert(ctx->log_fp);
+
+  /// Return early if message is filtered out by current log level, so
+  /// neither formatting nor flushing is paid for it
+  if (tag > ctx->log_level && !(tag == RESULT && ctx->log_level >= DEBUG))
+    return;
 
   /// Allocate buffer to hold message to log
   char buf[4096] = { 0 };
@@ -62,16 +680,16 @@ opal_log (log_level_e tag, const char *file, int line, const char *func,
    * If tag is a result of a system call and current log level is more
    * than DEBUG, print the message and return. Eg - PASS / FAIL etc
    */
-  if (tag == RESULT && LOG_LEVEL >= DEBUG)
+  if (tag == RESULT && ctx->log_level >= DEBUG)
     {
-      retVal = fprintf (log_fp, "%s", buf);
-      if (retVal < 0)
-        opal_exit(retVal);
+      ctx->retVal = fprintf (ctx->log_fp, "%s", buf);
+      if (ctx->retVal < 0)
+        opal_exit(ctx, ctx->retVal);
 
-      if (fflush (log_fp) != EXIT_SUCCESS)
+      if (fflush (ctx->log_fp) != EXIT_SUCCESS)
         {
           perror("fflush (log_fp)");
-          opal_exit(errno);
+          opal_exit(ctx, errno);
         }
       return;
     }
@@ -84,16 +702,16 @@ opal_log (log_level_e tag, const char *file, int line, const char *func,
    * [05/02/2021 20:57:58] [DEBUG]   main() [source_fp] access('input/hello.opl', R_OK) - PASS
    * ```
    */
-  if (tag <= LOG_LEVEL)
+  if (tag <= ctx->log_level)
     {
-      fprintf (log_fp, "\n[%10s:%4d] %24s() %s", file, line, func, buf);
+      fprintf (ctx->log_fp, "\n[%10s:%4d] %24s() %s", file, line, func, buf);
     }
 
   /// Flush message to log file
-  if (fflush (log_fp) != EXIT_SUCCESS)
+  if (fflush (ctx->log_fp) != EXIT_SUCCESS)
     {
       perror("fflush (log_fp)");
-      opal_exit(errno);
+      opal_exit(ctx, errno);
     }
 }
 
@@ -116,7 +734,7 @@ opal_log (log_level_e tag, const char *file, int line, const char *func,
  *
  */
 void
-banner (const char *msg)
+banner (opal_ctx_s *ctx, const char *msg)
 {
   /// Create buffer of 64 characters size and fill with 63 stars
   char stars[64] = { 0 };
@@ -142,154 +760,159 @@ banner (const char *msg)
  *
  */
 short
-opal_exit (short code)
+opal_exit (opal_ctx_s *ctx, short code)
 {
 
   logger(DEBUG, "=== START ===");
   logger(DEBUG, "Exit program with code: %d", code);
 
   /// Flush stdout
-  sprintf (perror_msg, "fflush(stdout)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fflush(stdout)");
+  logger(DEBUG, ctx->perror_msg);
   if (fflush (stdout) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Close source file
-  if (source_fp && source_fp != stdin)
+  /// Close source file, which may be the stream of a stage
+  stage_forget_source (ctx);
+  if (ctx->source_fp && ctx->source_fp != stdin)
     {
-      sprintf (perror_msg, "fclose(source_fp)");
-      logger(DEBUG, perror_msg);
-      if (fclose (source_fp) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "fclose(source_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fclose (ctx->source_fp) == EXIT_SUCCESS)
         {
           _PASS;
-          source_fp = NULL;
+          ctx->source_fp = NULL;
         }
       else
         {
-          perror (perror_msg);
+          ctx->source_fp = NULL;
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
     }
 
-  if (source_fn)
+  if (ctx->source_fn)
     {
       logger(DEBUG, "free (source_fn)");
-      free (source_fn);
-      source_fn = NULL;
+      free (ctx->source_fn);
+      ctx->source_fn = NULL;
     }
 
   /// Flush and close destination file
-  if (dest_fp && dest_fp != stdout)
+  if (ctx->dest_fp && ctx->dest_fp != stdout)
     {
-      sprintf (perror_msg, "fflush(dest_fp)");
-      logger(DEBUG, perror_msg);
-      if (fflush (dest_fp) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "fflush(dest_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fflush (ctx->dest_fp) == EXIT_SUCCESS)
         _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
 
-      sprintf (perror_msg, "fclose(dest_fp)");
-      logger(DEBUG, perror_msg);
-      if (fclose (dest_fp) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "fclose(dest_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fclose (ctx->dest_fp) == EXIT_SUCCESS)
         {
           _PASS;
-          dest_fp = NULL;
+          ctx->dest_fp = NULL;
         }
       else
         {
-          perror (perror_msg);
+          ctx->dest_fp = NULL;
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
     }
 
-  if (dest_fn)
+  if (ctx->dest_fn)
     {
       logger(DEBUG, "free (dest_fn)");
-      free (dest_fn);
-      dest_fn = NULL;
+      free (ctx->dest_fn);
+      ctx->dest_fn = NULL;
     }
 
   /// Flush and close report file
-  if (report_fp)
+  if (ctx->report_fp)
     {
-      sprintf (perror_msg, "fflush(report_fp)");
-      logger(DEBUG, perror_msg);
-      if (fflush (report_fp) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "fflush(report_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fflush (ctx->report_fp) == EXIT_SUCCESS)
         _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
 
-      sprintf (perror_msg, "fclose(report_fp)");
-      logger(DEBUG, perror_msg);
-      if (fclose (report_fp) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "fclose(report_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fclose (ctx->report_fp) == EXIT_SUCCESS)
         {
           _PASS;
-          report_fp = NULL;
+          ctx->report_fp = NULL;
         }
       else
         {
-          perror (perror_msg);
+          ctx->report_fp = NULL;
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
     }
 
-  if (report_fn)
+  if (ctx->report_fn)
     {
       logger(DEBUG, "free(report_fn)");
-      free (report_fn);
-      report_fn = NULL;
+      free (ctx->report_fn);
+      ctx->report_fn = NULL;
     }
 
   /// Flush and close log file
-  if (log_fp && log_fp != stdout)
+  if (ctx->log_fp && ctx->log_fp != stdout)
     {
 
-      sprintf (perror_msg, "fflush(log_fp)");
-      logger(DEBUG, perror_msg);
-      if (fflush (log_fp) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "fflush(log_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fflush (ctx->log_fp) == EXIT_SUCCESS)
         _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
 
-      sprintf (perror_msg, "fclose(log_fp)");
-      logger(DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "fclose(log_fp)");
+      logger(DEBUG, ctx->perror_msg);
       logger(DEBUG, "=== END ===");
       logger(DEBUG, "\n");
-      if (fclose (log_fp) != EXIT_SUCCESS)
+      int closed = fclose (ctx->log_fp);
+      ctx->log_fp = NULL;
+      if (closed != EXIT_SUCCESS)
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
-      log_fp = NULL;
     }
   else
     logger(DEBUG, "=== END ===\n\n");
 
-  if (log_fn)
+  if (ctx->log_fn)
     {
-      free (log_fn);
-      log_fn = NULL;
+      free (ctx->log_fn);
+      ctx->log_fn = NULL;
     }
 
   return (code);
@@ -308,7 +931,8 @@ opal_exit (short code)
  * @retval      Function call to opal_exit
  */
 short
-opal_error (short exit_code, char *log_msg, int fmt_option, char *fmt, ...)
+opal_error (opal_ctx_s *ctx, short exit_code, char *log_msg, int fmt_option,
+            char *fmt, ...)
 {
     if (fmt_option == 1)
     {
@@ -328,49 +952,132 @@ opal_error (short exit_code, char *log_msg, int fmt_option, char *fmt, ...)
         logger (ERROR, log_msg);
     }
     fprintf(stderr, "%s", log_msg);
-    return opal_exit(exit_code);
+    return opal_exit(ctx, exit_code);
+}
+
+
+/**
+ * @brief       Abort the current compilation
+ *
+ * @details     Closes the context's files via opal_exit(). A command line
+ * driver leaves ctx->abort_jmp NULL and the process exits with the code; a
+ * long-lived caller (eg - a batch job) sets ctx->abort_jmp with setjmp() and
+ * gets control back there instead.
+ *
+ * @param[in]   ctx     Compilation context
+ * @param[in]   code    Exit code
+ */
+void
+opal_abort (opal_ctx_s *ctx, short code)
+{
+  code = opal_exit (ctx, code);
+  if (ctx->abort_jmp)
+    longjmp (*ctx->abort_jmp, code ? code : EXIT_FAILURE);
+  exit (code);
+}
+
+/**
+ * @brief       Read the rest of a stream into one buffer
+ *
+ * @details     The stream is read in blocks into a buffer that doubles as it
+ * fills, so passes can scan their input with pointers instead of a call per
+ * character. The buffer is NUL terminated and must be freed by the caller.
+ *
+ * @param[in]   stream  Stream to read from
+ * @param[out]  len     Bytes read, not counting the terminating NUL
+ *
+ * @return      Buffer holding the stream contents
+ *
+ * @retval      NULL    On read error, with errno set
+ */
+char*
+read_stream (opal_ctx_s *ctx, FILE *stream, size_t *len)
+{
+  size_t cap = 4096;
+  size_t used = 0;
+  char *buf = malloc (cap);
+  if (buf == NULL)
+    {
+      perror ("malloc(read_stream)");
+      opal_abort (ctx, errno);
+    }
+
+  /// Read blocks until the end of the stream, keeping room for the NUL
+  size_t got = 0;
+  while ((got = fread (buf + used, 1, cap - used - 1, stream)) > 0)
+    {
+      used += got;
+      if (cap - used > 1)
+        continue;
+      char *grown = realloc (buf, cap * 2);
+      if (grown == NULL)
+        {
+          perror ("realloc(read_stream)");
+          free (buf);
+          opal_abort (ctx, errno);
+        }
+      buf = grown;
+      cap *= 2;
+    }
+
+  /// fread() returns short on both end of file and error
+  if (ferror (stream))
+    {
+      if (errno == EXIT_SUCCESS)
+        errno = EIO;
+      perror ("fread(read_stream)");
+      free (buf);
+      return NULL;
+    }
+
+  buf[used] = '\0';
+  *len = used;
+  return buf;
 }
 
 /**
- * @brief       Function to read next character from the source file pointer
+ * @brief       Function to read next character from the source buffer
+ *
+ * @details     The source is read whole into ctx->src_buf by
+ * build_symbol_table(). Only the line number is kept here; the column is
+ * worked out from the start of the current line when a lexeme needs it.
  *
  * @return      Character read
  *
- * @retval      Next character read from FILE *stream source_fp
- * @retval      errno           On system call failure
+ * @retval      Next character of the source
+ * @retval      EOF             At end of the source
  *
  */
 int
-read_next_char (void)
+read_next_char (opal_ctx_s *ctx)
 {
-  /// Read character from source file pointer
-  errno = EXIT_SUCCESS;
-  next_char = getc (source_fp);
-
-  /// getc() sets the errno in the event of an error
-  if (errno != EXIT_SUCCESS)
+  /// At end of source keep returning EOF; the column still advances per
+  /// read, as it did when reading with getc()
+  if (ctx->src_pos >= ctx->src_len)
     {
-      perror (perror_msg);
-      exit (opal_exit (errno));
+      ++ctx->src_eof_reads;
+      return ctx->next_char = EOF;
     }
 
-  /// Increment the column number of the character
-  ++char_col;
+  ctx->next_char = (unsigned char) ctx->src_buf[ctx->src_pos++];
 
-  /// If character is a newline, increment line number and reset column number
-  if (next_char == '\n')
+  /// If character is a newline, increment line number and start a new line
+  if (ctx->next_char == '\n')
     {
-      ++char_line;
-      char_col = 0;
+      ++ctx->char_line;
+      ctx->src_line = ctx->src_pos;
     }
 
   /// Return the character read
-  return next_char;
+  return ctx->next_char;
 }
 
 /**
  * @brief   Initialize HTML report file
  *
+ * @details The source file is copied to the report, unless ctx->source_fp
+ * is NULL as for binary IR files.
+ *
  * @param[in,out] report_fp    Report file pointer
  *
  * @return      The error return code of the function.
@@ -381,7 +1088,7 @@ read_next_char (void)
  *
  */
 short
-init_report (FILE *report_fp)
+init_report (opal_ctx_s *ctx, FILE *report_fp)
 {
 
   logger(DEBUG, "=== START ===");
@@ -398,37 +1105,38 @@ init_report (FILE *report_fp)
            "<style>\n");
 
   /// Open res/styles.css in read-only mode
-  sprintf (perror_msg, "css_fp = fopen ('%s', 'r')", css_fn);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "css_fp = fopen ('%s', 'r')", ctx->css_fn);
+  logger (DEBUG, ctx->perror_msg);
 
   errno = EXIT_SUCCESS;
-  FILE *css_fp = fopen (css_fn, "r");
+  FILE *css_fp = fopen (ctx->css_fn, "r");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      exit (opal_exit(errno));
+      opal_abort (ctx, errno);
     }
 
   /// Copy CSS to HTML report
   logger (DEBUG, "Copying CSS to HTML report");
-  char ch = 0;
-  while ((ch = fgetc (css_fp)) != EOF)
-    fputc (ch, report_fp);
+  char block[4096];
+  size_t block_len = 0;
+  while ((block_len = fread (block, 1, sizeof(block), css_fp)) > 0)
+    fwrite (block, 1, block_len, report_fp);
   _DONE;
 
   /// Close res/styles.css file
-  sprintf (perror_msg, "fclose(css_fp)");
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(css_fp)");
+  logger (DEBUG, ctx->perror_msg);
   if (fclose (css_fp) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      exit (opal_exit (errno));
+      opal_abort (ctx, errno);
     }
 
   fprintf(report_fp,"</style>\n"
@@ -437,18 +1145,29 @@ init_report (FILE *report_fp)
   /// Start HTML body tag
   fprintf (report_fp, "<body>\n");
 
+  /// A binary IR file has no source to show
+  if (ctx->source_fp == NULL)
+    {
+      fprintf (report_fp, "<h2>Compilation steps report </h2>\n"
+               "<h3>Binary IR file: <code>%s</code></h3>\n<hr>\n",
+               ctx->source_fn);
+      fflush (report_fp);
+
+      logger(DEBUG, "=== END ===");
+      return EXIT_SUCCESS;
+    }
+
   /// Open textarea tag for source file
   fprintf (report_fp, "<h2>Compilation steps report </h2>\n"
            "<h3>Original source file: <code>%s</code></h3>\n<hr>\n"
            "<textarea style='resize: none;' readonly rows='25' cols='80'>\n",
-           source_fn);
+           ctx->source_fn);
 
   /// Append source file to HTML report and close textarea tag
-  ch = 0;
   logger(DEBUG, "Copying source file to HTML report");
 
-  while ((ch = fgetc (source_fp)) != EOF)
-    fputc (ch, report_fp);
+  while ((block_len = fread (block, 1, sizeof(block), ctx->source_fp)) > 0)
+    fwrite (block, 1, block_len, report_fp);
 
   _DONE;
 
@@ -456,18 +1175,18 @@ init_report (FILE *report_fp)
   fflush (report_fp);
 
   /// Rewind source file pointer
-  sprintf (perror_msg, "rewind('%s')", source_fn);
-  logger(DEBUG, perror_msg);
-  rewind (source_fp);
+  sprintf (ctx->perror_msg, "rewind('%s')", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  rewind (ctx->source_fp);
 
   /// If current value of source file position not 0, print error and exit
-  if (ftell (source_fp) == 0)
+  if (ftell (ctx->source_fp) == 0)
       _DONE;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      exit (opal_exit(errno));
+      opal_abort (ctx, errno);
     }
 
   logger(DEBUG, "=== END ===");
@@ -487,7 +1206,7 @@ init_report (FILE *report_fp)
  *
  */
 short
-close_report (FILE *report_fp)
+close_report (opal_ctx_s *ctx, FILE *report_fp)
 {
 
   logger(DEBUG, "=== START ===");
@@ -504,13 +1223,206 @@ close_report (FILE *report_fp)
   return EXIT_SUCCESS;
 }
 
-/*
- * ==================================
- * END COMMON FUNCTION DEFINITIONS
- * ==================================
+/**
+ * @brief   Create stage output owned by the context
+ *
+ * @details The stage is linked into ctx->stages, so its buffer and stream
+ * are released by opal_ctx_free() even if the compilation is aborted.
+ *
+ * @param[in]   fn      tmp file name, copied, or NULL to keep output in memory
+ *
+ * @return      Empty stage
+ *
  */
-
-/*
+stage_buf_s*
+stage_new (opal_ctx_s *ctx, const char *fn)
+{
+  stage_buf_s *stage = calloc (1, sizeof(stage_buf_s));
+  if (stage && fn)
+    {
+      stage->fn = strdup (fn);
+      if (stage->fn == NULL)
+        {
+          free (stage);
+          stage = NULL;
+        }
+    }
+  if (stage == NULL)
+    {
+      perror ("calloc(stage)");
+      opal_abort (ctx, errno);
+    }
+
+  stage->next = ctx->stages;
+  ctx->stages = stage;
+  return stage;
+}
+
+/**
+ * @brief   Open stage output for writing
+ *
+ * @details If the stage has a file name, the tmp file is truncated and opened.
+ * Otherwise output is written to a growable memory buffer with
+ * open_memstream(), replacing any earlier contents of the stage.
+ *
+ * @param[in,out] stage    Stage to write
+ *
+ * @return      Stream open for writing
+ *
+ * @retval      FILE*   On success
+ * @retval      NULL    On system call failure, errno is set
+ *
+ */
+FILE*
+stage_open_write (opal_ctx_s *ctx, stage_buf_s *stage)
+{
+  assert(stage);
+
+  /// Close stream still open on the stage
+  if (stage_close (ctx, stage) != EXIT_SUCCESS)
+    return NULL;
+
+  errno = EXIT_SUCCESS;
+  if (stage->fn)
+    {
+      sprintf (ctx->perror_msg, "fopen('%s', 'wb')", stage->fn);
+      logger(DEBUG, ctx->perror_msg);
+      stage->fp = fopen (stage->fn, "wb");
+    }
+  else
+    {
+      /// Release buffer of previous contents, open_memstream() allocates anew
+      free (stage->data);
+      stage->data = NULL;
+      stage->len = 0;
+
+      sprintf (ctx->perror_msg, "open_memstream()");
+      logger(DEBUG, ctx->perror_msg);
+      stage->fp = open_memstream (&stage->data, &stage->len);
+    }
+
+  if (stage->fp)
+    _PASS;
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+    }
+
+  return stage->fp;
+}
+
+/**
+ * @brief   Open stage output for reading
+ *
+ * @details Closes the stream used to write the stage, so buffered output is
+ * flushed, and opens the tmp file or memory buffer for reading.
+ *
+ * @param[in,out] stage    Stage to read
+ *
+ * @return      Stream open for reading
+ *
+ * @retval      FILE*   On success
+ * @retval      NULL    On system call failure, errno is set
+ *
+ */
+FILE*
+stage_open_read (opal_ctx_s *ctx, stage_buf_s *stage)
+{
+  assert(stage);
+
+  /// Close the writer so its contents are complete
+  if (stage_close (ctx, stage) != EXIT_SUCCESS)
+    return NULL;
+
+  errno = EXIT_SUCCESS;
+  if (stage->fn)
+    {
+      sprintf (ctx->perror_msg, "fopen('%s', 'r')", stage->fn);
+      logger(DEBUG, ctx->perror_msg);
+      stage->fp = fopen (stage->fn, "r");
+    }
+  else
+    {
+      sprintf (ctx->perror_msg, "fmemopen(%zu bytes, 'r')", stage->len);
+      logger(DEBUG, ctx->perror_msg);
+      stage->fp = fmemopen (stage->data, stage->len, "r");
+    }
+
+  if (stage->fp)
+    _PASS;
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+    }
+
+  return stage->fp;
+}
+
+/**
+ * @brief   Close stream open on stage output
+ *
+ * @param[in,out] stage    Stage to close
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      errno           On system call failure
+ *
+ */
+short
+stage_close (opal_ctx_s *ctx, stage_buf_s *stage)
+{
+  assert(stage);
+
+  if (!stage->fp)
+    return EXIT_SUCCESS;
+
+  sprintf (ctx->perror_msg, "fclose(%s)", stage->fn ? stage->fn : "memstream");
+  logger(DEBUG, ctx->perror_msg);
+  if (fclose (stage->fp) == EXIT_SUCCESS)
+    {
+      _PASS;
+      stage->fp = NULL;
+    }
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+      stage->fp = NULL;
+      return (errno);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief   Close stage stream and free stage memory buffer
+ *
+ * @param[in,out] stage    Stage to free
+ *
+ * @return      None
+ *
+ */
+void
+stage_free (opal_ctx_s *ctx, stage_buf_s *stage)
+{
+  assert(stage);
+
+  stage_close (ctx, stage);
+  free (stage->data);
+  stage->data = NULL;
+  stage->len = 0;
+}
+
+/*
+ * ==================================
+ * END COMMON FUNCTION DEFINITIONS
+ * ==================================
+ */
+
+/*
  * ==================================
  * START MARC FUNCTION DEFINITIONS
  * ==================================
@@ -530,7 +1442,7 @@ close_report (FILE *report_fp)
  *
  */
 short
-rem_comments (FILE *source_fp, FILE *dest_fp)
+rem_comments (opal_ctx_s *ctx, FILE *source_fp, FILE *dest_fp)
 {
   logger(DEBUG, "=== START ===");
 
@@ -544,64 +1456,62 @@ rem_comments (FILE *source_fp, FILE *dest_fp)
   assert(dest_fp);
   _PASS;
 
-  char ch = 0;
-  char charNext = 0;
-  bool isComment = false;
+  /// Read the whole source into one buffer
+  size_t len = 0;
+  char *src = read_stream (ctx, source_fp, &len);
+  if (src == NULL)
+    return (errno);
+
+  const char *pos = src;
+  const char *end = src + len;
   int numComments = 0;
 
-  /// Start reading characters from file
-  while ((ch = fgetc (source_fp)) != EOF)
+  while (pos < end)
     {
-      /// If character is not a /, line is not a comment
-      if (ch != '/')
+      /// Copy text up to the next / in one run
+      const char *slash = memchr (pos, '/', end - pos);
+      if (slash == NULL)
         {
-          fputc (ch, dest_fp);
-          continue;
+          fwrite (pos, 1, end - pos, dest_fp);
+          break;
         }
-      /// If character is a /, read next character
-      else
-        charNext = fgetc (source_fp);
+      fwrite (pos, 1, slash - pos, dest_fp);
+      pos = slash + 1;
 
-      /// If next character is / or *, line is a comment, set flag
-      if (charNext == '/' || charNext == '*')
+      /// If next character is not / or *, it is not a comment, write both
+      int charNext = pos < end ? (unsigned char) *pos++ : EOF;
+      if (charNext != '/' && charNext != '*')
         {
-          isComment = true;
-          logger(DEBUG, "Start of comment");
+          fputc ('/', dest_fp);
+          if (charNext != EOF)
+            fputc (charNext, dest_fp);
+          continue;
         }
-      /// else, not a comment, write both characters to file
-      else
+      logger(DEBUG, "Start of comment");
+      numComments++;
+
+      /// Single line comment ends before its newline, which is kept
+      if (charNext == '/')
         {
-          fputc (ch, dest_fp);
-          fputc (charNext, dest_fp);
+          const char *eol = memchr (pos, '\n', end - pos);
+          pos = eol ? eol : end;
+          logger(DEBUG, "End of comment (single line)");
+          continue;
         }
 
-      /// If comment flag is set, process comment
+      /// Multi-line comment ends at a * read with the /, newlines are kept
+      bool isComment = true;
       while (isComment)
         {
-          /// Read next character from file
-          ch = fgetc (source_fp);
-
-          /// If next character is /, process single line comment
-          if (charNext == '/' && (ch == '\n' || ch == EOF))
-            {
-              logger(DEBUG, "End of comment (single line)");
-              isComment = false;
-              numComments++;
-              charNext = 0;
-            }
+          int ch = pos < end ? (unsigned char) *pos++ : EOF;
 
-          /// If next character is *, process multi-line comment
-          if (charNext == '*' && ch == '*')
+          if (ch == '*')
             {
-              ch = fgetc (source_fp);
-              if (ch == '\n')
-                numComments++;
-
+              ch = pos < end ? (unsigned char) *pos++ : EOF;
               if (ch == '/')
                 {
                   logger(DEBUG, "End of comment (multi-line)");
                   isComment = false;
-                  charNext = 0;
                 }
             }
 
@@ -609,17 +1519,18 @@ rem_comments (FILE *source_fp, FILE *dest_fp)
           if (isComment && ch == EOF)
             {
               fprintf (stderr, "Invalid end of file in comment");
+              free (src);
               return EXIT_FAILURE;
             }
 
           /// If char is a newline, write to file to preserve line numbers
           if (ch == '\n')
-              fputc (ch, dest_fp);
-
+            fputc (ch, dest_fp);
         }
     }
 
-  logger(DEBUG, "Removed %d comment lines", numComments);
+  free (src);
+  logger(DEBUG, "Removed %d comments", numComments);
   logger(DEBUG, "=== END ===");
   return EXIT_SUCCESS;
 }
@@ -638,7 +1549,7 @@ rem_comments (FILE *source_fp, FILE *dest_fp)
  *
  */
 short
-proc_includes (FILE *source_fp, FILE *dest_fp)
+proc_includes (opal_ctx_s *ctx, FILE *source_fp, FILE *dest_fp)
 {
   logger(DEBUG, "=== START ===");
 
@@ -653,8 +1564,8 @@ proc_includes (FILE *source_fp, FILE *dest_fp)
   _PASS;
 
   /// Move source_fp to beginning of file.
-  sprintf (perror_msg, "fseek (source_fp, 0, SEEK_SET)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fseek (source_fp, 0, SEEK_SET)");
+  logger(DEBUG, ctx->perror_msg);
   fseek (source_fp, 0, SEEK_SET);
 
   /// If source file position not 0, print error and exit
@@ -662,157 +1573,159 @@ proc_includes (FILE *source_fp, FILE *dest_fp)
     _DONE;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      exit (opal_exit(errno));
+      opal_abort (ctx, errno);
     }
 
-  /// Copy each character to the destination file, while checking for include files.
+  /// Read the whole source into one buffer
+  size_t len = 0;
+  char *src = read_stream (ctx, source_fp, &len);
+  if (src == NULL)
+    return (errno);
+
+  /// Copy the source to the destination file, while checking for include files.
   logger(DEBUG, "Reading file.");
-  char ch = fgetc (source_fp);
-  while (ch != EOF)
+  const char *pos = src;
+  const char *end = src + len;
+  while (pos < end)
     {
-      switch (ch)
+      /// Copy text up to the next # in one run
+      const char *hash = memchr (pos, '#', end - pos);
+      if (hash == NULL)
         {
-        case EOF:
-          {
-            _DONE;
-            break;
-          }
-        case ('#'):
-          {
-            logger(DEBUG, "Found hashtag symbol.");
-
-            ///Reads in 8 chars to check if they are "include ".
-            char include_buffer[9] = { 0 };
-            ssize_t sz = fread (include_buffer, sizeof(char), sizeof(char) * 8,
-                                source_fp);
-
-            /// Rewinds the file pointer.
-            fseek (source_fp, -sz, SEEK_CUR);
-
-            /// If include is found, process the included file.
-            if (strcasecmp (include_buffer, "include ") == 0)
-              {
-                logger(DEBUG, "Include keyword has been found.");
-
-                /// Move file pointer to the point after "include "
-                fseek (source_fp, sz, SEEK_CUR);
-                char filename_buffer[256] = { 0 };
-                int filename_len = 0;
-
-                /// Get the filename for the include file.
-                ch = fgetc (source_fp);
-                while (ch != '\n' && filename_len < 256)
-                  {
-                    if (ch != '"')
-                      filename_buffer[filename_len++] = ch;
-                    ch = fgetc (source_fp);
-                  }
-                logger(DEBUG, "Finished reading in the filename.");
+          fwrite (pos, 1, end - pos, dest_fp);
+          break;
+        }
+      fwrite (pos, 1, hash - pos, dest_fp);
+      pos = hash + 1;
+      logger(DEBUG, "Found hashtag symbol.");
 
-                char *include_basename = basename (filename_buffer);
-                char include_fn[512] = { 0 };
-                FILE *include_fp = NULL;
+      /// If "include " does not follow, copy the # as it is
+      if (end - pos < 8 || strncasecmp (pos, "include ", 8) != 0)
+        {
+          fputc ('#', dest_fp);
+          continue;
+        }
+      logger(DEBUG, "Include keyword has been found.");
+
+      /// Get the filename for the include file, up to the newline, which
+      /// is copied with the text after it
+      pos += 8;
+      char filename_buffer[256] = { 0 };
+      int filename_len = 0;
+      while (pos < end && *pos != '\n' && filename_len < 255)
+        {
+          if (*pos != '"')
+            filename_buffer[filename_len++] = *pos;
+          pos++;
+        }
+      logger(DEBUG, "Finished reading in the filename.");
 
-                /// If given file name is relative path, prefix source file dir
-                if (strcmp (filename_buffer, include_basename) == 0)
-                  {
-                    /// Get source file directory
-                    char *source_dir = dirname (source_fn);
-                    logger(DEBUG, "source_dir: %s", source_dir);
-                    sprintf (include_fn, "%s/%s", source_dir, include_basename);
-                  }
-                else
-                  sprintf (include_fn, "%s", filename_buffer);
+      char *include_basename = basename (filename_buffer);
+      char include_fn[512] = { 0 };
+      FILE *include_fp = NULL;
 
-                logger(DEBUG, "include_fn: %s", include_fn);
+      /// If given file name is relative path, prefix source file dir
+      if (strcmp (filename_buffer, include_basename) == 0)
+        {
+          /// Get source file directory from a copy, since
+          /// dirname() may modify its argument
+          char source_dir_buf[512] = { 0 };
+          snprintf (source_dir_buf, sizeof(source_dir_buf), "%s",
+                    ctx->source_fn);
+          char *source_dir = dirname (source_dir_buf);
+          logger(DEBUG, "source_dir: %s", source_dir);
+          sprintf (include_fn, "%s/%s", source_dir, include_basename);
+        }
+      else
+        sprintf (include_fn, "%s", filename_buffer);
 
-                /// If include file does not exist, print error and exit
-                sprintf (perror_msg, "access('%s', F_OK)", include_fn);
-                logger(DEBUG, perror_msg);
-                if (access (include_fn, F_OK) == EXIT_SUCCESS)
-                  _PASS;
-                else
-                  {
-                    perror (perror_msg);
-                    _FAIL;
-                    return (errno);
-                  }
+      logger(DEBUG, "include_fn: %s", include_fn);
 
-                /// If include file can not be read, print error and exit
-                sprintf (perror_msg, "access('%s', R_OK)", include_fn);
-                logger(DEBUG, perror_msg);
-                if (access (include_fn, R_OK) == EXIT_SUCCESS)
-                  _PASS;
-                else
-                  {
-                    perror (perror_msg);
-                    _FAIL;
-                    return (errno);
-                  }
+      /// If include file does not exist, print error and exit
+      sprintf (ctx->perror_msg, "access('%s', F_OK)", include_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (access (include_fn, F_OK) == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          free (src);
+          return (errno);
+        }
 
-                /// Open include file in read-only mode
-                sprintf (perror_msg, "include_fp = fopen('%s', 'r')",
-                         include_fn);
-                logger(DEBUG, perror_msg);
+      /// If include file can not be read, print error and exit
+      sprintf (ctx->perror_msg, "access('%s', R_OK)", include_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (access (include_fn, R_OK) == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          free (src);
+          return (errno);
+        }
 
-                errno = EXIT_SUCCESS;
-                include_fp = fopen (include_fn, "r");
-                if (errno == EXIT_SUCCESS)
-                  _PASS;
-                else
-                  {
-                    perror (perror_msg);
-                    _FAIL;
-                    return (errno);
-                  }
+      /// Open include file in read-only mode
+      sprintf (ctx->perror_msg, "include_fp = fopen('%s', 'r')",
+               include_fn);
+      logger(DEBUG, ctx->perror_msg);
 
-                char ch_2 = fgetc (include_fp);
+      errno = EXIT_SUCCESS;
+      include_fp = fopen (include_fn, "r");
+      if (errno == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          free (src);
+          return (errno);
+        }
 
-                /// Move contents of include file into destination file
-                logger(DEBUG, "Copy contents of %s into destination file",
-                       include_fn);
-                while (ch_2 != EOF)
-                  {
-                    fputc (ch_2, dest_fp);
-                    ch_2 = fgetc (include_fp);
-                  }
-                _DONE;
-
-                /// Flush destination file contents to disk
-                sprintf (perror_msg, "fflush(dest_fp)");
-                logger(DEBUG, perror_msg);
-                if (fflush (dest_fp) == EXIT_SUCCESS)
-                  _PASS;
-                else
-                  {
-                    perror (perror_msg);
-                    _FAIL;
-                    return (errno);
-                  }
+      /// Move contents of include file into destination file
+      logger(DEBUG, "Copy contents of %s into destination file",
+             include_fn);
+      size_t include_len = 0;
+      char *include_src = read_stream (ctx, include_fp, &include_len);
+      if (include_src == NULL)
+        {
+          fclose (include_fp);
+          free (src);
+          return (errno);
+        }
+      fwrite (include_src, 1, include_len, dest_fp);
+      free (include_src);
+      _DONE;
 
-                /// Close include file pointer
-                sprintf (perror_msg, "fclose (include_fp)");
-                logger(DEBUG, perror_msg);
-                if (fclose (include_fp) == EXIT_SUCCESS)
-                  _PASS;
-                else
-                  {
-                    perror (perror_msg);
-                    _FAIL;
-                    return (errno);
-                  }
-              }
-            continue;
-          }
-        default:
-          {
-            fputc (ch, dest_fp);
-          }
+      /// Close include file pointer
+      sprintf (ctx->perror_msg, "fclose (include_fp)");
+      logger(DEBUG, ctx->perror_msg);
+      if (fclose (include_fp) == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          free (src);
+          return (errno);
         }
-      /// Gets the next char for the switch case to evaluate.
-      ch = fgetc (source_fp);
+    }
+  free (src);
+
+  /// Flush destination file contents
+  sprintf (ctx->perror_msg, "fflush(dest_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (fflush (dest_fp) == EXIT_SUCCESS)
+    _PASS;
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+      return (errno);
     }
 
   logger(DEBUG, "=== END ===");
@@ -833,7 +1746,7 @@ proc_includes (FILE *source_fp, FILE *dest_fp)
  *
  */
 short
-print_marc_html(FILE *source_fp, FILE *report_fp)
+print_marc_html(opal_ctx_s *ctx, FILE *source_fp, FILE *report_fp)
 {
   logger(DEBUG, "=== START ===");
 
@@ -854,22 +1767,23 @@ print_marc_html(FILE *source_fp, FILE *report_fp)
 
   /// Append MARC output file to report file
   logger (DEBUG, "Copying MARC output to HTML report");
-  char ch = 0;
-  while ((ch = fgetc (source_fp)) != EOF)
-    fputc (ch, report_fp);
+  char block[4096];
+  size_t block_len = 0;
+  while ((block_len = fread (block, 1, sizeof(block), source_fp)) > 0)
+    fwrite (block, 1, block_len, report_fp);
   _DONE;
 
   fprintf (report_fp, "\n</textarea>\n");
 
   /// Flush contents of report to disk
-  sprintf (perror_msg, "fflush(report_fp)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fflush(report_fp)");
+  logger(DEBUG, ctx->perror_msg);
   if (fflush (report_fp) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
@@ -888,9 +1802,149 @@ print_marc_html(FILE *source_fp, FILE *report_fp)
  * ==================================
  */
 
+/**
+ * @brief       Skip whitespace in the source buffer
+ *
+ * @details     Whitespace is classified 16 bytes at a time with SSE2 where
+ * available, and a byte at a time for the tail or without it. Newlines
+ * skipped are counted into the line number, and the start of the last line
+ * is kept for the column.
+ */
+static void
+skip_space (opal_ctx_s *ctx)
+{
+  const char *p = ctx->src_buf + ctx->src_pos;
+  const char *end = ctx->src_buf + ctx->src_len;
+
+#ifdef __SSE2__
+  while (end - p >= 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) p);
+
+      /// isspace() is ' ' and '\t' to '\r'; bytes above 127 compare negative
+      __m128i ctl = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('\t' - 1)),
+                                   _mm_cmplt_epi8 (v, _mm_set1_epi8 ('\r' + 1)));
+      __m128i space = _mm_or_si128 (ctl, _mm_cmpeq_epi8 (v, _mm_set1_epi8 (' ')));
+      unsigned space_mask = _mm_movemask_epi8 (space);
+      unsigned nl_mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\n')));
+
+      /// Only newlines before the first non-space count
+      int len = 16;
+      if (space_mask != 0xFFFF)
+        {
+          len = __builtin_ctz (~space_mask);
+          nl_mask &= (1u << len) - 1;
+        }
+      if (nl_mask)
+        ctx->src_line = p - ctx->src_buf + 32 - __builtin_clz (nl_mask);
+
+      /// Count newlines by clearing the lowest bit; popcount would need
+      /// libgcc, which the library is not linked with
+      for (; nl_mask; nl_mask &= nl_mask - 1)
+        ++ctx->char_line;
+
+      p += len;
+      if (len < 16)
+        {
+          ctx->src_pos = p - ctx->src_buf;
+          return;
+        }
+    }
+#endif
+
+  while (p < end && isspace((unsigned char) *p))
+    {
+      if (*p++ == '\n')
+        {
+          ++ctx->char_line;
+          ctx->src_line = p - ctx->src_buf;
+        }
+    }
+  ctx->src_pos = p - ctx->src_buf;
+}
+
+/**
+ * @brief       Find end of a word of letters, digits and underscores
+ *
+ * @details     Word characters are classified 16 bytes at a time with SSE2
+ * where available. Without it this is a DFA that stays on integer while only
+ * digits are seen and moves to name on the first letter or underscore.
+ *
+ * @param[in]   p       Start of word
+ * @param[in]   end     End of source
+ * @param[out]  name    Set if the word has a character other than a digit
+ *
+ * @return      First character after the word
+ */
+static const char*
+scan_word (const char *p, const char *end, bool *name)
+{
+#ifdef __SSE2__
+  while (end - p >= 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) p);
+      __m128i lower = _mm_or_si128 (v, _mm_set1_epi8 (0x20));
+      __m128i alpha = _mm_and_si128 (_mm_cmpgt_epi8 (lower, _mm_set1_epi8 ('a' - 1)),
+                                     _mm_cmplt_epi8 (lower, _mm_set1_epi8 ('z' + 1)));
+      __m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('0' - 1)),
+                                     _mm_cmplt_epi8 (v, _mm_set1_epi8 ('9' + 1)));
+      __m128i under = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('_'));
+      unsigned digit_mask = _mm_movemask_epi8 (digit);
+      unsigned word_mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (alpha, under),
+                                                            digit));
+
+      int len = 16;
+      if (word_mask != 0xFFFF)
+        len = __builtin_ctz (~word_mask);
+      if ((word_mask & ~digit_mask) & ((1u << len) - 1))
+        *name = true;
+
+      p += len;
+      if (len < 16)
+        return p;
+    }
+#endif
+
+  for (; p < end && (isalnum((unsigned char) *p) || *p == '_'); p++)
+    if (!isdigit((unsigned char) *p))
+      *name = true;
+  return p;
+}
+
+/**
+ * @brief       Find end of the text of a string literal
+ *
+ * @param[in]   p       Start of text, after the opening quote
+ * @param[in]   end     End of source
+ *
+ * @return      First quote or newline, or end if there is none
+ */
+static const char*
+scan_string (const char *p, const char *end)
+{
+#ifdef __SSE2__
+  while (end - p >= 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) p);
+      unsigned stop_mask = _mm_movemask_epi8 (
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('"')),
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\n'))));
+      if (stop_mask)
+        return p + __builtin_ctz (stop_mask);
+      p += 16;
+    }
+#endif
+
+  while (p < end && *p != '"' && *p != '\n')
+    p++;
+  return p;
+}
+
 /**
  * @brief       Get lexeme for a string literal
  *
+ * @details     The text is interned straight from the source buffer.
+ *
  * @param[in]   char_line      line number of char in source file
  * @param[in]   char_col       column number of char in source file
  *
@@ -899,45 +1953,38 @@ print_marc_html(FILE *source_fp, FILE *report_fp)
  * @retval      struct lexeme *
  */
 lexeme_s
-get_string_literal_lexeme (int char_line, int char_col)
+get_string_literal_lexeme (opal_ctx_s *ctx, int char_line, int char_col)
 {
-  /// Initialize the string
-  char string[256] = { 0 };
+  /// The opening quote has been read, the text starts after it
+  const char *start = ctx->src_buf + ctx->src_pos;
+  const char *end = scan_string (start, ctx->src_buf + ctx->src_len);
 
-  int index = 0;
-
-  /// The next char needs to be checked, so get it.
-  read_next_char ();
-
-  while (next_char != '"')
+  if (end == ctx->src_buf + ctx->src_len)
     {
-      if (next_char == EOF)
-        {
-          fprintf (stderr, "[%d:%d] Illegal End of file in string.\n", char_line,
-                   char_col);
-          exit (opal_exit (EXIT_FAILURE));
-        }
-      else if (next_char == '\n')
-        {
-          fprintf (stderr, "[%d:%d] Illegal newline character in string.\n",
-                   char_line, char_col);
-          exit (opal_exit (EXIT_FAILURE));
-        }
-      else
-        string[index++] = next_char;
-
-      read_next_char ();
+      fprintf (stderr, "[%d:%d] Illegal End of file in string.\n", char_line,
+               char_col);
+      opal_abort (ctx, EXIT_FAILURE);
+    }
+  else if (*end == '\n')
+    {
+      fprintf (stderr, "[%d:%d] Illegal newline character in string.\n",
+               char_line, char_col);
+      opal_abort (ctx, EXIT_FAILURE);
     }
 
-  read_next_char ();
+  /// Move past the closing quote and read the next char
+  ctx->src_pos = end + 1 - ctx->src_buf;
+  read_next_char (ctx);
 
+  int sym = intern_symbol (ctx, start, end - start, true);
   lexeme_s retVal =
     {
       .type = lx_String,
       .line = char_line,
       .column = char_col,
       .int_val = 0,
-      .char_val = strdup(string)
+      .char_val = ctx->syms[sym].name,
+      .sym = sym
     };
 
   return retVal;
@@ -952,25 +1999,25 @@ get_string_literal_lexeme (int char_line, int char_col)
  *
  */
 lexeme_type_e
-binary_unary (char compound_char, lexeme_type_e compound_type,
+binary_unary (opal_ctx_s *ctx, char compound_char, lexeme_type_e compound_type,
               lexeme_type_e simple_type, int char_line, int char_col)
 {
   /// Initialize return variable.
   lexeme_type_e retVal = lx_NOP;
 
   /// The next char needs to be checked, so get it.
-  read_next_char ();
+  read_next_char (ctx);
 
-  if (next_char == EOF)
+  if (ctx->next_char == EOF)
     {
       /// Illegal character found.
       logger(ERROR, "[%d:%d] Illegal End of file.", char_line, char_col);
-      opal_exit(EXIT_FAILURE);
+      opal_exit(ctx, EXIT_FAILURE);
     }
-  else if (next_char == compound_char)
+  else if (ctx->next_char == compound_char)
     {
       /// Compound type found, so get the next char and return compound_type.
-      read_next_char ();
+      read_next_char (ctx);
       retVal = compound_type;
     }
   else
@@ -989,57 +2036,54 @@ binary_unary (char compound_char, lexeme_type_e compound_type,
  *
  */
 lexeme_s
-get_identifier_lexeme (int char_line, int char_col)
+get_identifier_lexeme (opal_ctx_s *ctx, int char_line, int char_col)
 {
   lexeme_s retVal = { 0 };
   retVal.line = char_line;
   retVal.column = char_col;
-  char identifier_str[1024] = { 0 };
-  int str_len = 0;
-  bool regex_match = false;
-
-  /// Get string to analyze
-  while (isalnum(next_char) || next_char == '_')
-    {
-      identifier_str[str_len++] = next_char;
-      read_next_char ();
-    }
 
-  /// Terminate string
-  identifier_str[str_len++] = '\0';
+  /// The word starts at the char already read, and is used in place
+  const char *start = ctx->src_buf + ctx->src_pos - 1;
+  bool name = false;
+  const char *end = scan_word (start, ctx->src_buf + ctx->src_len, &name);
+  int len = end - start;
 
   /// Error for unsupported characters
-  if (str_len == 1)
+  if (len == 0)
     {
       fprintf (stderr, "[%d: %d] Invalid identifier: %c.", char_line, char_col,
-               next_char);
-      exit (opal_exit(EXIT_FAILURE));
+               ctx->next_char);
+      opal_abort (ctx, EXIT_FAILURE);
     }
 
-  /// Determine if string is a reserved keyword
-  int i = 0;
-  for (i = 0; i < (sizeof(keyword_arr) / sizeof(keyword_arr[0])); i++)
+  /// Move past the word and read the next char
+  ctx->src_pos = end - ctx->src_buf;
+  read_next_char (ctx);
+
+  /// Determine if name is a reserved keyword, by its perfect hash slot
+  if (name && len >= keyword_min_len && len <= keyword_max_len)
     {
-      if (strcmp (identifier_str, keyword_arr[i].str) == 0)
+      int k = keyword_hash_arr[keyword_hash(start[0], len)];
+      if (k && strncmp (start, keyword_arr[k - 1].str, len) == 0
+          && keyword_arr[k - 1].str[len] == '\0')
         {
-          retVal.type = keyword_arr[i].lex_type;
+          retVal.type = keyword_arr[k - 1].lex_type;
           return retVal;
         }
     }
 
-  /// Determine if the string is an integer via regex
-  regex_match = match (identifier_str, int_regex_pattern);
-  if (regex_match)
+  if (!name)
     {
-      logger(DEBUG, "strtol (%s, NULL, 0)", identifier_str);
+      logger(DEBUG, "strtol (%.*s, NULL, 0)", len, start);
 
+      /// The word is all digits, so strtol() stops at its end
       errno = EXIT_SUCCESS;
-      int intVal = strtol (identifier_str, NULL, 0);
+      int intVal = strtol (start, NULL, 0);
       if (errno != EXIT_SUCCESS)
         {
-          perror (identifier_str);
+          fprintf (stderr, "%.*s: %s\n", len, start, strerror (errno));
           _FAIL;
-          exit (opal_exit(EXIT_FAILURE));
+          opal_abort (ctx, EXIT_FAILURE);
         }
       else
         {
@@ -1052,71 +2096,43 @@ get_identifier_lexeme (int char_line, int char_col)
     {
       /// String must be an identifier
       retVal.type = lx_Ident;
-      retVal.char_val = strdup(identifier_str);
+      retVal.sym = intern_symbol (ctx, start, len, false);
+      retVal.char_val = ctx->syms[retVal.sym].name;
     }
 
   return retVal;
 }
 
 /**
- * @brief       Matches a string against a regular expression pattern.
- *              From pubs.opengroup.org/onlinepubs/007904875/functions/regcomp.html
- *
- * @param[in]   str             String to match
- * @param[in]   pattern         Extended regular expression
+ * @brief       Get the next lexeme based on the next character
  *
- * @return      The result of the pattern match.
+ * @return      Next lexeme struct with values populated
  *
- * @retval      true(1)         On match
- * @retval      false(0)        On error
+ * @retval      struct lexeme
  *
  */
-bool
-match (const char *str, const char *pattern)
+lexeme_s
+get_next_lexeme (opal_ctx_s *ctx)
 {
-  int status;
-  regex_t regEx;
 
-  ///Ensure regex is set up properly
-  if (regcomp (&regEx, pattern, REG_EXTENDED | REG_NOSUB) != EXIT_SUCCESS)
-    return false;
+  /// Create a empty struct to populate and return
+  lexeme_s retVal = { 0 };
 
-  ///Process string against regex pattern
-  status = regexec (&regEx, str, (size_t) 0, NULL, 0);
-
-  regfree (&regEx);
-
-  if (status != EXIT_SUCCESS)
-    return false;
-
-  return true;
-}
-
-/**
- * @brief       Get the next lexeme based on the next character
- *
- * @return      Next lexeme struct with values populated
- *
- * @retval      struct lexeme
- *
- */
-lexeme_s
-get_next_lexeme (void)
-{
-
-  /// Create a empty struct to populate and return
-  lexeme_s retVal = { 0 };
-
-  /// Call read_next_char() to get the next character from source
-  while (isspace(next_char))
-    read_next_char ();
+  /// Skip whitespace in the source, then read the next character
+  if (isspace(ctx->next_char))
+    {
+      skip_space (ctx);
+      read_next_char (ctx);
+    }
 
-  /// Populate lexeme line and column number
-  retVal.line = char_line;
-  retVal.column = char_col;
+  /// Populate lexeme line and column number, the column being the distance
+  /// from the start of the line, plus any reads past the end of the source
+  ctx->char_col = ctx->src_pos - ctx->src_line + ctx->src_eof_reads;
+  retVal.line = ctx->char_line;
+  retVal.column = ctx->char_col;
 
   /// Get the lexeme type based on the next character
-  switch (next_char)
+  switch (ctx->next_char)
     {
     case '{':
       retVal.type = lx_Lbrace;
@@ -1152,33 +2168,39 @@ get_next_lexeme (void)
       retVal.type = lx_Sub;
       break;
     case '<':
-      retVal.type = binary_unary ('=', lx_Leq, lx_Lss, char_line, char_col);
+      retVal.type = binary_unary (ctx, '=', lx_Leq, lx_Lss,
+                                  ctx->char_line, ctx->char_col);
       return retVal;
     case '>':
-      retVal.type = binary_unary ('=', lx_Geq, lx_Gtr, char_line, char_col);
+      retVal.type = binary_unary (ctx, '=', lx_Geq, lx_Gtr,
+                                  ctx->char_line, ctx->char_col);
       return retVal;
     case '=':
-      retVal.type = binary_unary ('=', lx_Eq, lx_Assign, char_line, char_col);
+      retVal.type = binary_unary (ctx, '=', lx_Eq, lx_Assign,
+                                  ctx->char_line, ctx->char_col);
       return retVal;
     case '!':
-      retVal.type = binary_unary ('=', lx_Neq, lx_Not, char_line, char_col);
+      retVal.type = binary_unary (ctx, '=', lx_Neq, lx_Not,
+                                  ctx->char_line, ctx->char_col);
       return retVal;
     case '&':
-      retVal.type = binary_unary ('&', lx_And, lx_EOF, char_line, char_col);
+      retVal.type = binary_unary (ctx, '&', lx_And, lx_EOF,
+                                  ctx->char_line, ctx->char_col);
       return retVal;
     case '|':
-      retVal.type = binary_unary ('|', lx_Or, lx_EOF, char_line, char_col);
+      retVal.type = binary_unary (ctx, '|', lx_Or, lx_EOF,
+                                  ctx->char_line, ctx->char_col);
       return retVal;
     case '"':
-      return get_string_literal_lexeme (char_line, char_col);
+      return get_string_literal_lexeme (ctx, ctx->char_line, ctx->char_col);
     case EOF:
       retVal.type = lx_EOF;
       break;
     default:
-      return get_identifier_lexeme (char_line, char_col);
+      return get_identifier_lexeme (ctx, ctx->char_line, ctx->char_col);
     }
 
-  read_next_char ();
+  read_next_char (ctx);
   return retVal;
 }
 
@@ -1216,10 +2238,267 @@ get_lexeme_str (const lexeme_s *lexeme, char *buffer, const int buffer_len)
   return EXIT_SUCCESS;
 }
 
+/**
+ * @brief       Hash an identifier or string for the interned symbol index
+ *
+ * @param[in]   name     Identifier name or string text
+ * @param[in]   len      Length of name
+ * @param[in]   is_str   String literal rather than identifier
+ *
+ * @retval      FNV-1a hash of name, seeded apart for strings
+ */
+static unsigned
+hash_symbol (const char *name, size_t len, bool is_str)
+{
+  unsigned hash = is_str ? 0x050c5d1fu : 2166136261u;
+  const char *end = name + len;
+  for (; name < end; name++)
+    hash = (hash ^ (unsigned char) *name) * 16777619u;
+
+  return hash;
+}
+
+/**
+ * @brief       Get interned symbol of identifier or string, add if missing
+ *
+ * @details     Identifiers and strings live in separate namespaces, so an
+ * identifier and a string with the same text get separate symbols. Lookups
+ * probe an open addressing index kept at most half full, so interning is
+ * O(1) per occurrence however many names the program uses. The symbol slot
+ * is left at -1 for GENIE to give on first use. The name need not be NUL
+ * terminated, so it can be a slice of the source; it is copied to the arena
+ * the first time it is seen.
+ *
+ * @param[in]   name     Identifier name or string text
+ * @param[in]   len      Length of name
+ * @param[in]   is_str   String literal rather than identifier
+ *
+ * @return      Index of symbol in ctx->syms
+ */
+int
+intern_symbol (opal_ctx_s *ctx, const char *name, size_t len, bool is_str)
+{
+  unsigned hash = hash_symbol (name, len, is_str);
+
+  /// Double the index before it gets more than half full
+  if (2 * (ctx->syms_len + 1) > ctx->sym_index_cap)
+    {
+      unsigned cap = ctx->sym_index_cap ? 2 * ctx->sym_index_cap : 256;
+      unsigned *index = arena_alloc (ctx, cap * sizeof(unsigned));
+
+      unsigned i = 0;
+      for (i = 0; i < ctx->syms_len; i++)
+        {
+          unsigned pos = ctx->syms[i].hash & (cap - 1);
+          while (index[pos])
+            pos = (pos + 1) & (cap - 1);
+          index[pos] = i + 1;
+        }
+
+      ctx->sym_index = index;
+      ctx->sym_index_cap = cap;
+    }
+
+  /// Probe for the symbol and return it if found
+  unsigned pos = hash & (ctx->sym_index_cap - 1);
+  while (ctx->sym_index[pos])
+    {
+      intern_sym_s *symbol = &ctx->syms[ctx->sym_index[pos] - 1];
+      if (symbol->hash == hash && symbol->is_str == is_str
+          && strncmp (symbol->name, name, len) == 0
+          && symbol->name[len] == '\0')
+        return ctx->sym_index[pos] - 1;
+      pos = (pos + 1) & (ctx->sym_index_cap - 1);
+    }
+
+  /// Otherwise append it to the symbols
+  if (ctx->syms_len == ctx->syms_cap)
+    {
+      unsigned cap = ctx->syms_cap ? 2 * ctx->syms_cap : 64;
+      ctx->syms = arena_realloc (ctx, ctx->syms,
+                                 ctx->syms_cap * sizeof(intern_sym_s),
+                                 cap * sizeof(intern_sym_s));
+      ctx->syms_cap = cap;
+    }
+
+  char *copy = arena_alloc (ctx, len + 1);
+  memcpy (copy, name, len);
+
+  int sym = ctx->syms_len++;
+  ctx->syms[sym] = (intern_sym_s)
+    {
+      .name = copy,
+      .hash = hash,
+      .is_str = is_str,
+      .slot = -1
+    };
+  ctx->sym_index[pos] = sym + 1;
+  logger(DEBUG, "Interned %s '%s' as symbol %d.",
+         is_str ? "string" : "identifier", copy, sym);
+
+  return sym;
+}
+
+/**
+ * @brief       Store token at position in token arrays
+ *
+ * @param[in,out]   table     Token arrays to store in
+ * @param[in]       pos       Position to store at, within capacity
+ * @param[in]       lexeme    Lexeme of token, with sym set
+ */
+static void
+put_token (token_table_s *table, unsigned pos, const lexeme_s *lexeme)
+{
+  table->type[pos] = lexeme->type;
+  table->line[pos] = lexeme->line;
+  table->column[pos] = lexeme->column;
+  table->value[pos] = lexeme->type == lx_Integer ? lexeme->int_val
+      : lexeme->sym;
+}
+
+/**
+ * @brief       Append token to symbol table, growing its arrays as needed
+ *
+ * @param[in,out]   table     Symbol table to append to
+ * @param[in]       lexeme    Lexeme of token, with sym set
+ */
+static void
+append_token (opal_ctx_s *ctx, token_table_s *table, const lexeme_s *lexeme)
+{
+  if (table->len == table->cap)
+    {
+      unsigned cap = table->cap ? 2 * table->cap : 1024;
+      table->type = arena_realloc (ctx, table->type,
+                                   table->cap * sizeof(lexeme_type_e),
+                                   cap * sizeof(lexeme_type_e));
+      table->line = arena_realloc (ctx, table->line, table->cap * sizeof(int),
+                                   cap * sizeof(int));
+      table->column = arena_realloc (ctx, table->column,
+                                     table->cap * sizeof(int),
+                                     cap * sizeof(int));
+      table->value = arena_realloc (ctx, table->value,
+                                    table->cap * sizeof(int),
+                                    cap * sizeof(int));
+      table->cap = cap;
+    }
+
+  put_token (table, table->len++, lexeme);
+}
+
+/**
+ * @brief       Read the whole source into the lexer buffer
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      errno           On system call failure
+ */
+short
+open_lexer (opal_ctx_s *ctx)
+{
+  free (ctx->src_buf);
+  ctx->src_buf = read_stream (ctx, ctx->source_fp, &ctx->src_len);
+  if (ctx->src_buf == NULL)
+    return (errno);
+  ctx->src_pos = 0;
+  ctx->src_line = 0;
+  ctx->src_eof_reads = 0;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Release the lexer buffer
+ *
+ * @details     Identifiers and strings live in the arena, so the source is
+ * not needed once it has been lexed.
+ */
+void
+close_lexer (opal_ctx_s *ctx)
+{
+  free (ctx->src_buf);
+  ctx->src_buf = NULL;
+}
+
+/**
+ * @brief       Lex the next token into ctx->next_lexeme
+ *
+ * @details     Identifiers and strings come interned by the lexer, so later
+ * passes never compare names; other lexemes get no symbol. The lexeme is
+ * stringified to ctx->lexeme_str for logging.
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On error
+ */
+short
+lex_token (opal_ctx_s *ctx)
+{
+  ctx->next_lexeme = get_next_lexeme (ctx);
+  if (ctx->next_lexeme.type != lx_Ident && ctx->next_lexeme.type != lx_String)
+    ctx->next_lexeme.sym = -1;
+
+  return get_lexeme_str (&ctx->next_lexeme, ctx->lexeme_str, lexeme_str_len);
+}
+
+/**
+ * @brief       Lex the next token into a slot of a token ring
+ *
+ * @details     Used by ASTRO to parse while lexing, without a symbol table.
+ *
+ * @param[in,out]   ring      Token arrays used as a ring
+ * @param[in]       slot      Slot to store the token in
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On error
+ */
+short
+stream_token (opal_ctx_s *ctx, token_table_s *ring, unsigned slot)
+{
+  if (lex_token (ctx) != EXIT_SUCCESS)
+    return (EXIT_FAILURE);
+
+  logger(DEBUG, "Stream lexeme {%s}", ctx->lexeme_str);
+  put_token (ring, slot, &ctx->next_lexeme);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Get lexeme for token at position in symbol table
+ *
+ * @param[in]   table   Symbol table
+ * @param[in]   pos     Position of token
+ *
+ * @return      Lexeme with values of the token, char_val pointing to the
+ * interned name of strings and identifiers
+ */
+lexeme_s
+get_token (opal_ctx_s *ctx, const token_table_s *table, unsigned pos)
+{
+  lexeme_s lexeme = { 0 };
+  lexeme.type = table->type[pos];
+  lexeme.line = table->line[pos];
+  lexeme.column = table->column[pos];
+  lexeme.sym = -1;
+
+  if (lexeme.type == lx_Integer)
+    lexeme.int_val = table->value[pos];
+  else if (lexeme.type == lx_Ident || lexeme.type == lx_String)
+    {
+      lexeme.sym = table->value[pos];
+      lexeme.char_val = ctx->syms[lexeme.sym].name;
+    }
+
+  return lexeme;
+}
+
 /**
  * @brief       Populate symbol table with lexemes in source file pointer
  *
- * @param[in,out]   *symbol_table    Symbol table linked list to populate
+ * @param[in,out]   *symbol_table    Symbol table to populate
  * @param[in,out]   *symbol_count    Pointer to count of lexemes found
  *
  * @return      The error return code of the function.
@@ -1230,7 +2509,8 @@ get_lexeme_str (const lexeme_s *lexeme, char *buffer, const int buffer_len)
  *
  */
 short
-build_symbol_table (lexeme_s *symbol_table, int *symbol_count)
+build_symbol_table (opal_ctx_s *ctx, token_table_s *symbol_table,
+                    int *symbol_count)
 {
   logger(DEBUG, "=== START ===");
 
@@ -1244,41 +2524,33 @@ build_symbol_table (lexeme_s *symbol_table, int *symbol_count)
   assert(symbol_count);
   _PASS;
 
-  /// Create symbols at the beginning of the linked list
-  lexeme_s *current = symbol_table;
+  /// Read the whole source into one buffer for the lexer to scan
+  if (open_lexer (ctx) != EXIT_SUCCESS)
+    return (errno);
+
+  /// Start the symbol table with a No_operation token for start of input
+  lexeme_s start = { 0 };
+  start.type = lx_NOP;
+  start.sym = -1;
+  append_token (ctx, symbol_table, &start);
 
   /// Get lexemes in a loop until we get a EOF lexeme
   do
     {
-      /// Call get_next_lexeme() to populate next_lexeme
-      next_lexeme = get_next_lexeme ();
-
-      /// Append next_lexeme to symbol table
-      lexeme_s *new_symbol = (lexeme_s*) calloc (1, sizeof(lexeme_s));
-      new_symbol->line = next_lexeme.line;
-      new_symbol->column = next_lexeme.column;
-      new_symbol->type = next_lexeme.type;
-      new_symbol->int_val = next_lexeme.int_val;
-
-      new_symbol->char_val =
-          next_lexeme.char_val ? strdup(next_lexeme.char_val) : NULL;
-
-      /// Call get_lexeme_str() to stringify next_lexeme
-      if (get_lexeme_str (new_symbol, lexeme_str,
-                          lexeme_str_len) != EXIT_SUCCESS)
+      /// Call lex_token() to populate and stringify next_lexeme
+      if (lex_token (ctx) != EXIT_SUCCESS)
         return (EXIT_FAILURE);
 
       /// Append lexeme to symbol table
-      logger(DEBUG, "Append lexeme {%s}", lexeme_str);
-      current->next = new_symbol;
+      logger(DEBUG, "Append lexeme {%s}", ctx->lexeme_str);
+      append_token (ctx, symbol_table, &ctx->next_lexeme);
 
       /// Increment symbol count
       *symbol_count = *symbol_count + 1;
-
-      /// Move current to last symbol in linked list
-      current = current->next;
     }
-  while (next_lexeme.type != lx_EOF);
+  while (ctx->next_lexeme.type != lx_EOF);
+
+  close_lexer (ctx);
 
   logger(DEBUG, "=== END ===");
   return EXIT_SUCCESS;
@@ -1298,7 +2570,8 @@ build_symbol_table (lexeme_s *symbol_table, int *symbol_count)
  *
  */
 short
-print_symbol_table (lexeme_s *symbol_table, FILE *dest_fp)
+print_symbol_table (opal_ctx_s *ctx, token_table_s *symbol_table,
+                    FILE *dest_fp)
 {
   logger(DEBUG, "=== START ===");
 
@@ -1315,24 +2588,24 @@ print_symbol_table (lexeme_s *symbol_table, FILE *dest_fp)
   /// Write ALEX to destination file
   logger (DEBUG, "Writing ALEX output to destination file.");
 
-  lexeme_s *current = symbol_table;
-  while (current->next)
+  /// Print all tokens but End_of_input
+  unsigned pos = 0;
+  for (pos = 0; pos + 1 < symbol_table->len; pos++)
     {
       /// Call get_lexeme_str() to stringify next_lexeme
-      retVal = get_lexeme_str (current, lexeme_str,
+      lexeme_s current = get_token (ctx, symbol_table, pos);
+      ctx->retVal = get_lexeme_str (&current, ctx->lexeme_str,
                                lexeme_str_len);
-      if (retVal != EXIT_SUCCESS)
+      if (ctx->retVal != EXIT_SUCCESS)
         return (EXIT_FAILURE);
 
       /// Append lexeme to symbol table
-      retVal = fprintf (dest_fp, "%s\n", lexeme_str);
-      if (retVal < 0)
+      ctx->retVal = fprintf (dest_fp, "%s\n", ctx->lexeme_str);
+      if (ctx->retVal < 0)
         {
           perror ("fprintf (dest_fp, next_lexeme_str)");
-          exit (opal_exit (retVal));
+          opal_abort (ctx, ctx->retVal);
         }
-
-      current = current->next;
     }
   _DONE;
 
@@ -1354,7 +2627,8 @@ print_symbol_table (lexeme_s *symbol_table, FILE *dest_fp)
  *
  */
 short
-print_symbol_table_html (lexeme_s *symbol_table, FILE *report_fp)
+print_symbol_table_html (opal_ctx_s *ctx, token_table_s *symbol_table,
+                         FILE *report_fp)
 {
   logger(DEBUG, "=== START ===");
 
@@ -1382,34 +2656,34 @@ print_symbol_table_html (lexeme_s *symbol_table, FILE *report_fp)
   /// Append symbol table to report file
   logger (DEBUG, "Copying ALEX output to HTML report");
 
-  lexeme_s *current = symbol_table;
-  while (current->next)
+  unsigned pos = 0;
+  for (pos = 0; pos + 1 < symbol_table->len; pos++)
     {
+      lexeme_s current = get_token (ctx, symbol_table, pos);
       fprintf (report_fp, "<tr>");
       fprintf (report_fp, "<td>%d</td>\n"
                "<td>%d</td>\n"
                "<td>%s</td>\n",
-               current->line, current->column,
-               op_name[current->type]);
+               current.line, current.column,
+               op_name[current.type]);
 
-      if (current->type == lx_Integer)
+      if (current.type == lx_Integer)
         {
-          fprintf (report_fp, "<td>%d</td>\n", current->int_val);
+          fprintf (report_fp, "<td>%d</td>\n", current.int_val);
         }
-      else if (current->type == lx_Ident)
+      else if (current.type == lx_Ident)
         {
-          fprintf (report_fp, "<td>%s</td>\n", current->char_val);
+          fprintf (report_fp, "<td>%s</td>\n", current.char_val);
         }
-      else if (current->type == lx_String)
+      else if (current.type == lx_String)
         {
-          fprintf (report_fp, "<td>\"%s\"</td>\n", current->char_val);
+          fprintf (report_fp, "<td>\"%s\"</td>\n", current.char_val);
         }
       else
         {
           fprintf (report_fp, "<td></td>\n");
         }
       fprintf (report_fp, "</tr>\n");
-      current = current->next;
     }
 
   fprintf (report_fp, "</table></div>\n");
@@ -1418,14 +2692,14 @@ print_symbol_table_html (lexeme_s *symbol_table, FILE *report_fp)
   _DONE;
 
   /// Flush contents of report to disk
-  sprintf (perror_msg, "fflush(report_fp)");
-  logger(DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fflush(report_fp)");
+  logger(DEBUG, ctx->perror_msg);
   if (fflush (report_fp) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
@@ -1436,39 +2710,85 @@ print_symbol_table_html (lexeme_s *symbol_table, FILE *report_fp)
 }
 
 /**
- * @brief       Free memory allocated for symbol table linked list
+ * @brief       Save symbol table to a binary .otk file
  *
- * @param[in,out]   symbol_table    Symbol table to deallocate
+ * @details     The interned symbols are saved with the tokens, so ASTRO
+ * and GENIE can start from the file without running MARC and ALEX.
  *
- * @return      NULL
+ * @param[in]   symbol_table    Symbol table to save
+ * @param[in]   fn              File to write
+ *
+ * @return      The error return code of the function.
  *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      errno           On system call failure
  */
-void
-free_symbol_table (lexeme_s *symbol_table)
+short
+save_tokens (opal_ctx_s *ctx, const token_table_s *symbol_table,
+             const char *fn)
 {
   logger(DEBUG, "=== START ===");
-  /// Walk symbol table and free individual lexemes
 
-  lexeme_s *next_symbol = NULL;
-  while (symbol_table)
-    {
-      next_symbol = symbol_table;
-      symbol_table = symbol_table->next;
+  ir_header_s header = { .magic = OTK_MAGIC, .len = symbol_table->len,
+                         .tokens = symbol_table->len };
+  const void *arrays[] = { symbol_table->type, symbol_table->line,
+                           symbol_table->column, symbol_table->value };
 
-      get_lexeme_str (next_symbol, lexeme_str, lexeme_str_len);
-      logger(DEBUG, "Free symbol: %s", lexeme_str);
+  ctx->retVal = ir_write (ctx, fn, &header, arrays, 4, sizeof(int));
 
-      if (next_symbol->char_val)
-        {
-          free(next_symbol->char_val);
-          next_symbol->char_val = NULL;
-        }
+  logger(DEBUG, "=== END ===");
+  return ctx->retVal;
+}
+
+/**
+ * @brief       Map symbol table in from a binary .otk file
+ *
+ * @details     The token arrays are used where they lie in the mapped file.
+ * Tokens are checked, so a damaged file can not lead the parser astray.
+ *
+ * @param[out]  symbol_table    Symbol table to fill
+ * @param[in]   fn              File saved by save_tokens()
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On error
+ */
+short
+load_tokens (opal_ctx_s *ctx, token_table_s *symbol_table, const char *fn)
+{
+  logger(DEBUG, "=== START ===");
+
+  ir_header_s *header = ir_map_file (ctx, fn, OTK_MAGIC, 4, sizeof(int));
+  if (header == NULL)
+    return (EXIT_FAILURE);
 
-      free (next_symbol);
-      next_symbol = NULL;
+  int *arrays = (int*) ((uint32_t*) (header + 1) + header->syms_len);
+  symbol_table->type = (lexeme_type_e*) arrays;
+  symbol_table->line = arrays + header->len;
+  symbol_table->column = arrays + 2 * header->len;
+  symbol_table->value = arrays + 3 * header->len;
+  symbol_table->len = symbol_table->cap = header->len;
+
+  /// Every token must be known, with symbols in range, and the last lx_EOF
+  unsigned pos = 0;
+  for (pos = 0; pos < symbol_table->len; pos++)
+    {
+      lexeme_type_e type = symbol_table->type[pos];
+      if ((unsigned) type > lx_Input
+          || ((type == lx_Ident || type == lx_String)
+              && (unsigned) symbol_table->value[pos] >= ctx->syms_len))
+        break;
+    }
+  if (pos < symbol_table->len || pos == 0
+      || symbol_table->type[pos - 1] != lx_EOF)
+    {
+      fprintf (stderr, "%s: damaged token %u\n", fn, pos);
+      return (EXIT_FAILURE);
     }
 
   logger(DEBUG, "=== END ===");
+  return EXIT_SUCCESS;
 }
 
 /*
@@ -1483,26 +2803,90 @@ free_symbol_table (lexeme_s *symbol_table)
  * ==================================
  */
 
+/// Type of token being parsed, needs ctx in scope
+#define AST_TYPE (ctx->ast_tokens->type[ctx->ast_pos & ctx->ast_mask])
+/// Line of token being parsed, needs ctx in scope
+#define AST_LINE (ctx->ast_tokens->line[ctx->ast_pos & ctx->ast_mask])
+/// Column of token being parsed, needs ctx in scope
+#define AST_COLUMN (ctx->ast_tokens->column[ctx->ast_pos & ctx->ast_mask])
+/// Value of token being parsed, needs ctx in scope
+#define AST_VALUE (ctx->ast_tokens->value[ctx->ast_pos & ctx->ast_mask])
+/// Syntax tree node by index, needs ctx in scope
+#define NODE(id) (ctx->nodes[id])
+
 /**
- * @brief       Return syntax tree node with given left and right child nodes
+ * @brief       Move to the next token to parse
+ *
+ * @details     When streaming, the token is lexed into the ring now.
+ */
+static void
+next_ast_token (opal_ctx_s *ctx)
+{
+  ctx->ast_pos++;
+  if (ctx->ast_mask != ~0u
+      && stream_token (ctx, ctx->ast_tokens, ctx->ast_pos & ctx->ast_mask)
+          != EXIT_SUCCESS)
+    opal_abort (ctx, EXIT_FAILURE);
+}
+
+/**
+ * @brief       Take a zeroed node from the syntax tree node pool
+ *
+ * @details     The pool grows by doubling. It is held apart from the arena,
+ * so growing it leaves no old copies behind. Node 0 is taken first and never
+ * handed out, as index 0 stands for no node. Children are always made
+ * before their parent, so they have lower indices.
  *
  * @param[in]   type            Node type to create
- * @param[in]   left_child      Left child node pointer
- * @param[in]   right_child     Right child node pointer
  *
- * @return      Abstract syntax tree node pointer
+ * @return      Index of the node
+ */
+static node_id
+new_node (opal_ctx_s *ctx, ast_node_type_e type)
+{
+  if (ctx->nodes_len == ctx->nodes_cap)
+    {
+      unsigned cap = ctx->nodes_cap ? 2 * ctx->nodes_cap : 1024;
+      node_s *grown = realloc (ctx->nodes_mapped ? NULL : ctx->nodes,
+                               cap * sizeof(node_s));
+      if (grown == NULL)
+        {
+          perror ("realloc(nodes)");
+          opal_abort (ctx, errno);
+        }
+
+      /// A pool mapped in by load_ast() is copied out as it grows
+      if (ctx->nodes_mapped)
+        memcpy (grown, ctx->nodes, ctx->nodes_len * sizeof(node_s));
+      ctx->nodes_mapped = FALSE;
+      ctx->nodes = grown;
+      ctx->nodes_cap = cap;
+      if (ctx->nodes_len == 0)
+        ctx->nodes[ctx->nodes_len++] = (node_s) { .node_type = nd_NOP };
+    }
+
+  NODE(ctx->nodes_len) = (node_s) { .node_type = type };
+  return ctx->nodes_len++;
+}
+
+/**
+ * @brief       Return syntax tree node with given left and right child nodes
+ *
+ * @param[in]   type            Node type to create
+ * @param[in]   left_child      Left child node index, or 0
+ * @param[in]   right_child     Right child node index, or 0
  *
- * @retval      node_s*     On success
+ * @return      Abstract syntax tree node index
  */
-node_s*
-make_ast_node(ast_node_type_e type, node_s *left_child, node_s *right_child)
+node_id
+make_ast_node(opal_ctx_s *ctx, ast_node_type_e type, node_id left_child,
+              node_id right_child)
 {
 
   /// Create node with given children and return
-  node_s *tree = calloc (1, sizeof(node_s));
-  tree->left = left_child;
-  tree->right = right_child;
-  tree->node_type = type;
+  node_id tree = new_node (ctx, type);
+  NODE(tree).left = left_child;
+  NODE(tree).right = right_child;
 
   /// Create buffer for logging
   char buffer[1024] = { 0 };
@@ -1510,7 +2894,7 @@ make_ast_node(ast_node_type_e type, node_s *left_child, node_s *right_child)
   /// Append left child node type to log buffer
   strcat (buffer, "left->");
   if (left_child)
-    strcat (buffer, node_name[left_child->node_type]);
+    strcat (buffer, node_name[NODE(left_child).node_type]);
   else
     strcat (buffer, "NULL");
 
@@ -1521,7 +2905,7 @@ make_ast_node(ast_node_type_e type, node_s *left_child, node_s *right_child)
   /// Append right child node type to log buffer
   strcat (buffer, "\tright->");
   if (right_child)
-    strcat (buffer, node_name[right_child->node_type]);
+    strcat (buffer, node_name[NODE(right_child).node_type]);
   else
     strcat (buffer, "NULL");
 
@@ -1534,34 +2918,64 @@ make_ast_node(ast_node_type_e type, node_s *left_child, node_s *right_child)
 /**
  * @brief       Build abstract syntax tree from symbol table
  *
- * @param       symbol_table       Lexeme symbol table
+ * @details     Without a symbol table, tokens are lexed from ctx->source_fp
+ * as they are parsed and held in a ring of TOKEN_RING_LEN tokens, so no more
+ * than the ring is kept. ctx->ast_pos is then the count of tokens read.
+ *
+ * @param       symbol_table       Lexeme symbol table, or NULL to stream
  *
  * @return      Abstract syntax tree built from the symbol table
  *
- * @retval      Tree root node pointer      On success
- * @retval      NULL                        On error
+ * @retval      Tree root node index        On success
+ * @retval      0                           On error
  *
  */
-node_s*
-build_syntax_tree (lexeme_s *symbol_table)
+node_id
+build_syntax_tree (opal_ctx_s *ctx, token_table_s *symbol_table)
 {
   logger(DEBUG, "=== START ===");
 
-  /// Check if symbol table pointer is not NULL
-  logger(DEBUG, "assert(symbol_table)");
-  assert(symbol_table);
-  _PASS;
-
-  /// Create syntax tree node NULL pointer to return
-  node_s *tree = NULL;
+  /// Create syntax tree node index to return, 0 for no node
+  node_id tree = 0;
 
   /// Start reading lexemes from the symbol table
-  ast_curr_lexeme = symbol_table;
+  ctx->ast_tokens = symbol_table;
+  ctx->ast_mask = ~0u;
+  ctx->ast_pos = 0;
+
+  /// ... or from the source, starting the ring with a No_operation token
+  if (symbol_table == NULL)
+    {
+      logger(DEBUG, "Stream tokens through a ring of %d.", TOKEN_RING_LEN);
+      if (open_lexer (ctx) != EXIT_SUCCESS)
+        return 0;
+
+      token_table_s *ring = arena_alloc (ctx, sizeof(token_table_s));
+      ring->type = arena_alloc (ctx, TOKEN_RING_LEN * sizeof(lexeme_type_e));
+      ring->line = arena_alloc (ctx, TOKEN_RING_LEN * sizeof(int));
+      ring->column = arena_alloc (ctx, TOKEN_RING_LEN * sizeof(int));
+      ring->value = arena_alloc (ctx, TOKEN_RING_LEN * sizeof(int));
+      ring->type[0] = lx_NOP;
+      ring->value[0] = -1;
+      ring->len = ring->cap = TOKEN_RING_LEN;
+
+      ctx->ast_tokens = ring;
+      ctx->ast_mask = TOKEN_RING_LEN - 1;
+    }
 
   /// Call make_ast_node() until lexeme with lx_EOF is seen
   do {
-      tree = make_ast_node(nd_Sequence, tree, make_statement_node());
-  } while (tree != NULL && ast_curr_lexeme->type != lx_EOF);
+      tree = make_ast_node(ctx, nd_Sequence, tree, make_statement_node(ctx));
+  } while (tree && AST_TYPE != lx_EOF);
+
+  if (symbol_table == NULL)
+    {
+      close_lexer (ctx);
+      ctx->ast_mask = ~0u;
+    }
+
+  logger(DEBUG, "Syntax tree of %u nodes, %zu bytes.", ctx->nodes_len - 1,
+         (ctx->nodes_len - 1) * sizeof(node_s));
 
   logger(DEBUG, "=== END ===");
   return tree;
@@ -1575,45 +2989,45 @@ build_syntax_tree (lexeme_s *symbol_table)
  * @return      NULL
  */
 void
-expect_lexeme (lexeme_type_e expected_type)
+expect_lexeme (opal_ctx_s *ctx, lexeme_type_e expected_type)
 {
-  /// If ast_curr_lexeme is of expected type
-  if (ast_curr_lexeme->type == expected_type)
+  /// If token being parsed is of expected type
+  if (AST_TYPE == expected_type)
     {
       /// ... read next lexeme and return
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
       return;
     }
 
   /// ... else print error and exit
   fprintf(stderr, "%s expected but %s found.", grammar[expected_type].text,
-         grammar[ast_curr_lexeme->type].text);
-  exit (opal_exit (EXIT_FAILURE));
+         grammar[AST_TYPE].text);
+  opal_abort (ctx, EXIT_FAILURE);
 }
 
 /**
  * @brief       Build and return expression inside parantheses
  *
- * @return      Syntax tree node pointer
+ * @return      Syntax tree node index
  *
- * @retval      node_s*     On success
- * @retval      NULL        On error
+ * @retval      node_id     On success
+ * @retval      0           On error
  *
  */
-node_s*
-make_parentheses_expression(void)
+node_id
+make_parentheses_expression(opal_ctx_s *ctx)
 {
   /// Expect left parantheses before the expression
-  expect_lexeme (lx_Lparen);
+  expect_lexeme (ctx, lx_Lparen);
 
   ///
-  node_s *tree = NULL;
+  node_id tree = 0;
 
   /// Create tree for expression inside parantheses
-  tree = make_expression_node (0);
+  tree = make_expression_node (ctx, 0);
 
   /// Expect right parantheses after the expression
-  expect_lexeme (lx_Rparen);
+  expect_lexeme (ctx, lx_Rparen);
 
   /// return tree
   return tree;
@@ -1623,38 +3037,32 @@ make_parentheses_expression(void)
  * @brief
  *
  * @param[in]   type            type of node in tree
- * @param[in]   curr_lexeme     lexeme to make leaf with
+ * @param[in]   pos             position of token to make leaf with
  *
- * @return      Syntax tree node pointer
+ * @return      Syntax tree node index
  *
- * @retval      node_s*     On success
- * @retval      NULL        On error
+ * @retval      node_id     On success
+ * @retval      0           On error
  *
  */
-node_s*
-make_leaf_node (ast_node_type_e type, lexeme_s *curr_lexeme)
+node_id
+make_leaf_node (opal_ctx_s *ctx, ast_node_type_e type, unsigned pos)
 {
 
   logger(DEBUG, "=== START ===");
 
-  /// Create the leaf node to return
-  node_s *node = calloc (1, sizeof(node_s));
-  logger(DEBUG, "assert(node)");
-  assert(node);
-  _PASS;
+  /// Create the leaf node to return, of the given node type
+  node_id node = new_node (ctx, type);
 
-  /// Assign node type to new node
-  node->node_type = type;
+  /// Its value is the interned symbol of a string or an identifier, or the
+  /// value of an integer, as held by the token
+  NODE(node).value = ctx->ast_tokens->value[pos & ctx->ast_mask];
 
-  /// If lexeme type is a string or an identifier
   if ((type == nd_String) || (type == nd_Ident))
-    node->char_val = strdup (curr_lexeme->char_val);
-
-  /// Otherwise the lexeme type is an integer
-  else if (type == nd_Integer)
-    node->int_val = curr_lexeme->int_val;
-
-  logger(DEBUG, "Returning leaf node with val: '%s'.", node->char_val);
+    logger(DEBUG, "Returning leaf node with val: '%s'.",
+           ctx->syms[NODE(node).value].name);
+  else
+    logger(DEBUG, "Returning leaf node with val: %d.", NODE(node).value);
 
   logger(DEBUG, "=== END ===");
   return node;
@@ -1665,44 +3073,46 @@ make_leaf_node (ast_node_type_e type, lexeme_s *curr_lexeme)
  *
  * @param[in]   precedence    Precedence of mathematical operation
  *
- * @return      Syntax tree node pointer
+ * @return      Syntax tree node index
  *
- * @retval      node_s*     On success
- * @retval      NULL        On error
+ * @retval      node_id     On success
+ * @retval      0           On error
  */
-node_s*
-make_expression_node(int precedence)
+node_id
+make_expression_node(opal_ctx_s *ctx, int precedence)
 {
   /// Create the tree node to return
-  node_s* tree = NULL;
-  node_s* node = NULL;
+  node_id tree = 0;
+  node_id node = 0;
 
   lexeme_type_e operator = lx_NOP;
 
-  switch(ast_curr_lexeme->type){
+  switch(AST_TYPE){
 
     case lx_Not:
       /// If lexeme type is Not, get next lexeme
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
 
       /// ...make Not node with the children next_lexeme and NULL
-      tree = make_ast_node(nd_Not,make_expression_node(grammar[lx_Not].precedence),NULL);
+      tree = make_ast_node(ctx, nd_Not,
+                           make_expression_node(ctx, grammar[lx_Not].precedence),
+                           0);
       break;
 
     case lx_Add:
     case lx_Sub:
       /// If lexeme type is Add or Sub, save type
-      operator = ast_curr_lexeme->type;
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      operator = AST_TYPE;
+      next_ast_token (ctx);
 
       /// Get next lexeme and make new expression node with it
-      node = make_expression_node(grammar[lx_Negate].precedence);
+      node = make_expression_node(ctx, grammar[lx_Negate].precedence);
 
       /// If original node type was Sub
       if (operator == lx_Sub)
 
         /// ...make a Negate node with the children new node and NULL
-        tree = make_ast_node(nd_Negate, node, NULL);
+        tree = make_ast_node(ctx, nd_Negate, node, 0);
 
       /// Else only use the new node
       else
@@ -1711,53 +3121,56 @@ make_expression_node(int precedence)
 
     case lx_Integer:
       /// If lexeme type is Integer, make leaf node and get next lexeme
-      tree = make_leaf_node(nd_Integer, ast_curr_lexeme);
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      tree = make_leaf_node(ctx, nd_Integer, ctx->ast_pos);
+      next_ast_token (ctx);
       break;
 
     case lx_Ident:
       /// If lexeme type is Ident, make leaf node and get next lexeme
-      tree = make_leaf_node(nd_Ident, ast_curr_lexeme);
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      tree = make_leaf_node(ctx, nd_Ident, ctx->ast_pos);
+      next_ast_token (ctx);
       break;
 
     case lx_Input:
       /// If lexeme type is Input, get next lexeme
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
 
       /// ...expect LParen
-      expect_lexeme(lx_Lparen);
+      expect_lexeme(ctx, lx_Lparen);
 
-      /// ... and make Input node with NULL as one child
-      node_s *input_tree = make_ast_node (nd_Input,make_leaf_node(nd_String, ast_curr_lexeme), NULL);
+      /// ... and make Input node with no node as one child
+      node_id input_tree = make_ast_node (ctx, nd_Input,
+                                          make_leaf_node(ctx, nd_String,
+                                                         ctx->ast_pos),
+                                          0);
 
       /// ... and expect String contents as the other
-      expect_lexeme(lx_String);
-      tree = make_ast_node(nd_Sequence, input_tree, tree);
+      expect_lexeme(ctx, lx_String);
+      tree = make_ast_node(ctx, nd_Sequence, input_tree, tree);
 
       /// ... finally expect Rparen to close Input
-      expect_lexeme(lx_Rparen);
+      expect_lexeme(ctx, lx_Rparen);
       break;
 
     case lx_Lparen:
       /// If lexeme type is Lparen, make tree from contents within
-      tree = make_parentheses_expression ();
+      tree = make_parentheses_expression (ctx);
       break;
 
     default:
       /// Expressions cannot start with any other type of lexeme
       fprintf (stderr, "[%d:%d] Unexpected lexeme type found: %s\n",
-               ast_curr_lexeme->line, ast_curr_lexeme->column,
-               op_name[ast_curr_lexeme->type]);
-      exit (opal_exit (EXIT_FAILURE));
+               AST_LINE, AST_COLUMN,
+               op_name[AST_TYPE]);
+      opal_abort (ctx, EXIT_FAILURE);
   }
 
     /// While the next lexeme is binary and its precedence is at least as high as the current lexeme
-    while (grammar[ast_curr_lexeme->type].is_binary && grammar[ast_curr_lexeme->type].precedence >= precedence)
+    while (grammar[AST_TYPE].is_binary && grammar[AST_TYPE].precedence >= precedence)
       {
         /// Save lexeme type and get next lexeme
-        lexeme_type_e orig_op = ast_curr_lexeme->type;
-        ast_curr_lexeme = ast_curr_lexeme->next;
+        lexeme_type_e orig_op = AST_TYPE;
+        next_ast_token (ctx);
 
          /// Search for higher precedence in a later lexeme
          int precedence_ctr = grammar[orig_op].precedence;
@@ -1767,10 +3180,10 @@ make_expression_node(int precedence)
              precedence_ctr++;
 
          /// Recursively make new expression node with incremented precedence
-         node = make_expression_node(precedence_ctr);
+         node = make_expression_node(ctx, precedence_ctr);
 
          /// ...and add it to a working tree
-         tree = make_ast_node(grammar[orig_op].node_type, tree, node);
+         tree = make_ast_node(ctx, grammar[orig_op].node_type, tree, node);
 
       }/// ...until all higher precedented lexemes in expression are processed
 
@@ -1780,138 +3193,138 @@ make_expression_node(int precedence)
 /**
  * @brief       Build and return syntax tree node for a statement
  *
- * @return      Syntax tree node pointer
+ * @return      Syntax tree node index
  *
- * @retval      node_s*     On success
- * @retval      NULL        On error
+ * @retval      node_id     On success
+ * @retval      0           On error
  */
-node_s*
-make_statement_node (void)
+node_id
+make_statement_node (opal_ctx_s *ctx)
 {
-  node_s *tree = NULL;                  ///< Syntax tree node to return
-  node_s *value = NULL;                 ///< Leaf node with int/string value
-  node_s *expression = NULL;            ///< Node for expression
-  node_s *condition_statement = NULL;   ///< if/while condition statement node
-  node_s *else_statement = NULL;        ///< else condition statement node
+  node_id tree = 0;                     ///< Syntax tree node to return
+  node_id value = 0;                    ///< Leaf node with int/string value
+  node_id expression = 0;               ///< Node for expression
+  node_id condition_statement = 0;      ///< if/while condition statement node
+  node_id else_statement = 0;           ///< else condition statement node
 
-  switch (ast_curr_lexeme->type)
+  switch (AST_TYPE)
     {
     case lx_If:
       /// If next lexeme is if statement, read next lexeme
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
 
       /// ... get expression inside left parentheses
-      expression = make_parentheses_expression ();
+      expression = make_parentheses_expression (ctx);
 
       /// ... get condition statement node
-      condition_statement = make_statement_node ();
+      condition_statement = make_statement_node (ctx);
 
-      /// ... and create else statement node as NULL
-      else_statement = NULL;
+      /// ... and create else statement node as no node
+      else_statement = 0;
 
       /// If next lexeme is an else
-      if (ast_curr_lexeme->type == lx_Else)
+      if (AST_TYPE == lx_Else)
         {
           /// ... read next lexeme
-          ast_curr_lexeme = ast_curr_lexeme->next;
+          next_ast_token (ctx);
 
           /// ... and make else statement node
-          else_statement = make_statement_node ();
+          else_statement = make_statement_node (ctx);
         }
 
       /// Build and return the tree with left child as the expression node &
       /// right child as the code block to execute
-      tree = make_ast_node (
+      tree = make_ast_node (ctx, 
           nd_If, expression,
-          make_ast_node (nd_If, condition_statement, else_statement));
+          make_ast_node (ctx, nd_If, condition_statement, else_statement));
       break;
 
     case lx_Print:             // print '(' expr {',' expr} ')'
       /// If next lexeme is print, read next lexeme
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
 
       /// Loop over lexemes inside the left and right parantheses of print
       /// statement, incrementing with every comma lexeme found
-      for (expect_lexeme (lx_Lparen);; expect_lexeme (lx_Comma))
+      for (expect_lexeme (ctx, lx_Lparen);; expect_lexeme (ctx, lx_Comma))
         {
           /// For string inside print statement ...
-          if (ast_curr_lexeme->type == lx_String)
+          if (AST_TYPE == lx_String)
             {
               /// Build tree with left child as op-code to print string &
               /// right child as the leaf node representing the string
-              expression = make_ast_node (
-                  nd_Prts, make_leaf_node (nd_String, ast_curr_lexeme), NULL);
+              expression = make_ast_node (ctx, 
+                  nd_Prts, make_leaf_node (ctx, nd_String, ctx->ast_pos), 0);
 
               /// ... and read next lexeme
-              ast_curr_lexeme = ast_curr_lexeme->next;
+              next_ast_token (ctx);
             }
           /// For integer inside print statement ...
           else
             {
               /// Build tree with left child as op-code to print integer &
               /// right child as the expression node representing the integer
-              expression = make_ast_node (
-                  nd_Prti, make_expression_node (0), NULL);
+              expression = make_ast_node (ctx, 
+                  nd_Prti, make_expression_node (ctx, 0), 0);
 
               /// make_expression_node() will read next lexeme
             }
 
           /// Build tree for statement till this comma
-          tree = make_ast_node (nd_Sequence, tree, expression);
+          tree = make_ast_node (ctx, nd_Sequence, tree, expression);
 
           /// If no more commas in print statement, return tree
-          if (ast_curr_lexeme->type != lx_Comma)
+          if (AST_TYPE != lx_Comma)
             break;
         }
 
       /// Expect a ')' & a ';' after print, else print error and exit
-      expect_lexeme (lx_Rparen);
-      expect_lexeme (lx_Semi);
+      expect_lexeme (ctx, lx_Rparen);
+      expect_lexeme (ctx, lx_Semi);
       break;
 
     case lx_Semi:
       /// If next lexeme is semicolon, read next lexeme & return tree
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
       break;
 
     case lx_NOP:
       /// If next lexeme is no operation, read next lexeme & return tree
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
       break;
 
     case lx_Ident:
       /// If next lexeme is an identifier create leaf node for it
-      value = make_leaf_node (nd_Ident, ast_curr_lexeme);
+      value = make_leaf_node (ctx, nd_Ident, ctx->ast_pos);
 
       /// ... and read next lexeme
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
 
       /// Expect an '=' operator after an identifier, else print error and exit
-      expect_lexeme (lx_Assign);
+      expect_lexeme (ctx, lx_Assign);
 
       /// Build expression tree whose result we will assign to the identifier
-      expression = make_expression_node (0);
+      expression = make_expression_node (ctx, 0);
 
       /// Build tree with left child as identifier & right child as expression
-      tree = make_ast_node (nd_Assign, value, expression);
+      tree = make_ast_node (ctx, nd_Assign, value, expression);
 
       /// Expect a semi colon after expression, else print error and exit
-      expect_lexeme (lx_Semi);
+      expect_lexeme (ctx, lx_Semi);
       break;
 
     case lx_While:
       /// If next lexeme is while, read next lexeme
-      ast_curr_lexeme = ast_curr_lexeme->next;
+      next_ast_token (ctx);
 
       /// ... build expression node inside parantheses
-      expression = make_parentheses_expression ();
+      expression = make_parentheses_expression (ctx);
 
       /// ... build tree node to execute if condition is true
-      condition_statement = make_statement_node ();
+      condition_statement = make_statement_node (ctx);
 
       /// ... return while tree with left child as expression & right child as
       /// code block to execute
-      tree = make_ast_node (nd_While, expression, condition_statement);
+      tree = make_ast_node (ctx, nd_While, expression, condition_statement);
       break;
 
     case lx_Lbrace:
@@ -1922,16 +3335,16 @@ make_statement_node (void)
           tree = make_ast_node (nd_Sequence, tree, make_statement_node ());
         }
         */
-      expect_lexeme (lx_Lbrace);
-      while (ast_curr_lexeme->type != lx_Rbrace
-          && ast_curr_lexeme->type != lx_EOF)
+      expect_lexeme (ctx, lx_Lbrace);
+      while (AST_TYPE != lx_Rbrace
+          && AST_TYPE != lx_EOF)
         {
-          tree = make_ast_node (nd_Sequence, tree, make_statement_node ());
+          tree = make_ast_node (ctx, nd_Sequence, tree, make_statement_node (ctx));
         }
 
       /// Expect a right brace after code block and return tree, else print
       /// error and exit
-      expect_lexeme (lx_Rbrace);
+      expect_lexeme (ctx, lx_Rbrace);
       break;
 
     case lx_EOF:
@@ -1941,139 +3354,573 @@ make_statement_node (void)
     default:
       /// Statements cannot start with any other type of lexeme
       fprintf(stderr, "[%d:%d] Cannot start statement with '%s': %s\n",
-             ast_curr_lexeme->line, ast_curr_lexeme->column,
-             grammar[ast_curr_lexeme->type].text, ast_curr_lexeme->char_val);
-      exit(opal_exit(EXIT_FAILURE));
+             AST_LINE, AST_COLUMN, grammar[AST_TYPE].text,
+             AST_TYPE == lx_Ident || AST_TYPE == lx_String
+             ? ctx->syms[AST_VALUE].name : "(null)");
+      opal_abort (ctx, EXIT_FAILURE);
     }
 
   return tree;
 }
 
 /**
- * @brief       Optimize the abstract syntax tree
- * @param[in]   tree
+ * @brief       Look up the grammar attributes of an AST operator node type
+ *
+ * @param[in]   type        Node type to look up
  *
- * @return      Optimized abstract syntax tree root pointer
+ * @return      Grammar entry of the binary/unary operator
  *
- * @retval      node_s*     On success
- * @retval      NULL        On error
+ * @retval      attributes_s*   On success
+ * @retval      NULL            If the node type is not an operator
  */
-node_s*
-optimize_syntax_tree(node_s *tree)
+static const attributes_s*
+opt_operator (ast_node_type_e type)
 {
+  for (size_t i = 0; i < sizeof (grammar) / sizeof (grammar[0]); i++)
+    if (grammar[i].node_type == (int) type
+        && (grammar[i].is_binary || grammar[i].is_unary))
+      return &grammar[i];
 
-  /// Return NULL if no node
-  if (!tree)
-    return NULL;
+  return NULL;
+}
+
+/**
+ * @brief       Check if a subtree can be dropped without changing behaviour
+ *
+ * Input reads have side effects and division/modulo may fault at run time,
+ * so only subtrees free of both can be discarded by an identity.
+ *
+ * @param[in]   tree        Expression subtree
+ *
+ * @return      TRUE if the subtree is side effect free
+ */
+static bool
+opt_is_pure (opal_ctx_s *ctx, node_id tree)
+{
+  walk_stack_s stack = { .size = sizeof(node_id) };
+  bool pure = TRUE;
 
-  /// If no left or right child nodes
-  if (!tree->left && !tree->right)
+  *(node_id*) walk_push (ctx, &stack) = tree;
+  while (pure && stack.len)
     {
-      if (tree->node_type == nd_Sequence)
-        {
-          /// Empty code block with no child nodes
-          return NULL;
-        }
-      else
+      node_id node = *(node_id*) walk_pop (&stack);
+      if (!node)
+        continue;
+
+      switch (NODE(node).node_type)
         {
-          /// Leaf node
-          return tree;
+        case nd_Ident:
+        case nd_Integer:
+        case nd_String:
+          break;
+        case nd_Input:
+        case nd_Div:
+        case nd_Mod:
+          pure = FALSE;
+          break;
+        default:
+          if (!opt_operator (NODE(node).node_type))
+            pure = FALSE;
+          else
+            {
+              *(node_id*) walk_push (ctx, &stack) = NODE(node).right;
+              *(node_id*) walk_push (ctx, &stack) = NODE(node).left;
+            }
         }
     }
 
-  /// If no left node, return address of right
-  if (!tree->left
-      && (tree->node_type == nd_Sequence || tree->node_type == nd_If))
-    return optimize_syntax_tree (tree->right);
-
-  /// If no right node, return address of left
-  else if (!tree->right
-      && (tree->node_type == nd_Sequence || tree->node_type == nd_If))
-    return optimize_syntax_tree (tree->left);
-
-  /// If node has left and right nodes, optimize them
-  tree->left = optimize_syntax_tree (tree->left);
-  tree->right = optimize_syntax_tree (tree->right);
-
-  return tree;
+  walk_free (&stack);
+  return pure;
 }
 
 /**
- * @brief           Print abstract syntax tree to destination file
- *
- * @param[in]       syntax_tree       Abstract syntax tree
- * @param[in,out]   dest_fp           Destination file pointer
- *
- * @return      The error return code of the function.
+ * @brief       Check if an expression can only evaluate to 0 or 1
  *
- * @retval          EXIT_SUCCESS    On success
- * @retval          EXIT_FAILURE    On error
- * @retval          errno           On system call failure
+ * @param[in]   tree        Expression subtree
  *
+ * @return      TRUE if the expression is boolean valued
  */
-short
-print_ast (node_s *syntax_tree, FILE *dest_fp)
+static bool
+opt_is_bool (opal_ctx_s *ctx, node_id tree)
 {
-  logger(DEBUG, "=== START ===");
-
-  /// Check if syntax tree pointer is not NULL
-  logger(DEBUG, "assert(syntax_tree)");
-  assert(syntax_tree);
+  switch (NODE(tree).node_type)
+    {
+    case nd_Eq:
+    case nd_Neq:
+    case nd_Lss:
+    case nd_Gtr:
+    case nd_Leq:
+    case nd_Geq:
+    case nd_And:
+    case nd_Or:
+    case nd_Not:
+      return TRUE;
+    case nd_Integer:
+      return NODE(tree).value == 0 || NODE(tree).value == 1;
+    default:
+      return FALSE;
+    }
+}
+
+/**
+ * @brief       Evaluate an operator on constant operands
+ *
+ * Mirrors the run time semantics of header.asm: arithmetic wraps at 64 bits,
+ * the dividend of IDIV is taken as unsigned and comparisons/logic yield 0/1.
+ * Operations that would fault at run time are left unfolded.
+ *
+ * @param[in]   type        Operator node type
+ * @param[in]   a           Left (or only) operand
+ * @param[in]   b           Right operand, ignored for unary operators
+ * @param[out]  result      Folded value
+ *
+ * @return      TRUE if the operation was folded
+ */
+static bool
+opt_eval (ast_node_type_e type, long a, long b, long *result)
+{
+  unsigned long divisor = b < 0 ? -(unsigned long) b : (unsigned long) b;
+
+  switch (type)
+    {
+    case nd_Add:    *result = (unsigned long) a + (unsigned long) b; break;
+    case nd_Sub:    *result = (unsigned long) a - (unsigned long) b; break;
+    case nd_Mul:    *result = (unsigned long) a * (unsigned long) b; break;
+    case nd_Negate: *result = -(unsigned long) a; break;
+    case nd_Eq:     *result = a == b; break;
+    case nd_Neq:    *result = a != b; break;
+    case nd_Lss:    *result = a < b; break;
+    case nd_Gtr:    *result = a > b; break;
+    case nd_Leq:    *result = a <= b; break;
+    case nd_Geq:    *result = a >= b; break;
+    case nd_And:    *result = (a & b) != 0; break;
+    case nd_Or:     *result = (a | b) != 0; break;
+    case nd_Not:    *result = a == 0; break;
+    case nd_Div:
+    case nd_Mod:
+      if (divisor == 0
+          || (unsigned long) a / divisor > (unsigned long) INT64_MAX + (b < 0))
+        return FALSE;
+      if (type == nd_Mod)
+        *result = (unsigned long) a % divisor;
+      else
+        *result = b < 0 ? -((unsigned long) a / divisor)
+                        : (unsigned long) a / divisor;
+      break;
+    default:
+      return FALSE;
+    }
+
+  /// PUSH takes a sign extended 32 bit immediate
+  return *result >= INT32_MIN && *result <= INT32_MAX;
+}
+
+/**
+ * @brief       Drop a node but keep (and return) one of its children
+ *
+ * @details     Dropped nodes stay in the node pool until it is freed.
+ *
+ * @param[in]   tree        Node to remove
+ * @param[in]   keep        Child of tree that replaces it
+ *
+ * @return      keep
+ */
+static node_id
+opt_replace (opal_ctx_s *ctx, node_id tree, node_id keep)
+{
+  logger(DEBUG, "Replace %s node with its %s child.",
+         node_name[NODE(tree).node_type],
+         keep == NODE(tree).left ? "left" : "right");
+  return keep;
+}
+
+/**
+ * @brief       Simplify an optimized if/while condition
+ *
+ * Only the truth value of a condition matters, so double negation can be
+ * dropped even when the operand is not boolean valued.
+ */
+static node_id
+opt_condition (opal_ctx_s *ctx, node_id cond, bool *changed)
+{
+  while (NODE(cond).node_type == nd_Not
+         && NODE(NODE(cond).left).node_type == nd_Not)
+    {
+      node_id inner = NODE(cond).left;
+      cond = opt_replace (ctx, opt_replace (ctx, cond, inner),
+                          NODE(inner).left);
+      *changed = TRUE;
+    }
+
+  return cond;
+}
+
+/**
+ * @brief       Optimize an expression operator node
+ *
+ * Folds constant operands, then applies the algebraic identities
+ * x+0, x-0, x*1, x*0, !!x and -(-x).
+ */
+static node_id
+opt_operator_node (opal_ctx_s *ctx, node_id tree, bool *changed)
+{
+  node_s *node = &NODE(tree);
+  const attributes_s *op = opt_operator (node->node_type);
+  node_s *l = &NODE(node->left);
+  node_s *r = &NODE(node->right);
+  long result = 0;
+
+  /// Fold constant subtrees; a missing operand is node 0, a nd_NOP
+  if (l->node_type == nd_Integer
+      && (op->is_unary || r->node_type == nd_Integer)
+      && opt_eval (node->node_type, l->value,
+                   op->is_unary ? 0 : r->value, &result))
+    {
+      node->left = node->right = 0;
+      node->node_type = nd_Integer;
+      node->value = result;
+      *changed = TRUE;
+      return tree;
+    }
+
+  switch (node->node_type)
+    {
+    case nd_Add:
+      if (r->node_type == nd_Integer && r->value == 0)
+        break;
+      if (l->node_type == nd_Integer && l->value == 0)
+        goto keep_right;
+      return tree;
+
+    case nd_Sub:
+      if (r->node_type == nd_Integer && r->value == 0)
+        break;
+      return tree;
+
+    case nd_Mul:
+      if (r->node_type == nd_Integer && r->value == 1)
+        break;
+      if (l->node_type == nd_Integer && l->value == 1)
+        goto keep_right;
+      if (r->node_type == nd_Integer && r->value == 0
+          && opt_is_pure (ctx, node->left))
+        goto keep_right;
+      if (l->node_type == nd_Integer && l->value == 0
+          && opt_is_pure (ctx, node->right))
+        break;
+      return tree;
+
+    case nd_Negate:
+      if (l->node_type != nd_Negate)
+        return tree;
+      *changed = TRUE;
+      return opt_replace (ctx, opt_replace (ctx, tree, node->left), l->left);
+
+    case nd_Not:
+      if (l->node_type != nd_Not || !opt_is_bool (ctx, l->left))
+        return tree;
+      *changed = TRUE;
+      return opt_replace (ctx, opt_replace (ctx, tree, node->left), l->left);
+
+    default:
+      return tree;
+    }
+
+  /// Keep the left operand
+  *changed = TRUE;
+  return opt_replace (ctx, tree, node->left);
+
+keep_right:
+  *changed = TRUE;
+  return opt_replace (ctx, tree, node->right);
+}
+
+/**
+ * @brief       Optimize a node whose children have been optimized
+ *
+ * @param[in]       tree        Node to optimize
+ * @param[in,out]   changed     Set to TRUE if the node was rewritten
+ *
+ * @return      Optimized node, 0 if it was removed entirely
+ */
+static node_id
+opt_node (opal_ctx_s *ctx, node_id tree, bool *changed)
+{
+  node_s *node = &NODE(tree);
+  node_s *branches = NULL;
+  node_id taken = 0;
+
+  switch (node->node_type)
+    {
+    case nd_Sequence:
+      /// Collapse empty code blocks and single statement sequences
+      if (node->left && node->right)
+        return tree;
+      *changed = TRUE;
+      return opt_replace (ctx, tree, node->left ? node->left : node->right);
+
+    case nd_If:
+      /// if is nd_If(condition, nd_If(then, else)); the inner node is never
+      /// collapsed since GENIE reads both branches from it
+      node->left = opt_condition (ctx, node->left, changed);
+      branches = &NODE(node->right);
+
+      /// Constant condition: keep only the branch that is taken
+      if (NODE(node->left).node_type == nd_Integer)
+        {
+          taken = NODE(node->left).value ? branches->left : branches->right;
+          *changed = TRUE;
+          return taken;
+        }
+
+      /// Both branches empty: drop the statement if the condition is pure
+      if (!branches->left && !branches->right
+          && opt_is_pure (ctx, node->left))
+        {
+          *changed = TRUE;
+          return 0;
+        }
+      return tree;
+
+    case nd_While:
+      node->left = opt_condition (ctx, node->left, changed);
+
+      /// while (0) never runs its body
+      if (NODE(node->left).node_type == nd_Integer
+          && NODE(node->left).value == 0)
+        {
+          *changed = TRUE;
+          return 0;
+        }
+      return tree;
+
+    default:
+      if (opt_operator (node->node_type))
+        return opt_operator_node (ctx, tree, changed);
+      return tree;
+    }
+}
+
+/**
+ * Node pending in an optimization pass, with the link that points to it.
+ * Passes add no nodes, so links into the node pool stay valid.
+ */
+typedef struct opt_frame
+{
+  node_id tree;         ///< Node to optimize
+  node_id *link;        ///< Where to store the optimized node
+  bool expanded;        ///< Children have been pushed
+} opt_frame_s;
+
+/// Push the node a link points to, if any, for an optimization pass
+static void
+opt_push (opal_ctx_s *ctx, walk_stack_s *stack, node_id *link)
+{
+  if (!*link)
+    return;
+
+  opt_frame_s *frame = walk_push (ctx, stack);
+  frame->tree = *link;
+  frame->link = link;
+}
+
+/**
+ * @brief       Run one bottom-up optimization pass over a subtree
+ *
+ * @details     Nodes are optimized after their children, walking with an
+ * explicit stack. The inner nd_If of an if statement is not optimized
+ * itself, only its branches are.
+ *
+ * @param[in]       tree        Subtree to optimize
+ * @param[in,out]   changed     Set to TRUE if the subtree was rewritten
+ *
+ * @return      Optimized subtree, 0 if it was removed entirely
+ */
+static node_id
+opt_tree (opal_ctx_s *ctx, node_id tree, bool *changed)
+{
+  walk_stack_s stack = { .size = sizeof(opt_frame_s) };
+  node_id root = tree;
+
+  opt_push (ctx, &stack, &root);
+  while (stack.len)
+    {
+      opt_frame_s *frame = walk_pop (&stack);
+      node_id node = frame->tree;
+      node_id *link = frame->link;
+
+      /// Optimize the node once its children are done
+      if (frame->expanded)
+        {
+          *link = opt_node (ctx, node, changed);
+          continue;
+        }
+
+      /// Otherwise put it back, then its children so they are done first,
+      /// left before right
+      frame = walk_push (ctx, &stack);
+      frame->tree = node;
+      frame->link = link;
+      frame->expanded = TRUE;
+      if (NODE(node).node_type == nd_If)
+        {
+          opt_push (ctx, &stack, &NODE(NODE(node).right).right);
+          opt_push (ctx, &stack, &NODE(NODE(node).right).left);
+        }
+      else
+        opt_push (ctx, &stack, &NODE(node).right);
+      opt_push (ctx, &stack, &NODE(node).left);
+    }
+
+  walk_free (&stack);
+  return root;
+}
+
+/**
+ * @brief       Optimize the abstract syntax tree
+ *
+ * Folds constant subtrees of every binary/unary operator in grammar[],
+ * simplifies algebraic identities, prunes if/while statements with constant
+ * conditions and removes empty code blocks. Passes are repeated until the
+ * tree no longer changes. Nodes that are removed stay in the node pool, so
+ * the caller must continue with the returned tree.
+ *
+ * @param[in]   tree
+ *
+ * @return      Optimized abstract syntax tree root index
+ *
+ * @retval      node_id     On success, an empty nd_Sequence if the whole
+ *                          program was optimized away
+ */
+node_id
+optimize_syntax_tree(opal_ctx_s *ctx, node_id tree)
+{
+  bool changed = TRUE;
+  int passes = 0;
+
+  /// Iterate to a fixpoint
+  while (changed)
+    {
+      changed = FALSE;
+      tree = opt_tree (ctx, tree, &changed);
+      passes++;
+    }
+
+  logger(DEBUG, "Syntax tree optimized in %d passes.", passes);
+
+  /// Keep a root node for the report and code generator
+  if (!tree)
+    tree = make_ast_node (ctx, nd_Sequence, 0, 0);
+
+  return tree;
+}
+
+/**
+ * @brief           Print abstract syntax tree to destination file
+ *
+ * @param[in]       syntax_tree       Abstract syntax tree
+ * @param[in,out]   dest_fp           Destination file pointer
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval          EXIT_SUCCESS    On success
+ * @retval          EXIT_FAILURE    On error
+ * @retval          errno           On system call failure
+ *
+ */
+short
+print_ast (opal_ctx_s *ctx, node_id syntax_tree, FILE *dest_fp)
+{
+  logger(DEBUG, "=== START ===");
+
+  /// Check if syntax tree pointer is not NULL
+  logger(DEBUG, "assert(syntax_tree)");
+  assert(syntax_tree);
   _PASS;
 
   /// Print syntax tree in pre-traversal mode to destination file pointer
-  traverse_ast (syntax_tree, dest_fp);
+  traverse_ast (ctx, syntax_tree, dest_fp);
 
   logger(DEBUG, "=== END ===");
   return (EXIT_SUCCESS);
 }
 
+/// Node pending in a report graph walk, with the id of its parent
+typedef struct graph_frame
+{
+  node_id node;         ///< Node to print
+  int parent;           ///< Id of parent node, or -1 for the root
+} graph_frame_s;
+
 /**
  * @brief           Traverse abstract syntax tree pre-order
+ *
+ * @details     Nodes are numbered in the order they are printed, and each
+ * is printed with the edge from its parent. The walk keeps pending nodes
+ * on an explicit stack.
+ *
  * @param[in]    node       Abstract syntax tree node to print
  * @param[in]    report_fp  Destination report file pointer
- * @param[in]    level      Level in tree
+ * @param[in]    id         Id of node, the rest get the ids that follow
  */
 void
-traversePreOrder_graph (node_s *node, FILE *report_fp, int level)
+traversePreOrder_graph (opal_ctx_s *ctx, node_id node, FILE *report_fp,
+                        int id)
 {
-  /// If node to print is null, return
-  if (!node)
-    return;
-
-  /// If node is string, print char_val
-  if (node->node_type == nd_String)
-    fprintf (report_fp, "%d[\"'%s'\"]:::%s\n", level, node->char_val,
-             node_name[node->node_type]);
-
-  /// If node is identifier, print name
-  else if (node->node_type == nd_Ident)
-      fprintf (report_fp, "%d[%s]:::%s\n", level, node->char_val,
-               node_name[node->node_type]);
-
-  /// ... if node is integer, print the int_val
-  else if (node->node_type == nd_Integer)
-    fprintf (report_fp, "%d[%d]:::%s\n", level, node->int_val,
-             node_name[node->node_type]);
-
-  /// ... else, print node type name
-  else
-    fprintf (report_fp, "%d[%s]:::%s\n", level, node_name[node->node_type],
-             node_name[node->node_type]);
+  walk_stack_s stack = { .size = sizeof(graph_frame_s) };
 
-  /// If node has left/right child nodes, create connection with array index
-  if (node->left)
-    fprintf (report_fp,"%d --> %d\n", level, level*2 + 1);
+  graph_frame_s *frame = walk_push (ctx, &stack);
+  frame->node = node;
+  frame->parent = -1;
 
-  if (node->right)
-    fprintf (report_fp,"%d --> %d\n", level, level*2 + 2);
-
-  /// Print child nodes of tree recursively for left and right child nodes
-  if (node->left || node->right)
+  while (stack.len)
     {
-      traversePreOrder_graph (node->left, report_fp, level*2 + 1);
-      traversePreOrder_graph (node->right, report_fp, level*2 + 2);
+      frame = walk_pop (&stack);
+      node = frame->node;
+      int parent = frame->parent;
+
+      /// If node to print is null, skip it
+      if (!node)
+        continue;
+
+      /// Connect node to its parent
+      if (parent >= 0)
+        fprintf (report_fp, "%d --> %d\n", parent, id);
+
+      /// If node is string, print its text
+      if (NODE(node).node_type == nd_String)
+        fprintf (report_fp, "%d[\"'%s'\"]:::%s\n", id,
+                 ctx->syms[NODE(node).value].name,
+                 node_name[NODE(node).node_type]);
+
+      /// If node is identifier, print name
+      else if (NODE(node).node_type == nd_Ident)
+          fprintf (report_fp, "%d[%s]:::%s\n", id,
+                   ctx->syms[NODE(node).value].name,
+                   node_name[NODE(node).node_type]);
+
+      /// ... if node is integer, print the value
+      else if (NODE(node).node_type == nd_Integer)
+        fprintf (report_fp, "%d[%d]:::%s\n", id, NODE(node).value,
+                 node_name[NODE(node).node_type]);
+
+      /// ... else, print node type name
+      else
+        fprintf (report_fp, "%d[%s]:::%s\n", id,
+                 node_name[NODE(node).node_type],
+                 node_name[NODE(node).node_type]);
+
+      /// Print child nodes next, left before right
+      frame = walk_push (ctx, &stack);
+      frame->node = NODE(node).right;
+      frame->parent = id;
+      frame = walk_push (ctx, &stack);
+      frame->node = NODE(node).left;
+      frame->parent = id;
+      id++;
     }
+
+  walk_free (&stack);
 }
 
 /**
@@ -2090,7 +3937,7 @@ traversePreOrder_graph (node_s *node, FILE *report_fp, int level)
  *
  */
 short
-print_ast_html (node_s *syntax_tree, FILE *report_fp)
+print_ast_html (opal_ctx_s *ctx, node_id syntax_tree, FILE *report_fp)
 {
   logger(DEBUG, "=== START ===");
 
@@ -2104,8 +3951,8 @@ print_ast_html (node_s *syntax_tree, FILE *report_fp)
 
   /// Open res/mermaid.styles in read-only mode
   char *mermaid_fn = "res/mermaid.styles";
-  sprintf (perror_msg, "css_fp = fopen ('%s', 'r')", mermaid_fn);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "css_fp = fopen ('%s', 'r')", mermaid_fn);
+  logger (DEBUG, ctx->perror_msg);
 
   errno = EXIT_SUCCESS;
   FILE *mermaid_fp = fopen (mermaid_fn, "r");
@@ -2113,9 +3960,9 @@ print_ast_html (node_s *syntax_tree, FILE *report_fp)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      exit (opal_exit(errno));
+      opal_abort (ctx, errno);
     }
 
   /// Copy CSS to HTML report
@@ -2127,27 +3974,27 @@ print_ast_html (node_s *syntax_tree, FILE *report_fp)
   fprintf(report_fp, "\n");
 
   /// Close res/styles.css file
-  sprintf (perror_msg, "fclose(mermaid_fp)");
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(mermaid_fp)");
+  logger (DEBUG, ctx->perror_msg);
   if (fclose (mermaid_fp) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      exit (opal_exit (errno));
+      opal_abort (ctx, errno);
     }
 
   /// Print abstract syntax tree to report
-  traversePreOrder_graph (syntax_tree, report_fp, 0);
+  traversePreOrder_graph (ctx, syntax_tree, report_fp, 0);
 
   /// Write mermaid graph footer
   fprintf(report_fp, "</div>\n"
           "<script src='https://cdn.jsdelivr.net/npm/mermaid/dist/mermaid.min.js'></script>\n"
           "<script>mermaid.initialize({startOnLoad:true, flowchart: {curve:'cardinal', useMaxWidth:false, }, });</script>\n");
 
-  sprintf (perror_msg, "fflush(graph_fp)");
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fflush(graph_fp)");
+  logger (DEBUG, ctx->perror_msg);
 
   errno = EXIT_SUCCESS;
   fflush (report_fp);
@@ -2155,7 +4002,7 @@ print_ast_html (node_s *syntax_tree, FILE *report_fp)
     _PASS;
   else
     {
-      perror(perror_msg);
+      perror(ctx->perror_msg);
       _FAIL;
       return (errno);
     }
@@ -2165,62 +4012,134 @@ print_ast_html (node_s *syntax_tree, FILE *report_fp)
 }
 
 /**
- * @brief       Free memory allocated for syntax tree
+ * @brief                   Traverses the syntax tree while printing the contents to dest_fp.
  *
- * @param[in,out]   node   Syntax tree to deallocate
+ * @details                 Nodes are printed pre-order, keeping pending nodes
+ *                          on an explicit stack.
  *
- * @return      NULL
+ * @param[in]   node        The syntax tree node to be processed
+ * @param[in]   dest_fp     The file to which the node's content will be printed
  *
+ * @return                  NULL
  */
 void
-free_syntax_tree (node_s *node)
+traverse_ast(opal_ctx_s *ctx, node_id node, FILE *dest_fp)
 {
-  if (!node)
-    return;
+    walk_stack_s stack = { .size = sizeof(node_id) };
 
-  free_syntax_tree(node->left);
-  free_syntax_tree(node->right);
+    *(node_id*) walk_push (ctx, &stack) = node;
+    while (stack.len)
+      {
+        node = *(node_id*) walk_pop (&stack);
 
-  if (node->char_val)
-    {
-      free(node->char_val);
-      node->char_val = NULL;
-    }
+        /// We have reached a missing leaf
+        if (!node)
+            continue;
+
+        /// If node is identifier or string, print its interned name
+        if (NODE(node).node_type == nd_Ident
+            || NODE(node).node_type == nd_String)
+            fprintf (dest_fp, "%s\n", ctx->syms[NODE(node).value].name);
+
+        /// ... if node is integer, print the value
+        else if (NODE(node).node_type == nd_Integer)
+            fprintf (dest_fp, "%d\n", NODE(node).value);
+
+        /// ... else, print node type name
+        else
+            fprintf (dest_fp, "%s\n", node_name[NODE(node).node_type]);
+
+        /// Print left subtree next, then right subtree
+        *(node_id*) walk_push (ctx, &stack) = NODE(node).right;
+        *(node_id*) walk_push (ctx, &stack) = NODE(node).left;
+      }
 
-  free(node);
-  node = NULL;
+    walk_free (&stack);
 }
 
 /**
- * @brief                   Traverses the syntax tree while printing the contents to dest_fp.
+ * @brief       Save syntax tree to a binary .oast file
  *
- * @param[in]   node        The syntax tree node to be processed
- * @param[in]   dest_fp     The file to which the node's content will be printed
+ * @details     The node pool is saved whole with one write, with the
+ * interned symbols its leaves refer to, so GENIE can start from the file
+ * without running MARC, ALEX and ASTRO.
  *
- * @return                  NULL
+ * @param[in]   syntax_tree     Root of the syntax tree
+ * @param[in]   symbol_count    Number of tokens the tree was parsed from
+ * @param[in]   fn              File to write
+ *
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      errno           On system call failure
  */
-void
-traverse_ast(node_s *node, FILE *dest_fp)
+short
+save_ast (opal_ctx_s *ctx, node_id syntax_tree, int symbol_count,
+          const char *fn)
 {
-    /// We have reached a NULL leaf
-    if (!node)
-        return;
+  logger(DEBUG, "=== START ===");
 
-    /// If node is identifier or string, print char_val
-    if (node->node_type == nd_Ident || node->node_type == nd_String)
-        fprintf (dest_fp, "%s\n", node->char_val);
+  ir_header_s header = { .magic = OAST_MAGIC, .len = ctx->nodes_len,
+                         .root = syntax_tree, .tokens = symbol_count };
+  const void *arrays[] = { ctx->nodes };
 
-    /// ... if node is integer, print the int_val
-    else if (node->node_type == nd_Integer)
-        fprintf (dest_fp, "%d\n", node->int_val);
+  ctx->retVal = ir_write (ctx, fn, &header, arrays, 1, sizeof(node_s));
 
-    /// ... else, print node type name
-    else
-        fprintf (dest_fp, "%s\n", node_name[node->node_type]);
+  logger(DEBUG, "=== END ===");
+  return ctx->retVal;
+}
+
+/**
+ * @brief       Map syntax tree in from a binary .oast file
+ *
+ * @details     The node pool is used where it lies in the mapped file, and
+ * copied out only if it grows. Nodes are checked: children must have lower
+ * indices than their parent, as make_ast_node() gives them, so a damaged
+ * file can not make walks loop.
+ *
+ * @param[in]   fn              File saved by save_ast()
+ * @param[out]  symbol_count    Number of tokens the tree was parsed from
+ *
+ * @return      Root of the syntax tree
+ *
+ * @retval      node_id     On success
+ * @retval      0           On error
+ */
+node_id
+load_ast (opal_ctx_s *ctx, const char *fn, int *symbol_count)
+{
+  logger(DEBUG, "=== START ===");
+
+  ir_header_s *header = ir_map_file (ctx, fn, OAST_MAGIC, 1, sizeof(node_s));
+  if (header == NULL)
+    return 0;
+
+  node_s *nodes = (node_s*) ((uint32_t*) (header + 1) + header->syms_len);
+  node_id id = 1;
+  for (id = 1; id < header->len; id++)
+    {
+      node_s *node = &nodes[id];
+      if (node->node_type > nd_Input || node->left >= id || node->right >= id
+          || ((node->node_type == nd_Ident || node->node_type == nd_String)
+              && (unsigned) node->value >= ctx->syms_len))
+        break;
+    }
+  if (id < header->len || header->root == 0 || header->root >= header->len
+      || nodes[0].node_type != nd_NOP || nodes[0].left || nodes[0].right)
+    {
+      fprintf (stderr, "%s: damaged node %u\n", fn, id);
+      return 0;
+    }
+
+  if (!ctx->nodes_mapped)
+    free (ctx->nodes);
+  ctx->nodes = nodes;
+  ctx->nodes_len = ctx->nodes_cap = header->len;
+  ctx->nodes_mapped = TRUE;
+  *symbol_count = header->tokens;
 
-    /// Recursive calls for further tree traversal
-    traverse_ast (node->left, dest_fp);
-    traverse_ast (node->right, dest_fp);
+  logger(DEBUG, "=== END ===");
+  return header->root;
 }
 
 /*
@@ -2229,138 +4148,884 @@ traverse_ast(node_s *node, FILE *dest_fp)
  * ==================================
  */
 
-/**
- * @brief Append ASM code to array
- * @param code      ASM code
- * @param intval    Integer value
- * @param label     String value
- */
-void
-add_asm_code (asm_code_e code, int intval, char *label)
+/// Check if command is a jump to the label of the command
+static bool
+asm_is_jump (asm_code_e cmd)
 {
-  /// Create struct with given intval and code
-  asm_cmd_e asm_cmd = { 0 };
-  asm_cmd.intval = intval;
-  asm_cmd.cmd = code;
-
-  /// Add the asm_code label if there is one
-  if (label)
-    asm_cmd.label = strdup (label);
+  return cmd == asm_Jmp || cmd == asm_Jz || cmd == asm_Jnz
+      || (cmd >= asm_Jeq && cmd <= asm_Jgeq);
+}
 
-  logger(DEBUG, "Added command - cmd: %s, label: %s", asm_cmds[asm_cmd.cmd],
-         asm_cmd.label ? asm_cmd.label : "NULL");
+/// Conditional jump taken exactly when cmd is not, asm_NOP if there is none
+static asm_code_e
+asm_invert_jump (asm_code_e cmd)
+{
+  switch (cmd)
+    {
+    case asm_Jz:
+      return asm_Jnz;
+    case asm_Jnz:
+      return asm_Jz;
+    case asm_Jeq:
+      return asm_Jneq;
+    case asm_Jneq:
+      return asm_Jeq;
+    case asm_Jlss:
+      return asm_Jgeq;
+    case asm_Jgeq:
+      return asm_Jlss;
+    case asm_Jgtr:
+      return asm_Jleq;
+    case asm_Jleq:
+      return asm_Jgtr;
+    default:
+      return asm_NOP;
+    }
+}
 
-  /// Adds the asm_cmd
-  asm_cmd_list[asm_cmd_list_len++] = asm_cmd;
+/// Fused compare and branch taken when comparison cmd is true, or asm_NOP
+static asm_code_e
+asm_fused_jump (asm_code_e cmd)
+{
+  if (cmd >= asm_Eq && cmd <= asm_Geq)
+    return asm_Jeq + (cmd - asm_Eq);
+  return asm_NOP;
 }
 
+/// Open addressing map of assembly labels to an int, eg - a command index
+typedef struct label_map
+{
+  const char **labels;  ///< label of each slot, NULL for a free slot
+  int *values;          ///< value of the label in each slot
+  unsigned cap;         ///< number of slots, a power of two
+} label_map_s;
+
 /**
- * @brief Generate assembly command list from given abstract syntax tree
- * @param       ast   Abstract syntax tree
+ * @brief       Allocate empty label map with room for count labels
  *
- * @return      NULL
+ * @details     The map is kept at most half full, so looking a label up
+ * takes O(1) probes however many labels the program has. Labels are not
+ * copied, they must outlive the map.
+ *
+ * @param[out]  map     Map to allocate, freed by label_map_free()
+ * @param[in]   count   Most labels that will be added
+ */
+static void
+label_map_init (opal_ctx_s *ctx, label_map_s *map, unsigned count)
+{
+  map->cap = 16;
+  while (map->cap < 2 * count)
+    map->cap *= 2;
+  map->labels = calloc (map->cap, sizeof(*map->labels));
+  map->values = calloc (map->cap, sizeof(*map->values));
+  if (map->labels == NULL || map->values == NULL)
+    {
+      perror ("calloc(label_map)");
+      opal_abort (ctx, errno);
+    }
+}
+
+/// Slot holding label, or the free slot where it would be added
+static unsigned
+label_map_slot (const label_map_s *map, const char *label)
+{
+  unsigned pos = hash_symbol (label, strlen (label), false) & (map->cap - 1);
+  while (map->labels[pos] && strcmp (map->labels[pos], label) != 0)
+    pos = (pos + 1) & (map->cap - 1);
+  return pos;
+}
+
+/// Value of label in map, added as 0 if missing
+static int*
+label_map_at (label_map_s *map, const char *label)
+{
+  unsigned pos = label_map_slot (map, label);
+  if (map->labels[pos] == NULL)
+    {
+      map->labels[pos] = label;
+      map->values[pos] = 0;
+    }
+  return &map->values[pos];
+}
+
+/// Value of label in map, or missing if it is not there
+static int
+label_map_get (const label_map_s *map, const char *label, int missing)
+{
+  unsigned pos = label_map_slot (map, label);
+  return map->labels[pos] ? map->values[pos] : missing;
+}
+
+/// Free slots of label map
+static void
+label_map_free (label_map_s *map)
+{
+  free (map->labels);
+  free (map->values);
+  *map = (label_map_s) { 0 };
+}
+
+/**
+ * @brief       Grow array geometrically to hold at least need elements
+ *
+ * @details     Capacity doubles from MIN_ASM_ARRAY, so appending costs O(1)
+ * amortised and small programs use small tables. The array lives in the
+ * arena, so the newest one grows in place.
+ *
+ * @param       array   Array to grow, may be NULL
+ * @param[in,out] cap   Capacity of array in elements
+ * @param       need    Elements the array must hold
+ * @param       size    Size of one element
+ * @param       name    Array name for logging
+ *
+ * @return      Grown array
+ */
+static void*
+grow_array (opal_ctx_s *ctx, void *array, unsigned *cap, unsigned need,
+            size_t size, const char *name)
+{
+  if (need <= *cap)
+    return array;
+
+  unsigned new_cap = *cap ? *cap : MIN_ASM_ARRAY;
+  while (new_cap < need)
+    new_cap *= 2;
+
+  logger(DEBUG, "Grow %s to %u entries.", name, new_cap);
+  void *grown = arena_realloc (ctx, array, *cap * size, new_cap * size);
+
+  *cap = new_cap;
+  return grown;
+}
+
+/**
+ * @brief Append ASM code to array
+ * @param code      ASM code
+ * @param intval    Integer value
+ * @param label     String value
+ */
+void
+add_asm_code (opal_ctx_s *ctx, asm_code_e code, int intval, char *label)
+{
+  /// Create struct with given intval and code
+  asm_cmd_e asm_cmd = { 0 };
+  asm_cmd.intval = intval;
+  asm_cmd.cmd = code;
+
+  /// Add the asm_code label if there is one
+  if (label)
+    asm_cmd.label = arena_strdup (ctx, label);
+
+  logger(DEBUG, "Added command - cmd: %s, label: %s", asm_cmds[asm_cmd.cmd],
+         asm_cmd.label ? asm_cmd.label : "NULL");
+
+  /// Adds the asm_cmd
+  ctx->asm_cmd_list = grow_array (ctx, ctx->asm_cmd_list,
+                                  &ctx->asm_cmd_list_cap,
+                                  ctx->asm_cmd_list_len + 1,
+                                  sizeof(asm_cmd_e), "asm_cmd_list");
+  ctx->asm_cmd_list[ctx->asm_cmd_list_len++] = asm_cmd;
+}
+
+/// Kinds of work pending in code generation
+typedef enum gen_step
+{
+  gen_Node,             ///< Generate code of node
+  gen_Cmd,              ///< Add command, with label if it has one
+  gen_FalseJump,        ///< Generate condition node, jumping if it is false
+  gen_Store,            ///< Store to variable of assignment node
+} gen_step_e;
+
+/// Work pending in code generation
+typedef struct gen_task
+{
+  gen_step_e step;      ///< What to do
+  node_id node;         ///< Node of gen_Node, gen_FalseJump and gen_Store
+  asm_code_e cmd;       ///< Command of gen_Cmd
+  const char *label;    ///< Label format of gen_Cmd and gen_FalseJump, or NULL
+  int label_id;         ///< Number that makes the label unique
+} gen_task_s;
+
+/// Push code generation work; pushed last is done first
+static void
+gen_push (opal_ctx_s *ctx, walk_stack_s *stack, gen_step_e step, node_id node,
+          asm_code_e cmd, const char *label, int label_id)
+{
+  gen_task_s *task = walk_push (ctx, stack);
+  task->step = step;
+  task->node = node;
+  task->cmd = cmd;
+  task->label = label;
+  task->label_id = label_id;
+}
+
+/**
+ * @brief Generate assembly command list from given abstract syntax tree
+ *
+ * @details The tree is walked with an explicit stack of pending work, so
+ * statement sequences as long as the program do not recurse. Work for a node
+ * is pushed in reverse, to be done in the order written below.
+ *
+ * A condition of if/while that is a comparison is emitted as its operands and
+ * the fused compare and branch on the opposite comparison, so the branch is
+ * taken without pushing and testing a 0/1 result.
+ *
+ * @param       ast   Abstract syntax tree
+ *
+ * @return      NULL
  */
 void
-gen_asm_code (node_s *ast)
+gen_asm_code (opal_ctx_s *ctx, node_id ast)
 {
+  walk_stack_s stack = { .size = sizeof(gen_task_s) };
+  char label[64] = { 0 };
   int location_offset = 0;
-  // int int_val = 0;
-  char start_label[64] = { 0 };
-  char else_label[64] = { 0 };
-  char end_label[64] = { 0 };
+  int id = 0;
 
-  if (!ast)
-    return;
+  gen_push (ctx, &stack, gen_Node, ast, asm_NOP, NULL, 0);
+  while (stack.len)
+    {
+      gen_task_s task = *(gen_task_s*) walk_pop (&stack);
+      ast = task.node;
+
+      switch (task.step)
+        {
+        case gen_Cmd:
+          if (task.label)
+            sprintf (label, task.label, task.label_id);
+          add_asm_code (ctx, task.cmd, 0, task.label ? label : NULL);
+          continue;
+
+        case gen_Store:
+          location_offset = add_var(ctx, NODE(NODE(ast).left).value);
+          add_asm_code(ctx, asm_Store, location_offset, NULL);
+          continue;
+
+        case gen_FalseJump:
+          if (asm_fused_jump ((asm_code_e) NODE(ast).node_type) != asm_NOP)
+            {
+              gen_push (ctx, &stack, gen_Cmd, 0,
+                        asm_invert_jump (asm_fused_jump ((asm_code_e)
+                                                         NODE(ast).node_type)),
+                        task.label, task.label_id);
+              gen_push (ctx, &stack, gen_Node, NODE(ast).right, asm_NOP, NULL, 0);
+              gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+            }
+          else
+            {
+              gen_push (ctx, &stack, gen_Cmd, 0, asm_Jz, task.label,
+                        task.label_id);
+              gen_push (ctx, &stack, gen_Node, ast, asm_NOP, NULL, 0);
+            }
+          continue;
+
+        case gen_Node:
+          break;
+        }
+
+      if (!ast)
+        continue;
+
+      switch (NODE(ast).node_type)
+        {
+        case nd_Sequence:
+          gen_push (ctx, &stack, gen_Node, NODE(ast).right, asm_NOP, NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+          break;
+        case nd_While:
+          /// while block start, if false end, body, loop back, block end
+          id = ctx->asm_cmd_list_len;
+          sprintf (label, "_while_loop_%d", id);
+          add_asm_code (ctx, asm_Label, 0, label);
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Label, "_while_end_%d", id);
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Jmp, "_while_loop_%d", id);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).right, asm_NOP, NULL, 0);
+          gen_push (ctx, &stack, gen_FalseJump, NODE(ast).left, asm_NOP,
+                    "_while_end_%d", id);
+          break;
+        case nd_If:
+          /// start if, false jump to else block, true execute body and exit,
+          /// start else, execute else body, if/else end
+          id = ctx->asm_cmd_list_len;
+          sprintf (label, "_if_%d", id);
+          add_asm_code (ctx, asm_Label, 0, label);
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Label, "_fi_%d", id);
+          gen_push (ctx, &stack, gen_Node, NODE(NODE(ast).right).right, asm_NOP, NULL, 0);
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Label, "_else_%d", id);
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Jmp, "_fi_%d", id);
+          gen_push (ctx, &stack, gen_Node, NODE(NODE(ast).right).left, asm_NOP, NULL, 0);
+          gen_push (ctx, &stack, gen_FalseJump, NODE(ast).left, asm_NOP,
+                    "_else_%d", id);
+          break;
+        case nd_Add:
+        case nd_Sub:
+        case nd_Mul:
+        case nd_Div:
+        case nd_Mod:
+        case nd_Eq:
+        case nd_Neq:
+        case nd_Lss:
+        case nd_Gtr:
+        case nd_Leq:
+        case nd_Geq:
+        case nd_And:
+        case nd_Or:
+          gen_push (ctx, &stack, gen_Cmd, 0, (asm_code_e) NODE(ast).node_type,
+                    NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).right, asm_NOP, NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+          break;
+        case nd_Negate:
+        case nd_Not:
+          gen_push (ctx, &stack, gen_Cmd, 0, (asm_code_e) NODE(ast).node_type,
+                    NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+          break;
+        case nd_Ident:
+          location_offset = add_var(ctx, NODE(ast).value);
+          add_asm_code(ctx, asm_Fetch, location_offset, NULL);
+          break;
+        case nd_Integer:
+          add_asm_code(ctx, asm_Push, NODE(ast).value, NULL);
+          break;
+        case nd_String:
+          location_offset = add_str(ctx, NODE(ast).value);
+          add_asm_code(ctx, asm_Push, location_offset, NULL);
+          break;
+        case nd_Assign:
+          gen_push (ctx, &stack, gen_Store, ast, asm_NOP, NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).right, asm_NOP, NULL, 0);
+          break;
+        case nd_Input:
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Input, NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+          break;
+        case nd_Prti:
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Prti, NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+          break;
+        case nd_Prts:
+          gen_push (ctx, &stack, gen_Cmd, 0, asm_Prts, NULL, 0);
+          gen_push (ctx, &stack, gen_Node, NODE(ast).left, asm_NOP, NULL, 0);
+          break;
+        default:
+          fprintf(stderr, "Unexpected operator: %s\n", node_name[NODE(ast).node_type]);
+          walk_free (&stack);
+          opal_abort (ctx, EXIT_FAILURE);
+        }
+    }
+
+  walk_free (&stack);
+}
+
+/// Count jumps of the assembly code list to each label into refs
+static void
+ph_count_refs (opal_ctx_s *ctx, label_map_s *refs)
+{
+  label_map_init (ctx, refs, ctx->asm_cmd_list_len);
+  for (unsigned i = 0; i < ctx->asm_cmd_list_len; i++)
+    if (asm_is_jump (ctx->asm_cmd_list[i].cmd))
+      ++*label_map_at (refs, ctx->asm_cmd_list[i].label);
+}
+
+/// Remove command, dropped from the list at the end of the pass
+static void
+ph_remove (asm_cmd_e *cmd)
+{
+  cmd->label = NULL;
+  cmd->cmd = asm_NOP;
+}
+
+/// Count a rewrite by peephole rule, needs ctx and changed in scope
+#define PH_HIT(rule) (ctx->peephole_hits[rule]++, changed = true)
+
+/**
+ * @brief       Rewrite assembly code list with the enabled peephole rules
+ *
+ * @details     Each pass looks at every command with the one or two that
+ * follow it. Commands that are rewritten away become asm_NOP and are
+ * removed at the end of the pass. Passes repeat until no rule applies, as
+ * one rewrite can enable another: O_NOT, O_JZ becomes O_JNZ, which a
+ * preceding comparison then fuses with. Rewrites made by each rule are
+ * counted in ctx->peephole_hits.
+ *
+ * Jumps to each label are counted once per pass, and the counts kept up to
+ * date as rules drop or retarget jumps, so finding a dead label does not
+ * scan the whole list.
+ */
+void
+peephole_asm_code (opal_ctx_s *ctx)
+{
+  logger(DEBUG, "=== START ===");
+
+  asm_cmd_e *list = ctx->asm_cmd_list;
+  unsigned on = ctx->peephole;
+  bool changed = true;
+  int passes = 0;
 
-  switch (ast->node_type)
+  while (changed)
     {
-    case nd_Sequence:
-      gen_asm_code (ast->left);
-      gen_asm_code (ast->right);
-      break;
-    case nd_While:
-      sprintf (start_label, "_while_loop_%d", asm_cmd_list_len);
-      sprintf (end_label, "_while_end_%d", asm_cmd_list_len);
+      changed = false;
+      passes++;
+      label_map_s refs = { 0 };
+      if (on & 1u << ph_DeadLabel)
+        ph_count_refs (ctx, &refs);
 
-      add_asm_code (asm_Label, 0, start_label);     // while block start
-      gen_asm_code (ast->left);                     // check condition
-      add_asm_code (asm_Jz, 0, end_label);          // if false, end
-      gen_asm_code (ast->right);                    // body
-      add_asm_code (asm_Jmp, 0, start_label);       // loop back
-      add_asm_code (asm_Label, 0, end_label);       // while block end
+      for (unsigned i = 0; i < ctx->asm_cmd_list_len; i++)
+        {
+          asm_cmd_e *cmd = &list[i];
+          asm_cmd_e *next = i + 1 < ctx->asm_cmd_list_len ? cmd + 1 : NULL;
+          asm_cmd_e *third = i + 2 < ctx->asm_cmd_list_len ? cmd + 2 : NULL;
+          if (cmd->cmd == asm_NOP || (next && next->cmd == asm_NOP))
+            continue;
 
-      break;
-    case nd_If:
-      sprintf (start_label, "_if_%d", asm_cmd_list_len);
-      sprintf (else_label, "_else_%d", asm_cmd_list_len);
-      sprintf (end_label, "_fi_%d", asm_cmd_list_len);
-
-      add_asm_code (asm_Label, 0, start_label);    // start if
-      gen_asm_code (ast->left);                    // check condition
-      add_asm_code (asm_Jz, 0, else_label);        // false, jump to else block
-      gen_asm_code (ast->right->left);             // true, execute body ..
-      add_asm_code (asm_Jmp, 0, end_label);        // .. and exit
-      add_asm_code (asm_Label, 0, else_label);     // start else
-      gen_asm_code (ast->right->right);            // execute else body and exit
-      add_asm_code (asm_Label, 0, end_label);      // if/else end
+          /// _STORE_ i, _FETCH_ i keeps the value: _TEE_ i
+          if ((on & 1u << ph_StoreFetch) && next && cmd->cmd == asm_Store
+              && next->cmd == asm_Fetch && cmd->intval == next->intval)
+            {
+              cmd->cmd = asm_Tee;
+              ph_remove (next);
+              PH_HIT(ph_StoreFetch);
+            }
 
+          /// _FETCH_ i, _STORE_ i changes nothing
+          else if ((on & 1u << ph_StoreFetch) && next
+              && cmd->cmd == asm_Fetch && next->cmd == asm_Store
+              && cmd->intval == next->intval)
+            {
+              ph_remove (cmd);
+              ph_remove (next);
+              PH_HIT(ph_StoreFetch);
+            }
+
+          /// O_NOT, O_JZ L is O_JNZ L, and O_NOT, O_JNZ L is O_JZ L
+          else if ((on & 1u << ph_InvertJump) && next && cmd->cmd == asm_Not
+              && (next->cmd == asm_Jz || next->cmd == asm_Jnz))
+            {
+              next->cmd = asm_invert_jump (next->cmd);
+              ph_remove (cmd);
+              PH_HIT(ph_InvertJump);
+            }
+
+          /// Jcc L1, JMP L2, L1: is J!cc L2, L1:
+          else if ((on & 1u << ph_InvertJump) && third
+              && asm_invert_jump (cmd->cmd) != asm_NOP
+              && next->cmd == asm_Jmp && third->cmd == asm_Label
+              && strcmp (cmd->label, third->label) == 0)
+            {
+              if (refs.cap)
+                --*label_map_at (&refs, cmd->label);
+              cmd->cmd = asm_invert_jump (cmd->cmd);
+              cmd->label = next->label;
+              next->label = NULL;
+              ph_remove (next);
+              PH_HIT(ph_InvertJump);
+            }
+
+          /// Comparison, O_JZ/O_JNZ is a single compare and branch
+          else if ((on & 1u << ph_FuseCompare) && next
+              && asm_fused_jump (cmd->cmd) != asm_NOP
+              && (next->cmd == asm_Jz || next->cmd == asm_Jnz))
+            {
+              next->cmd = next->cmd == asm_Jnz ? asm_fused_jump (cmd->cmd)
+                  : asm_invert_jump (asm_fused_jump (cmd->cmd));
+              ph_remove (cmd);
+              PH_HIT(ph_FuseCompare);
+            }
+
+          /// JMP to a label among the labels that directly follow it
+          else if ((on & 1u << ph_JumpNext) && cmd->cmd == asm_Jmp)
+            {
+              for (unsigned j = i + 1; j < ctx->asm_cmd_list_len
+                  && (list[j].cmd == asm_Label || list[j].cmd == asm_NOP); j++)
+                if (list[j].cmd == asm_Label
+                    && strcmp (list[j].label, cmd->label) == 0)
+                  {
+                    if (refs.cap)
+                      --*label_map_at (&refs, cmd->label);
+                    ph_remove (cmd);
+                    PH_HIT(ph_JumpNext);
+                    break;
+                  }
+            }
+
+          /// Label no jump goes to
+          else if ((on & 1u << ph_DeadLabel) && cmd->cmd == asm_Label
+              && label_map_get (&refs, cmd->label, 0) == 0)
+            {
+              ph_remove (cmd);
+              PH_HIT(ph_DeadLabel);
+            }
+        }
+      label_map_free (&refs);
+
+      /// Drop removed commands
+      unsigned len = 0;
+      for (unsigned i = 0; i < ctx->asm_cmd_list_len; i++)
+        if (list[i].cmd != asm_NOP)
+          list[len++] = list[i];
+      memset (&list[len], 0, (ctx->asm_cmd_list_len - len) * sizeof(*list));
+      ctx->asm_cmd_list_len = len;
+    }
+
+  for (int r = 0; r < ph_Rules; r++)
+    logger(DEBUG, "Peephole rule %s: %u hits", peephole_names[r],
+           ctx->peephole_hits[r]);
+  logger(DEBUG, "%u assembly commands after %d passes",
+         ctx->asm_cmd_list_len, passes);
+  logger(DEBUG, "=== END ===");
+}
+
+#undef PH_HIT
+
+/**
+ * @brief       Parse comma separated list of peephole rule names
+ *
+ * @param[in]   rules   Rule names of peephole_names, 'all' or 'none'
+ * @param[out]  mask    Mask of rules, bit ph_* set for each rule enabled
+ *
+ * @return      Function exit code
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On unknown rule name
+ */
+short
+parse_peephole_rules (const char *rules, unsigned *mask)
+{
+  *mask = 0;
+  for (const char *name = rules; *name;)
+    {
+      size_t name_len = strcspn (name, ",");
+      int r = 0;
+      if (name_len == 3 && strncmp (name, "all", 3) == 0)
+        *mask = PEEPHOLE_ALL;
+      else if (!(name_len == 4 && strncmp (name, "none", 4) == 0))
+        {
+          for (r = 0; r < ph_Rules; r++)
+            if (strlen (peephole_names[r]) == name_len
+                && strncmp (name, peephole_names[r], name_len) == 0)
+              break;
+          if (r == ph_Rules)
+            return EXIT_FAILURE;
+          *mask |= 1u << r;
+        }
+      name += name_len;
+      if (*name == ',')
+        name++;
+    }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Format hit count of each peephole rule as 'name count, ...'
+ *
+ * @param[out]  buf     Destination buffer
+ * @param[in]   len     Size of buf
+ */
+void
+peephole_summary (opal_ctx_s *ctx, char *buf, size_t len)
+{
+  size_t used = 0;
+  buf[0] = '\0';
+  for (int r = 0; r < ph_Rules && used < len; r++)
+    used += snprintf (buf + used, len - used, "%s%s %u", r ? ", " : "",
+                      peephole_names[r], ctx->peephole_hits[r]);
+}
+
+/// Append register command to list, needs list and len in scope
+#define REG(op, value) \
+  (list[len].cmd = (op), list[len++].arg = (value))
+
+/**
+ * @brief       Build register code from assembly code list
+ *
+ * @details     Without ctx->tos_cache each stack command becomes a reg_Cmd
+ * for its macro. With it, the number of cached values is tracked while
+ * walking the list: pushes and fetches load RAX, moving a cached top to RBX
+ * and spilling RBX when both are in use, and operations pop only the
+ * operands that are not cached. All values are spilled to the machine stack
+ * before labels, jumps and the remaining macros, so every label is reached
+ * with nothing cached. A jump on a cached condition tests RAX, spills the
+ * rest and jumps on the flags; a fused compare and branch compares RBX with
+ * RAX instead.
+ *
+ * @param       cmd_list    Assembly command list
+ * @param[out]  reg_list    Register code, freed by caller
+ *
+ * @return      Number of register commands
+ */
+int
+gen_reg_code (opal_ctx_s *ctx, asm_cmd_e cmd_list[], reg_cmd_s **reg_list)
+{
+  logger(DEBUG, "=== START ===");
+
+  /// No stack command needs more than three register commands
+  reg_cmd_s *list = malloc ((3 * ctx->asm_cmd_list_len + 1)
+                            * sizeof(reg_cmd_s));
+  if (list == NULL)
+    {
+      perror ("malloc(reg_list)");
+      opal_abort (ctx, EXIT_FAILURE);
+    }
+
+  int len = 0;
+  int cached = 0;               ///< Values of top of stack held in registers
+  for (int i = 0; i < ctx->asm_cmd_list_len; i++)
+    {
+      asm_code_e cmd = cmd_list[i].cmd;
+      if (!ctx->tos_cache)
+        cmd = asm_NOP;
+
+      switch (cmd)
+        {
+        case asm_Push:
+        case asm_Fetch:
+          if (cached == 2)
+            REG(reg_PushRbx, 0);
+          if (cached >= 1)
+            REG(reg_MovRbxRax, 0);
+          REG(cmd == asm_Push ? reg_LoadImm : reg_LoadVar,
+              cmd_list[i].intval);
+          cached = cached == 2 ? 2 : cached + 1;
+          break;
+        case asm_Store:
+          if (cached == 0)
+            REG(reg_PopRax, 0);
+          REG(reg_StoreVar, cmd_list[i].intval);
+          if (cached == 2)
+            REG(reg_MovRaxRbx, 0);
+          cached = cached == 2 ? 1 : 0;
+          break;
+        case asm_Tee:
+          if (cached == 0)
+            REG(reg_PopRax, 0);
+          REG(reg_StoreVar, cmd_list[i].intval);
+          cached = cached == 0 ? 1 : cached;
+          break;
+        case asm_Negate:
+        case asm_Not:
+          if (cached == 0)
+            REG(reg_PopRax, 0);
+          REG(reg_Op, cmd);
+          cached = cached == 0 ? 1 : cached;
+          break;
+        case asm_Add:
+        case asm_Sub:
+        case asm_Mul:
+        case asm_Div:
+        case asm_Mod:
+        case asm_Eq:
+        case asm_Neq:
+        case asm_Lss:
+        case asm_Gtr:
+        case asm_Leq:
+        case asm_Geq:
+        case asm_And:
+        case asm_Or:
+          if (cached == 0)
+            REG(reg_PopRax, 0);
+          if (cached <= 1)
+            REG(reg_PopRbx, 0);
+          REG(reg_Op, cmd);
+          cached = 1;
+          break;
+        case asm_Jz:
+        case asm_Jnz:
+          if (cached == 0)
+            REG(reg_PopRax, 0);
+          REG(reg_Test, 0);
+          if (cached == 2)
+            REG(reg_PushRbx, 0);
+          REG(cmd == asm_Jz ? reg_Jz : reg_Jnz, i);
+          cached = 0;
+          break;
+        case asm_Jeq:
+        case asm_Jneq:
+        case asm_Jlss:
+        case asm_Jgtr:
+        case asm_Jleq:
+        case asm_Jgeq:
+          /// Both operands are used, nothing is left cached to spill
+          if (cached == 0)
+            REG(reg_PopRax, 0);
+          if (cached <= 1)
+            REG(reg_PopRbx, 0);
+          REG(reg_Cmp, 0);
+          REG(reg_Jcc, i);
+          cached = 0;
+          break;
+        case asm_HALT:
+          /// Values left in registers are never used
+          REG(reg_Cmd, i);
+          cached = 0;
+          break;
+        default:
+          /// Macros take their operands from the machine stack
+          if (cached == 2)
+            REG(reg_PushRbx, 0);
+          if (cached >= 1)
+            REG(reg_PushRax, 0);
+          REG(reg_Cmd, i);
+          cached = 0;
+          break;
+        }
+    }
+
+  logger(DEBUG, "%d assembly commands, %d register commands",
+         ctx->asm_cmd_list_len, len);
+  *reg_list = list;
+  logger(DEBUG, "=== END ===");
+  return len;
+}
+
+#undef REG
+
+/// NASM condition code under which comparison of stack command is false
+static const char*
+reg_false_cc (asm_code_e cmd)
+{
+  switch (cmd)
+    {
+    case asm_Eq:
+      return "NE";
+    case asm_Neq:
+      return "E";
+    case asm_Lss:
+      return "GE";
+    case asm_Gtr:
+      return "LE";
+    case asm_Leq:
+      return "G";
+    case asm_Geq:
+      return "L";
+    case asm_Not:
+      return "NE";
+    default:
+      return "E";               // O_AND, O_OR: false if result is zero
+    }
+}
+
+/// NASM condition code under which comparison of stack command is true
+static const char*
+reg_true_cc (asm_code_e cmd)
+{
+  switch (cmd)
+    {
+    case asm_Eq:
+      return "E";
+    case asm_Neq:
+      return "NE";
+    case asm_Lss:
+      return "L";
+    case asm_Gtr:
+      return "G";
+    case asm_Leq:
+      return "LE";
+    case asm_Geq:
+      return "GE";
+    case asm_Not:
+      return "E";
+    default:
+      return "NE";              // O_AND, O_OR: true if result is non-zero
+    }
+}
+
+/// NASM condition code under which fused compare and branch jumps
+static const char*
+reg_jump_cc (asm_code_e cmd)
+{
+  static const char *const cc[] = { "E", "NE", "L", "G", "LE", "GE" };
+  return cc[cmd - asm_Jeq];
+}
+
+/**
+ * @brief       Print register command as NASM instructions
+ *
+ * @details     Comparisons and logical operations set RAX to isTrue or
+ * isFalse with a jump, as their macros do, to a label made unique by the
+ * index of the command.
+ *
+ * @param       cmd_list    Assembly command list the register code is for
+ * @param       reg         Register command to print
+ * @param       index       Index of register command
+ * @param       dest_fp     Destination file pointer
+ */
+static void
+print_reg_cmd (opal_ctx_s *ctx, asm_cmd_e cmd_list[], reg_cmd_s *reg,
+               int index, FILE *dest_fp)
+{
+  static const char *const mov[] =
+    {
+      [reg_PushRax] = "PUSH RAX", [reg_PushRbx] = "PUSH RBX",
+      [reg_PopRax] = "POP  RAX", [reg_PopRbx] = "POP  RBX",
+      [reg_MovRbxRax] = "MOV  RBX, RAX", [reg_MovRaxRbx] = "MOV  RAX, RBX",
+      [reg_Test] = "TEST RAX, RAX", [reg_Cmp] = "CMP  RBX, RAX",
+    };
+
+  switch (reg->cmd)
+    {
+    case reg_LoadImm:
+      fprintf (dest_fp, "  MOV  RAX, %ld\n", reg->arg);
       break;
-    case nd_Add:
-    case nd_Sub:
-    case nd_Mul:
-    case nd_Div:
-    case nd_Mod:
-    case nd_Eq:
-    case nd_Neq:
-    case nd_Lss:
-    case nd_Gtr:
-    case nd_Leq:
-    case nd_Geq:
-    case nd_And:
-    case nd_Or:
-      gen_asm_code(ast->left);
-      gen_asm_code(ast->right);
-      add_asm_code(ast->node_type, 0, NULL);
-      break;
-    case nd_Negate:
-    case nd_Not:
-      gen_asm_code(ast->left);
-      add_asm_code(ast->node_type, 0, NULL);
-      break;
-    case nd_Ident:
-      location_offset = add_var(ast->char_val);
-      add_asm_code(asm_Fetch, location_offset, NULL);
-      break;
-    case nd_Integer:
-      add_asm_code(asm_Push, ast->int_val, NULL);
-      break;
-    case nd_String:
-      location_offset = add_str(ast->char_val);
-      add_asm_code(asm_Push, location_offset, NULL);
+    case reg_LoadVar:
+      fprintf (dest_fp, "  MOV  RAX, [data+(8*%ld)]\n", reg->arg);
       break;
-    case nd_Assign:
-      gen_asm_code(ast->right);
-      location_offset = add_var(ast->left->char_val);
-      add_asm_code(asm_Store, location_offset, NULL);
+    case reg_StoreVar:
+      fprintf (dest_fp, "  MOV  [data+(8*%ld)], RAX\n", reg->arg);
       break;
-    case nd_Input:
-      gen_asm_code(ast->left);
-      add_asm_code(asm_Input, 0, NULL);
+    case reg_Jz:
+    case reg_Jnz:
+      fprintf (dest_fp, "  %s  %s\n", reg->cmd == reg_Jz ? "JE " : "JNE",
+               cmd_list[reg->arg].label);
       break;
-    case nd_Prti:
-      gen_asm_code(ast->left);
-      add_asm_code(asm_Prti, 0, NULL);
+    case reg_Jcc:
+      fprintf (dest_fp, "  J%-3s %s\n", reg_jump_cc (cmd_list[reg->arg].cmd),
+               cmd_list[reg->arg].label);
       break;
-    case nd_Prts:
-      gen_asm_code(ast->left);
-      add_asm_code(asm_Prts, 0, NULL);
+    case reg_Op:
+      switch (reg->arg)
+        {
+        case asm_Add:
+          fprintf (dest_fp, "  ADD  RAX, RBX\n");
+          break;
+        case asm_Sub:
+          fprintf (dest_fp, "  SUB  RBX, RAX\n  MOV  RAX, RBX\n");
+          break;
+        case asm_Mul:
+          fprintf (dest_fp, "  IMUL RAX, RBX\n");
+          break;
+        case asm_Div:
+        case asm_Mod:
+          fprintf (dest_fp, "  XCHG RAX, RBX\n  XOR  RDX, RDX\n  IDIV RBX\n");
+          if (reg->arg == asm_Mod)
+            fprintf (dest_fp, "  MOV  RAX, RDX\n");
+          break;
+        case asm_Negate:
+          fprintf (dest_fp, "  NEG  RAX\n");
+          break;
+        default:
+          if (reg->arg == asm_And)
+            fprintf (dest_fp, "  AND  RAX, RBX\n");
+          else if (reg->arg == asm_Or)
+            fprintf (dest_fp, "  OR   RAX, RBX\n");
+          else if (reg->arg == asm_Not)
+            fprintf (dest_fp, "  CMP  RAX, 0\n");
+          else
+            fprintf (dest_fp, "  CMP  RBX, RAX\n");
+          if (ctx->branchless)
+            fprintf (dest_fp, "  SET%-2s AL\n  MOVZX EAX, AL\n",
+                     reg_true_cc (reg->arg));
+          else
+            fprintf (dest_fp, "  MOV  EAX, isFalse\n  J%-3s _bool_%d\n"
+                     "  MOV  EAX, isTrue\n_bool_%d:\n",
+                     reg_false_cc (reg->arg), index, index);
+          break;
+        }
       break;
     default:
-      fprintf(stderr, "Unexpected operator: %s\n", node_name[ast->node_type]);
-      exit (opal_exit (EXIT_FAILURE));
+      fprintf (dest_fp, "  %s\n", mov[reg->cmd]);
+      break;
     }
-
-  return;
 }
 
 /**
@@ -2375,7 +5040,7 @@ gen_asm_code (node_s *ast)
  * @retval      EXIT_FAILURE    On error
  */
 short
-print_asm_code(asm_cmd_e cmd_list[], FILE *dest_fp)
+print_asm_code(opal_ctx_s *ctx, asm_cmd_e cmd_list[], FILE *dest_fp)
 {
   /*
    * Traverse and print the assembly code
@@ -2392,8 +5057,8 @@ print_asm_code(asm_cmd_e cmd_list[], FILE *dest_fp)
    */
 
     /// Open header file in 'r' mode
-    sprintf (perror_msg, "header_fp = fopen('res/header.asm', 'r')");
-    logger(DEBUG, perror_msg);
+    sprintf (ctx->perror_msg, "header_fp = fopen('res/header.asm', 'r')");
+    logger(DEBUG, ctx->perror_msg);
     FILE *header_fp = NULL;
     errno = EXIT_SUCCESS;
     header_fp = fopen ("res/header.asm", "r");
@@ -2401,7 +5066,7 @@ print_asm_code(asm_cmd_e cmd_list[], FILE *dest_fp)
         _PASS;
     else
     {
-        perror (perror_msg);
+        perror (ctx->perror_msg);
         _FAIL;
         return (errno);
     }
@@ -2421,36 +5086,236 @@ print_asm_code(asm_cmd_e cmd_list[], FILE *dest_fp)
       ch = fgetc (header_fp);
   }
 
-  /// Close header file pointer if not NULL
-  sprintf (perror_msg, "fclose(header_fp)");
-  logger(DEBUG, perror_msg);
-  if (header_fp)
-  {
-      if (fclose (header_fp) == EXIT_SUCCESS)
-      {
-          _PASS;
-          header_fp = NULL;
-      }
-      else
-      {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
-      }
-  }
+  /// Close header file pointer if not NULL
+  sprintf (ctx->perror_msg, "fclose(header_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (header_fp)
+  {
+      if (fclose (header_fp) == EXIT_SUCCESS)
+      {
+          _PASS;
+          header_fp = NULL;
+      }
+      else
+      {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+      }
+  }
+
+  /// Print user code
+  int i = 0;
+  logger(DEBUG, "Print ASM user code");
+  reg_cmd_s *reg_list = NULL;
+  int reg_len = gen_reg_code (ctx, cmd_list, &reg_list);
+  for (int r = 0; r < reg_len; r++)
+    {
+      if (reg_list[r].cmd != reg_Cmd)
+        {
+          print_reg_cmd (ctx, cmd_list, &reg_list[r], r, dest_fp);
+          continue;
+        }
+
+      i = reg_list[r].arg;
+      switch (cmd_list[i].cmd)
+        {
+        case asm_Fetch:
+        case asm_Store:
+        case asm_Tee:
+        case asm_Push:
+          fprintf (dest_fp, "  %s\t%d\n", asm_cmds[cmd_list[i].cmd],
+                   cmd_list[i].intval);
+          break;
+        case asm_Add:
+        case asm_Sub:
+        case asm_Negate:
+        case asm_Mul:
+        case asm_Div:
+        case asm_Mod:
+        case asm_Eq:
+        case asm_Neq:
+        case asm_Lss:
+        case asm_Gtr:
+        case asm_Leq:
+        case asm_Geq:
+        case asm_And:
+        case asm_Or:
+        case asm_Not:
+          /// Branch-free macros are named O_SET<name> after O_<name>
+          if (ctx->branchless && cmd_list[i].cmd >= asm_Eq)
+            fprintf (dest_fp, "  O_SET%s\n", asm_cmds[cmd_list[i].cmd] + 2);
+          else
+            fprintf (dest_fp, "  %s\n", asm_cmds[cmd_list[i].cmd]);
+          break;
+        case asm_Prts:
+        case asm_Input:
+        case asm_Prti:
+        case asm_HALT:
+          fprintf (dest_fp, "  %s\n", asm_cmds[cmd_list[i].cmd]);
+          break;
+        case asm_Label:
+          fprintf (dest_fp, "%s:\n", cmd_list[i].label);
+          break;
+        case asm_Jz:
+        case asm_Jnz:
+        case asm_Jeq:
+        case asm_Jneq:
+        case asm_Jlss:
+        case asm_Jgtr:
+        case asm_Jleq:
+        case asm_Jgeq:
+        case asm_Jmp:
+          fprintf (dest_fp, "  %s\t\t%s\n", asm_cmds[cmd_list[i].cmd],
+                   cmd_list[i].label);
+          break;
+        default:
+          logger(ERROR, "Unknown opcode %d\n", cmd_list[i].cmd);
+          free (reg_list);
+          opal_abort (ctx, EXIT_FAILURE);
+        }
+    }
+  free (reg_list);
+  _DONE;
+
+  /// Open footer file in 'r' mode
+  sprintf (ctx->perror_msg, "footer_fp = fopen('res/footer.asm', 'r')");
+  logger(DEBUG, ctx->perror_msg);
+  FILE *footer_fp = NULL;
+  errno = EXIT_SUCCESS;
+  footer_fp = fopen ("res/footer.asm", "r");
+  if (errno == EXIT_SUCCESS)
+      _PASS;
+  else
+  {
+      perror (ctx->perror_msg);
+      _FAIL;
+      return (errno);
+  }
+
+  /// Copy contents of footer char by char to dest_fp
+  logger(DEBUG, "Copying contents of footer.asm in print_asm_code()");
+  ch = fgetc (footer_fp);
+  while (ch != EOF)
+  {
+      fputc (ch, dest_fp);
+      ch = fgetc (footer_fp);
+  }
+
+  /// Close footer file pointer if not NULL
+  sprintf (ctx->perror_msg, "fclose(footer_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (footer_fp)
+    {
+      if (fclose (footer_fp) == EXIT_SUCCESS)
+        {
+          _PASS;
+          footer_fp = NULL;
+        }
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
+    }
+
+  /// Create strings and their lengths
+  fprintf (dest_fp, "  ; === Strings ===;\n");
+  for (i = 0; i < ctx->strs_len; i++)
+    {
+      fprintf (dest_fp, "  msg%d: DB \"", i);
+      /// Read each string character
+      int j = 0;
+      for (j = 0; j < strlen (ctx->strs[i]); j++)
+        {
+          ///print ASCII values for newlines
+          if (ctx->strs[i][j] == '\\' && ctx->strs[i][j + 1] == 'n')
+            {
+              fprintf (dest_fp, "\", 13, 10, \"");
+              j = j + 1;
+            }
+
+          /// directly print all other characters
+          else
+            fprintf (dest_fp, "%c", ctx->strs[i][j]);
+        }
+
+      /// NULL terminate string
+      fprintf (dest_fp, "\", NULL\n");
+
+      /// Print string length
+      fprintf (dest_fp, "  len%d EQU $ - msg%d\n", i, i);
+    }
+
+  if (ctx->strs_len > 0)
+    {
+      /// Print string array
+      fprintf (dest_fp, "  strs: DQ ");
+      for (i = 0; i < ctx->strs_len; i++)
+        {
+          fprintf (dest_fp, "msg%d, ", i);
+        }
+      fprintf (dest_fp, "\n");
+
+      /// ...and length array
+      fprintf (dest_fp, "  lens: DQ ");
+      for (i = 0; i < ctx->strs_len; i++)
+        {
+          fprintf (dest_fp, "len%d, ", i);
+        }
+      fprintf (dest_fp, "\n");
+    }
+
+  /// Create integers array
+  if (ctx->vars_len > 0)
+    {
+      logger(DEBUG, "Create data array of length: %d", ctx->vars_len);
+      fprintf (dest_fp, "  ; === Integers ===;\n  data  TIMES %d DQ 0\n",
+               ctx->vars_len);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Print assembly code list to HTML report file
+ *
+ * @param       cmd_list    Assembly command list to print
+ * @param       dest_fp   Destination HTML reportfile pointer
+ *
+ * @return      Function exit code
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On error
+ */
+short
+print_asm_code_html (opal_ctx_s *ctx, asm_cmd_e cmd_list[], FILE *dest_fp)
+{
+  logger(DEBUG, "=== START ===");
+
+  fprintf (dest_fp, "<h3>0-address stack machine code by Code generator "
+           "<code>GENIE</code></h3>\n<hr>\n");
+
+  char summary[256] = { 0 };
+  peephole_summary (ctx, summary, sizeof(summary));
+  fprintf (dest_fp, "<p>Peephole rule hits: %s</p>\n", summary);
+
+  fprintf (dest_fp,
+           "<textarea style='resize: none;' readonly rows='25' cols='80'>");
 
-  /// Print user code
   int i = 0;
-  logger(DEBUG, "Print ASM user code");
-  for (i = 0; i < asm_cmd_list_len; i++)
+  logger(DEBUG, "Print ASM user code to HTML");
+  for (i = 0; i < ctx->asm_cmd_list_len; i++)
     {
-      switch (asm_cmd_list[i].cmd)
+      switch (ctx->asm_cmd_list[i].cmd)
         {
         case asm_Fetch:
         case asm_Store:
+        case asm_Tee:
         case asm_Push:
-          fprintf (dest_fp, "  %s\t%d\n", asm_cmds[asm_cmd_list[i].cmd],
-                   asm_cmd_list[i].intval);
+          fprintf (dest_fp, "  %s\t%d\n", asm_cmds[ctx->asm_cmd_list[i].cmd],
+                   ctx->asm_cmd_list[i].intval);
           break;
         case asm_Add:
         case asm_Sub:
@@ -2471,495 +5336,1984 @@ print_asm_code(asm_cmd_e cmd_list[], FILE *dest_fp)
         case asm_Input:
         case asm_Prti:
         case asm_HALT:
-          fprintf (dest_fp, "  %s\n", asm_cmds[asm_cmd_list[i].cmd]);
+          fprintf (dest_fp, "  %s\n", asm_cmds[ctx->asm_cmd_list[i].cmd]);
           break;
         case asm_Label:
-          fprintf (dest_fp, "%s:\n", asm_cmd_list[i].label);
+          fprintf (dest_fp, "%s:\n", ctx->asm_cmd_list[i].label);
           break;
         case asm_Jz:
+        case asm_Jnz:
+        case asm_Jeq:
+        case asm_Jneq:
+        case asm_Jlss:
+        case asm_Jgtr:
+        case asm_Jleq:
+        case asm_Jgeq:
         case asm_Jmp:
-          fprintf (dest_fp, "  %s\t\t%s\n", asm_cmds[asm_cmd_list[i].cmd],
-                   asm_cmd_list[i].label);
+          fprintf (dest_fp, "  %s\t\t%s\n", asm_cmds[ctx->asm_cmd_list[i].cmd],
+                   ctx->asm_cmd_list[i].label);
           break;
         default:
-          logger(ERROR, "Unknown opcode %d\n", asm_cmd_list[i].cmd);
-          exit (opal_exit (EXIT_FAILURE));
+          fprintf(stderr, "Unknown opcode %d\n", ctx->asm_cmd_list[i].cmd);
+          opal_abort (ctx, EXIT_FAILURE);
         }
     }
   _DONE;
 
-  /// Open footer file in 'r' mode
-  sprintf (perror_msg, "footer_fp = fopen('res/footer.asm', 'r')");
-  logger(DEBUG, perror_msg);
-  FILE *footer_fp = NULL;
+  /// Create strings and their lengths
+  fprintf (dest_fp, "  ; === Strings ===;\n");
+  for (i = 0; i < ctx->strs_len; i++)
+    {
+      fprintf (dest_fp, "  msg%d: DB \"", i);
+      /// Read each string character
+      int j = 0;
+      for (j = 0; j < strlen (ctx->strs[i]); j++)
+        {
+          ///print ASCII values for newlines
+          if (ctx->strs[i][j] == '\\' && ctx->strs[i][j + 1] == 'n')
+            {
+              fprintf (dest_fp, "\", 13, 10, \"");
+              j = j + 1;
+            }
+
+          /// directly print all other characters
+          else
+            fprintf (dest_fp, "%c", ctx->strs[i][j]);
+        }
+
+      /// NULL terminate string
+      fprintf (dest_fp, "\", NULL\n");
+
+      /// Print string length
+      fprintf (dest_fp, "  len%d EQU $ - msg%d\n", i, i);
+    }
+
+  if (ctx->strs_len > 0)
+    {
+      /// Print string array
+      fprintf (dest_fp, "  strs: DQ ");
+      for (i = 0; i < ctx->strs_len; i++)
+        fprintf (dest_fp, "msg%d, ", i);
+
+      fprintf (dest_fp, "\n");
+
+      /// ...and length array
+      fprintf (dest_fp, "  lens: DQ ");
+      for (i = 0; i < ctx->strs_len; i++)
+        fprintf (dest_fp, "len%d, ", i);
+
+      fprintf (dest_fp, "\n");
+    }
+
+  /// Create integers array
+  if (ctx->vars_len > 0)
+    {
+      logger(DEBUG, "Create data array of length: %d", ctx->vars_len);
+      fprintf (dest_fp, "  ; === Integers ===;\n  data  TIMES %d DQ 0\n",
+               ctx->vars_len);
+    }
+
+  fprintf (dest_fp, "</textarea>");
+  logger(DEBUG, "=== END ===");
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Get index of an identifier in array, add if missing
+ *
+ * @details     The index is kept in the interned symbol, so each occurrence
+ * costs O(1) and indices are given in order of first use.
+ *
+ * @param[in]   sym   interned symbol of identifier to get index for
+ *
+ * @return      index of identifier in the array
+ */
+int
+add_var (opal_ctx_s *ctx, int sym)
+{
+  intern_sym_s *symbol = &ctx->syms[sym];
+
+  /// Return index given at an earlier occurrence
+  if (symbol->slot >= 0)
+    {
+      logger(DEBUG, "Identifier '%s' found at index %d.", symbol->name,
+             symbol->slot);
+      return symbol->slot;
+    }
+
+  /// Otherwise append the identifier to the array
+  symbol->slot = ctx->vars_len;
+  logger(DEBUG, "Created new identifier '%s' at index %d.", symbol->name,
+         symbol->slot);
+  ctx->vars = grow_array (ctx, ctx->vars, &ctx->vars_cap, ctx->vars_len + 1,
+                          sizeof(char*), "vars");
+  ctx->vars[ctx->vars_len++] = symbol->name;
+
+  /// and return its index
+  return symbol->slot;
+}
+
+/**
+ * @brief       Get index of a string in array, add if missing
+ *
+ * @param[in]   sym   interned symbol of string to get index for
+ *
+ * @return      index of string in the array
+ */
+int
+add_str (opal_ctx_s *ctx, int sym)
+{
+  intern_sym_s *symbol = &ctx->syms[sym];
+
+  /// Return index given at an earlier occurrence
+  if (symbol->slot >= 0)
+    {
+      logger(DEBUG, "String '%s' found at index %d.", symbol->name,
+             symbol->slot);
+      return symbol->slot;
+    }
+
+  /// Otherwise append the string to the array
+  symbol->slot = ctx->strs_len;
+  logger(DEBUG, "Created new string '%s' at index %d.", symbol->name,
+         symbol->slot);
+  ctx->strs = grow_array (ctx, ctx->strs, &ctx->strs_cap, ctx->strs_len + 1,
+                          sizeof(char*), "strs");
+  ctx->strs[ctx->strs_len++] = symbol->name;
+
+  /// and return its index
+  return symbol->slot;
+}
+
+/**
+ * @brief       Size ASM arrays for the lexeme count and interned symbols
+ *
+ * @details     GENIE emits about one command per lexeme, and a program
+ * uses at most as many variables and strings as ALEX interned, so the
+ * tables rarely grow while generating code.
+ *
+ * @param       symbol_count    Lexeme count reported by build_symbol_table()
+ */
+void
+reserve_asm_arrays (opal_ctx_s *ctx, int symbol_count)
+{
+  unsigned idents = 0;
+  unsigned strings = 0;
+  unsigned i = 0;
+  for (i = 0; i < ctx->syms_len; i++)
+    {
+      if (ctx->syms[i].is_str)
+        strings++;
+      else
+        idents++;
+    }
+
+  logger(DEBUG, "Reserve %d commands, %u variables and %u strings.",
+         symbol_count, idents, strings);
+
+  ctx->asm_cmd_list = grow_array (ctx, ctx->asm_cmd_list,
+                                  &ctx->asm_cmd_list_cap, symbol_count,
+                                  sizeof(asm_cmd_e), "asm_cmd_list");
+  ctx->vars = grow_array (ctx, ctx->vars, &ctx->vars_cap, idents,
+                          sizeof(char*), "vars");
+  ctx->strs = grow_array (ctx, ctx->strs, &ctx->strs_cap, strings,
+                          sizeof(char*), "strs");
+}
+
+/*
+ * ==================================
+ * START ORCHESTRATOR FUNCTION DEFINITIONS
+ * ==================================
+ */
+
+/**
+ * @brief          Assemble object file using NASM
+ * @param asm_fn   Assembly source file name
+ * @param obj_fn   Object destination file name
+ */
+short
+gen_obj (opal_ctx_s *ctx, char *asm_fn, char *obj_fn)
+{
+    logger(DEBUG, "=== START ===");
+    /// Assert assembly file name is not null
+    assert(asm_fn);
+    /// Assert object file name is not null
+    assert(obj_fn);
+    /// Check if asm_fn can be read
+    sprintf(ctx->perror_msg, "access (%s, R_OK)", asm_fn);
+    logger(DEBUG, ctx->perror_msg);
+    errno = EXIT_SUCCESS;
+    if (access (asm_fn, R_OK) == EXIT_SUCCESS)
+    {
+        _PASS;
+        /// Create the NASM call with -g, -f and -o flags
+        logger(DEBUG, "Calling NASM to assemble object.");
+        char nasm_cmd[1024] = { 0 };
+        sprintf (nasm_cmd, "nasm -g -f elf64 -o %s %s", obj_fn, asm_fn);
+        logger(DEBUG, nasm_cmd);
+        int sys_call = system (nasm_cmd);
+        if (sys_call == EXIT_SUCCESS)
+        {
+            _PASS;
+            /// Check if obj_fn can be read
+            sprintf (ctx->perror_msg, "access (%s, R_OK)", obj_fn);
+            logger(DEBUG, ctx->perror_msg);
+            errno = EXIT_SUCCESS;
+            if (access (obj_fn, R_OK) == EXIT_SUCCESS)
+                _PASS;
+            else
+            {
+                perror (ctx->perror_msg);
+                _FAIL;
+                return (errno);
+            }
+        }
+        else
+        {
+            perror (nasm_cmd);
+            _FAIL;
+            return (sys_call);
+        }
+    }
+    else
+    {
+        perror (ctx->perror_msg);
+        _FAIL;
+        return (errno);
+    }
+    logger(DEBUG, "=== END ===");
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * @brief           Link object using LD
+ * @param obj_fn    Source object file name
+ * @param dest_fn   Destination binary file name
+ */
+short
+gen_bin (opal_ctx_s *ctx, char *obj_fn, char *dest_fn)
+{
+  logger(DEBUG, "=== START ===");
+
+  /// Assert object file name is not null
+  assert(obj_fn);
+
+  /// Assert destination file name is not null
+  assert(dest_fn);
+
+  /// Call to linker
+  logger(DEBUG, "Calling LD to link object.");
+  char LD_cmd[1024] = { 0 };
+  sprintf(LD_cmd, "ld -m elf_x86_64 -o %s -lc -I/lib64/ld-linux-x86-64.so.2 %s", dest_fn, obj_fn);
+
+  /// Confirm obj_fn can be read
+  logger(DEBUG, "access(obj_fn, R_OK)");
   errno = EXIT_SUCCESS;
-  footer_fp = fopen ("res/footer.asm", "r");
-  if (errno == EXIT_SUCCESS)
-      _PASS;
+  if (access(obj_fn, R_OK) == 0)
+    {
+
+      /// Use LD to link the obj_fn contents
+      logger(DEBUG, "ld -m elf_x86_64 -o %s -lc -I/lib64/ld-linux-x86-64.so.2 %s", dest_fn, obj_fn);
+      errno = EXIT_SUCCESS;
+      int sys_call = system(LD_cmd);
+
+      /// Confirm successful linking
+      if (sys_call == 0)
+        {
+          /// Confirm dest_fn can be read to and executed
+          logger(DEBUG, "access(obj_fn, R_OK) && access(obj_fn, X_OK)");
+          errno = EXIT_SUCCESS;
+          if ((access(dest_fn, R_OK) == 0) && (access(dest_fn, X_OK) == 0))
+            _PASS;
+
+            /// Return errno if missing permissions on dest_fn
+          else
+            {
+              perror("access(obj_fn, R_OK) && access(obj_fn, X_OK)");
+              return errno;
+            }
+        }
+
+      /// ...or log command if unsuccessful
+      else{
+        perror(LD_cmd);
+        return sys_call;
+      }
+    }
+
+  /// ...or missing read permission on obj_fn
   else
-  {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-  }
+    {
+      perror("access(obj_fn, R_OK)");
+      return errno;
+    }
+
+  logger(DEBUG, "=== END ===");
+
+  return EXIT_SUCCESS;
+}
+
+/*
+ * ==================================
+ * START NATIVE BACKEND FUNCTION DEFINITIONS
+ * ==================================
+ */
 
-  /// Copy contents of footer char by char to dest_fp
-  logger(DEBUG, "Copying contents of footer.asm in print_asm_code()");
-  ch = fgetc (footer_fp);
-  while (ch != EOF)
-  {
-      fputc (ch, dest_fp);
-      ch = fgetc (footer_fp);
-  }
+/*
+ * The native backend encodes asm_cmd_list straight into x86-64 machine code
+ * and writes a static ELF executable, instead of printing NASM source and
+ * running nasm and ld. Each command is encoded as the same instruction
+ * sequence as the macro of the same name in res/header.asm, so behaviour
+ * (including exit codes on failed writes and quirks of _INPUT_) is identical.
+ * A change to a macro in header.asm must be mirrored here, and is checked by
+ * verify_native_bin().
+ */
 
-  /// Close footer file pointer if not NULL
-  sprintf (perror_msg, "fclose(footer_fp)");
-  logger(DEBUG, perror_msg);
-  if (footer_fp)
+/// Append bytes given as arguments to machine code buffer, needs ctx in scope
+#define X64(buf, ...) \
+  x64_emit (ctx, buf, (const unsigned char[]) { __VA_ARGS__ }, \
+            sizeof((const unsigned char[]) { __VA_ARGS__ }))
+
+/// x86-64 condition codes, low nibble of Jcc opcodes
+enum { cc_B = 0x2, cc_E = 0x4, cc_NE = 0x5, cc_BE = 0x6, cc_A = 0x7,
+  cc_L = 0xC, cc_GE = 0xD, cc_LE = 0xE, cc_G = 0xF };
+
+/// Append bytes to buffer, growing it as needed
+static void
+x64_emit (opal_ctx_s *ctx, x64_buf_s *buf, const unsigned char *bytes,
+          size_t len)
+{
+  if (buf->len + len > buf->cap)
     {
-      if (fclose (footer_fp) == EXIT_SUCCESS)
+      size_t cap = buf->cap ? buf->cap * 2 : 4096;
+      while (cap < buf->len + len)
+        cap *= 2;
+      unsigned char *data = realloc (buf->data, cap);
+      if (data == NULL)
         {
-          _PASS;
-          footer_fp = NULL;
+          perror ("realloc(x64_buf)");
+          opal_abort (ctx, errno);
         }
-      else
+      buf->data = data;
+      buf->cap = cap;
+    }
+  memcpy (buf->data + buf->len, bytes, len);
+  buf->len += len;
+}
+
+/// Append 32-bit little endian value to buffer
+static void
+x64_emit_u32 (opal_ctx_s *ctx, x64_buf_s *buf, unsigned value)
+{
+  X64(buf, value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff,
+      (value >> 24) & 0xff);
+}
+
+/// Append 32-bit address of offset in data segment, relocated by x64_relocate
+static void
+x64_emit_addr (opal_ctx_s *ctx, x64_buf_s *buf, unsigned offset)
+{
+  if (buf->relocs_len == buf->relocs_cap)
+    {
+      size_t cap = buf->relocs_cap ? buf->relocs_cap * 2 : 256;
+      size_t *relocs = realloc (buf->relocs, cap * sizeof(size_t));
+      if (relocs == NULL)
         {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
+          perror ("realloc(x64_relocs)");
+          opal_abort (ctx, errno);
         }
+      buf->relocs = relocs;
+      buf->relocs_cap = cap;
     }
+  buf->relocs[buf->relocs_len++] = buf->len;
+  x64_emit_u32 (ctx, buf, offset);
+}
 
-  /// Create strings and their lengths
-  fprintf (dest_fp, "  ; === Strings ===;\n");
-  for (i = 0; i < strs_len; i++)
+/// Add address of data segment to the offsets emitted by x64_emit_addr
+static void
+x64_relocate (x64_buf_s *buf, unsigned data_addr)
+{
+  for (size_t r = 0; r < buf->relocs_len; r++)
     {
-      fprintf (dest_fp, "  msg%d: DB \"", i);
-      /// Read each string character
-      int j = 0;
-      for (j = 0; j < strlen (strs[i]); j++)
-        {
-          ///print ASCII values for newlines
-          if (strs[i][j] == '\\' && strs[i][j + 1] == 'n')
-            {
-              fprintf (dest_fp, "\", 13, 10, \"");
-              j = j + 1;
-            }
+      unsigned char *at = buf->data + buf->relocs[r];
+      unsigned value = (at[0] | at[1] << 8 | at[2] << 16
+          | (unsigned) at[3] << 24) + data_addr;
+      at[0] = value & 0xff;
+      at[1] = (value >> 8) & 0xff;
+      at[2] = (value >> 16) & 0xff;
+      at[3] = (value >> 24) & 0xff;
+    }
+}
 
-          /// directly print all other characters
-          else
-            fprintf (dest_fp, "%c", strs[i][j]);
-        }
+/// Free bytes and relocations of buffer
+static void
+x64_buf_free (x64_buf_s *buf)
+{
+  free (buf->data);
+  free (buf->relocs);
+  *buf = (x64_buf_s) { 0 };
+}
 
-      /// NULL terminate string
-      fprintf (dest_fp, "\", NULL\n");
+/// Append Jcc rel32 with unresolved target, return offset of rel32
+static size_t
+x64_emit_jcc (opal_ctx_s *ctx, x64_buf_s *buf, int cc)
+{
+  X64(buf, 0x0f, 0x80 | cc);
+  x64_emit_u32 (ctx, buf, 0);
+  return buf->len - 4;
+}
 
-      /// Print string length
-      fprintf (dest_fp, "  len%d EQU $ - msg%d\n", i, i);
+/// Append JMP rel32 with unresolved target, return offset of rel32
+static size_t
+x64_emit_jmp (opal_ctx_s *ctx, x64_buf_s *buf)
+{
+  X64(buf, 0xe9);
+  x64_emit_u32 (ctx, buf, 0);
+  return buf->len - 4;
+}
+
+/// Point rel32 at offset 'at' to code offset 'target'
+static void
+x64_patch (x64_buf_s *buf, size_t at, size_t target)
+{
+  unsigned rel = (unsigned) (target - (at + 4));
+  buf->data[at] = rel & 0xff;
+  buf->data[at + 1] = (rel >> 8) & 0xff;
+  buf->data[at + 2] = (rel >> 16) & 0xff;
+  buf->data[at + 3] = (rel >> 24) & 0xff;
+}
+
+/// Point rel32 at offset 'at' to end of buffer
+static void
+x64_patch_here (x64_buf_s *buf, size_t at)
+{
+  x64_patch (buf, at, buf->len);
+}
+
+/// HALT RAX - exits with SYS_EXIT as code, as the macro loads RAX first
+static void
+x64_emit_halt_rax (opal_ctx_s *ctx, x64_buf_s *code)
+{
+  X64(code, 0xb8, 60, 0, 0, 0);                 // MOV  RAX, SYS_EXIT
+  X64(code, 0x48, 0x89, 0xc7);                  // MOV  RDI, RAX
+  X64(code, 0x0f, 0x05);                        // SYSCALL
+}
+
+/// _FLUSH_ - write bytes in output buffer to STDOUT and empty it
+static void
+x64_emit_flush (opal_ctx_s *ctx, x64_buf_s *code, const x64_layout_s *layout)
+{
+  X64(code, 0x48, 0x8b, 0x14, 0x25);            // MOV  RDX, [olen]
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  X64(code, 0x48, 0x83, 0xfa, 0);               // CMP  RDX, 0
+  size_t end = x64_emit_jcc (ctx, code, cc_E);  // JE   %%end
+  X64(code, 0xbe);                              // MOV  RSI, obuf
+  x64_emit_addr (ctx, code, layout->obuf_addr);
+  X64(code, 0xb8, 1, 0, 0, 0);                  // MOV  RAX, SYS_WRITE
+  X64(code, 0xbf, 1, 0, 0, 0);                  // MOV  RDI, STDOUT
+  X64(code, 0x0f, 0x05);                        // SYSCALL
+  X64(code, 0x48, 0x39, 0xc2);                  // CMP  RDX, RAX
+  size_t empty = x64_emit_jcc (ctx, code, cc_E); // JE  %%empty
+  x64_emit_halt_rax (ctx, code);                // HALT RAX
+  x64_patch_here (code, empty);                 // %%empty:
+  X64(code, 0x48, 0xc7, 0x04, 0x25);            // MOV  QWORD [olen], 0
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  x64_emit_u32 (ctx, code, 0);
+  x64_patch_here (code, end);                   // %%end:
+}
+
+/// O_PRTS - append string whose index is on top of stack to output buffer
+static void
+x64_emit_prts (opal_ctx_s *ctx, x64_buf_s *code, const x64_layout_s *layout)
+{
+  X64(code, 0x58);                              // POP  RAX
+  X64(code, 0xbb, 8, 0, 0, 0);                  // MOV  RBX, 8d
+  X64(code, 0x48, 0xf7, 0xeb);                  // IMUL RBX
+  X64(code, 0x48, 0x8b, 0xb0);                  // MOV  RSI, [strs+RAX]
+  x64_emit_addr (ctx, code, layout->strs_addr);
+  X64(code, 0x48, 0x8b, 0x90);                  // MOV  RDX, [lens+RAX]
+  x64_emit_addr (ctx, code, layout->lens_addr);
+  size_t copy = code->len;                      // %%copy:
+  X64(code, 0xb9);                              // MOV  RCX, OBUF_SIZE
+  x64_emit_u32 (ctx, code, OBUF_SIZE);
+  X64(code, 0x48, 0x2b, 0x0c, 0x25);            // SUB  RCX, [olen]
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  size_t room = x64_emit_jcc (ctx, code, cc_NE); // JNZ %%room
+  X64(code, 0x56, 0x52);                        // PUSH RSI, PUSH RDX
+  x64_emit_flush (ctx, code, layout);           // _FLUSH_
+  X64(code, 0x5a, 0x5e);                        // POP  RDX, POP RSI
+  x64_patch (code, x64_emit_jmp (ctx, code), copy); // JMP %%copy
+  x64_patch_here (code, room);                  // %%room:
+  X64(code, 0x48, 0x39, 0xd1);                  // CMP  RCX, RDX
+  size_t copy_n = x64_emit_jcc (ctx, code, cc_BE); // JBE %%copy_n
+  X64(code, 0x48, 0x89, 0xd1);                  // MOV  RCX, RDX
+  x64_patch_here (code, copy_n);                // %%copy_n:
+  X64(code, 0x48, 0x29, 0xca);                  // SUB  RDX, RCX
+  X64(code, 0xbf);                              // MOV  RDI, obuf
+  x64_emit_addr (ctx, code, layout->obuf_addr);
+  X64(code, 0x48, 0x03, 0x3c, 0x25);            // ADD  RDI, [olen]
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  X64(code, 0x48, 0x01, 0x0c, 0x25);            // ADD  [olen], RCX
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  X64(code, 0xf3, 0xa4);                        // REP  MOVSB
+  X64(code, 0x48, 0x83, 0xfa, 0);               // CMP  RDX, 0
+  x64_patch (code, x64_emit_jcc (ctx, code, cc_NE), copy); // JNE %%copy
+}
+
+/// O_PRTI - append integer on top of stack to output buffer
+static void
+x64_emit_prti (opal_ctx_s *ctx, x64_buf_s *code, const x64_layout_s *layout)
+{
+  X64(code, 0x48, 0x81, 0x3c, 0x25);            // CMP  QWORD [olen], ..
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  x64_emit_u32 (ctx, code, OBUF_SIZE - 20);     // .. OBUF_SIZE - 20
+  size_t room = x64_emit_jcc (ctx, code, cc_BE); // JBE %%room
+  x64_emit_flush (ctx, code, layout);           // _FLUSH_
+  x64_patch_here (code, room);                  // %%room:
+  X64(code, 0x58);                              // POP  RAX
+  X64(code, 0xbf);                              // MOV  RDI, obuf
+  x64_emit_addr (ctx, code, layout->obuf_addr);
+  X64(code, 0x48, 0x03, 0x3c, 0x25);            // ADD  RDI, [olen]
+  x64_emit_addr (ctx, code, layout->olen_addr);
+  X64(code, 0x48, 0x83, 0xf8, 0);               // CMP  RAX, 0
+  size_t start = x64_emit_jcc (ctx, code, cc_GE); // JGE %%start
+  X64(code, 0xc6, 0x07, '-');                   // MOV  BYTE [RDI], '-'
+  X64(code, 0x48, 0xff, 0xc7);                  // INC  RDI
+  X64(code, 0x48, 0xf7, 0xd8);                  // NEG  RAX
+  x64_patch_here (code, start);                 // %%start:
+  X64(code, 0xb9, 1, 0, 0, 0);                  // MOV  RCX, 1
+  X64(code, 0xba, 10, 0, 0, 0);                 // MOV  RDX, 10
+  size_t count = code->len;                     // %%count:
+  X64(code, 0x48, 0x39, 0xd0);                  // CMP  RAX, RDX
+  size_t counted = x64_emit_jcc (ctx, code, cc_B); // JB %%counted
+  X64(code, 0x48, 0xff, 0xc1);                  // INC  RCX
+  X64(code, 0x48, 0x6b, 0xd2, 10);              // IMUL RDX, RDX, 10
+  x64_patch (code, x64_emit_jmp (ctx, code), count); // JMP %%count
+  x64_patch_here (code, counted);               // %%counted:
+  X64(code, 0x48, 0x01, 0xcf);                  // ADD  RDI, RCX
+  X64(code, 0x49, 0x89, 0xf8);                  // MOV  R8, RDI
+
+  size_t pairs = code->len;                     // %%pairs:
+  X64(code, 0x48, 0x83, 0xf8, 100);             // CMP  RAX, 100
+  size_t last = x64_emit_jcc (ctx, code, cc_B); // JB   %%last
+  X64(code, 0x48, 0x89, 0xc3);                  // MOV  RBX, RAX
+  X64(code, 0x48, 0xc1, 0xe8, 2);               // SHR  RAX, 2
+  X64(code, 0x48, 0xba, 0xc3, 0xf5, 0x28, 0x5c, // MOV  RDX, 0x28F5C28F5C28F5C3
+      0x8f, 0xc2, 0xf5, 0x28);
+  X64(code, 0x48, 0xf7, 0xe2);                  // MUL  RDX
+  X64(code, 0x48, 0x89, 0xd0);                  // MOV  RAX, RDX
+  X64(code, 0x48, 0xc1, 0xe8, 2);               // SHR  RAX, 2
+  X64(code, 0x48, 0x6b, 0xd0, 100);             // IMUL RDX, RAX, 100
+  X64(code, 0x48, 0x29, 0xd3);                  // SUB  RBX, RDX
+  X64(code, 0x0f, 0xb7, 0x14, 0x5d);            // MOVZX EDX, WORD [pairs+RBX*2]
+  x64_emit_addr (ctx, code, layout->pairs_addr);
+  X64(code, 0x48, 0x83, 0xef, 2);               // SUB  RDI, 2
+  X64(code, 0x66, 0x89, 0x17);                  // MOV  [RDI], DX
+  x64_patch (code, x64_emit_jmp (ctx, code), pairs); // JMP %%pairs
+
+  x64_patch_here (code, last);                  // %%last:
+  X64(code, 0x48, 0x83, 0xf8, 10);              // CMP  RAX, 10
+  size_t one = x64_emit_jcc (ctx, code, cc_B);  // JB   %%one
+  X64(code, 0x0f, 0xb7, 0x14, 0x45);            // MOVZX EDX, WORD [pairs+RAX*2]
+  x64_emit_addr (ctx, code, layout->pairs_addr);
+  X64(code, 0x66, 0x89, 0x57, 0xfe);            // MOV  [RDI-2], DX
+  size_t end = x64_emit_jmp (ctx, code);        // JMP  %%end
+  x64_patch_here (code, one);                   // %%one:
+  X64(code, 0x04, 48);                          // ADD  AL, 48
+  X64(code, 0x88, 0x47, 0xff);                  // MOV  [RDI-1], AL
+  x64_patch_here (code, end);                   // %%end:
+  X64(code, 0x49, 0x81, 0xe8);                  // SUB  R8, obuf
+  x64_emit_addr (ctx, code, layout->obuf_addr);
+  X64(code, 0x4c, 0x89, 0x04, 0x25);            // MOV  [olen], R8
+  x64_emit_addr (ctx, code, layout->olen_addr);
+}
+
+/// _INPUT_ - print prompt, read line from input buffer and push its integer
+static void
+x64_emit_input (opal_ctx_s *ctx, x64_buf_s *code, const x64_layout_s *layout)
+{
+  x64_emit_prts (ctx, code, layout);            // O_PRTS
+  X64(code, 0x48, 0x31, 0xc0);                  // XOR  RAX, RAX
+  X64(code, 0x4d, 0x31, 0xc0);                  // XOR  R8, R8
+  X64(code, 0x4d, 0x31, 0xd2);                  // XOR  R10, R10
+  X64(code, 0x48, 0x8b, 0x34, 0x25);            // MOV  RSI, [ipos]
+  x64_emit_addr (ctx, code, layout->ipos_addr);
+  X64(code, 0x4c, 0x8b, 0x0c, 0x25);            // MOV  R9, [iend]
+  x64_emit_addr (ctx, code, layout->iend_addr);
+
+  size_t next = code->len;                      // %%next:
+  X64(code, 0x4c, 0x39, 0xce);                  // CMP  RSI, R9
+  size_t to_byte = x64_emit_jcc (ctx, code, cc_B); // JB %%byte
+  X64(code, 0x50);                              // PUSH RAX
+  x64_emit_flush (ctx, code, layout);           // _FLUSH_
+  X64(code, 0xb8, 0, 0, 0, 0);                  // MOV  RAX, SYS_READ
+  X64(code, 0xbf, 0, 0, 0, 0);                  // MOV  RDI, STDIN
+  X64(code, 0xbe);                              // MOV  RSI, ibuf
+  x64_emit_addr (ctx, code, layout->ibuf_addr);
+  X64(code, 0xba);                              // MOV  RDX, IBUF_SIZE
+  x64_emit_u32 (ctx, code, IBUF_SIZE);
+  X64(code, 0x0f, 0x05);                        // SYSCALL
+  X64(code, 0x49, 0x89, 0xc1);                  // MOV  R9, RAX
+  X64(code, 0x58);                              // POP  RAX
+  X64(code, 0x48, 0x31, 0xf6);                  // XOR  RSI, RSI
+  X64(code, 0x49, 0x83, 0xf9, 0);               // CMP  R9, 0
+  size_t read_byte = x64_emit_jcc (ctx, code, cc_G); // JG %%byte
+  X64(code, 0x4d, 0x31, 0xc9);                  // XOR  R9, R9
+  size_t eof = x64_emit_jmp (ctx, code);        // JMP  %%end
+
+  x64_patch_here (code, to_byte);               // %%byte:
+  x64_patch_here (code, read_byte);
+  X64(code, 0x0f, 0xb6, 0x9e);                  // MOVZX EBX, BYTE [ibuf+RSI]
+  x64_emit_addr (ctx, code, layout->ibuf_addr);
+  X64(code, 0x48, 0xff, 0xc6);                  // INC  RSI
+  X64(code, 0x80, 0xfb, 0x0a);                  // CMP  BL, 0ah
+  size_t newline = x64_emit_jcc (ctx, code, cc_E); // JE %%end
+  X64(code, 0x49, 0x83, 0xfa, 1);               // CMP  R10, 1
+  x64_patch (code, x64_emit_jcc (ctx, code, cc_A), next); // JA %%next
+  size_t in_digits = x64_emit_jcc (ctx, code, cc_E); // JE %%digit
+  X64(code, 0x49, 0xc7, 0xc2, 1, 0, 0, 0);      // MOV  R10, 1
+  X64(code, 0x80, 0xfb, 45);                    // CMP  BL, 45
+  size_t not_sign = x64_emit_jcc (ctx, code, cc_NE); // JNE %%digit
+  X64(code, 0x49, 0xc7, 0xc0, 1, 0, 0, 0);      // MOV  R8, 1d
+  x64_patch (code, x64_emit_jmp (ctx, code), next); // JMP %%next
+
+  x64_patch_here (code, in_digits);             // %%digit:
+  x64_patch_here (code, not_sign);
+  X64(code, 0x83, 0xeb, 48);                    // SUB  EBX, 48
+  X64(code, 0x83, 0xfb, 9);                     // CMP  EBX, 9
+  size_t past = x64_emit_jcc (ctx, code, cc_A); // JA   %%past
+  X64(code, 0x48, 0x6b, 0xc0, 10);              // IMUL RAX, RAX, 10
+  X64(code, 0x48, 0x01, 0xd8);                  // ADD  RAX, RBX
+  x64_patch (code, x64_emit_jmp (ctx, code), next); // JMP %%next
+  x64_patch_here (code, past);                  // %%past:
+  X64(code, 0x49, 0xc7, 0xc2, 2, 0, 0, 0);      // MOV  R10, 2
+  x64_patch (code, x64_emit_jmp (ctx, code), next); // JMP %%next
+
+  x64_patch_here (code, eof);                   // %%end:
+  x64_patch_here (code, newline);
+  X64(code, 0x48, 0x89, 0x34, 0x25);            // MOV  [ipos], RSI
+  x64_emit_addr (ctx, code, layout->ipos_addr);
+  X64(code, 0x4c, 0x89, 0x0c, 0x25);            // MOV  [iend], R9
+  x64_emit_addr (ctx, code, layout->iend_addr);
+  X64(code, 0x49, 0x83, 0xf8, 1);               // CMP  R8, 1d
+  size_t push_val = x64_emit_jcc (ctx, code, cc_NE); // JNE %%push_val
+  X64(code, 0x48, 0xf7, 0xd8);                  // NEG  RAX
+  x64_patch_here (code, push_val);              // %%push_val:
+  X64(code, 0x50);                              // PUSH RAX
+}
+
+/// Condition code under which comparison or logical command is false
+static int
+x64_false_cc (asm_code_e cmd)
+{
+  static const int cc_false[] = { cc_NE, cc_E, cc_GE, cc_LE, cc_G, cc_L };
+  if (cmd >= asm_Eq && cmd <= asm_Geq)
+    return cc_false[cmd - asm_Eq];
+  return cmd == asm_Not ? cc_NE : cc_E;
+}
+
+/// Condition code under which fused compare and branch jumps
+static int
+x64_jump_cc (asm_code_e cmd)
+{
+  static const int cc_true[] = { cc_E, cc_NE, cc_L, cc_G, cc_LE, cc_GE };
+  return cc_true[cmd - asm_Jeq];
+}
+
+/// Push isTrue if given Jcc is not taken, else push isFalse
+static void
+x64_emit_push_bool (opal_ctx_s *ctx, x64_buf_s *code, int cc_false)
+{
+  size_t is_false = x64_emit_jcc (ctx, code, cc_false);
+  X64(code, 0x6a, 1);                           // PUSH isTrue
+  size_t end = x64_emit_jmp (ctx, code);        // JMP  %%end
+  x64_patch_here (code, is_false);
+  X64(code, 0x6a, 0);                           // PUSH isFalse
+  x64_patch_here (code, end);                   // %%end:
+}
+
+/// Set EAX to 1 if given Jcc would not be taken, else to 0, without a branch
+static void
+x64_emit_setcc (opal_ctx_s *ctx, x64_buf_s *code, int cc_false)
+{
+  X64(code, 0x0f, 0x90 | (cc_false ^ 1), 0xc0); // SETcc AL
+  X64(code, 0x0f, 0xb6, 0xc0);                  // MOVZX EAX, AL
+}
+
+/// Push isTrue if given Jcc is not taken, else push isFalse, as O_SET* does
+static void
+x64_emit_push_cc (opal_ctx_s *ctx, x64_buf_s *code, int cc_false)
+{
+  if (!ctx->branchless)
+    {
+      x64_emit_push_bool (ctx, code, cc_false);
+      return;
     }
+  x64_emit_setcc (ctx, code, cc_false);
+  X64(code, 0x50);                              // PUSH RAX
+}
+
+/**
+ * @brief       Lay out runtime data segment as the footer of header.asm does
+ *
+ * @details     Data segment holds the 'pairs' digit table, the strings (each
+ * followed by the NULL, which is counted in its length), the 'strs' and
+ * 'lens' tables and the 'data' array of variables, followed by the 'olen',
+ * 'ipos' and 'iend' counts and the 'obuf' output and 'ibuf' input buffers.
+ *
+ * @param[out]  data        Bytes of data segment stored in the file
+ * @param[out]  layout      Offsets of runtime data in the data segment
+ */
+static void
+x64_layout_data (opal_ctx_s *ctx, x64_buf_s *data, x64_layout_s *layout)
+{
+  static const unsigned char zeros[8] = { 0 };
 
-  if (strs_len > 0)
+  /// Strings are laid out back to back, so one ends where the next starts
+  unsigned *str_addr = malloc ((ctx->strs_len + 1) * sizeof(unsigned));
+  if (str_addr == NULL)
     {
-      /// Print string array
-      fprintf (dest_fp, "  strs: DQ ");
-      for (i = 0; i < strs_len; i++)
-        {
-          fprintf (dest_fp, "msg%d, ", i);
-        }
-      fprintf (dest_fp, "\n");
+      perror ("malloc(str_addr)");
+      opal_abort (ctx, errno);
+    }
 
-      /// ...and length array
-      fprintf (dest_fp, "  lens: DQ ");
-      for (i = 0; i < strs_len; i++)
+  /// 'pairs' used by O_PRTI
+  layout->pairs_addr = data->len;
+  for (int i = 0; i < 100; i++)
+    X64(data, '0' + i / 10, '0' + i % 10);
+
+  /// Strings, with "\n" stored as 13, 10 like print_asm_code() does
+  for (int i = 0; i < ctx->strs_len; i++)
+    {
+      str_addr[i] = data->len;
+      for (int j = 0; ctx->strs[i][j]; j++)
         {
-          fprintf (dest_fp, "len%d, ", i);
+          if (ctx->strs[i][j] == '\\' && ctx->strs[i][j + 1] == 'n')
+            {
+              X64(data, 13, 10);
+              j = j + 1;
+            }
+          else
+            X64(data, ctx->strs[i][j]);
         }
-      fprintf (dest_fp, "\n");
+      X64(data, 0);
     }
+  str_addr[ctx->strs_len] = data->len;
 
-  /// Create integers array
-  if (vars_len > 0)
+  /// Tables of string addresses and lengths, 8 byte aligned
+  x64_emit (ctx, data, zeros, (8 - data->len % 8) % 8);
+  layout->strs_addr = data->len;
+  for (int i = 0; i < ctx->strs_len; i++)
     {
-      logger(DEBUG, "Create data array of length: %d", vars_len);
-      fprintf (dest_fp, "  ; === Integers ===;\n  data  TIMES %d DQ 0\n",
-               vars_len);
+      x64_emit_addr (ctx, data, str_addr[i]);
+      x64_emit_u32 (ctx, data, 0);
     }
+  layout->lens_addr = data->len;
+  for (int i = 0; i < ctx->strs_len; i++)
+    {
+      x64_emit_u32 (ctx, data, str_addr[i + 1] - str_addr[i]);
+      x64_emit_u32 (ctx, data, 0);
+    }
+  free (str_addr);
+
+  /// Variables and buffers are zero, so they take no room in the file
+  layout->file_len = data->len;
+  layout->data_addr = data->len;
+  layout->olen_addr = layout->data_addr + 8 * ctx->vars_len;
+  layout->ipos_addr = layout->olen_addr + 8;
+  layout->iend_addr = layout->ipos_addr + 8;
+  layout->obuf_addr = layout->iend_addr + 8;
+  layout->ibuf_addr = layout->obuf_addr + OBUF_SIZE;
+  layout->mem_len = layout->ibuf_addr + IBUF_SIZE;
+}
 
-  return EXIT_SUCCESS;
+/// Encode stack command, other than labels and jumps, as its macro
+static void
+x64_emit_cmd (opal_ctx_s *ctx, x64_buf_s *code, const x64_layout_s *layout,
+              asm_cmd_e *cmd)
+{
+  switch (cmd->cmd)
+    {
+    case asm_Add:
+      X64(code, 0x58, 0x5b, 0x48, 0x01, 0xd8, 0x50);
+      break;
+    case asm_Sub:
+      X64(code, 0x5b, 0x58, 0x48, 0x29, 0xd8, 0x50);
+      break;
+    case asm_Negate:
+      X64(code, 0x58, 0x48, 0xf7, 0xd8, 0x50);
+      break;
+    case asm_Mul:
+      X64(code, 0x58, 0x5b, 0x48, 0xf7, 0xeb, 0x50);
+      break;
+    case asm_Div:
+      X64(code, 0x5b, 0x58, 0x48, 0x31, 0xd2, 0x48, 0xf7, 0xfb, 0x50);
+      break;
+    case asm_Mod:
+      X64(code, 0x5b, 0x58, 0x48, 0x31, 0xd2, 0x48, 0xf7, 0xfb, 0x52);
+      break;
+    case asm_Eq:
+    case asm_Neq:
+    case asm_Lss:
+    case asm_Gtr:
+    case asm_Leq:
+    case asm_Geq:
+      X64(code, 0x5b, 0x58, 0x48, 0x39, 0xd8);          // POP, POP, CMP
+      x64_emit_push_cc (ctx, code, x64_false_cc (cmd->cmd));
+      break;
+    case asm_And:
+    case asm_Or:
+      X64(code, 0x58, 0x5b);                            // POP RAX, POP RBX
+      if (cmd->cmd == asm_Or)
+        X64(code, 0x48, 0x09, 0xd8);                    // OR   RAX, RBX
+      else if (ctx->branchless)
+        X64(code, 0x48, 0x85, 0xd8);                    // TEST RAX, RBX
+      else
+        X64(code, 0x48, 0x21, 0xd8);                    // AND  RAX, RBX
+      x64_emit_push_cc (ctx, code, cc_E);
+      break;
+    case asm_Not:
+      X64(code, 0x58);                                  // POP RAX
+      if (ctx->branchless)
+        X64(code, 0x48, 0x85, 0xc0);                    // TEST RAX, RAX
+      else
+        X64(code, 0x48, 0x83, 0xf8, 0);                 // CMP  RAX, 0
+      x64_emit_push_cc (ctx, code, cc_NE);
+      break;
+    case asm_Fetch:
+      X64(code, 0x48, 0x8b, 0x04, 0x25);                // MOV RAX, [data+8*i]
+      x64_emit_addr (ctx, code, layout->data_addr + 8 * cmd->intval);
+      X64(code, 0x50);                                  // PUSH RAX
+      break;
+    case asm_Store:
+      X64(code, 0x58);                                  // POP RAX
+      X64(code, 0x48, 0x89, 0x04, 0x25);                // MOV [data+8*i], RAX
+      x64_emit_addr (ctx, code, layout->data_addr + 8 * cmd->intval);
+      break;
+    case asm_Tee:
+      X64(code, 0x48, 0x8b, 0x04, 0x24);                // MOV RAX, [RSP]
+      X64(code, 0x48, 0x89, 0x04, 0x25);                // MOV [data+8*i], RAX
+      x64_emit_addr (ctx, code, layout->data_addr + 8 * cmd->intval);
+      break;
+    case asm_Push:
+      X64(code, 0x68);                                  // PUSH imm32
+      x64_emit_u32 (ctx, code, (unsigned) cmd->intval);
+      break;
+    case asm_Prts:
+      x64_emit_prts (ctx, code, layout);
+      break;
+    case asm_Prti:
+      x64_emit_prti (ctx, code, layout);
+      break;
+    case asm_Input:
+      x64_emit_input (ctx, code, layout);
+      break;
+    case asm_HALT:
+      x64_emit_flush (ctx, code, layout);               // _FLUSH_
+      X64(code, 0xb8, 60, 0, 0, 0);                     // MOV RAX, SYS_EXIT
+      X64(code, 0xbf, 0, 0, 0, 0);                      // MOV RDI, 0
+      X64(code, 0x0f, 0x05);                            // SYSCALL
+      break;
+    default:
+      logger(ERROR, "Unknown opcode %d\n", cmd->cmd);
+      opal_abort (ctx, EXIT_FAILURE);
+    }
+}
+
+/// Encode register command other than jumps, as print_reg_cmd() prints it
+static void
+x64_emit_reg (opal_ctx_s *ctx, x64_buf_s *code, const x64_layout_s *layout,
+              reg_cmd_s *reg)
+{
+  switch (reg->cmd)
+    {
+    case reg_PushRax:
+      X64(code, 0x50);
+      break;
+    case reg_PushRbx:
+      X64(code, 0x53);
+      break;
+    case reg_PopRax:
+      X64(code, 0x58);
+      break;
+    case reg_PopRbx:
+      X64(code, 0x5b);
+      break;
+    case reg_MovRbxRax:
+      X64(code, 0x48, 0x89, 0xc3);
+      break;
+    case reg_MovRaxRbx:
+      X64(code, 0x48, 0x89, 0xd8);
+      break;
+    case reg_Test:
+      X64(code, 0x48, 0x85, 0xc0);
+      break;
+    case reg_Cmp:
+      X64(code, 0x48, 0x39, 0xc3);
+      break;
+    case reg_LoadImm:
+      X64(code, 0x48, 0xc7, 0xc0);                      // MOV RAX, imm32
+      x64_emit_u32 (ctx, code, (unsigned) reg->arg);
+      break;
+    case reg_LoadVar:
+      X64(code, 0x48, 0x8b, 0x04, 0x25);                // MOV RAX, [data+8*i]
+      x64_emit_addr (ctx, code, layout->data_addr + 8 * reg->arg);
+      break;
+    case reg_StoreVar:
+      X64(code, 0x48, 0x89, 0x04, 0x25);                // MOV [data+8*i], RAX
+      x64_emit_addr (ctx, code, layout->data_addr + 8 * reg->arg);
+      break;
+    case reg_Op:
+      switch (reg->arg)
+        {
+        case asm_Add:
+          X64(code, 0x48, 0x01, 0xd8);                  // ADD  RAX, RBX
+          break;
+        case asm_Sub:
+          X64(code, 0x48, 0x29, 0xc3);                  // SUB  RBX, RAX
+          X64(code, 0x48, 0x89, 0xd8);                  // MOV  RAX, RBX
+          break;
+        case asm_Mul:
+          X64(code, 0x48, 0x0f, 0xaf, 0xc3);            // IMUL RAX, RBX
+          break;
+        case asm_Div:
+        case asm_Mod:
+          X64(code, 0x48, 0x93);                        // XCHG RAX, RBX
+          X64(code, 0x48, 0x31, 0xd2);                  // XOR  RDX, RDX
+          X64(code, 0x48, 0xf7, 0xfb);                  // IDIV RBX
+          if (reg->arg == asm_Mod)
+            X64(code, 0x48, 0x89, 0xd0);                // MOV  RAX, RDX
+          break;
+        case asm_Negate:
+          X64(code, 0x48, 0xf7, 0xd8);                  // NEG  RAX
+          break;
+        default:
+          if (reg->arg == asm_And)
+            X64(code, 0x48, 0x21, 0xd8);                // AND  RAX, RBX
+          else if (reg->arg == asm_Or)
+            X64(code, 0x48, 0x09, 0xd8);                // OR   RAX, RBX
+          else if (reg->arg == asm_Not)
+            X64(code, 0x48, 0x83, 0xf8, 0);             // CMP  RAX, 0
+          else
+            X64(code, 0x48, 0x39, 0xc3);                // CMP  RBX, RAX
+          if (ctx->branchless)
+            {
+              x64_emit_setcc (ctx, code, x64_false_cc (reg->arg));
+              break;
+            }
+          X64(code, 0xb8, 0, 0, 0, 0);                  // MOV  EAX, isFalse
+          size_t end = x64_emit_jcc (ctx, code, x64_false_cc (reg->arg));
+          X64(code, 0xb8, 1, 0, 0, 0);                  // MOV  EAX, isTrue
+          x64_patch_here (code, end);
+          break;
+        }
+      break;
+    default:
+      logger(ERROR, "Unknown register command %d\n", reg->cmd);
+      opal_abort (ctx, EXIT_FAILURE);
+    }
 }
 
 /**
- * @brief Print assembly code list to HTML report file
+ * @brief          Write static ELF executable from assembly code list
  *
- * @param       cmd_list    Assembly command list to print
- * @param       dest_fp   Destination HTML reportfile pointer
+ * @details        Encodes each command as the x86-64 instructions of its
+ * macro in res/header.asm, resolves labels, and writes an executable with a
+ * read/execute code segment at NATIVE_TEXT_ADDR and a read/write data
+ * segment on the page after it. Addresses of data are emitted as offsets
+ * and relocated once the size of the code is known, so code and data may
+ * together take up to NATIVE_ADDR_END. The executable needs neither libc
+ * nor the dynamic linker.
  *
- * @return      Function exit code
+ * @param cmd_list Assembly command list
+ * @param dest_fn  Destination binary file name
  *
- * @retval      EXIT_SUCCESS    On success
- * @retval      EXIT_FAILURE    On error
+ * @return         Function exit code
+ *
+ * @retval         EXIT_SUCCESS    On success
+ * @retval         EXIT_FAILURE    On error
+ * @retval         errno           On system call failure
  */
 short
-print_asm_code_html (asm_cmd_e cmd_list[], FILE *dest_fp)
+gen_native_bin (opal_ctx_s *ctx, asm_cmd_e cmd_list[], char *dest_fn)
 {
   logger(DEBUG, "=== START ===");
 
-  fprintf (dest_fp, "<h3>0-address stack machine code by Code generator "
-           "<code>GENIE</code></h3>\n<hr>\n");
+  /// Assert destination file name is not null
+  assert(dest_fn);
 
-  fprintf (dest_fp,
-           "<textarea style='resize: none;' readonly rows='25' cols='80'>");
+  x64_buf_s code = { 0 };
+  x64_buf_s data = { 0 };
+  x64_layout_s layout = { 0 };
+  x64_layout_data (ctx, &data, &layout);
+  logger(DEBUG, "Data segment: %u bytes in file, %u bytes in memory",
+         layout.file_len, layout.mem_len);
+
+  /// Command of each label, for jumps to find their label's code offset
+  label_map_s label_cmd = { 0 };
+  label_map_init (ctx, &label_cmd, ctx->asm_cmd_list_len);
+
+  /// Code offsets of labels, and jumps to resolve once all are known
+  size_t *label_off = calloc (ctx->asm_cmd_list_len + 1, sizeof(size_t));
+  size_t *jump_at = calloc (ctx->asm_cmd_list_len + 1, sizeof(size_t));
+  int *jump_cmd = calloc (ctx->asm_cmd_list_len + 1, sizeof(int));
+  int jump_len = 0;
+  if (!label_off || !jump_at || !jump_cmd)
+    {
+      perror ("calloc(labels)");
+      label_map_free (&label_cmd);
+      free (label_off);
+      free (jump_at);
+      free (jump_cmd);
+      return (errno);
+    }
 
-  int i = 0;
-  logger(DEBUG, "Print ASM user code to HTML");
-  for (i = 0; i < asm_cmd_list_len; i++)
+  /// Header of header.asm starts user code with a NOP
+  X64(&code, 0x90);
+
+  reg_cmd_s *reg_list = NULL;
+  int reg_len = gen_reg_code (ctx, cmd_list, &reg_list);
+
+  logger(DEBUG, "Encode ASM user code");
+  for (int r = 0; r < reg_len; r++)
     {
-      switch (asm_cmd_list[i].cmd)
+      reg_cmd_s *reg = &reg_list[r];
+      asm_cmd_e *cmd = &cmd_list[reg->arg];
+      if (reg->cmd != reg_Cmd)
+        {
+          if (reg->cmd == reg_Jz || reg->cmd == reg_Jnz
+              || reg->cmd == reg_Jcc)
+            {
+              jump_at[jump_len] = x64_emit_jcc (ctx, &code,
+                                                reg->cmd == reg_Jcc
+                                                    ? x64_jump_cc (cmd->cmd)
+                                                    : reg->cmd == reg_Jz ? cc_E
+                                                    : cc_NE);
+              jump_cmd[jump_len++] = reg->arg;
+            }
+          else
+            x64_emit_reg (ctx, &code, &layout, reg);
+          continue;
+        }
+
+      switch (cmd->cmd)
         {
-        case asm_Fetch:
-        case asm_Store:
-        case asm_Push:
-          fprintf (dest_fp, "  %s\t%d\n", asm_cmds[asm_cmd_list[i].cmd],
-                   asm_cmd_list[i].intval);
-          break;
-        case asm_Add:
-        case asm_Sub:
-        case asm_Negate:
-        case asm_Mul:
-        case asm_Div:
-        case asm_Mod:
-        case asm_Eq:
-        case asm_Neq:
-        case asm_Lss:
-        case asm_Gtr:
-        case asm_Leq:
-        case asm_Geq:
-        case asm_And:
-        case asm_Or:
-        case asm_Not:
-        case asm_Prts:
-        case asm_Input:
-        case asm_Prti:
-        case asm_HALT:
-          fprintf (dest_fp, "  %s\n", asm_cmds[asm_cmd_list[i].cmd]);
-          break;
         case asm_Label:
-          fprintf (dest_fp, "%s:\n", asm_cmd_list[i].label);
+          label_off[reg->arg] = code.len;
+          if (label_map_get (&label_cmd, cmd->label, -1) < 0)
+            *label_map_at (&label_cmd, cmd->label) = reg->arg;
           break;
         case asm_Jz:
+        case asm_Jnz:
+          X64(&code, 0x58, 0x48, 0x83, 0xf8, 0);        // POP, CMP RAX, 0
+          jump_at[jump_len] = x64_emit_jcc (ctx, &code,
+                                            cmd->cmd == asm_Jz ? cc_E : cc_NE);
+          jump_cmd[jump_len++] = reg->arg;
+          break;
+        case asm_Jeq:
+        case asm_Jneq:
+        case asm_Jlss:
+        case asm_Jgtr:
+        case asm_Jleq:
+        case asm_Jgeq:
+          X64(&code, 0x5b, 0x58, 0x48, 0x39, 0xd8);     // POP, POP, CMP
+          jump_at[jump_len] = x64_emit_jcc (ctx, &code, x64_jump_cc (cmd->cmd));
+          jump_cmd[jump_len++] = reg->arg;
+          break;
         case asm_Jmp:
-          fprintf (dest_fp, "  %s\t\t%s\n", asm_cmds[asm_cmd_list[i].cmd],
-                   asm_cmd_list[i].label);
+          jump_at[jump_len] = x64_emit_jmp (ctx, &code);
+          jump_cmd[jump_len++] = reg->arg;
           break;
         default:
-          fprintf(stderr, "Unknown opcode %d\n", asm_cmd_list[i].cmd);
-          exit (opal_exit (EXIT_FAILURE));
+          x64_emit_cmd (ctx, &code, &layout, cmd);
         }
     }
+  free (reg_list);
   _DONE;
 
-  /// Create strings and their lengths
-  fprintf (dest_fp, "  ; === Strings ===;\n");
-  for (i = 0; i < strs_len; i++)
+  /// Resolve jumps to labels
+  ctx->retVal = EXIT_SUCCESS;
+  for (int j = 0; j < jump_len; j++)
     {
-      fprintf (dest_fp, "  msg%d: DB \"", i);
-      /// Read each string character
-      int j = 0;
-      for (j = 0; j < strlen (strs[i]); j++)
+      char *label = cmd_list[jump_cmd[j]].label;
+      int i = label_map_get (&label_cmd, label, -1);
+      if (i < 0)
         {
-          ///print ASCII values for newlines
-          if (strs[i][j] == '\\' && strs[i][j + 1] == 'n')
-            {
-              fprintf (dest_fp, "\", 13, 10, \"");
-              j = j + 1;
-            }
-
-          /// directly print all other characters
-          else
-            fprintf (dest_fp, "%c", strs[i][j]);
+          logger(ERROR, "Undefined label: %s", label);
+          fprintf (stderr, "Undefined label: %s\n", label);
+          ctx->retVal = EXIT_FAILURE;
+          break;
         }
-
-      /// NULL terminate string
-      fprintf (dest_fp, "\", NULL\n");
-
-      /// Print string length
-      fprintf (dest_fp, "  len%d EQU $ - msg%d\n", i, i);
+      x64_patch (&code, jump_at[j], label_off[i]);
+    }
+  label_map_free (&label_cmd);
+  free (label_off);
+  free (jump_at);
+  free (jump_cmd);
+
+  /// ELF header and program headers, code follows them in the first segment
+  Elf64_Ehdr ehdr = { 0 };
+  Elf64_Phdr phdr[3] = { 0 };
+  size_t text_off = sizeof(ehdr) + sizeof(phdr);
+  size_t text_end = text_off + code.len;
+  size_t data_off = (text_end + 0xfff) & ~(size_t) 0xfff;
+
+  size_t data_addr = NATIVE_TEXT_ADDR + data_off;
+
+  if (ctx->retVal == EXIT_SUCCESS
+      && data_addr + layout.mem_len > NATIVE_ADDR_END)
+    {
+      logger(ERROR, "Code of %zu bytes and data of %u bytes do not fit below "
+             "%#lx", code.len, layout.mem_len, NATIVE_ADDR_END);
+      fprintf (stderr, "Program too large for native backend\n");
+      ctx->retVal = EXIT_FAILURE;
+    }
+  if (ctx->retVal != EXIT_SUCCESS)
+    {
+      x64_buf_free (&code);
+      x64_buf_free (&data);
+      return (ctx->retVal);
     }
 
-  if (strs_len > 0)
+  /// Data segment starts on the page after the code, now that it is placed
+  logger(DEBUG, "Data segment at %#zx", data_addr);
+  x64_relocate (&code, data_addr);
+  x64_relocate (&data, data_addr);
+
+  memcpy (ehdr.e_ident, ELFMAG, SELFMAG);
+  ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+  ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  ehdr.e_type = ET_EXEC;
+  ehdr.e_machine = EM_X86_64;
+  ehdr.e_version = EV_CURRENT;
+  ehdr.e_entry = NATIVE_TEXT_ADDR + text_off;
+  ehdr.e_phoff = sizeof(ehdr);
+  ehdr.e_ehsize = sizeof(ehdr);
+  ehdr.e_phentsize = sizeof(Elf64_Phdr);
+  ehdr.e_phnum = 3;
+
+  phdr[0].p_type = PT_LOAD;
+  phdr[0].p_flags = PF_R | PF_X;
+  phdr[0].p_vaddr = phdr[0].p_paddr = NATIVE_TEXT_ADDR;
+  phdr[0].p_filesz = phdr[0].p_memsz = text_end;
+  phdr[0].p_align = 0x1000;
+
+  phdr[1].p_type = PT_LOAD;
+  phdr[1].p_flags = PF_R | PF_W;
+  phdr[1].p_offset = data_off;
+  phdr[1].p_vaddr = phdr[1].p_paddr = data_addr;
+  phdr[1].p_filesz = layout.file_len;
+  phdr[1].p_memsz = layout.mem_len;
+  phdr[1].p_align = 0x1000;
+
+  /// Non-executable stack
+  phdr[2].p_type = PT_GNU_STACK;
+  phdr[2].p_flags = PF_R | PF_W;
+  phdr[2].p_align = 16;
+
+  /// Create executable, permissions as ld gives them subject to umask
+  sprintf (ctx->perror_msg, "open('%s', O_WRONLY | O_CREAT | O_TRUNC)",
+           dest_fn);
+  logger(DEBUG, ctx->perror_msg);
+  errno = EXIT_SUCCESS;
+  int dest_fd = open (dest_fn, O_WRONLY | O_CREAT | O_TRUNC, 0777);
+  FILE *dest_fp = dest_fd >= 0 ? fdopen (dest_fd, "wb") : NULL;
+  if (dest_fp)
+    _PASS;
+  else
     {
-      /// Print string array
-      fprintf (dest_fp, "  strs: DQ ");
-      for (i = 0; i < strs_len; i++)
-        fprintf (dest_fp, "msg%d, ", i);
+      perror (ctx->perror_msg);
+      _FAIL;
+      if (dest_fd >= 0)
+        close (dest_fd);
+      x64_buf_free (&code);
+      x64_buf_free (&data);
+      return (errno);
+    }
 
-      fprintf (dest_fp, "\n");
+  fwrite (&ehdr, sizeof(ehdr), 1, dest_fp);
+  fwrite (phdr, sizeof(phdr), 1, dest_fp);
+  fwrite (code.data, 1, code.len, dest_fp);
+  for (size_t pad = text_end; pad < data_off; pad++)
+    fputc (0, dest_fp);
+  fwrite (data.data, 1, data.len, dest_fp);
+  x64_buf_free (&code);
+  x64_buf_free (&data);
+
+  sprintf (ctx->perror_msg, "fclose(dest_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (ferror (dest_fp) == 0 && fclose (dest_fp) == EXIT_SUCCESS)
+    _PASS;
+  else
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+      return (errno ? errno : EXIT_FAILURE);
+    }
 
-      /// ...and length array
-      fprintf (dest_fp, "  lens: DQ ");
-      for (i = 0; i < strs_len; i++)
-        fprintf (dest_fp, "len%d, ", i);
+  logger(DEBUG, "Wrote %zu bytes of code to %s", text_end - text_off,
+         dest_fn);
+  logger(DEBUG, "=== END ===");
+  return EXIT_SUCCESS;
+}
 
-      fprintf (dest_fp, "\n");
-    }
+/**
+ * @brief           Run an executable with redirected standard streams
+ *
+ * @details         The executable is run without a shell, so file names are
+ * taken as they are. An alarm set before execv() is kept by the executable
+ * and kills it after VERIFY_TIMEOUT seconds. The child process only makes
+ * async-signal-safe calls, as batch jobs of other threads may hold locks.
+ *
+ * @param bin_fn    Executable file name
+ * @param input_fn  File for standard input
+ * @param out_fn    File for standard output
+ * @return          Exit status of executable, or -1 if it did not exit
+ */
+static int
+run_bin (opal_ctx_s *ctx, char *bin_fn, char *input_fn, char *out_fn)
+{
+  sprintf (ctx->perror_msg, "run('%s' < '%s' > '%s')", bin_fn, input_fn,
+           out_fn);
+  logger(DEBUG, ctx->perror_msg);
 
-  /// Create integers array
-  if (vars_len > 0)
+  pid_t pid = fork ();
+  if (pid == 0)
     {
-      logger(DEBUG, "Create data array of length: %d", vars_len);
-      fprintf (dest_fp, "  ; === Integers ===;\n  data  TIMES %d DQ 0\n",
-               vars_len);
+      int in_fd = open (input_fn, O_RDONLY);
+      int out_fd = open (out_fn, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (in_fd < 0 || out_fd < 0 || dup2 (in_fd, STDIN_FILENO) < 0
+          || dup2 (out_fd, STDOUT_FILENO) < 0)
+        _exit (127);
+      close (in_fd);
+      close (out_fd);
+
+      char *argv[] = { bin_fn, NULL };
+      alarm (VERIFY_TIMEOUT);
+      execv (bin_fn, argv);
+      _exit (127);
     }
 
-  fprintf (dest_fp, "</textarea>");
-  logger(DEBUG, "=== END ===");
+  int status = 0;
+  pid_t done = -1;
+  if (pid > 0)
+    while ((done = waitpid (pid, &status, 0)) < 0 && errno == EINTR)
+      ;
 
-  return EXIT_SUCCESS;
+  if (done < 0)
+    {
+      perror (ctx->perror_msg);
+      _FAIL;
+      return -1;
+    }
+  if (!WIFEXITED(status))
+    {
+      logger(DEBUG, "Executable did not exit, status: %d", status);
+      return -1;
+    }
+  _PASS;
+  return WEXITSTATUS(status);
 }
 
 /**
- * @brief       Get index of an identifier in array, add if missing
+ * @brief           Run native and NASM built executables, compare behaviour
  *
- * @param[in]   ident_curr   identifier to get index for
+ * @details         Both executables are run with standard input from
+ * input_fn and must produce the same standard output and exit status. The
+ * outputs are kept in '<bin>.out' files for inspection when they differ.
  *
- * @return      index of identifier in the array
+ * @param native_fn Executable written by gen_native_bin()
+ * @param nasm_fn   Executable built with gen_obj() and gen_bin()
+ * @param input_fn  Standard input of both runs, /dev/null if NULL
+ *
+ * @return          Function exit code
+ *
+ * @retval          EXIT_SUCCESS    If behaviour is identical
+ * @retval          EXIT_FAILURE    If behaviour differs
  */
-int
-add_var (char *ident_curr)
+short
+verify_native_bin (opal_ctx_s *ctx, char *native_fn, char *nasm_fn,
+                   char *input_fn)
 {
-  /// If identifier array is not empty
-  if (vars_len > 0)
+  logger(DEBUG, "=== START ===");
+
+  /// Assert executable file names are not null
+  assert(native_fn);
+  assert(nasm_fn);
+  if (input_fn == NULL)
+    input_fn = "/dev/null";
+
+  char native_out[1024] = { 0 };
+  char nasm_out[1024] = { 0 };
+  snprintf (native_out, sizeof(native_out), "%s.out", native_fn);
+  snprintf (nasm_out, sizeof(nasm_out), "%s.out", nasm_fn);
+
+  int native_status = run_bin (ctx, native_fn, input_fn, native_out);
+  int nasm_status = run_bin (ctx, nasm_fn, input_fn, nasm_out);
+  logger(DEBUG, "Exit status native: %d, nasm: %d", native_status,
+         nasm_status);
+
+  /// Compare standard output byte by byte
+  bool same = native_status == nasm_status;
+  FILE *native_fp = fopen (native_out, "r");
+  FILE *nasm_fp = fopen (nasm_out, "r");
+  if (!native_fp || !nasm_fp)
+    same = false;
+  else
     {
-      /// Search it for the current identifier
-      int i = 0;
-      for (i = 0; i < vars_len; i++)
+      int a = 0, b = 0;
+      do
         {
-          /// and return its index if found
-          if (strcmp (ident_curr, vars[i]) == 0)
-            {
-              logger(DEBUG, "Identifier '%s' found at index %d.", ident_curr,
-                     i);
-              return i;
-            }
+          a = fgetc (native_fp);
+          b = fgetc (nasm_fp);
         }
+      while (a == b && a != EOF);
+      if (a != b)
+        same = false;
     }
+  if (native_fp)
+    fclose (native_fp);
+  if (nasm_fp)
+    fclose (nasm_fp);
 
-  int index = vars_len;
-  /// Otherwise append the identifier to the array
-  logger(DEBUG, "Created new identifier '%s' at index %d.", ident_curr, index);
-  vars[vars_len++] = strdup (ident_curr);
+  if (!same)
+    {
+      logger(ERROR, "Native executable %s differs from NASM executable %s",
+             native_fn, nasm_fn);
+      fprintf (stderr, "Native and NASM executables differ, exit status %d "
+               "and %d, output in %s and %s\n", native_status, nasm_status,
+               native_out, nasm_out);
+      _FAIL;
+      return EXIT_FAILURE;
+    }
 
-  /// and return its index
-  return index;
+  remove (native_out);
+  remove (nasm_out);
+  _PASS;
+  logger(DEBUG, "=== END ===");
+  return EXIT_SUCCESS;
 }
 
+/*
+ * ==================================
+ * START INTERPRETER FUNCTION DEFINITIONS
+ * ==================================
+ */
+
+/*
+ * The interpreter executes the assembly code list without building an
+ * executable. vm_load() drops labels, resolves each jump to the index of its
+ * target and checks the stack depth of every instruction, so vm_run() needs
+ * neither label lookups nor stack bound checks. vm_run() is direct threaded:
+ * each instruction holds the address of its handler, and every handler ends
+ * by jumping to the handler of the next instruction with a computed goto.
+ * Runtime behaviour is that of the macros in res/header.asm, as for the
+ * native backend.
+ */
+
+/// Stack effect of a command: values popped and pushed
+typedef struct vm_effect
+{
+  signed char pop;      ///< Values popped, -1 if command can not be executed
+  signed char push;     ///< Values pushed
+} vm_effect_s;
+
+/// Stack effect of each command, indexed by asm_code_e
+static const vm_effect_s vm_effect[] =
+  {
+    [asm_NOP] = { 0, 0 }, [asm_EOF] = { -1, 0 }, [asm_Ident] = { -1, 0 },
+    [asm_Int] = { -1, 0 }, [asm_String] = { -1, 0 }, [asm_Assign] = { -1, 0 },
+    [asm_Add] = { 2, 1 }, [asm_Sub] = { 2, 1 }, [asm_Negate] = { 1, 1 },
+    [asm_Mul] = { 2, 1 }, [asm_Div] = { 2, 1 }, [asm_Mod] = { 2, 1 },
+    [asm_Eq] = { 2, 1 }, [asm_Neq] = { 2, 1 }, [asm_Lss] = { 2, 1 },
+    [asm_Gtr] = { 2, 1 }, [asm_Leq] = { 2, 1 }, [asm_Geq] = { 2, 1 },
+    [asm_And] = { 2, 1 }, [asm_Or] = { 2, 1 }, [asm_Not] = { 1, 1 },
+    [asm_Fetch] = { 0, 1 }, [asm_Store] = { 1, 0 }, [asm_Push] = { 0, 1 },
+    [asm_Jmp] = { 0, 0 }, [asm_Jz] = { 1, 0 }, [asm_Jnz] = { 1, 0 },
+    [asm_Prts] = { 1, 0 }, [asm_Prti] = { 1, 0 }, [asm_HALT] = { 0, 0 },
+    [asm_Label] = { 0, 0 }, [asm_Input] = { 1, 1 }, [asm_Tee] = { 1, 1 },
+    [asm_Jeq] = { 2, 0 }, [asm_Jneq] = { 2, 0 }, [asm_Jlss] = { 2, 0 },
+    [asm_Jgtr] = { 2, 0 }, [asm_Jleq] = { 2, 0 }, [asm_Jgeq] = { 2, 0 },
+  };
+
 /**
- * @brief       Get index of a string in array, add if missing
+ * @brief       Find maximum stack depth of program
  *
- * @param[in]   str_curr   string to get index for
+ * @details     Walks every path of the program from its first instruction.
+ * Code generated by GENIE has the same depth on every path into an
+ * instruction and never pops an empty stack; a program that does not is
+ * rejected, as vm_run() does not check stack bounds.
  *
- * @return      index of string in the array
+ * @param[in,out] prog  Program, stack_len is set
+ * @return      EXIT_SUCCESS, or EXIT_FAILURE if stack use is not consistent
  */
-int
-add_str (char *str_curr)
+static short
+vm_check_stack (opal_ctx_s *ctx, vm_prog_s *prog)
 {
-  /// If string array is not empty
-  if (strs_len > 0)
+  int *depth = malloc (prog->code_len * sizeof(int));
+  unsigned *work = malloc (prog->code_len * sizeof(unsigned));
+  if (!depth || !work)
+    {
+      perror ("malloc(depth)");
+      free (depth);
+      free (work);
+      return EXIT_FAILURE;
+    }
+  for (unsigned i = 0; i < prog->code_len; i++)
+    depth[i] = -1;
+
+  /// Each instruction enters the work list once, when its depth is found
+  unsigned work_len = 0;
+  int max = 0;
+  depth[0] = 0;
+  work[work_len++] = 0;
+  while (work_len > 0)
     {
-      /// Search it for the current string
-      int i = 0;
-      for (i = 0; i < strs_len; i++)
+      unsigned i = work[--work_len];
+      vm_insn_s *insn = &prog->code[i];
+      if (depth[i] < vm_effect[insn->cmd].pop)
+        {
+          logger(ERROR, "Stack underflow at instruction %u (%s)", i,
+                 asm_cmds[insn->cmd]);
+          max = -1;
+          work_len = 0;
+          break;
+        }
+      int out = depth[i] - vm_effect[insn->cmd].pop
+          + vm_effect[insn->cmd].push;
+      if (out > max)
+        max = out;
+
+      /// Successors: next instruction unless jump or halt, and jump target
+      unsigned next[2] = { 0 };
+      int next_len = 0;
+      if (insn->cmd != asm_Jmp && insn->cmd != asm_HALT)
+        next[next_len++] = i + 1;
+      if (asm_is_jump (insn->cmd))
+        next[next_len++] = insn->arg;
+      for (int n = 0; n < next_len; n++)
         {
-          /// and return its index if found
-          if (strcmp (str_curr, strs[i]) == 0)
+          if (depth[next[n]] == -1)
+            {
+              depth[next[n]] = out;
+              work[work_len++] = next[n];
+            }
+          else if (depth[next[n]] != out)
             {
-              logger(DEBUG, "Identifier '%s' found at index %d.", str_curr, i);
-              return i;
+              logger(ERROR, "Stack depth %d and %d at instruction %u", out,
+                     depth[next[n]], next[n]);
+              max = -1;
+              work_len = 0;
+              break;
             }
         }
     }
 
-  int index = strs_len;
-  /// Otherwise append the string to the array
-  logger(DEBUG, "Created new identifier '%s' at index %d.", str_curr, index);
-  strs[strs_len++] = strdup (str_curr);
-
-  /// and return its index
-  return index;
+  short result = work_len == 0 && max >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  free (depth);
+  free (work);
+  prog->stack_len = max + 1;
+  logger(DEBUG, "Maximum stack depth: %d", max);
+  return result;
 }
 
 /**
- * @brief Free vars & strs arrays used for generating assembly code
- * @param NONE
+ * @brief          Load assembly code list into a program for the interpreter
+ *
+ * @details        Labels are dropped and jumps hold the index of the
+ * instruction that followed their label, looked up in a label map so
+ * loading is linear in the number of commands. Strings are stored as the native
+ * backend stores them: "\n" as CR LF, followed by a NULL counted in their
+ * length. A HALT is appended, so execution can not run past the end.
+ *
+ * @param cmd_list Assembly command list
+ *
+ * @return         Program to pass to vm_run(), or NULL on error
  */
-short
-free_asm_arrays ()
+vm_prog_s*
+vm_load (opal_ctx_s *ctx, asm_cmd_e cmd_list[])
 {
+  logger(DEBUG, "=== START ===");
 
-  /// Walk the list of vars & free as needed
-  int i = 0;
-  for (i = 0; i < vars_len; i++)
+  /// Instruction each label points to
+  label_map_s label_insn = { 0 };
+  label_map_init (ctx, &label_insn, ctx->asm_cmd_list_len);
+
+  vm_prog_s *prog = calloc (1, sizeof(vm_prog_s));
+  if (prog)
+    {
+      prog->code = calloc (ctx->asm_cmd_list_len + 1, sizeof(vm_insn_s));
+      prog->strs = calloc (ctx->strs_len + 1, sizeof(char*));
+      prog->str_lens = calloc (ctx->strs_len + 1, sizeof(long));
+    }
+  if (!prog || !prog->code || !prog->strs || !prog->str_lens)
     {
-      if (vars[i])
+      perror ("calloc(vm_prog)");
+      label_map_free (&label_insn);
+      vm_free (prog);
+      return NULL;
+    }
+  prog->vars_len = ctx->vars_len;
+
+  /// Copy commands without labels, noting where each label points
+  for (int i = 0; i < ctx->asm_cmd_list_len; i++)
+    {
+      asm_cmd_e *cmd = &cmd_list[i];
+      if (cmd->cmd == asm_Label)
+        {
+          if (label_map_get (&label_insn, cmd->label, -1) < 0)
+            *label_map_at (&label_insn, cmd->label) = prog->code_len;
+          continue;
+        }
+      if (cmd->cmd == asm_NOP)
+        continue;
+      if (cmd->cmd >= sizeof(vm_effect) / sizeof(vm_effect[0])
+          || vm_effect[cmd->cmd].pop < 0)
         {
-          free (vars[i]);
-          vars[i] = NULL;
+          logger(ERROR, "Unknown opcode %d", cmd->cmd);
+          fprintf (stderr, "Unknown opcode %d\n", cmd->cmd);
+          goto fail;
         }
+      prog->code[prog->code_len].cmd = cmd->cmd;
+      prog->code[prog->code_len++].arg = cmd->intval;
     }
+  prog->code[prog->code_len++].cmd = asm_HALT;
 
-  /// Walk the list of strs & free as needed
-  for (i = 0; i < strs_len; i++)
+  /// Resolve jumps to labels, second pass as jumps may point forward
+  unsigned insn = 0;
+  for (int i = 0; i < ctx->asm_cmd_list_len; i++)
     {
-      if (strs[i])
+      asm_cmd_e *cmd = &cmd_list[i];
+      if (cmd->cmd == asm_Label || cmd->cmd == asm_NOP)
+        continue;
+      if (asm_is_jump (cmd->cmd))
         {
-          free (strs[i]);
-          strs[i] = NULL;
+          int target = label_map_get (&label_insn, cmd->label, -1);
+          if (target < 0)
+            {
+              logger(ERROR, "Undefined label: %s", cmd->label);
+              fprintf (stderr, "Undefined label: %s\n", cmd->label);
+              goto fail;
+            }
+          prog->code[insn].arg = target;
         }
+      insn++;
     }
+  label_map_free (&label_insn);
 
-  /// Walk the list of ASM commands & free as needed
-  for (i = 0; i < asm_cmd_list_len; i++)
+  /// Strings, with "\n" stored as 13, 10 like print_asm_code() does
+  for (int i = 0; i < ctx->strs_len; i++)
     {
-      if (asm_cmd_list[i].label)
+      char *str = malloc (2 * strlen (ctx->strs[i]) + 1);
+      if (str == NULL)
         {
-          free (asm_cmd_list[i].label);
-          asm_cmd_list[i].label = NULL;
+          perror ("malloc(str)");
+          goto fail;
         }
+      long len = 0;
+      for (int j = 0; ctx->strs[i][j]; j++)
+        {
+          if (ctx->strs[i][j] == '\\' && ctx->strs[i][j + 1] == 'n')
+            {
+              str[len++] = 13;
+              str[len++] = 10;
+              j = j + 1;
+            }
+          else
+            str[len++] = ctx->strs[i][j];
+        }
+      str[len++] = '\0';
+      prog->strs[i] = str;
+      prog->str_lens[i] = len;
+      prog->strs_len = i + 1;
     }
 
-  return EXIT_SUCCESS;
+  if (vm_check_stack (ctx, prog) != EXIT_SUCCESS)
+    {
+      fprintf (stderr, "Program uses stack inconsistently\n");
+      goto fail;
+    }
+
+  logger(DEBUG, "Loaded %u instructions, %u strings, %u variables",
+         prog->code_len, prog->strs_len, prog->vars_len);
+  _PASS;
+  logger(DEBUG, "=== END ===");
+  return prog;
+
+fail:
+  label_map_free (&label_insn);
+  vm_free (prog);
+  _FAIL;
+  return NULL;
 }
 
-/*
- * ==================================
- * START ORCHESTRATOR FUNCTION DEFINITIONS
- * ==================================
+/**
+ * @brief       Free program loaded by vm_load()
+ * @param[in]   prog    Program, may be NULL
  */
+void
+vm_free (vm_prog_s *prog)
+{
+  if (prog == NULL)
+    return;
+  if (prog->strs)
+    for (unsigned i = 0; i < prog->strs_len; i++)
+      free (prog->strs[i]);
+  free (prog->strs);
+  free (prog->str_lens);
+  free (prog->code);
+  free (prog);
+}
+
+/// Write as the SYSCALL of header.asm does, returning count or -errno
+static long
+vm_write (int fd, const void *buf, size_t len)
+{
+  long written = write (fd, buf, len);
+  return written < 0 ? -errno : written;
+}
+
+/// Write bytes in output buffer as _FLUSH_ does, false if write failed
+static bool
+vm_flush (vm_out_s *out)
+{
+  if (out->len == 0)
+    return true;
+  if (vm_write (out->fd, out->buf, out->len) != out->len)
+    return false;
+  out->len = 0;
+  return true;
+}
+
+/// Append bytes to output buffer as O_PRTS does, false if a flush failed
+static bool
+vm_print (vm_out_s *out, const void *bytes, long len)
+{
+  const unsigned char *src = bytes;
+  while (len > 0)
+    {
+      if (out->len == OBUF_SIZE && !vm_flush (out))
+        return false;
+      long copy = OBUF_SIZE - out->len < len ? OBUF_SIZE - out->len : len;
+      memcpy (out->buf + out->len, src, copy);
+      out->len += copy;
+      src += copy;
+      len -= copy;
+    }
+  return true;
+}
 
 /**
- * @brief          Assemble object file using NASM
- * @param asm_fn   Assembly source file name
- * @param obj_fn   Object destination file name
+ * @brief       Read a line and convert it to an integer as _INPUT_ does
+ *
+ * @details     Bytes are taken from the input buffer, which is refilled with
+ * a read of up to IBUF_SIZE bytes when empty, up to and including the
+ * newline. Bytes after it are kept for the next call. Output is flushed
+ * before each read. A leading '-' negates, conversion stops at the first non
+ * digit and the rest of the line is skipped. End of file or a failed read
+ * ends the line.
+ *
+ * @param[in]   in      Input buffer
+ * @param[in]   out     Output buffer, flushed before reading
+ * @param[out]  value   Integer read
+ * @return      false if flushing output failed
  */
-short
-gen_obj (char *asm_fn, char *obj_fn)
+static bool
+vm_input (vm_in_s *in, vm_out_s *out, long *value)
 {
-    logger(DEBUG, "=== START ===");
-    /// Assert assembly file name is not null
-    assert(asm_fn);
-    /// Assert object file name is not null
-    assert(obj_fn);
-    /// Check if asm_fn can be read
-    sprintf(perror_msg, "access (%s, R_OK)", asm_fn);
-    logger(DEBUG, perror_msg);
-    errno = EXIT_SUCCESS;
-    if (access (asm_fn, R_OK) == EXIT_SUCCESS)
+  unsigned long result = 0;
+  bool negative = false;
+  int stage = 0;                ///< 0 at start of line, 1 in digits, 2 after
+  for (;;)
     {
-        _PASS;
-        /// Create the NASM call with -g, -f and -o flags
-        logger(DEBUG, "Calling NASM to assemble object.");
-        char nasm_cmd[1024] = { 0 };
-        sprintf (nasm_cmd, "nasm -g -f elf64 -o %s %s", obj_fn, asm_fn);
-        logger(DEBUG, nasm_cmd);
-        int sys_call = system (nasm_cmd);
-        if (sys_call == EXIT_SUCCESS)
+      if (in->pos == in->end)
         {
-            _PASS;
-            /// Check if obj_fn can be read
-            sprintf (perror_msg, "access (%s, R_OK)", obj_fn);
-            logger(DEBUG, perror_msg);
-            errno = EXIT_SUCCESS;
-            if (access (obj_fn, R_OK) == EXIT_SUCCESS)
-                _PASS;
-            else
+          if (!vm_flush (out))
+            return false;
+          in->pos = 0;
+          in->end = read (in->fd, in->buf, IBUF_SIZE);
+          if (in->end <= 0)
             {
-                perror (perror_msg);
-                _FAIL;
-                return (errno);
+              in->end = 0;
+              break;
             }
         }
-        else
-        {
-            perror (nasm_cmd);
-            _FAIL;
-            return (sys_call);
-        }
-    }
-    else
-    {
-        perror (perror_msg);
-        _FAIL;
-        return (errno);
+      unsigned char ch = in->buf[in->pos++];
+      if (ch == '\n')
+        break;
+      if (stage == 0 && ch == '-')
+        negative = true;
+      else if (stage <= 1 && ch >= '0' && ch <= '9')
+        result = result * 10 + (ch - '0');
+      else
+        stage = 2;
+      if (stage == 0)
+        stage = 1;
     }
-    logger(DEBUG, "=== END ===");
-    return EXIT_SUCCESS;
+  *value = negative ? -result : result;
+  return true;
 }
 
-
 /**
- * @brief           Link object using LD
- * @param obj_fn    Source object file name
- * @param dest_fn   Destination binary file name
+ * @brief         Execute program loaded by vm_load()
+ *
+ * @details       The first run sets the handler address of each instruction,
+ * so a program must not be run by two threads at once until it has been run
+ * once. Values are 64 bit and wrap on overflow. Output is buffered as in
+ * header.asm, and written when the buffer fills, before input is read and
+ * at HALT. A failed write ends the program with the exit status HALT RAX of
+ * header.asm gives it. Division by zero or overflow of division, which raise
+ * SIGFPE in the executable, end the program with status 128 + SIGFPE, as a
+ * shell reports for it, and lose output still in the buffer as it does.
+ *
+ * @param prog    Program
+ * @param in_fd   File descriptor read by input()
+ * @param out_fd  File descriptor written by print()
+ *
+ * @return        Exit status of program
  */
-short
-gen_bin (char *obj_fn, char *dest_fn)
+int
+vm_run (opal_ctx_s *ctx, vm_prog_s *prog, int in_fd, int out_fd)
 {
   logger(DEBUG, "=== START ===");
 
-  /// Assert object file name is not null
-  assert(obj_fn);
-
-  /// Assert destination file name is not null
-  assert(dest_fn);
-
-  /// Call to linker
-  logger(DEBUG, "Calling LD to link object.");
-  char LD_cmd[1024] = { 0 };
-  sprintf(LD_cmd, "ld -m elf_x86_64 -o %s -lc -I/lib64/ld-linux-x86-64.so.2 %s", dest_fn, obj_fn);
-
-  /// Confirm obj_fn can be read
-  logger(DEBUG, "access(obj_fn, R_OK)");
-  errno = EXIT_SUCCESS;
-  if (access(obj_fn, R_OK) == 0)
+  /// Handler of each command, indexed by asm_code_e
+  static const void *const handler[] =
     {
+      [asm_Add] = &&do_add, [asm_Sub] = &&do_sub,
+      [asm_Negate] = &&do_negate, [asm_Mul] = &&do_mul,
+      [asm_Div] = &&do_div, [asm_Mod] = &&do_mod, [asm_Eq] = &&do_eq,
+      [asm_Neq] = &&do_neq, [asm_Lss] = &&do_lss, [asm_Gtr] = &&do_gtr,
+      [asm_Leq] = &&do_leq, [asm_Geq] = &&do_geq, [asm_And] = &&do_and,
+      [asm_Or] = &&do_or, [asm_Not] = &&do_not, [asm_Fetch] = &&do_fetch,
+      [asm_Store] = &&do_store, [asm_Push] = &&do_push,
+      [asm_Jmp] = &&do_jmp, [asm_Jz] = &&do_jz, [asm_Jnz] = &&do_jnz,
+      [asm_Prts] = &&do_prts, [asm_Prti] = &&do_prti,
+      [asm_HALT] = &&do_halt, [asm_Input] = &&do_input,
+      [asm_Tee] = &&do_tee, [asm_Jeq] = &&do_jeq, [asm_Jneq] = &&do_jneq,
+      [asm_Jlss] = &&do_jlss, [asm_Jgtr] = &&do_jgtr, [asm_Jleq] = &&do_jleq,
+      [asm_Jgeq] = &&do_jgeq,
+    };
 
-      /// Use LD to link the obj_fn contents
-      logger(DEBUG, "ld -m elf_x86_64 -o %s -lc -I/lib64/ld-linux-x86-64.so.2 %s", dest_fn, obj_fn);
-      errno = EXIT_SUCCESS;
-      int sys_call = system(LD_cmd);
-
-      /// Confirm successful linking
-      if (sys_call == 0)
-        {
-          /// Confirm dest_fn can be read to and executed
-          logger(DEBUG, "access(obj_fn, R_OK) && access(obj_fn, X_OK)");
-          errno = EXIT_SUCCESS;
-          if ((access(dest_fn, R_OK) == 0) && (access(dest_fn, X_OK) == 0))
-            _PASS;
-
-            /// Return errno if missing permissions on dest_fn
-          else
-            {
-              perror("access(obj_fn, R_OK) && access(obj_fn, X_OK)");
-              return errno;
-            }
-        }
-
-      /// ...or log command if unsuccessful
-      else{
-        perror(LD_cmd);
-        return sys_call;
-      }
+  if (!prog->threaded)
+    {
+      for (unsigned i = 0; i < prog->code_len; i++)
+        prog->code[i].op = handler[prog->code[i].cmd];
+      prog->threaded = true;
     }
 
-  /// ...or missing read permission on obj_fn
-  else
+  long *stack = malloc (prog->stack_len * sizeof(long));
+  long *vars = calloc (prog->vars_len + 1, sizeof(long));
+  vm_in_s *in = malloc (sizeof(vm_in_s));
+  vm_out_s *out = malloc (sizeof(vm_out_s));
+  if (!stack || !vars || !in || !out)
     {
-      perror("access(obj_fn, R_OK)");
-      return errno;
+      perror ("malloc(stack)");
+      free (stack);
+      free (vars);
+      free (in);
+      free (out);
+      return EXIT_FAILURE;
     }
-
+  in->fd = in_fd;
+  in->pos = in->end = 0;
+  out->fd = out_fd;
+  out->len = 0;
+
+  vm_insn_s *const code = prog->code;
+  vm_insn_s *ip = code;         ///< Next instruction
+  long *sp = stack;             ///< Next free stack slot
+  long a = 0, b = 0;
+  int status = EXIT_SUCCESS;
+
+/// Jump to handler of next instruction
+#define VM_NEXT() goto *(ip++)->op
+/// Pop operands b, then a, of a binary operation
+#define VM_POP2() (b = *--sp, a = *--sp)
+
+  VM_NEXT();
+
+do_add:
+  VM_POP2();
+  *sp++ = (unsigned long) a + (unsigned long) b;
+  VM_NEXT();
+do_sub:
+  VM_POP2();
+  *sp++ = (unsigned long) a - (unsigned long) b;
+  VM_NEXT();
+do_negate:
+  sp[-1] = -(unsigned long) sp[-1];
+  VM_NEXT();
+do_mul:
+  VM_POP2();
+  *sp++ = (unsigned long) a * (unsigned long) b;
+  VM_NEXT();
+do_div:
+do_mod:
+  {
+    /// IDIV after XOR RDX: dividend is taken as unsigned, quotient must fit
+    VM_POP2();
+    unsigned long divisor = b < 0 ? -(unsigned long) b : (unsigned long) b;
+    unsigned long quotient = divisor ? (unsigned long) a / divisor : 0;
+    if (divisor == 0 || quotient > (unsigned long) INT64_MAX + (b < 0))
+      {
+        fprintf (stderr, "Floating point exception\n");
+        status = 128 + SIGFPE;
+        goto done;
+      }
+    if (ip[-1].cmd == asm_Mod)
+      *sp++ = (unsigned long) a % divisor;
+    else
+      *sp++ = b < 0 ? -quotient : quotient;
+  }
+  VM_NEXT();
+do_eq:
+  VM_POP2();
+  *sp++ = a == b;
+  VM_NEXT();
+do_neq:
+  VM_POP2();
+  *sp++ = a != b;
+  VM_NEXT();
+do_lss:
+  VM_POP2();
+  *sp++ = a < b;
+  VM_NEXT();
+do_gtr:
+  VM_POP2();
+  *sp++ = a > b;
+  VM_NEXT();
+do_leq:
+  VM_POP2();
+  *sp++ = a <= b;
+  VM_NEXT();
+do_geq:
+  VM_POP2();
+  *sp++ = a >= b;
+  VM_NEXT();
+do_and:
+  VM_POP2();
+  *sp++ = (a & b) != 0;
+  VM_NEXT();
+do_or:
+  VM_POP2();
+  *sp++ = (a | b) != 0;
+  VM_NEXT();
+do_not:
+  sp[-1] = sp[-1] == 0;
+  VM_NEXT();
+do_fetch:
+  *sp++ = vars[ip[-1].arg];
+  VM_NEXT();
+do_store:
+  vars[ip[-1].arg] = *--sp;
+  VM_NEXT();
+do_tee:
+  vars[ip[-1].arg] = sp[-1];
+  VM_NEXT();
+do_push:
+  *sp++ = ip[-1].arg;
+  VM_NEXT();
+do_jmp:
+  ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jz:
+  if (*--sp == 0)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jnz:
+  if (*--sp != 0)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jeq:
+  VM_POP2();
+  if (a == b)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jneq:
+  VM_POP2();
+  if (a != b)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jlss:
+  VM_POP2();
+  if (a < b)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jgtr:
+  VM_POP2();
+  if (a > b)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jleq:
+  VM_POP2();
+  if (a <= b)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_jgeq:
+  VM_POP2();
+  if (a >= b)
+    ip = code + ip[-1].arg;
+  VM_NEXT();
+do_prts:
+  a = *--sp;
+  if (!vm_print (out, prog->strs[a], prog->str_lens[a]))
+    goto write_error;
+  VM_NEXT();
+do_prti:
+  {
+    /// Digits of magnitude as unsigned, so INT64_MIN prints as in _PRTI_
+    char digits[24] = { 0 };
+    int pos = sizeof(digits);
+    unsigned long value = *--sp;
+    bool negative = (long) value < 0;
+    if (negative)
+      value = -value;
+    do
+      {
+        digits[--pos] = '0' + value % 10;
+        value /= 10;
+      }
+    while (value != 0);
+    if (negative)
+      digits[--pos] = '-';
+
+    /// Flush first unless sign and 19 digits fit, then append all at once
+    if (out->len > OBUF_SIZE - 20 && !vm_flush (out))
+      goto write_error;
+    memcpy (out->buf + out->len, digits + pos, sizeof(digits) - pos);
+    out->len += sizeof(digits) - pos;
+  }
+  VM_NEXT();
+do_input:
+  a = sp[-1];
+  if (!vm_print (out, prog->strs[a], prog->str_lens[a])
+      || !vm_input (in, out, &sp[-1]))
+    goto write_error;
+  VM_NEXT();
+do_halt:
+  if (vm_flush (out))
+    {
+      status = EXIT_SUCCESS;
+      goto done;
+    }
+write_error:
+  /// HALT RAX loads SYS_EXIT into RAX before moving RAX to the exit code
+  status = 60;
+
+#undef VM_NEXT
+#undef VM_POP2
+
+done:
+  free (stack);
+  free (vars);
+  free (in);
+  free (out);
+  logger(DEBUG, "Program exit status: %d", status);
   logger(DEBUG, "=== END ===");
-
-  return EXIT_SUCCESS;
+  return status;
 }
@@ -37,6 +37,7 @@ static struct argp_option options[] =       ///< The options we understand
 struct arguments
 {
   char *args[1];     ///< Source file
+  bool debug;        ///< Log debug messages
   char *logfile;     ///< filename for logger
   char *destfile;    ///< filename for destination file
   char *report;      ///< filename for html report
@@ -54,7 +55,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
     {
 
     case 'd':
-      LOG_LEVEL = DEBUG;
+      arguments->debug = true;
       break;
 
     case 'l':
@@ -114,101 +115,111 @@ main (int argc, char **argv)
   /// Parse arguments
   argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
+  /// Create compilation context, else exit program
+  opal_ctx_s *ctx = opal_ctx_new ();
+  if (ctx == NULL)
+    {
+      perror ("opal_ctx_new()");
+      return (EXIT_FAILURE);
+    }
+  if (arguments.debug)
+    ctx->log_level = DEBUG;
+
   /// Populate variables for source, destination, log file
-  source_fn = strdup (arguments.args[0]);
-  dest_fn = arguments.destfile ? strdup (arguments.destfile) : NULL;
-  log_fn =
+  ctx->source_fn = strdup (arguments.args[0]);
+  ctx->dest_fn = arguments.destfile ? strdup (arguments.destfile) : NULL;
+  ctx->log_fn =
       arguments.logfile ? strdup (arguments.logfile) : strdup ("log/oc_log");
 
   /// Open log file in append mode, else exit program
-  sprintf (perror_msg, "log_fp = fopen(%s, 'a')", log_fn);
-  log_fp = fopen (log_fn, "a");
+  sprintf (ctx->perror_msg, "log_fp = fopen(%s, 'a')", ctx->log_fn);
+  ctx->log_fp = fopen (ctx->log_fn, "a");
   errno = EXIT_SUCCESS;
   if (errno != EXIT_SUCCESS)
     {
       _FAIL;
-      perror (perror_msg);
-      return (opal_exit (EXIT_FAILURE));
+      perror (ctx->perror_msg);
+      return (opal_exit (ctx, EXIT_FAILURE));
     }
 
-  banner ("MARC start.");
-  logger (DEBUG, "Log: %s", log_fn);
-  logger (DEBUG, "source_fn: '%s'", source_fn);
+  banner (ctx, "MARC start.");
+  logger (DEBUG, "Log: %s", ctx->log_fn);
+  logger (DEBUG, "source_fn: '%s'", ctx->source_fn);
 
   /// If source file does not exist, print error and exit
-  sprintf (perror_msg, "access('%s', F_OK)", source_fn);
-  logger (DEBUG, perror_msg);
-  if (access (source_fn, F_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->source_fn);
+  logger (DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, F_OK) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// If source file can not be read, print error and exit
-  sprintf (perror_msg, "access('%s', R_OK)", source_fn);
-  logger (DEBUG, perror_msg);
-  if (access (source_fn, R_OK) == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "access('%s', R_OK)", ctx->source_fn);
+  logger (DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, R_OK) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Open source file in read-only mode
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", source_fn);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "source_fp = fopen('%s', 'r')", ctx->source_fn);
+  logger (DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  source_fp = fopen (source_fn, "r");
+  ctx->source_fp = fopen (ctx->source_fn, "r");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// If destination is file
-  if (dest_fn)
+  if (ctx->dest_fn)
     {
-      logger (DEBUG, "dest_fn: %s", dest_fn);
+      logger (DEBUG, "dest_fn: %s", ctx->dest_fn);
 
       /// Check if destination file exists
-      sprintf (perror_msg, "access('%s', F_OK)", dest_fn);
-      logger (DEBUG, perror_msg);
-      if (access (dest_fn, F_OK) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->dest_fn);
+      logger (DEBUG, ctx->perror_msg);
+      if (access (ctx->dest_fn, F_OK) == EXIT_SUCCESS)
         {
           _PASS;
 
           /// If destination file can't be written, print error and exit
-          sprintf (perror_msg, "access('%s', W_OK)", dest_fn);
-          logger (DEBUG, perror_msg);
-          if (access (dest_fn, W_OK) == EXIT_SUCCESS)
+          sprintf (ctx->perror_msg, "access('%s', W_OK)", ctx->dest_fn);
+          logger (DEBUG, ctx->perror_msg);
+          if (access (ctx->dest_fn, W_OK) == EXIT_SUCCESS)
             _PASS;
           else
             {
               _FAIL;
-              perror (perror_msg);
+              perror (ctx->perror_msg);
               return (errno);
             }
         }
 
       /// Open destination file in 'wb' mode
-      sprintf (perror_msg, "dest_fp = fopen('%s', 'wb')", dest_fn);
-      logger (DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "dest_fp = fopen('%s', 'wb')", ctx->dest_fn);
+      logger (DEBUG, ctx->perror_msg);
       errno = EXIT_SUCCESS;
-      dest_fp = fopen (dest_fn, "wb");
+      ctx->dest_fp = fopen (ctx->dest_fn, "wb");
       if (errno == EXIT_SUCCESS)
         _PASS;
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
@@ -216,7 +227,7 @@ main (int argc, char **argv)
   else
     {
       logger (DEBUG, "Destination: STDOUT");
-      dest_fp = stdout;
+      ctx->dest_fp = stdout;
     }
 
   /// Create and open temp destination file for remove_comments()
@@ -224,8 +235,8 @@ main (int argc, char **argv)
   logger (DEBUG, "rc_tmp: '%s'", rc_tmp);
 
   /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
+  logger (DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   FILE *rc_fp = fopen (rc_tmp, "wb");
   if (errno == EXIT_SUCCESS)
@@ -233,18 +244,18 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Remove comments from source with rem_comments(), write to rc_tmp
-  retVal = rem_comments (source_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
-      return (opal_exit (retVal));
+  ctx->retVal = rem_comments (ctx, ctx->source_fp, rc_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+      return (opal_exit (ctx, ctx->retVal));
 
   /// Close rem_comments temp file pointer rc_fp if not NULL
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(rc_fp)");
+  logger (DEBUG, ctx->perror_msg);
   if (rc_fp)
     {
       if (fclose (rc_fp) == EXIT_SUCCESS)
@@ -252,14 +263,14 @@ main (int argc, char **argv)
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// Open rem_comments temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
+  logger (DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   rc_fp = fopen (rc_tmp, "r");
   if (errno == EXIT_SUCCESS)
@@ -267,7 +278,7 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
@@ -276,8 +287,8 @@ main (int argc, char **argv)
   logger (DEBUG, "pi_tmp: '%s'", pi_tmp);
 
   /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
+  logger (DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   FILE *pi_fp = fopen (pi_tmp, "wb");
   if (errno == EXIT_SUCCESS)
@@ -285,29 +296,29 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Process #include directives from source with proc_includes()
-  retVal = proc_includes (rc_fp, pi_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = proc_includes (ctx, rc_fp, pi_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Close rem_comments temp file pointer if not NULL
   if (rc_fp)
     {
-      sprintf (perror_msg, "fclose(rc_fp)");
-      logger (DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "fclose(rc_fp)");
+      logger (DEBUG, ctx->perror_msg);
 
       if (fclose (rc_fp) == EXIT_SUCCESS)
         _PASS;
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
@@ -315,22 +326,22 @@ main (int argc, char **argv)
   /// Close proc_includes temp file pointer if not NULL
   if (pi_fp)
     {
-      sprintf (perror_msg, "fclose(pi_fp)");
-      logger (DEBUG, perror_msg);
+      sprintf (ctx->perror_msg, "fclose(pi_fp)");
+      logger (DEBUG, ctx->perror_msg);
 
       if (fclose (pi_fp) == EXIT_SUCCESS)
         _PASS;
       else
         {
           _FAIL;
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           return (errno);
         }
     }
 
   /// Open proc_includes temp file in read mode, else print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
+  logger (DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
   pi_fp = fopen (pi_tmp, "r");
   if (errno == EXIT_SUCCESS)
@@ -338,30 +349,30 @@ main (int argc, char **argv)
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// Remove comments included file with rem_comments(), write to destination
-  retVal = rem_comments (pi_fp, dest_fp);
-  if (retVal != EXIT_SUCCESS)
+  ctx->retVal = rem_comments (ctx, pi_fp, ctx->dest_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
     {
-      return (opal_exit (retVal));
+      return (opal_exit (ctx, ctx->retVal));
     }
 
   /// Close proc_includes temp file pointer
-  sprintf (perror_msg, "fclose(pi_fp)");
-  logger (DEBUG, perror_msg);
+  sprintf (ctx->perror_msg, "fclose(pi_fp)");
+  logger (DEBUG, ctx->perror_msg);
   if (fclose (pi_fp) == EXIT_SUCCESS)
     _PASS;
   else
     {
       _FAIL;
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       return (errno);
     }
 
   /// source_fp and dest_fp closed by opal_exit()
-  return (opal_exit (EXIT_SUCCESS));
+  return (opal_exit (ctx, EXIT_SUCCESS));
 }
 
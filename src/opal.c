@@ -1,11 +1,22 @@
 /// @file opal.c
 
+#define _GNU_SOURCE     /* dladdr() */
+
 #include <argp.h>
 #include <assert.h>
+#include <dirent.h>     /* compilation cache directory */
+#include <dlfcn.h>      /* dladdr() */
 #include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>     /* basename() */
+#include <pthread.h>    /* batch worker threads */
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>     /* fclose */
 #include <string.h>
+#include <sys/file.h>   /* flock() */
+#include <sys/stat.h>
+#include <time.h>       /* clock_gettime() */
 #include <unistd.h>
 
 #include "../include/libopal.h"
@@ -27,8 +38,24 @@ const char *argp_program_bug_address =
     "https://github.com/mckerracher/OPaL/issues";
 
 /// Program documentation
-static char doc[] = "opal - OPaL Compiler";
-static char args_doc[] = "FILE";            ///< Arguments we accept
+static char doc[] = "opal - OPaL Compiler"
+    "\vWith more than one FILE, each is compiled as an independent job and "
+    "--output, --log and --report name directories (default '.', 'log' and "
+    "'report') that receive one binary, log and report per FILE, named after "
+    "it.\n\n'opal run FILE' compiles FILE and executes it in the interpreter, "
+    "without writing an executable, and exits with its exit status.\n\n"
+    "With --cache, an executable built before from the same source, after "
+    "#include files are read, with the same options, compiler version and "
+    "runtime is linked from DIR instead of being compiled again.";
+static char args_doc[] = "FILE...\nrun FILE";   ///< Arguments we accept
+
+/// Keys of options without a short option
+enum opal_long_opt
+{
+  OPT_CACHE_SIZE = 256, ///< --cache-size
+  OPT_CACHE_STATS,      ///< --cache-stats
+};
+
 static struct argp_option options[] =       ///< The options we understand
   {
     { "debug", 'd', 0, 0, "Log debug messages" },
@@ -37,19 +64,100 @@ static struct argp_option options[] =       ///< The options we understand
     { "output", 'o', "FILE", 0, "Output to FILE instead of 'a.out'" },
     { "report", 'r', "FILE", 0,
         "Save report to FILE instead of 'report/oc_report.html'" },
+    { "save-temps", 'k', 0, 0,
+        "Save intermediate stage files to 'tmp/' instead of memory" },
+    { "jobs", 'j', "N", 0,
+        "Compile up to N FILEs in parallel, 0 for one per CPU (default 1)" },
+    { "backend", 'b', "NAME", 0,
+        "Build executable with 'native' code generator (default), 'nasm' and "
+        "ld, or 'verify' to build with both and compare their behaviour" },
+    { "verify-input", 'i', "FILE", 0,
+        "Standard input of executables run by --backend=verify, instead of "
+        "'/dev/null'" },
+    { "tos-cache", 't', 0, 0,
+        "Keep top of stack in registers instead of using stack macros" },
+    { "branchless", 'B', 0, 0,
+        "Set results of comparison and logical operators with SETcc "
+        "instead of conditional jumps" },
+    { "peephole", 'p', "RULES", 0,
+        "Comma separated peephole rules to apply: store-fetch, invert-jump, "
+        "dead-label, jump-next, fuse-compare, 'all' (default) or 'none'" },
+    { "stream", 's', 0, 0,
+        "Parse tokens as they are lexed instead of building the symbol table "
+        "first; ignored with --report or --save-temps, which list it" },
+    { "cache", 'c', "DIR", 0,
+        "Take executables from compilation cache DIR, and save them to it; "
+        "ignored with --save-temps, --backend=verify and 'opal run'" },
+    { "cache-size", OPT_CACHE_SIZE, "KIB", 0,
+        "Limit compilation cache to KIB kibibytes, evicting least recently "
+        "used executables (default 65536)" },
+    { "cache-stats", OPT_CACHE_STATS, 0, 0,
+        "Print hits, misses, evictions and size of compilation cache, after "
+        "compiling any FILE" },
     { 0 }
   };
 
+/// Ways to build the executable from assembly code list
+typedef enum opal_backend
+{
+  backend_Native = 0,   ///< Encode machine code with gen_native_bin()
+  backend_Nasm,         ///< Assemble with NASM and link with ld
+  backend_Verify,       ///< Build both ways and compare behaviour
+  backend_Run,          ///< Execute in interpreter with vm_run(), 'opal run'
+} opal_backend_e;
+
+/// Names of backends, as given to --backend
+static const char backend_name[][8] = { "native", "nasm", "verify" };
+
+/// Hex digits of a compilation cache key, which names its cache entry
+#define CACHE_KEY_LEN 32
+
+/// Size of buffers naming files in the compilation cache, with the directory
+#define CACHE_PATH_LEN 512
+
+/// Default limit of compilation cache size in KiB, for --cache-size
+#define CACHE_SIZE_DEFAULT 65536
+
 /// Struct to hold Command Line arguments
 struct arguments
 {
-  char *args[1];     ///< Source file
+  char **args;       ///< Source files
+  int arg_count;     ///< Number of source files
+  bool run;          ///< 'opal run FILE', execute in the interpreter
+  int jobs;          ///< Number of parallel jobs, 0 for one per CPU
+  bool debug;        ///< Log debug messages
   char *logfile;     ///< filename for logger
   char *destfile;    ///< filename for destination file
   char *report;      ///< filename for html report
   bool quiet;        ///< Print messages to standard output during execution
+  bool save_temps;   ///< Write intermediate stages to tmp/ files
+  opal_backend_e backend; ///< How to build the executable
+  char *verify_input; ///< Standard input for --backend=verify
+  bool tos_cache;    ///< Generate code caching top of stack in registers
+  bool branchless;   ///< Generate comparisons without conditional jumps
+  unsigned peephole; ///< Mask of peephole rules to apply
+  bool stream;       ///< Parse tokens as they are lexed
+  char *cache_dir;   ///< Compilation cache directory, NULL for none
+  unsigned long cache_size; ///< Limit of compilation cache in KiB
+  bool cache_stats;  ///< Print statistics of compilation cache
 };
 
+/// Options that apply to every compilation
+typedef struct opal_opts
+{
+  bool debug;               ///< Log debug messages
+  bool quiet;               ///< Do not print progress to standard output
+  bool save_temps;          ///< Save intermediate stage files
+  opal_backend_e backend;   ///< How to build the executable
+  char *verify_input;       ///< Standard input for --backend=verify
+  bool tos_cache;           ///< Keep top of stack in registers
+  bool branchless;          ///< Set comparison results with SETcc
+  unsigned peephole;        ///< Mask of peephole rules to apply
+  bool stream;              ///< Parse without building the symbol table
+  char *cache_dir;          ///< Compilation cache directory, NULL for none
+  unsigned long cache_size; ///< Limit of compilation cache in KiB
+} opal_opts_s;
+
 /**
  * @brief Get the input argument from argp_parse, which we know is a pointer to
  * our arguments structure.
@@ -66,7 +174,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
   switch (key)
     {
     case 'd':
-      LOG_LEVEL = DEBUG;
+      arguments->debug = true;
       break;
 
     case 'q':
@@ -85,15 +193,98 @@ parse_opt (int key, char *arg, struct argp_state *state)
       arguments->report = arg;
       break;
 
-    case ARGP_KEY_ARG:
-      if (state->arg_num >= 1)      // Too many arguments
+    case 'k':
+      arguments->save_temps = true;
+      break;
+
+    case 'j':
+      {
+        char *end = NULL;
+        long jobs = strtol (arg, &end, 10);
+        if (*arg == '\0' || *end != '\0' || jobs < 0 || jobs > 1024)
+          argp_error (state, "invalid number of jobs: '%s'", arg);
+        arguments->jobs = (int) jobs;
+      }
+      break;
+
+    case 'b':
+      {
+        int i = 0;
+        for (i = 0; i <= backend_Verify; i++)
+          if (strcmp (arg, backend_name[i]) == 0)
+            break;
+        if (i > backend_Verify)
+          argp_error (state, "invalid backend: '%s'", arg);
+        arguments->backend = i;
+      }
+      break;
+
+    case 'i':
+      arguments->verify_input = arg;
+      break;
+
+    case 't':
+      arguments->tos_cache = true;
+      break;
+
+    case 'B':
+      arguments->branchless = true;
+      break;
+
+    case 'p':
+      if (parse_peephole_rules (arg, &arguments->peephole) != EXIT_SUCCESS)
+        argp_error (state, "invalid peephole rules: '%s'", arg);
+      break;
+
+    case 's':
+      arguments->stream = true;
+      break;
+
+    case 'c':
+      /// Leave room for '/', a key and the '.new' of an entry being saved
+      if (strlen (arg) + 1 + CACHE_KEY_LEN + sizeof(".new") > CACHE_PATH_LEN)
+        argp_error (state, "cache directory name too long: '%s'", arg);
+      arguments->cache_dir = arg;
+      break;
+
+    case OPT_CACHE_SIZE:
+      {
+        char *end = NULL;
+        errno = EXIT_SUCCESS;
+        unsigned long size = strtoul (arg, &end, 10);
+        if (*arg == '\0' || *arg == '-' || *end != '\0' || errno != 0)
+          argp_error (state, "invalid cache size: '%s'", arg);
+        arguments->cache_size = size;
+      }
+      break;
+
+    case OPT_CACHE_STATS:
+      arguments->cache_stats = true;
+      break;
+
+    case ARGP_KEY_ARGS:
+      arguments->args = state->argv + state->next;
+      arguments->arg_count = state->argc - state->next;
+
+      /// Options are moved before FILEs, so 'run' is the first of them
+      if (strcmp (arguments->args[0], "run") == 0)
+        {
+          arguments->run = true;
+          arguments->args++;
+          arguments->arg_count--;
+          if (arguments->arg_count != 1)
+            argp_error (state, "run takes one FILE");
+        }
+      break;
+
+    case ARGP_KEY_NO_ARGS:         // Not enough arguments
+      if (!arguments->cache_stats)
         argp_usage (state);
-      arguments->args[state->arg_num] = arg;
       break;
 
     case ARGP_KEY_END:
-      if (state->arg_num < 1)       // Not enough arguments
-        argp_usage (state);
+      if (arguments->cache_stats && !arguments->cache_dir)
+        argp_error (state, "--cache-stats needs --cache=DIR");
       break;
 
     default:
@@ -105,639 +296,1566 @@ parse_opt (int key, char *arg, struct argp_state *state)
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
 /**
- * @brief       Main function for opal - OPaL compiler
- * @details
- * 1. Calls the remove_comments() and proc_includes() to process source file.
- * 2. Calls the build_symbol_table() to build symbol table.
- * 3. Calls build_syntax_tree() to build the abstract syntax tree.
- * 4. Calls gen_asm() to build the assembly code table and write to destination.
- * 5. Calls gen_obj() to assemble object file using NASM.
- * 6. Calls gen_bin() to link binary file using ld.
+ * @brief       Write assembly code list to a file for NASM
  *
- * @param[in]   argc    Number of command line arguments
- * @param[in]   argv    Vector of individual command line argument strings
- * @return      The error return code of the function.
+ * @details     With --save-temps the file is 'PREFIXasm.tmp', else it gets a
+ * unique name in tmp/, so concurrent compilations in one directory do not
+ * clobber each other's files. The object file name shares its stem.
  *
- * @retval      EXIT_SUCCESS    On success
- * @retval      EXIT_FAILURE    On error
- * @retval      errno           On system call failure
+ * @param[in]   ctx         Compilation context
+ * @param[in]   tmp_prefix  Prefix of files saved with --save-temps
+ * @param[in]   opts        Compilation options
+ * @param[out]  asm_tmp     Name of assembly file written, 1024 bytes
+ * @param[out]  obj_fn      Name of object file for NASM, 1024 bytes
+ * @return      The error return code of the function.
  */
-
-int
-main (int argc, char **argv)
+static int
+write_asm_file (opal_ctx_s *ctx, const char *tmp_prefix,
+                const opal_opts_s *opts, char *asm_tmp, char *obj_fn)
 {
+  FILE *asm_fp = NULL;
 
-  /// Create structure to process command line arguments
-  struct arguments arguments =
-    { .destfile = NULL, .logfile = NULL, .report = NULL, .quiet = false };
-
-  /// Parse arguments
-  argp_parse (&argp, argc, argv, 0, 0, &arguments);
-
-  /// Populate variables for source, destination, log, report files
-  source_fn = strdup (arguments.args[0]);
-  dest_fn = arguments.destfile ? strdup (arguments.destfile) : strdup ("a.out");
-  log_fn =
-      arguments.logfile ? strdup (arguments.logfile) : strdup ("log/oc_log");
-  report_fn =
-      arguments.report ?
-          strdup (arguments.report) : strdup ("report/oc_report.html");
-  bool quiet = arguments.quiet;
-
-  /// Open log file in append mode, else exit program
-  sprintf (perror_msg, "log_fp = fopen(%s, 'a')", log_fn);
-  errno = EXIT_SUCCESS;
-  log_fp = fopen (log_fn, "a");
-  if (errno != EXIT_SUCCESS)
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (opal_exit (EXIT_FAILURE));
-    }
-
-  banner ("Main start.");
-  logger(DEBUG, "Log: %s", log_fn);
-  logger(DEBUG, "source_fn: '%s'", source_fn);
-  logger(DEBUG, "report_fn: '%s'", report_fn);
-
-  if (!quiet)
+  if (opts->save_temps)
     {
-      fprintf (stdout,
-               "Source file:\t%s\nLog file:\t%s\nTemp directory:\ttmp/\n",
-               source_fn, log_fn);
+      snprintf (asm_tmp, 1024, "%sasm.tmp", tmp_prefix);
+      snprintf (obj_fn, 1024, "%snasm.o", tmp_prefix);
+      sprintf (ctx->perror_msg, "asm_fp = fopen('%s', 'wb')", asm_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      asm_fp = fopen (asm_tmp, "wb");
     }
-
-  /// If source file does not exist, print error and exit
-  sprintf (perror_msg, "access('%s', F_OK)", source_fn);
-  logger(DEBUG, perror_msg);
-  if (access (source_fn, F_OK) == EXIT_SUCCESS)
-    _PASS;
   else
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      strcpy (asm_tmp, "tmp/opal_XXXXXX.asm");
+      sprintf (ctx->perror_msg, "mkstemps('%s', 4)", asm_tmp);
+      logger(DEBUG, ctx->perror_msg);
+      errno = EXIT_SUCCESS;
+      int asm_fd = mkstemps (asm_tmp, 4);
+      if (asm_fd >= 0)
+        asm_fp = fdopen (asm_fd, "wb");
+
+      /// Object file shares the unique stem of the assembly file
+      sprintf (obj_fn, "%.*s.o", (int) (strlen (asm_tmp) - 4), asm_tmp);
     }
 
-  /// If source file can not be read, print error and exit
-  sprintf (perror_msg, "access('%s', R_OK)", source_fn);
-  logger(DEBUG, perror_msg);
-  if (access (source_fn, R_OK) == EXIT_SUCCESS)
+  logger(DEBUG, "asm_tmp: '%s'", asm_tmp);
+  if (asm_fp)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Check if destination file exists
-  sprintf (perror_msg, "access('%s', F_OK)", dest_fn);
-  logger(DEBUG, perror_msg);
-  if (access (dest_fn, F_OK) == EXIT_SUCCESS)
+  /// Print symbol table with print_symbol_table() to assembly file
+  ctx->retVal = print_asm_code (ctx, ctx->asm_cmd_list, asm_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (ctx->retVal);
+
+  /// Close asm temp file pointer asm_fp if not NULL
+  sprintf (ctx->perror_msg, "fclose(asm_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (asm_fp)
     {
-      /// If destination file exists, delete it
-      sprintf (perror_msg, "remove(%s)", dest_fn);
-      logger(DEBUG, perror_msg);
-      if (remove (dest_fn) == EXIT_SUCCESS)
-        _PASS;
+      if (fclose (asm_fp) == EXIT_SUCCESS)
+        {
+          _PASS;
+          asm_fp = NULL;
+        }
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
     }
 
-  /// Open source file in read-only mode
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", source_fn);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  source_fp = fopen (source_fn, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
-    {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
-    }
+  return EXIT_SUCCESS;
+}
 
-  /// Check if report file exists
-  sprintf (perror_msg, "access('%s', F_OK)", report_fn);
-  logger(DEBUG, perror_msg);
-  if (access (report_fn, F_OK) == EXIT_SUCCESS)
+/**
+ * @brief       Assemble with NASM and link with ld
+ *
+ * @param[in]   ctx         Compilation context
+ * @param[in]   asm_tmp     Assembly file written by write_asm_file()
+ * @param[in]   obj_fn      Object file to create
+ * @param[in]   dest_fn     Executable to create
+ * @param[in]   opts        Compilation options
+ * @return      The error return code of the function.
+ */
+static int
+build_with_nasm (opal_ctx_s *ctx, char *asm_tmp, char *obj_fn, char *dest_fn,
+                 const opal_opts_s *opts)
+{
+  /// If object object file exists, delete it
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", obj_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (obj_fn, F_OK) == EXIT_SUCCESS)
     {
-      /// Truncate report file
-      sprintf (perror_msg, "ftruncate(%s, EXIT_SUCCESS)", report_fn);
-      logger(DEBUG, perror_msg);
-      if (truncate (report_fn, 0) == EXIT_SUCCESS)
+      sprintf (ctx->perror_msg, "remove(%s)", obj_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (remove (obj_fn) == EXIT_SUCCESS)
         _PASS;
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
     }
 
-  /// If report file can not be written, print error and exit
-  sprintf (perror_msg, "report_fp = fopen('%s', 'a')", report_fn);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  report_fp = fopen (report_fn, "a");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
+  /// Assemble object using NASM
+  ctx->retVal = gen_obj (ctx, asm_tmp, obj_fn);
+  if (!opts->save_temps)
+    remove (asm_tmp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (ctx->retVal);
+
+  if (!opts->quiet)
+    fprintf(stdout, "Assemble object file using 'NASM'.\n");
+
+  /// Link object using LD
+  ctx->retVal = gen_bin (ctx, obj_fn, dest_fn);
+  if (!opts->save_temps)
+    remove (obj_fn);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (ctx->retVal);
+
+  if (!opts->quiet)
+    fprintf(stdout, "Link object file using 'ld'.\n");
+
+  return EXIT_SUCCESS;
+}
+
+/// Statistics of a compilation cache, kept in its 'stats' file
+typedef struct cache_stats
+{
+  unsigned long hits;       ///< Executables taken from the cache
+  unsigned long misses;     ///< Executables compiled, and saved to it
+  unsigned long evictions;  ///< Executables removed to keep it in its limit
+} cache_stats_s;
+
+/// Entry of a compilation cache, an executable named by its key
+typedef struct cache_entry
+{
+  char key[CACHE_KEY_LEN + 1];  ///< Name of entry file
+  off_t size;                   ///< Size of executable
+  struct timespec used;         ///< Last use, modification time of file
+} cache_entry_s;
+
+/**
+ * @brief       Add bytes to a compilation cache key
+ *
+ * @details     The key is two lanes of 64 bit FNV-1a with different offset
+ * bases and primes, so that 128 bits keep different sources apart. It is not
+ * a cryptographic hash: the cache directory must only be writable by those
+ * who trust each other's executables.
+ *
+ * @param[in,out] key   Key lanes
+ * @param[in]   data    Bytes to add
+ * @param[in]   len     Number of bytes
+ */
+static void
+cache_hash (uint64_t key[2], const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; i++)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      key[0] = (key[0] ^ p[i]) * 0x100000001b3ULL;
+      key[1] = (key[1] ^ p[i]) * 0x9e3779b97f4a7c15ULL;
     }
+}
 
-  /// Initialize HTML report file
-  retVal = init_report (report_fp);
-  if (retVal != EXIT_SUCCESS)
-    opal_exit (retVal);
+/// Add a part of known length to a compilation cache key, length first
+static void
+cache_hash_part (uint64_t key[2], const void *data, uint64_t len)
+{
+  cache_hash (key, &len, sizeof(len));
+  cache_hash (key, data, len);
+}
 
-  /// Call MARC functions to pre-process source file
-  banner ("MARC start.");
+/**
+ * @brief       Add contents of a file to a compilation cache key
+ * @details     A file that can not be read adds a length no file has.
+ * @param[in,out] key   Key lanes
+ * @param[in]   fn      File to add
+ */
+static void
+cache_hash_file (uint64_t key[2], const char *fn)
+{
+  struct stat st = { 0 };
+  FILE *fp = fopen (fn, "rb");
+  if (fp == NULL || fstat (fileno (fp), &st) != EXIT_SUCCESS)
+    {
+      uint64_t missing = UINT64_MAX;
+      cache_hash (key, &missing, sizeof(missing));
+      if (fp)
+        fclose (fp);
+      return;
+    }
 
-  /// Create and open temp destination file for remove_comments()
-  char *rc_tmp = "tmp/marc_rc.tmp";
-  logger(DEBUG, "rc_tmp: '%s'", rc_tmp);
+  uint64_t len = st.st_size;
+  cache_hash (key, &len, sizeof(len));
 
-  /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  FILE *rc_fp = fopen (rc_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
+  char buf[4096];
+  size_t n = 0;
+  while ((n = fread (buf, 1, sizeof(buf), fp)) > 0)
+    cache_hash (key, buf, n);
+  fclose (fp);
+}
+
+/// Spread every bit of a key lane over all of it, as MurmurHash3 does
+static uint64_t
+cache_mix (uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * @brief       Compute compilation cache key of a source file
+ *
+ * @details     The key covers everything the executable is built from: the
+ * source as ALEX reads it, after #include files are read and comments are
+ * removed, the compiler version, the library file holding the code
+ * generators and native runtime, so that a rebuilt libopal.so misses the
+ * entries of the old one, the runtime in 'res/header.asm' and
+ * 'res/footer.asm', the backend and the code generation options.
+ *
+ * @param[in]   opts    Compilation options
+ * @param[in]   src     Output of MARC
+ * @param[in]   len     Number of bytes of src
+ * @param[out]  key     Key as CACHE_KEY_LEN hex digits
+ */
+static void
+cache_make_key (const opal_opts_s *opts, const char *src, size_t len,
+                char key[CACHE_KEY_LEN + 1])
+{
+  uint64_t lanes[2] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL };
+
+  char flags[128] = { 0 };
+  int flags_len = snprintf (flags, sizeof(flags),
+                            "OPaL %.2f backend=%s tos-cache=%d branchless=%d "
+                            "peephole=%u", __VERSION_NUM,
+                            backend_name[opts->backend], opts->tos_cache,
+                            opts->branchless, opts->peephole);
+  cache_hash_part (lanes, flags, flags_len);
+
+  Dl_info lib = { 0 };
+  if (dladdr ((void*) gen_native_bin, &lib) && lib.dli_fname)
+    cache_hash_file (lanes, lib.dli_fname);
   else
+    cache_hash_file (lanes, "");
+
+  cache_hash_file (lanes, "res/header.asm");
+  cache_hash_file (lanes, "res/footer.asm");
+  cache_hash_part (lanes, src, len);
+
+  snprintf (key, CACHE_KEY_LEN + 1, "%016llx%016llx",
+            (unsigned long long) cache_mix (lanes[0]),
+            (unsigned long long) cache_mix (lanes[1]));
+}
+
+/**
+ * @brief       Name a file in the compilation cache directory
+ *
+ * @param[out]  buf     Buffer of CACHE_PATH_LEN bytes for the name
+ * @param[in]   dir     Compilation cache directory
+ * @param[in]   name    Name of file in dir
+ * @return      EXIT_SUCCESS, or -1 with errno ENAMETOOLONG if the name does
+ * not fit
+ */
+static int
+cache_path (char buf[CACHE_PATH_LEN], const char *dir, const char *name)
+{
+  int len = snprintf (buf, CACHE_PATH_LEN, "%s/%s", dir, name);
+  if (len < 0 || len >= CACHE_PATH_LEN)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      errno = ENAMETOOLONG;
+      return -1;
     }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Open and lock 'stats' file of compilation cache
+ *
+ * @details     Creates the cache directory if it does not exist. The lock is
+ * held until the file is closed, so that lookups, saves and evictions of
+ * jobs and compilers sharing the cache do not interleave.
+ *
+ * @param[in]   dir     Compilation cache directory
+ * @return      File descriptor of locked file, or -1 with errno set
+ */
+static int
+cache_lock (const char *dir)
+{
+  if (mkdir (dir, 0777) != EXIT_SUCCESS && errno != EEXIST)
+    return -1;
 
-  /// Remove comments from source with rem_comments(), write to rc_tmp
-  retVal = rem_comments (source_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  char stats_fn[CACHE_PATH_LEN] = { 0 };
+  if (cache_path (stats_fn, dir, "stats") != EXIT_SUCCESS)
+    return -1;
 
-  if (!quiet)
-    fprintf(stdout, "Removed comments from source file.\n");
+  int fd = open (stats_fn, O_RDWR | O_CREAT, 0666);
+  if (fd < 0)
+    return -1;
 
-  /// Close source file pointer source_fp if not NULL
-  sprintf (perror_msg, "fclose(source_fp)");
-  logger(DEBUG, perror_msg);
-  if (source_fp)
+  if (flock (fd, LOCK_EX) != EXIT_SUCCESS)
     {
-      if (fclose (source_fp) == EXIT_SUCCESS)
-        {
-          _PASS;
-          source_fp = NULL;
-        }
-      else
-        {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
-        }
+      int err = errno;
+      close (fd);
+      errno = err;
+      return -1;
+    }
+
+  return fd;
+}
+
+/// Read statistics from locked 'stats' file, zero for a new cache
+static void
+cache_read_stats (int fd, cache_stats_s *stats)
+{
+  char buf[256] = { 0 };
+  *stats = (cache_stats_s) { 0 };
+  if (pread (fd, buf, sizeof(buf) - 1, 0) > 0)
+    sscanf (buf, "hits %lu\nmisses %lu\nevictions %lu", &stats->hits,
+            &stats->misses, &stats->evictions);
+}
+
+/**
+ * @brief       Add counts to statistics in locked 'stats' file
+ * @param[in]   fd      File descriptor from cache_lock()
+ * @param[in]   add     Counts to add
+ * @return      EXIT_SUCCESS, or errno on system call failure
+ */
+static int
+cache_add_stats (int fd, const cache_stats_s *add)
+{
+  cache_stats_s stats = { 0 };
+  cache_read_stats (fd, &stats);
+  stats.hits += add->hits;
+  stats.misses += add->misses;
+  stats.evictions += add->evictions;
+
+  char buf[256] = { 0 };
+  int len = snprintf (buf, sizeof(buf), "hits %lu\nmisses %lu\nevictions %lu\n",
+                      stats.hits, stats.misses, stats.evictions);
+  if (pwrite (fd, buf, len, 0) != len || ftruncate (fd, len) != EXIT_SUCCESS)
+    return (errno);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Copy an executable, where a hard link can not be made
+ * @param[in]   src_fn  Executable to copy
+ * @param[in]   dest_fn New file to create, with the mode of src_fn
+ * @return      EXIT_SUCCESS, or -1 with errno set
+ */
+static int
+cache_copy (const char *src_fn, const char *dest_fn)
+{
+  struct stat st = { 0 };
+  int src_fd = open (src_fn, O_RDONLY);
+  if (src_fd < 0)
+    return -1;
+  if (fstat (src_fd, &st) != EXIT_SUCCESS)
+    {
+      close (src_fd);
+      return -1;
+    }
+
+  int dest_fd = open (dest_fn, O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 0777);
+  if (dest_fd < 0)
+    {
+      close (src_fd);
+      return -1;
     }
 
-  /// Close rem_comments() temp file pointer rc_fp if not NULL
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
-  if (rc_fp)
+  char buf[65536];
+  ssize_t n = 0;
+  while ((n = read (src_fd, buf, sizeof(buf))) > 0)
+    if (write (dest_fd, buf, n) != n)
+      {
+        n = -1;
+        break;
+      }
+
+  int err = errno;
+  close (src_fd);
+  if (close (dest_fd) != EXIT_SUCCESS && n == 0)
+    {
+      err = errno;
+      n = -1;
+    }
+  if (n != 0)
+    unlink (dest_fn);
+  errno = err;
+  return n == 0 ? EXIT_SUCCESS : -1;
+}
+
+/// Order cache entries from least to most recently used
+static int
+cache_entry_cmp (const void *a, const void *b)
+{
+  const struct timespec *ta = &((const cache_entry_s*) a)->used;
+  const struct timespec *tb = &((const cache_entry_s*) b)->used;
+  if (ta->tv_sec != tb->tv_sec)
+    return ta->tv_sec < tb->tv_sec ? -1 : 1;
+  if (ta->tv_nsec != tb->tv_nsec)
+    return ta->tv_nsec < tb->tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/**
+ * @brief       List entries of compilation cache
+ *
+ * @details     Entries are files named by a key. Other files, as 'stats'
+ * and copies not yet renamed into place, are left out.
+ *
+ * @param[in]   dir     Compilation cache directory
+ * @param[out]  entries Array of entries, to free()
+ * @param[out]  total   Sum of sizes of entries
+ * @return      Number of entries, or -1 with errno set
+ */
+static int
+cache_scan (const char *dir, cache_entry_s **entries, off_t *total)
+{
+  DIR *dp = opendir (dir);
+  if (dp == NULL)
+    return -1;
+
+  int count = 0;
+  int cap = 0;
+  *entries = NULL;
+  *total = 0;
+
+  struct dirent *de = NULL;
+  while ((de = readdir (dp)) != NULL)
     {
-      if (fclose (rc_fp) == EXIT_SUCCESS)
+      if (strlen (de->d_name) != CACHE_KEY_LEN
+          || strspn (de->d_name, "0123456789abcdef") != CACHE_KEY_LEN)
+        continue;
+
+      char entry_fn[CACHE_PATH_LEN] = { 0 };
+      struct stat st = { 0 };
+      if (cache_path (entry_fn, dir, de->d_name) != EXIT_SUCCESS
+          || stat (entry_fn, &st) != EXIT_SUCCESS)
+        continue;
+
+      if (count == cap)
         {
-          _PASS;
-          rc_fp = NULL;
+          cap = cap ? cap * 2 : 64;
+          cache_entry_s *grown = realloc (*entries, cap * sizeof(**entries));
+          if (grown == NULL)
+            {
+              free (*entries);
+              *entries = NULL;
+              closedir (dp);
+              errno = ENOMEM;
+              return -1;
+            }
+          *entries = grown;
         }
-      else
+
+      cache_entry_s *entry = &(*entries)[count++];
+      memcpy (entry->key, de->d_name, CACHE_KEY_LEN + 1);
+      entry->size = st.st_size;
+      entry->used = st.st_mtim;
+      *total += st.st_size;
+    }
+
+  closedir (dp);
+  return count;
+}
+
+/**
+ * @brief       Evict least recently used entries over the cache size limit
+ * @param[in]   opts        Compilation options
+ * @param[out]  evicted     Number of entries removed
+ * @return      EXIT_SUCCESS, or -1 with errno set
+ */
+static int
+cache_evict (const opal_opts_s *opts, unsigned long *evicted)
+{
+  cache_entry_s *entries = NULL;
+  off_t total = 0;
+  int count = cache_scan (opts->cache_dir, &entries, &total);
+  if (count < 0)
+    return -1;
+
+  off_t limit = (off_t) opts->cache_size * 1024;
+  *evicted = 0;
+  if (total > limit)
+    {
+      qsort (entries, count, sizeof(*entries), cache_entry_cmp);
+      for (int i = 0; i < count && total > limit; i++)
         {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
+          char entry_fn[CACHE_PATH_LEN] = { 0 };
+          if (cache_path (entry_fn, opts->cache_dir, entries[i].key)
+              != EXIT_SUCCESS)
+            continue;
+
+          if (unlink (entry_fn) == EXIT_SUCCESS || errno == ENOENT)
+            {
+              total -= entries[i].size;
+              ++*evicted;
+            }
         }
     }
 
-  /// Open rem_comments() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  rc_fp = fopen (rc_tmp, "r");
-  if (errno == EXIT_SUCCESS)
+  free (entries);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Take executable from compilation cache
+ *
+ * @details     The cache entry is hard linked as the destination file, or
+ * copied where the two are on different file systems. A hit makes the entry
+ * the most recently used one.
+ *
+ * @param[in]   ctx     Compilation context
+ * @param[in]   opts    Compilation options
+ * @param[in]   key     Key from cache_make_key()
+ * @param[out]  hit     True if the executable was in the cache
+ * @return      The error return code of the function.
+ */
+static int
+cache_fetch (opal_ctx_s *ctx, const opal_opts_s *opts, const char *key,
+             bool *hit)
+{
+  char entry_fn[CACHE_PATH_LEN] = { 0 };
+  logger(DEBUG, "Cache key: %s", key);
+
+  sprintf (ctx->perror_msg, "cache_path('%s', '%s')", opts->cache_dir, key);
+  logger(DEBUG, ctx->perror_msg);
+  if (cache_path (entry_fn, opts->cache_dir, key) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Create and open temp destination file for proc_includes()
-  char *pi_tmp = "tmp/marc_pi.tmp";
-  logger(DEBUG, "pi_tmp: '%s'", pi_tmp);
-
-  /// If temp file can not be written, print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'wb')", pi_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  FILE *pi_fp = fopen (pi_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "cache_lock('%s')", opts->cache_dir);
+  logger(DEBUG, ctx->perror_msg);
+  int lock_fd = cache_lock (opts->cache_dir);
+  if (lock_fd >= 0)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Process #include directives from source with proc_includes()
-  retVal = proc_includes (rc_fp, pi_fp);
-  if (retVal != EXIT_SUCCESS)
-    {
-      return (opal_exit (retVal));
-    }
-
-  if (!quiet)
-    fprintf(stdout, "Processed #include files.\n");
+  sprintf (ctx->perror_msg, "link('%s', '%s')", entry_fn, ctx->dest_fn);
+  logger(DEBUG, ctx->perror_msg);
+  errno = EXIT_SUCCESS;
+  *hit = link (entry_fn, ctx->dest_fn) == EXIT_SUCCESS;
+  if (!*hit && (errno == EXDEV || errno == EPERM || errno == EMLINK))
+    *hit = cache_copy (entry_fn, ctx->dest_fn) == EXIT_SUCCESS;
 
-  /// Close rem_comments temp file pointer if not NULL
-  if (rc_fp)
+  if (*hit || errno == ENOENT)
+    _PASS;
+  else
     {
-      sprintf (perror_msg, "fclose(rc_fp)");
-      logger(DEBUG, perror_msg);
-
-      if (fclose (rc_fp) == EXIT_SUCCESS)
-        {
-          _PASS;
-          rc_fp = NULL;
-        }
-      else
-        {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
-        }
+      perror (ctx->perror_msg);
+      _FAIL;
+      int err = errno;
+      close (lock_fd);
+      return (err);
     }
 
-  /// Close proc_includes() temp file pointer if not NULL
-  if (pi_fp)
-    {
-      sprintf (perror_msg, "fclose(pi_fp)");
-      logger(DEBUG, perror_msg);
+  /// Modification time of entry is its last use, for eviction
+  if (*hit)
+    utimensat (AT_FDCWD, entry_fn, NULL, 0);
+  logger(INFO, "Compilation cache %s: %s", *hit ? "hit" : "miss", entry_fn);
 
-      if (fclose (pi_fp) == EXIT_SUCCESS)
-        {
-          _PASS;
-          pi_fp = NULL;
-        }
-      else
-        {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
-        }
-    }
+  cache_stats_s add = { .hits = *hit, .misses = !*hit };
+  ctx->retVal = cache_add_stats (lock_fd, &add);
+  close (lock_fd);
+  return (ctx->retVal);
+}
 
-  /// Open proc_includes() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "pi_fp = fopen('%s', 'r')", pi_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  pi_fp = fopen (pi_tmp, "r");
-  if (errno == EXIT_SUCCESS)
+/**
+ * @brief       Save executable to compilation cache
+ *
+ * @details     The destination file is hard linked as the cache entry, or
+ * copied and renamed into place where the two are on different file
+ * systems. Least recently used entries are then evicted until the cache is
+ * within its size limit.
+ *
+ * @param[in]   ctx     Compilation context
+ * @param[in]   opts    Compilation options
+ * @param[in]   key     Key from cache_make_key()
+ * @return      The error return code of the function.
+ */
+static int
+cache_store (opal_ctx_s *ctx, const opal_opts_s *opts, const char *key)
+{
+  char entry_fn[CACHE_PATH_LEN] = { 0 };
+  char new_fn[CACHE_PATH_LEN + sizeof(".new")] = { 0 };
+
+  sprintf (ctx->perror_msg, "cache_path('%s', '%s')", opts->cache_dir, key);
+  logger(DEBUG, ctx->perror_msg);
+  if (cache_path (entry_fn, opts->cache_dir, key) == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
+  snprintf (new_fn, sizeof(new_fn), "%s.new", entry_fn);
 
-  /// Open rem_comments() temp file in write mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'wb')", rc_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  rc_fp = fopen (rc_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
+  sprintf (ctx->perror_msg, "cache_lock('%s')", opts->cache_dir);
+  logger(DEBUG, ctx->perror_msg);
+  int lock_fd = cache_lock (opts->cache_dir);
+  if (lock_fd >= 0)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-
-  if (!quiet)
-    fprintf(stdout, "Removed comments from included files.\n");
-
-  /// Remove comments from includes files with rem_comments(), write to rc_tmp
-  retVal = rem_comments (pi_fp, rc_fp);
-  if (retVal != EXIT_SUCCESS)
+  /// An entry saved by a job compiling the same source meanwhile is kept
+  sprintf (ctx->perror_msg, "link('%s', '%s')", ctx->dest_fn, entry_fn);
+  logger(DEBUG, ctx->perror_msg);
+  errno = EXIT_SUCCESS;
+  bool saved = link (ctx->dest_fn, entry_fn) == EXIT_SUCCESS
+      || errno == EEXIST;
+  if (!saved && (errno == EXDEV || errno == EPERM || errno == EMLINK))
     {
-      return (opal_exit (retVal));
+      sprintf (ctx->perror_msg, "copy('%s', '%s')", ctx->dest_fn, new_fn);
+      logger(DEBUG, ctx->perror_msg);
+      unlink (new_fn);
+      saved = cache_copy (ctx->dest_fn, new_fn) == EXIT_SUCCESS
+          && rename (new_fn, entry_fn) == EXIT_SUCCESS;
     }
 
-  /// Close proc_includes() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(pi_fp)");
-  logger(DEBUG, perror_msg);
-  if (fclose (pi_fp) == EXIT_SUCCESS)
+  cache_stats_s add = { 0 };
+  if (saved)
     {
       _PASS;
-      pi_fp = NULL;
+      sprintf (ctx->perror_msg, "cache_evict('%s')", opts->cache_dir);
+      logger(DEBUG, ctx->perror_msg);
+      saved = cache_evict (opts, &add.evictions) == EXIT_SUCCESS;
     }
+
+  if (saved)
+    _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
-      return (errno);
+      int err = errno;
+      unlink (new_fn);
+      close (lock_fd);
+      return (err);
     }
 
-  /// Close rem_comments() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
-  if (fclose (rc_fp) == EXIT_SUCCESS)
+  if (add.evictions)
+    logger(INFO, "Compilation cache evicted %lu entries.", add.evictions);
+
+  ctx->retVal = cache_add_stats (lock_fd, &add);
+  close (lock_fd);
+  return (ctx->retVal);
+}
+
+/**
+ * @brief       Print statistics of compilation cache to standard output
+ * @param[in]   opts    Compilation options
+ * @return      EXIT_SUCCESS, or errno on system call failure
+ */
+static int
+print_cache_stats (const opal_opts_s *opts)
+{
+  int lock_fd = cache_lock (opts->cache_dir);
+  if (lock_fd < 0)
     {
-      _PASS;
-      rc_fp = NULL;
+      perror (opts->cache_dir);
+      return (errno);
     }
-  else
+
+  cache_stats_s stats = { 0 };
+  cache_read_stats (lock_fd, &stats);
+
+  cache_entry_s *entries = NULL;
+  off_t total = 0;
+  int count = cache_scan (opts->cache_dir, &entries, &total);
+  int err = errno;
+  free (entries);
+  close (lock_fd);
+  if (count < 0)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      errno = err;
+      perror (opts->cache_dir);
+      return (err);
     }
 
-  /// Open rem_comments() temp file in read mode, else print error and exit
-  sprintf (perror_msg, "rc_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  fprintf (stdout, "Compilation cache:\t%s\nCache hits:\t%lu\n"
+           "Cache misses:\t%lu\nCache evictions:\t%lu\n"
+           "Cache entries:\t%d, %lld of %lu KiB\n", opts->cache_dir,
+           stats.hits, stats.misses, stats.evictions, count,
+           (long long) (total + 1023) / 1024, opts->cache_size);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief       Compile one source file with the given context
+ * @details
+ * 1. Calls the remove_comments() and proc_includes() to process source file.
+ * 2. Calls the build_symbol_table() to build symbol table.
+ * 3. Calls build_syntax_tree() to build the abstract syntax tree.
+ * 4. Calls gen_asm() to build the assembly code table and write to destination.
+ * 5. Calls gen_native_bin() to write the executable, or gen_obj() and
+ *    gen_bin() to assemble and link it using NASM and ld, or both for
+ *    verify_native_bin() to compare. For 'opal run', calls vm_load() and
+ *    vm_run() to execute the program instead.
+ *
+ * With --cache, the output of MARC is looked up in the compilation cache
+ * with cache_fetch(), and on a hit the executable is linked from the cache
+ * and steps 2 to 5 are skipped. Otherwise the executable built is saved to
+ * the cache with cache_store().
+ *
+ * Output of MARC and ALEX stages is passed between stages in memory buffers.
+ * With --save-temps, it is written to files in tmp/ for inspection.
+ *
+ * The context must have its source, destination, log and report file names
+ * set. Files are closed with opal_exit() before returning.
+ *
+ * @param[in]   ctx         Compilation context
+ * @param[in]   tmp_prefix  Prefix of files saved with --save-temps
+ * @param[in]   opts        Compilation options
+ * @param[out]  cache_hit   True if executable was taken from the cache
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On error
+ * @retval      errno           On system call failure
+ * @retval      status          Exit status of program, for 'opal run'
+ */
+static int
+compile_file (opal_ctx_s *ctx, const char *tmp_prefix,
+              const opal_opts_s *opts, bool *cache_hit)
+{
+  /// Open log file in append mode, else fail; there is no log to say so
+  sprintf (ctx->perror_msg, "log_fp = fopen(%s, 'a')", ctx->log_fn);
   errno = EXIT_SUCCESS;
-  rc_fp = fopen (rc_tmp, "r");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
+  ctx->log_fp = fopen (ctx->log_fn, "a");
+  if (ctx->log_fp == NULL)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      perror (ctx->perror_msg);
+      return (EXIT_FAILURE);
     }
 
-  /// Append MARC output to HTML report
-  retVal = print_marc_html (rc_fp, report_fp);
-  if (retVal != EXIT_SUCCESS)
+  banner (ctx, "Main start.");
+  logger(DEBUG, "Log: %s", ctx->log_fn);
+  logger(DEBUG, "source_fn: '%s'", ctx->source_fn);
+  logger(DEBUG, "report_fn: '%s'", ctx->report_fn);
+
+  if (!opts->quiet)
     {
-      return (opal_exit (retVal));
+      fprintf (stdout, "Source file:\t%s\nLog file:\t%s\n", ctx->source_fn,
+               ctx->log_fn);
+      if (opts->save_temps)
+        fprintf (stdout, "Temp directory:\ttmp/\n");
     }
 
-  /// Close rem_comments() temp file pointer, else print error and exit
-  sprintf (perror_msg, "fclose(rc_fp)");
-  logger(DEBUG, perror_msg);
-  if (fclose (rc_fp) == EXIT_SUCCESS)
+  /// If source file does not exist, print error and exit
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, F_OK) == EXIT_SUCCESS)
+    _PASS;
+  else
     {
-      _PASS;
-      rc_fp = NULL;
+      perror (ctx->perror_msg);
+      _FAIL;
+      return (errno);
     }
+
+  /// If source file can not be read, print error and exit
+  sprintf (ctx->perror_msg, "access('%s', R_OK)", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->source_fn, R_OK) == EXIT_SUCCESS)
+    _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Start lexical analyzer code
-  banner ("ALEX start.");
+  /// Check if destination file exists, the interpreter writes none
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->dest_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (opts->backend != backend_Run
+      && access (ctx->dest_fn, F_OK) == EXIT_SUCCESS)
+    {
+      /// If destination file exists, delete it
+      sprintf (ctx->perror_msg, "remove(%s)", ctx->dest_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (remove (ctx->dest_fn) == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
+    }
 
-  /// Open rem_comments() temp file as source_fp, else print error and exit
-  sprintf (perror_msg, "source_fp = fopen('%s', 'r')", rc_tmp);
-  logger(DEBUG, perror_msg);
+  /// Open source file in read-only mode
+  sprintf (ctx->perror_msg, "source_fp = fopen('%s', 'r')", ctx->source_fn);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  source_fp = fopen (rc_tmp, "r");
+  ctx->source_fp = fopen (ctx->source_fn, "r");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Create symbol table linked list
-  logger(DEBUG, "Create symbol_table linked list node.");
-  lexeme_s *symbol_table = (lexeme_s*) calloc (1, sizeof(lexeme_s));
-
-  int symbol_count = 0;                ///< Number of lexemes identified
-
-  if (!quiet)
-    fprintf(stdout, "Symbol table of lexemes created.\n");
-
-  /// Build symbol table using rem_comments() temp file as source
-  retVal = build_symbol_table (symbol_table, &symbol_count);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
-
-  logger(DEBUG, "assert(symbol_ct [%d] > 0)", symbol_count);
-  assert(symbol_count > 0);
-  _PASS;
-
-  /// Create and open temp destination file for print_symbol_table()
-  char *alex_tmp = "tmp/alex.tmp";
-  logger(DEBUG, "alex_tmp: '%s'", alex_tmp);
+  /// Check if report file exists
+  sprintf (ctx->perror_msg, "access('%s', F_OK)", ctx->report_fn);
+  logger(DEBUG, ctx->perror_msg);
+  if (access (ctx->report_fn, F_OK) == EXIT_SUCCESS)
+    {
+      /// Truncate report file
+      sprintf (ctx->perror_msg, "ftruncate(%s, EXIT_SUCCESS)", ctx->report_fn);
+      logger(DEBUG, ctx->perror_msg);
+      if (truncate (ctx->report_fn, 0) == EXIT_SUCCESS)
+        _PASS;
+      else
+        {
+          perror (ctx->perror_msg);
+          _FAIL;
+          return (errno);
+        }
+    }
 
-  /// If alex temp file can not be written, print error and exit
-  sprintf (perror_msg, "alex_fp = fopen('%s', 'wb')", alex_tmp);
-  logger(DEBUG, perror_msg);
+  /// If report file can not be written, print error and exit
+  sprintf (ctx->perror_msg, "report_fp = fopen('%s', 'a')", ctx->report_fn);
+  logger(DEBUG, ctx->perror_msg);
   errno = EXIT_SUCCESS;
-  FILE *alex_fp = fopen (alex_tmp, "wb");
+  ctx->report_fp = fopen (ctx->report_fn, "a");
   if (errno == EXIT_SUCCESS)
     _PASS;
   else
     {
-      perror (perror_msg);
+      perror (ctx->perror_msg);
       _FAIL;
       return (errno);
     }
 
-  /// Print symbol table with print_symbol_table() to alex temp file
-  retVal = print_symbol_table (symbol_table, alex_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  /// Initialize HTML report file
+  ctx->retVal = init_report (ctx, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    opal_exit (ctx, ctx->retVal);
 
-  /// Print symbol table HTML report with print_symbol_table_html()
-  retVal = print_symbol_table_html (symbol_table, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  /// Call MARC functions to pre-process source file
+  banner (ctx, "MARC start.");
+
+  /// Stage outputs are kept in memory, unless asked to save them in tmp/
+  char rc_tmp[1024] = { 0 };
+  char pi_tmp[1024] = { 0 };
+  snprintf (rc_tmp, sizeof(rc_tmp), "%smarc_rc.tmp", tmp_prefix);
+  snprintf (pi_tmp, sizeof(pi_tmp), "%smarc_pi.tmp", tmp_prefix);
+  stage_buf_s *rc_stage = stage_new (ctx, opts->save_temps ? rc_tmp : NULL);
+  stage_buf_s *pi_stage = stage_new (ctx, opts->save_temps ? pi_tmp : NULL);
+  logger(DEBUG, "rc_stage: '%s'", rc_stage->fn ? rc_stage->fn : "memory");
+  logger(DEBUG, "pi_stage: '%s'", pi_stage->fn ? pi_stage->fn : "memory");
+
+  /// Open stage for remove_comments() output, else print error and exit
+  FILE *rc_fp = stage_open_write (ctx, rc_stage);
+  if (!rc_fp)
+    return (opal_exit (ctx, errno));
+
+  /// Remove comments from source with rem_comments(), write to rc_stage
+  ctx->retVal = rem_comments (ctx, ctx->source_fp, rc_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
+
+  if (!opts->quiet)
+    fprintf(stdout, "Removed comments from source file.\n");
 
-  if (alex_fp)
+  /// Close source file pointer source_fp if not NULL
+  sprintf (ctx->perror_msg, "fclose(source_fp)");
+  logger(DEBUG, ctx->perror_msg);
+  if (ctx->source_fp)
     {
-      sprintf (perror_msg, "fclose(alex_fp)");
-      logger(DEBUG, perror_msg);
-      if (fclose (alex_fp) == EXIT_SUCCESS)
+      if (fclose (ctx->source_fp) == EXIT_SUCCESS)
         {
           _PASS;
-          alex_fp = NULL;
+          ctx->source_fp = NULL;
         }
       else
         {
-          perror (perror_msg);
+          perror (ctx->perror_msg);
           _FAIL;
           return (errno);
         }
     }
 
+  /// Open remove_comments() output for reading, else print error and exit
+  rc_fp = stage_open_read (ctx, rc_stage);
+  if (!rc_fp)
+    return (opal_exit (ctx, errno));
+
+  /// Open stage for proc_includes() output, else print error and exit
+  FILE *pi_fp = stage_open_write (ctx, pi_stage);
+  if (!pi_fp)
+    return (opal_exit (ctx, errno));
+
+  /// Process #include directives from source with proc_includes()
+  ctx->retVal = proc_includes (ctx, rc_fp, pi_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    {
+      return (opal_exit (ctx, ctx->retVal));
+    }
+
+  if (!opts->quiet)
+    fprintf(stdout, "Processed #include files.\n");
+
+  /// Open proc_includes() output for reading, else print error and exit
+  pi_fp = stage_open_read (ctx, pi_stage);
+  if (!pi_fp)
+    return (opal_exit (ctx, errno));
+
+  /// Reuse rem_comments() stage for output, else print error and exit
+  rc_fp = stage_open_write (ctx, rc_stage);
+  if (!rc_fp)
+    return (opal_exit (ctx, errno));
+
+  if (!opts->quiet)
+    fprintf(stdout, "Removed comments from included files.\n");
+
+  /// Remove comments from includes files with rem_comments(), write to rc_stage
+  ctx->retVal = rem_comments (ctx, pi_fp, rc_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    {
+      return (opal_exit (ctx, ctx->retVal));
+    }
+
+  /// Release proc_includes() stage, it is no longer needed
+  stage_free (ctx, pi_stage);
+
+  /// Open rem_comments() output for reading, else print error and exit
+  rc_fp = stage_open_read (ctx, rc_stage);
+  if (!rc_fp)
+    return (opal_exit (ctx, errno));
+
+  /// Append MARC output to HTML report
+  ctx->retVal = print_marc_html (ctx, rc_fp, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    {
+      return (opal_exit (ctx, ctx->retVal));
+    }
+
+  /// Look up executable in compilation cache by the source ALEX would read
+  bool use_cache = opts->cache_dir && !opts->save_temps
+      && (opts->backend == backend_Native || opts->backend == backend_Nasm);
+  char cache_key[CACHE_KEY_LEN + 1] = { 0 };
+  *cache_hit = false;
+  if (use_cache)
+    {
+      cache_make_key (opts, rc_stage->data, rc_stage->len, cache_key);
+      ctx->retVal = cache_fetch (ctx, opts, cache_key, cache_hit);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+    }
+
+  /// On a hit there is nothing left to build, finish the report
+  if (*cache_hit)
+    {
+      stage_free (ctx, rc_stage);
+
+      fprintf (ctx->report_fp, "<h3>Compilation cache</h3>\n<hr>\n"
+               "<p>Executable taken from <code>%s/%s</code>, "
+               "<code>ALEX</code>, <code>ASTRO</code> and <code>GENIE</code> "
+               "were skipped.</p>\n", opts->cache_dir, cache_key);
+      ctx->retVal = close_report (ctx, ctx->report_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        opal_exit (ctx, ctx->retVal);
+
+      if (!opts->quiet)
+        fprintf(stdout, "Executable taken from compilation cache.\n"
+                "Output file:\t%s\nCompilation report:\t%s\n", ctx->dest_fn,
+                ctx->report_fn);
+
+      free_arena (ctx);
+      return (opal_exit (ctx, EXIT_SUCCESS));
+    }
+
+  /// Start lexical analyzer code
+  banner (ctx, "ALEX start.");
+
+  /// Reopen rem_comments() output as source_fp, else print error and exit
+  ctx->source_fp = stage_open_read (ctx, rc_stage);
+  if (!ctx->source_fp)
+    return (opal_exit (ctx, errno));
+
+  token_table_s *symbol_table = NULL;  ///< Symbol table, NULL when streaming
+  int symbol_count = 0;                ///< Number of lexemes identified
+
+  if (opts->stream)
+    {
+      /// Tokens are lexed by ASTRO as it parses, so there is no table
+      logger(DEBUG, "Stream tokens to ASTRO without a symbol table.");
+      fprintf (ctx->report_fp,
+               "<h3>Symbol table by Lexical analyzer <code>ALEX</code></h3>\n"
+               "<hr>\n<p>Not built, tokens were streamed to "
+               "<code>ASTRO</code>.</p>\n");
+    }
+  else
+    {
+      /// Create symbol table of tokens
+      logger(DEBUG, "Create symbol_table token arrays.");
+      symbol_table = arena_alloc (ctx, sizeof(token_table_s));
+
+      if (!opts->quiet)
+        fprintf(stdout, "Symbol table of lexemes created.\n");
+
+      /// Build symbol table using rem_comments() output as source
+      ctx->retVal = build_symbol_table (ctx, symbol_table, &symbol_count);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      logger(DEBUG, "assert(symbol_ct [%d] > 0)", symbol_count);
+      assert(symbol_count > 0);
+      _PASS;
+
+      /// Source is fully read, release rem_comments() stage
+      ctx->source_fp = NULL;
+      stage_free (ctx, rc_stage);
+
+      /// Print symbol table with print_symbol_table() to alex temp file
+      if (opts->save_temps)
+        {
+          char alex_tmp[1024] = { 0 };
+          snprintf (alex_tmp, sizeof(alex_tmp), "%salex.tmp", tmp_prefix);
+          stage_buf_s *alex_stage = stage_new (ctx, alex_tmp);
+          FILE *alex_fp = stage_open_write (ctx, alex_stage);
+          if (!alex_fp)
+            return (opal_exit (ctx, errno));
+
+          ctx->retVal = print_symbol_table (ctx, symbol_table, alex_fp);
+          if (ctx->retVal != EXIT_SUCCESS)
+            return (opal_exit (ctx, ctx->retVal));
+
+          ctx->retVal = stage_close (ctx, alex_stage);
+          if (ctx->retVal != EXIT_SUCCESS)
+            return (opal_exit (ctx, ctx->retVal));
+        }
+
+      /// Print symbol table HTML report with print_symbol_table_html()
+      ctx->retVal = print_symbol_table_html (ctx, symbol_table,
+                                             ctx->report_fp);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+    }
+
   /// Start syntax analyzer code
-  banner ("ASTRO start.");
+  banner (ctx, "ASTRO start.");
 
-  /// Build abstract syntax tree using symbol table
-  node_s *syntax_tree = build_syntax_tree (symbol_table);
+  /// Build abstract syntax tree using symbol table, or lexing as it goes
+  node_id syntax_tree = build_syntax_tree (ctx, symbol_table);
+  if (!syntax_tree && opts->stream)
+    return (opal_exit (ctx, errno));
 
   logger(DEBUG, "assert(syntax_tree)");
   assert(syntax_tree);
   _PASS;
 
-  if (!quiet)
+  /// A streamed source is fully read once parsed, release its stage
+  if (opts->stream)
+    {
+      symbol_count = ctx->ast_pos;
+      ctx->source_fp = NULL;
+      stage_free (ctx, rc_stage);
+    }
+
+  if (!opts->quiet)
     fprintf(stdout, "Abstract Syntax Tree created.\n");
 
   /// Print abstract syntax tree HTML report with print_ast_html()
-  fprintf (report_fp, "<h3>Output by syntax analyzer <code>ASTRO</code></h3>\n"
+  fprintf (ctx->report_fp, "<h3>Output by syntax analyzer <code>ASTRO</code></h3>\n"
            "<hr>\n");
-  retVal = print_ast_html (syntax_tree, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  ctx->retVal = print_ast_html (ctx, syntax_tree, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Optimize the abstract syntax tree
-  node_s *syntax_tree_pass1 = optimize_syntax_tree (syntax_tree);
-  node_s *syntax_tree_pass2 = optimize_syntax_tree (syntax_tree_pass1);
+  syntax_tree = optimize_syntax_tree (ctx, syntax_tree);
 
-  if (!quiet)
+  if (!opts->quiet)
     fprintf(stdout, "Abstract Syntax Tree optimization done.\n");
 
   /// Print optimized syntax tree HTML report with print_ast_html()
-  fprintf (report_fp, "<h3>Optimized abstract syntax tree: </h3>\n<hr>\n");
-  retVal = print_ast_html (syntax_tree_pass2, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  fprintf (ctx->report_fp, "<h3>Optimized abstract syntax tree: </h3>\n<hr>\n");
+  ctx->retVal = print_ast_html (ctx, syntax_tree, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
   /// Start code generator
-  banner ("GENIE start.");
+  banner (ctx, "GENIE start.");
+
+  /// Size assembly code tables from the lexemes ALEX found
+  reserve_asm_arrays (ctx, symbol_count);
 
   /// Build assembly code table using
-  gen_asm_code (syntax_tree_pass2);
-  add_asm_code (asm_HALT, 0, NULL);
+  gen_asm_code (ctx, syntax_tree);
+  add_asm_code (ctx, asm_HALT, 0, NULL);
 
-  if (!quiet)
+  if (!opts->quiet)
     fprintf(stdout, "Assembly code generated.\n");
 
-  /// Create and open temp destination file for print_asm_code()
-  char *asm_tmp = "tmp/asm.tmp";
-  logger(DEBUG, "asm_tmp: '%s'", asm_tmp);
+  /// Rewrite assembly code list with peephole optimizer
+  peephole_asm_code (ctx);
 
-  /// If asm temp file can not be written, print error and exit
-  sprintf (perror_msg, "asm_fp = fopen('%s', 'wb')", asm_tmp);
-  logger(DEBUG, perror_msg);
-  errno = EXIT_SUCCESS;
-  FILE *asm_fp = fopen (asm_tmp, "wb");
-  if (errno == EXIT_SUCCESS)
-    _PASS;
-  else
+  if (!opts->quiet)
     {
-      perror (perror_msg);
-      _FAIL;
-      return (errno);
+      char summary[256] = { 0 };
+      peephole_summary (ctx, summary, sizeof(summary));
+      fprintf(stdout, "Peephole optimization done: %s.\n", summary);
     }
 
-  /// Print symbol table with print_symbol_table() to assembly file
-  retVal = print_asm_code (asm_cmd_list, asm_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  /// Print assembly code with print_asm_code_html()
+  ctx->retVal = print_asm_code_html (ctx, ctx->asm_cmd_list, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    return (opal_exit (ctx, ctx->retVal));
 
-  /// Close asm temp file pointer asm_fp if not NULL
-  sprintf (perror_msg, "fclose(asm_fp)");
-  logger(DEBUG, perror_msg);
-  if (asm_fp)
+  /// Start orchestrator
+  banner (ctx, "ORCHESTRATOR start.");
+
+  /// NASM reads the assembly from a file, the native backend needs none
+  bool use_nasm = opts->backend == backend_Nasm
+      || opts->backend == backend_Verify;
+  char asm_tmp[1024] = { 0 };
+  char obj_fn[1024] = { 0 };
+  if (use_nasm || opts->save_temps)
     {
-      if (fclose (asm_fp) == EXIT_SUCCESS)
-        {
-          _PASS;
-          asm_fp = NULL;
-        }
-      else
-        {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
-        }
+      ctx->retVal = write_asm_file (ctx, tmp_prefix, opts, asm_tmp,
+                                    obj_fn);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
     }
 
-  /// Print assembly code with print_asm_code_html()
-  retVal = print_asm_code_html (asm_cmd_list, report_fp);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  /// When verifying, NASM built executable sits next to the native one
+  char nasm_dest_fn[512] = { 0 };
+  snprintf (nasm_dest_fn, sizeof(nasm_dest_fn), "%s%s", ctx->dest_fn,
+            opts->backend == backend_Verify ? ".nasm" : "");
 
-  /// Start orchestrator
-  banner ("ORCHESTRATOR start.");
+  if (use_nasm)
+    {
+      ctx->retVal = build_with_nasm (ctx, asm_tmp, obj_fn, nasm_dest_fn, opts);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+    }
 
-  /// If object object file exists, delete it
-  char *obj_fn = "tmp/nasm.o";
-  sprintf (perror_msg, "access('%s', F_OK)", obj_fn);
-  logger(DEBUG, perror_msg);
-  if (access (obj_fn, F_OK) == EXIT_SUCCESS)
+  /// Execute program in the interpreter instead of writing an executable
+  int run_status = EXIT_SUCCESS;
+  if (opts->backend == backend_Run)
     {
-      sprintf (perror_msg, "remove(%s)", obj_fn);
-      logger(DEBUG, perror_msg);
-      if (remove (obj_fn) == EXIT_SUCCESS)
-        _PASS;
-      else
+      vm_prog_s *prog = vm_load (ctx, ctx->asm_cmd_list);
+      if (prog == NULL)
+        return (opal_exit (ctx, EXIT_FAILURE));
+
+      fflush (stdout);
+      run_status = vm_run (ctx, prog, STDIN_FILENO, STDOUT_FILENO);
+      vm_free (prog);
+    }
+
+  /// Encode machine code and write executable without NASM or ld
+  if (opts->backend == backend_Native || opts->backend == backend_Verify)
+    {
+      ctx->retVal = gen_native_bin (ctx, ctx->asm_cmd_list, ctx->dest_fn);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      if (!opts->quiet)
+        fprintf(stdout, "Write executable using native backend.\n");
+    }
+
+  /// Save executable to compilation cache for the next compilation
+  if (use_cache)
+    {
+      ctx->retVal = cache_store (ctx, opts, cache_key);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      if (!opts->quiet)
+        fprintf(stdout, "Executable saved to compilation cache.\n");
+    }
+
+  /// Run both executables and compare their behaviour
+  if (opts->backend == backend_Verify)
+    {
+      ctx->retVal = verify_native_bin (ctx, ctx->dest_fn, nasm_dest_fn,
+                                       opts->verify_input);
+      if (!opts->save_temps)
+        remove (nasm_dest_fn);
+      if (ctx->retVal != EXIT_SUCCESS)
+        return (opal_exit (ctx, ctx->retVal));
+
+      if (!opts->quiet)
+        fprintf(stdout, "Native executable behaves as NASM executable.\n");
+    }
+
+  /// Close HTML report file
+  ctx->retVal = close_report (ctx, ctx->report_fp);
+  if (ctx->retVal != EXIT_SUCCESS)
+    opal_exit (ctx, ctx->retVal);
+
+  char arena_mark[128] = { 0 };
+  arena_summary (ctx, arena_mark, sizeof(arena_mark));
+  logger(INFO, "Arena high-water mark: %s.", arena_mark);
+
+  if (!opts->quiet && opts->backend != backend_Run)
+    fprintf(stdout, "Output file:\t%s\nCompilation report:\t%s\n"
+            "Arena high-water mark:\t%s\n", ctx->dest_fn, ctx->report_fn,
+            arena_mark);
+
+  /// Free lexemes, syntax tree and code tables with the arena holding them
+  free_arena (ctx);
+
+  /// source_fp, dest_fp, log_fp & report_fp closed by opal_exit()
+  return (opal_exit (ctx, run_status));
+}
+
+/// One source file of a compilation, and its outcome
+typedef struct opal_job
+{
+  char *source_fn;      ///< Source file
+  char name[256];       ///< Base name of source file without extension
+  char dest_fn[512];    ///< Binary to produce
+  char log_fn[512];     ///< Log file of this job
+  char report_fn[512];  ///< HTML report of this job
+  char tmp_prefix[512]; ///< Prefix of files saved with --save-temps
+  int result;           ///< Exit code of compile_file()
+  bool cached;          ///< Executable was taken from compilation cache
+  double seconds;       ///< Wall time taken
+} opal_job_s;
+
+/// Work queue shared by batch worker threads
+typedef struct opal_batch
+{
+  opal_job_s *jobs;         ///< All jobs of the batch
+  int job_count;            ///< Number of jobs
+  int next_job;             ///< Index of next job to hand out
+  int failed;               ///< Number of jobs that failed
+  int cached;               ///< Number of jobs taken from compilation cache
+  opal_opts_s opts;         ///< Options of every job, quiet applies to batch
+  pthread_mutex_t lock;     ///< Guards next_job, failed and standard output
+} opal_batch_s;
+
+/// Seconds elapsed on the monotonic clock
+static double
+now_seconds (void)
+{
+  struct timespec ts = { 0 };
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief       Compile one job in a context of its own
+ *
+ * @details     Library errors that would exit the process are caught with
+ * the context's abort_jmp, so a failing job does not take its batch down.
+ *
+ * @param[in]   job         Job to compile, result and time are filled in
+ * @param[in]   opts        Compilation options
+ * @return      Exit code of the job
+ */
+static int
+run_job (opal_job_s *job, const opal_opts_s *opts)
+{
+  double start = now_seconds ();
+
+  opal_ctx_s *ctx = opal_ctx_new ();
+  if (ctx == NULL)
+    {
+      perror ("opal_ctx_new()");
+      job->result = EXIT_FAILURE;
+      return job->result;
+    }
+  if (opts->debug)
+    ctx->log_level = DEBUG;
+  ctx->tos_cache = opts->tos_cache;
+  ctx->branchless = opts->branchless;
+  ctx->peephole = opts->peephole;
+
+  /// Context owns its copy of the file names, freed by opal_exit()
+  ctx->source_fn = strdup (job->source_fn);
+  ctx->dest_fn = strdup (job->dest_fn);
+  ctx->log_fn = strdup (job->log_fn);
+  ctx->report_fn = strdup (job->report_fn);
+
+  jmp_buf abort_jmp;
+  int result = setjmp (abort_jmp);
+  if (result == 0)
+    {
+      ctx->abort_jmp = &abort_jmp;
+      result = compile_file (ctx, job->tmp_prefix, opts, &job->cached);
+    }
+
+  opal_ctx_free (ctx);
+  job->result = result;
+  job->seconds = now_seconds () - start;
+  return result;
+}
+
+/**
+ * @brief       Batch worker thread, compiles jobs until the queue is empty
+ * @param[in]   arg     Pointer to the shared opal_batch_s
+ * @return      NULL
+ */
+static void*
+batch_worker (void *arg)
+{
+  opal_batch_s *batch = arg;
+
+  /// Progress of individual jobs would interleave, so is not printed
+  opal_opts_s job_opts = batch->opts;
+  job_opts.quiet = true;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&batch->lock);
+      int i = batch->next_job++;
+      pthread_mutex_unlock (&batch->lock);
+      if (i >= batch->job_count)
+        break;
+
+      opal_job_s *job = &batch->jobs[i];
+      run_job (job, &job_opts);
+
+      pthread_mutex_lock (&batch->lock);
+      if (job->result != EXIT_SUCCESS)
+        ++batch->failed;
+      if (job->cached)
+        ++batch->cached;
+      if (!batch->opts.quiet)
         {
-          perror (perror_msg);
-          _FAIL;
-          return (errno);
+          if (job->result == EXIT_SUCCESS)
+            fprintf (stdout, "[ OK ] %s -> %s (%.2fs%s)\n", job->source_fn,
+                     job->dest_fn, job->seconds,
+                     job->cached ? ", cached" : "");
+          else
+            fprintf (stdout, "[FAIL] %s: exit %d, see %s\n", job->source_fn,
+                     job->result, job->log_fn);
+          fflush (stdout);
         }
+      pthread_mutex_unlock (&batch->lock);
     }
 
-  /// Assemble object using NASM
-  retVal = gen_obj (asm_tmp, obj_fn);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  return NULL;
+}
 
-  if (!quiet)
-    fprintf(stdout, "Assemble object file using 'NASM'.\n");
+/**
+ * @brief       Build a job per source file, named after the file
+ *
+ * @details     For FILE 'dir/name.opl' the job writes 'DEST_DIR/name',
+ * 'LOG_DIR/name.log', 'REPORT_DIR/name.html' and saves temps as
+ * 'tmp/name.*'. Two FILEs with the same name would overwrite each other's
+ * outputs, so that is rejected.
+ *
+ * @param[in]   arguments   Parsed command line arguments
+ * @return      Array of arg_count jobs, or NULL on error
+ */
+static opal_job_s*
+make_jobs (struct arguments *arguments)
+{
+  const char *dest_dir = arguments->destfile ? arguments->destfile : ".";
+  const char *log_dir = arguments->logfile ? arguments->logfile : "log";
+  const char *report_dir = arguments->report ? arguments->report : "report";
 
-  /// Link object using LD
-  retVal = gen_bin (obj_fn, dest_fn);
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  opal_job_s *jobs = calloc (arguments->arg_count, sizeof(opal_job_s));
+  if (jobs == NULL)
+    {
+      perror ("calloc(jobs)");
+      return NULL;
+    }
 
-  if (!quiet)
-    fprintf(stdout, "Link object file using 'ld'.\n");
+  for (int i = 0; i < arguments->arg_count; i++)
+    {
+      /// Name of job is base name of source file without extension
+      char path[512] = { 0 };
+      snprintf (path, sizeof(path), "%s", arguments->args[i]);
+      snprintf (jobs[i].name, sizeof(jobs[i].name), "%s", basename (path));
+      char *ext = strrchr (jobs[i].name, '.');
+      if (ext && ext != jobs[i].name)
+        *ext = '\0';
+
+      for (int j = 0; j < i; j++)
+        if (strcmp (jobs[j].name, jobs[i].name) == 0)
+          {
+            fprintf (stderr, "opal: '%s' and '%s' would both compile to '%s'\n",
+                     jobs[j].source_fn, arguments->args[i], jobs[i].name);
+            free (jobs);
+            return NULL;
+          }
+
+      jobs[i].source_fn = arguments->args[i];
+      snprintf (jobs[i].dest_fn, sizeof(jobs[i].dest_fn), "%s/%s", dest_dir,
+                jobs[i].name);
+      snprintf (jobs[i].log_fn, sizeof(jobs[i].log_fn), "%s/%s.log", log_dir,
+                jobs[i].name);
+      snprintf (jobs[i].report_fn, sizeof(jobs[i].report_fn), "%s/%s.html",
+                report_dir, jobs[i].name);
+      snprintf (jobs[i].tmp_prefix, sizeof(jobs[i].tmp_prefix), "tmp/%s.",
+                jobs[i].name);
+    }
 
-  /// Close HTML report file
-  retVal = close_report (report_fp);
-  if (retVal != EXIT_SUCCESS)
-    opal_exit (retVal);
+  return jobs;
+}
 
-  if (!quiet)
-    fprintf(stdout, "Output file:\t%s\nCompilation report:\t%s\n",
-            dest_fn, report_fn);
+/**
+ * @brief       Main function for opal - OPaL compiler
+ * @details
+ * A single FILE is compiled to the given output, log and report files,
+ * printing progress as it goes; see compile_file().
+ *
+ * Several FILEs are compiled as a batch by a pool of --jobs worker threads.
+ * Each job gets its own context, binary, log, report and temp file names,
+ * and a line is printed as each job finishes, followed by a summary.
+ *
+ * 'opal run FILE' compiles FILE quietly and executes it in the interpreter,
+ * exiting with its exit status.
+ *
+ * --cache-stats prints statistics of the compilation cache after any FILE
+ * is compiled; FILE may then be omitted.
+ *
+ * @param[in]   argc    Number of command line arguments
+ * @param[in]   argv    Vector of individual command line argument strings
+ * @return      The error return code of the function.
+ *
+ * @retval      EXIT_SUCCESS    On success
+ * @retval      EXIT_FAILURE    On error, or if any job of a batch failed
+ * @retval      errno           On system call failure
+ */
 
-  /// Free memory used by symbol_table
-  free_symbol_table (symbol_table);
-  symbol_table = NULL;
+int
+main (int argc, char **argv)
+{
 
-  /// Free memory used by syntax_tree
-  free_syntax_tree (syntax_tree);
-  syntax_tree = NULL;
+  /// Create structure to process command line arguments
+  struct arguments arguments =
+    { .destfile = NULL, .logfile = NULL, .report = NULL, .quiet = false,
+      .save_temps = false, .jobs = 1, .backend = backend_Native,
+      .peephole = PEEPHOLE_ALL, .cache_size = CACHE_SIZE_DEFAULT };
 
-  /// Free memory used by ASM array
-  retVal = free_asm_arrays();
-  if (retVal != EXIT_SUCCESS)
-    return (opal_exit (retVal));
+  /// Parse arguments
+  argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
-  /// source_fp, dest_fp, log_fp & report_fp closed by opal_exit()
-  return (opal_exit (EXIT_SUCCESS));
+  opal_opts_s opts =
+    { .debug = arguments.debug, .quiet = arguments.quiet,
+      .save_temps = arguments.save_temps, .backend = arguments.backend,
+      .verify_input = arguments.verify_input,
+      .tos_cache = arguments.tos_cache, .branchless = arguments.branchless,
+      .peephole = arguments.peephole, .cache_dir = arguments.cache_dir,
+      .cache_size = arguments.cache_size };
+
+  /// The symbol table is only built when it is listed in a report or file
+  opts.stream = arguments.stream && !arguments.report
+      && !arguments.save_temps;
+  if (arguments.stream && !opts.stream)
+    fprintf (stderr, "opal: --stream ignored with %s, which lists the symbol "
+             "table\n", arguments.report ? "--report" : "--save-temps");
+
+  /// Output of compiler would mix with output of program, so is not printed
+  if (arguments.run)
+    {
+      opts.backend = backend_Run;
+      opts.quiet = true;
+    }
+
+  /// Compile a single source file to the given or default file names
+  if (arguments.arg_count == 1)
+    {
+      opal_job_s job = { .source_fn = arguments.args[0],
+                         .tmp_prefix = "tmp/" };
+      snprintf (job.dest_fn, sizeof(job.dest_fn), "%s",
+                arguments.destfile ? arguments.destfile : "a.out");
+      snprintf (job.log_fn, sizeof(job.log_fn), "%s",
+                arguments.logfile ? arguments.logfile : "log/oc_log");
+      snprintf (job.report_fn, sizeof(job.report_fn), "%s",
+                arguments.report ? arguments.report : "report/oc_report.html");
+
+      int result = run_job (&job, &opts);
+      if (arguments.cache_stats && opts.backend != backend_Run)
+        print_cache_stats (&opts);
+      return result;
+    }
+
+  /// With no FILE, only print statistics of compilation cache
+  if (arguments.arg_count == 0)
+    return (print_cache_stats (&opts));
+
+  /// Otherwise compile a batch, one job per source file
+  opal_job_s *jobs = make_jobs (&arguments);
+  if (jobs == NULL)
+    return (EXIT_FAILURE);
+
+  opal_batch_s batch =
+    { .jobs = jobs, .job_count = arguments.arg_count, .opts = opts };
+  pthread_mutex_init (&batch.lock, NULL);
+
+  /// Never start more workers than there are jobs
+  int worker_count = arguments.jobs;
+  if (worker_count == 0)
+    worker_count = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  if (worker_count < 1)
+    worker_count = 1;
+  if (worker_count > batch.job_count)
+    worker_count = batch.job_count;
+
+  double start = now_seconds ();
+
+  /// Start workers; if none can be started, work on this thread instead
+  pthread_t *workers = calloc (worker_count, sizeof(pthread_t));
+  int started = 0;
+  while (workers && started < worker_count
+      && pthread_create (&workers[started], NULL, batch_worker, &batch) == 0)
+    ++started;
+
+  if (started == 0)
+    batch_worker (&batch);
+
+  for (int i = 0; i < started; i++)
+    pthread_join (workers[i], NULL);
+
+  if (!arguments.quiet)
+    {
+      fprintf (stdout, "Compiled %d of %d files with %d jobs in %.2fs",
+               batch.job_count - batch.failed, batch.job_count,
+               started ? started : 1, now_seconds () - start);
+      if (arguments.cache_dir)
+        fprintf (stdout, ", %d from cache", batch.cached);
+      fprintf (stdout, ".\n");
+    }
+
+  if (arguments.cache_stats)
+    print_cache_stats (&opts);
+
+  pthread_mutex_destroy (&batch.lock);
+  free (workers);
+  free (jobs);
+
+  return (batch.failed ? EXIT_FAILURE : EXIT_SUCCESS);
 }
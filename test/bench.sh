@@ -0,0 +1,38 @@
+# Benchmark 'opal run' interpreter against native executable on the same
+# program, best of RUNS runs each. Usage: test/bench.sh [FILE.opl] [RUNS]
+source_fn=${1:-input/bench.opl}
+runs=${2:-3}
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+build/opal --quiet --output=output/bench.bin "$source_fn" || exit 1
+
+# Best wall time in seconds of running command RUNS times
+best_time () {
+  local best=""
+  for ((i = 0; i < runs; i++)); do
+    local start=$(date +%s%N)
+    "$@" > /dev/null < /dev/null || return 1
+    local elapsed=$(( $(date +%s%N) - start ))
+    if [[ -z $best || $elapsed -lt $best ]]; then
+      best=$elapsed
+    fi
+  done
+  echo $best
+}
+
+native=$(best_time output/bench.bin) || exit 1
+interp=$(best_time build/opal run "$source_fn") || exit 1
+
+cmp -s <(output/bench.bin < /dev/null) <(build/opal run "$source_fn" < /dev/null)
+if [[ $? -ne 0 ]] ; then
+  printf "Output of interpreter differs from native executable\n"
+  exit 1
+fi
+
+awk -v native=$native -v interp=$interp 'BEGIN {
+  printf "%-12s %10.3f s\n", "native", native / 1e9
+  printf "%-12s %10.3f s\n", "opal run", interp / 1e9
+  printf "%-12s %10.2f x native\n", "interpreter", interp / native
+}'
+exit 0
@@ -0,0 +1,45 @@
+# Benchmark native executables built with and without --branchless on
+# comparisons of random numbers, best of RUNS runs each. The program reads its
+# seed from standard input, SEED or a random one by default.
+# Usage: test/cmpbench.sh [FILE.opl] [RUNS]
+source_fn=${1:-input/cmpbench.opl}
+runs=${2:-3}
+seed=${SEED:-$RANDOM}
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+build/opal --quiet --output=output/cmpbench.bin "$source_fn" || exit 1
+build/opal --quiet --branchless --output=output/cmpbench-branchless.bin \
+  "$source_fn" || exit 1
+
+# Best wall time in seconds of running command RUNS times
+best_time () {
+  local best=""
+  for ((i = 0; i < runs; i++)); do
+    local start=$(date +%s%N)
+    "$@" > /dev/null <<< "$seed" || return 1
+    local elapsed=$(( $(date +%s%N) - start ))
+    if [[ -z $best || $elapsed -lt $best ]]; then
+      best=$elapsed
+    fi
+  done
+  echo $best
+}
+
+jumps=$(best_time output/cmpbench.bin) || exit 1
+setcc=$(best_time output/cmpbench-branchless.bin) || exit 1
+
+cmp -s <(output/cmpbench.bin <<< "$seed") \
+  <(output/cmpbench-branchless.bin <<< "$seed")
+if [[ $? -ne 0 ]] ; then
+  printf "Output of --branchless executable differs\n"
+  exit 1
+fi
+
+awk -v seed=$seed -v jumps=$jumps -v setcc=$setcc 'BEGIN {
+  printf "%-12s %10d\n", "seed", seed
+  printf "%-12s %10.3f s\n", "jumps", jumps / 1e9
+  printf "%-12s %10.3f s\n", "branchless", setcc / 1e9
+  printf "%-12s %10.2f x branchless\n", "jumps", jumps / setcc
+}'
+exit 0
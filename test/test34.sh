@@ -0,0 +1,52 @@
+printf "build/opal --quiet --jobs=2 input/test2.opl input/test2.opl\n";
+
+export LD_LIBRARY_PATH=build/
+build/opal --quiet --jobs=2 input/test2.opl input/test2.opl
+if [[ $? -ne 1 ]] ; then
+  exit 1
+fi
+
+printf "build/opal --quiet --jobs=2 input/no_file_1.opl input/no_file_2.opl\n";
+build/opal --quiet --jobs=2 input/no_file_1.opl input/no_file_2.opl
+if [[ $? -ne 1 ]] ; then
+  exit 1
+fi
+
+## A log that can not be opened fails its jobs, it does not abort the batch
+printf "build/opal --quiet --jobs=2 --log=output/no_dir/log input/test2.opl input/calc.opl\n";
+build/opal --quiet --jobs=2 --log=output/no_dir/log input/test2.opl \
+  input/calc.opl
+if [[ $? -ne 1 ]] ; then
+  exit 1
+fi
+
+## Each FILE of a batch gets its own working binary, log and report
+printf "build/opal --quiet --jobs=2 --output=output/test34 --log=output/test34 --report=output/test34 input/calc.opl input/Sequences.opl\n";
+rm -rf output/test34
+mkdir -p output/test34
+build/opal --quiet --jobs=2 --output=output/test34 --log=output/test34 \
+  --report=output/test34 input/calc.opl input/Sequences.opl
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+for f in calc calc.log calc.html Sequences Sequences.log Sequences.html ; do
+  if [[ ! -f output/test34/$f ]] ; then
+    exit 1
+  fi
+done
+output/test34/calc < test/test35.in | cmp - test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+build/opal run input/Sequences.opl < test/test35.in > output/test34/Sequences.out
+output/test34/Sequences < test/test35.in | cmp - output/test34/Sequences.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal --jobs=x input/test2.opl\n";
+build/opal --jobs=x input/test2.opl
+if [[ $? -ne 64 ]] ; then
+  exit 1
+fi
+exit 0
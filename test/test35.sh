@@ -0,0 +1,54 @@
+printf "build/opal --quiet --output=output/test35.bin input/calc.opl\n";
+
+export LD_LIBRARY_PATH=build/
+build/opal --quiet --output=output/test35.bin input/calc.opl
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "output/test35.bin < test/test35.in\n";
+output/test35.bin < test/test35.in > output/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+cmp output/test35.out test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal --quiet --tos-cache --output=output/test35.bin input/calc.opl\n";
+build/opal --quiet --tos-cache --output=output/test35.bin input/calc.opl
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+output/test35.bin < test/test35.in | cmp - test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal --quiet --branchless --output=output/test35.bin input/calc.opl\n";
+build/opal --quiet --branchless --output=output/test35.bin input/calc.opl
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+output/test35.bin < test/test35.in | cmp - test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal --quiet --branchless --tos-cache --output=output/test35.bin input/calc.opl\n";
+build/opal --quiet --branchless --tos-cache --output=output/test35.bin input/calc.opl
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+output/test35.bin < test/test35.in | cmp - test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal --backend=bogus input/test2.opl\n";
+build/opal --backend=bogus input/test2.opl
+if [[ $? -ne 64 ]] ; then
+  exit 1
+fi
+exit 0
@@ -0,0 +1,30 @@
+printf "build/opal run input/calc.opl < test/test35.in\n";
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+build/opal run input/calc.opl < test/test35.in > output/test36.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+cmp output/test36.out test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal -q run --tos-cache input/calc.opl < test/test35.in\n";
+build/opal -q run --tos-cache input/calc.opl < test/test35.in \
+  > output/test36.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+cmp output/test36.out test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal run input/test2.opl input/calc.opl\n";
+build/opal run input/test2.opl input/calc.opl
+if [[ $? -ne 64 ]] ; then
+  exit 1
+fi
+exit 0
@@ -0,0 +1,915 @@
+; github.com/torvalds/linux/blob/master/arch/x86/entry/syscalls/syscall_64.tbl
+%define SYS_READ  0
+%define SYS_WRITE 1
+%define SYS_OPEN  2
+%define SYS_EXIT 60
+
+; pubs.opengroup.org/onlinepubs/9699919799/basedefs/unistd.h.html
+%define STDIN     0
+%define STDOUT    1
+%define STDERR    2
+
+; pubs.opengroup.org/onlinepubs/9699919799/basedefs/stdlib.h.html
+%define EXIT_SUCCESS 0
+%define EXIT_FAILURE 1
+
+; Constants for better code readability
+%define NULL    0
+%define isTrue  1
+%define isFalse 0
+
+; Sizes of output buffer 'obuf' and input buffer 'ibuf', must match
+; OBUF_SIZE and IBUF_SIZE of include/libopal.h
+%define OBUF_SIZE 4096
+%define IBUF_SIZE 65536
+
+; =============================================================================
+; Arithematic instructions
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - O_ADD
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Sum of integers on top of stack
+; Desc  - Push (stack[-1] + stack[-2]) on stack
+; -----------------------------------------------------------------------------
+%macro O_ADD 0
+  POP  RAX                  ; Get 'a' from stack
+  POP  RBX                  ; Get 'b' from stack
+  ADD  RAX, RBX             ; Sum a + b
+  PUSH RAX                  ; Push sum onto stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SUB
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Different of integers on top of stack
+; Desc  - Push (stack[-2] - stack[-1]) on stack
+; -----------------------------------------------------------------------------
+%macro O_SUB 0
+  POP  RBX                  ; Get 'a' from stack
+  POP  RAX                  ; Get 'b' from stack
+  SUB  RAX, RBX             ; Subtract a - b
+  PUSH RAX                  ; Push difference onto stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_NEGATE
+; Args  - None
+; Pre   - Operand integer on top of stack
+; Post  - Negative of integer on stack
+; Desc  - Push negative of stack[-1] on stack
+; -----------------------------------------------------------------------------
+%macro O_NEGATE 0
+  POP   RAX                 ; Get 'a' from stack
+  NEG   RAX                 ; Negate a
+  PUSH  RAX                 ; Push -(a) onto stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_MUL
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Product of integers on top of stack
+; Desc  - Push (stack[-1] * stack[-2]) on stack
+; -----------------------------------------------------------------------------
+%macro O_MUL 0
+  POP  RAX                  ; Get 'a' from stack
+  POP  RBX                  ; Get 'b' from stack
+  IMUL RBX                  ; Multiply a * b
+  PUSH RAX                  ; Push product onto stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_DIV
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Quotient of integer division on stack
+; Desc  - Push (stack[-2] / stack[-1]) on stack
+; -----------------------------------------------------------------------------
+%macro O_DIV 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  XOR  RDX, RDX             ; Clear for division
+  IDIV RBX                  ; Divide a / b
+  PUSH RAX                  ; Push dividend onto stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_MOD
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Remainder of integer division on stack
+; Desc  - Push (stack[-2] % stack[-1]) on stack
+; -----------------------------------------------------------------------------
+%macro O_MOD 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  XOR  RDX, RDX             ; Clear for division
+  IDIV RBX                  ; Divide a / b
+  PUSH RDX                  ; Push remainder onto stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_EQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - If stack[-1] == stack[-2], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_EQ 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  CMP  RAX, RBX             ; a ?? b
+  JNE  %%a_neq_b
+  PUSH isTrue               ; a == b
+  JMP  %%end
+%%a_neq_b:
+  PUSH isFalse              ; a != b
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_NEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - If stack[-1] != stack[-2], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_NEQ 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  CMP  RAX, RBX             ; a ?? b
+  JE   %%a_eq_b
+  PUSH isTrue               ; a != b
+  JMP  %%end
+%%a_eq_b:
+  PUSH isFalse              ; a == b
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_LSS
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - If stack[-2] < stack[-1], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_LSS 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  CMP  RAX, RBX             ; a ?? b
+  JNL  %%a_geq_b
+  PUSH isTrue               ; a < b
+  JMP  %%end
+%%a_geq_b:
+  PUSH isFalse              ; a >= b
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_GTR
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - If stack[-2] > stack[-1], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_GTR 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  CMP  RAX, RBX             ; a ?? b
+  JNG  %%a_leq_b
+  PUSH isTrue               ; a > b
+  JMP  %%end
+%%a_leq_b:
+  PUSH isFalse              ; a <= b
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_LEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - If stack[-2] <= stack[-1], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_LEQ 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  CMP  RAX, RBX             ; a ?? b
+  JG   %%a_gtr_b
+  PUSH isTrue               ; a <= b
+  JMP  %%end
+%%a_gtr_b:
+  PUSH isFalse              ; a > b
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_GEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - If stack[-2] >= stack[-1], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_GEQ 0
+  POP  RBX                  ; Get 'b' from stack
+  POP  RAX                  ; Get 'a' from stack
+  CMP  RAX, RBX             ; a ?? b
+  JL  %%a_less_b
+  PUSH isTrue               ; a >= b
+  JMP  %%end
+%%a_less_b:
+  PUSH isFalse              ; a < b
+%%end:
+%endmacro
+
+; =============================================================================
+; Logical instructions
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - O_AND
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Logical AND result of integers on stack
+; Desc  - If stack[-1] && stack[-2], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_AND 0
+  POP  RAX               ; Get 'a' from stack
+  POP  RBX               ; Get 'b' from stack
+  AND  RAX, RBX          ; a && b
+  JNZ  %%a_and_b
+  PUSH isFalse           ; If (a && b) is zero, push isFalse ..
+  JMP  %%end
+%%a_and_b:
+  PUSH isTrue            ; .. else, push isTrue
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_OR
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Logical OR result of integers on stack
+; Desc  - If stack[-1] || stack[-2], push isTrue on stack, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_OR 0
+  POP  RAX               ; Get 'a' from stack
+  POP  RBX               ; Get 'b' from stack
+  OR   RAX, RBX          ; a || b
+  JNZ  %%a_or_b
+  PUSH isFalse           ; If (a || b) is zero, push isFalse ..
+  JMP  %%end
+%%a_or_b:
+  PUSH isTrue            ; .. else, push isTrue
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_NOT
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Logical NOT result of integer on top of stack
+; Desc  - If stack[-1] is non-zero, push isFalse, if value is 0, push isTrue
+; -----------------------------------------------------------------------------
+%macro O_NOT 0
+  POP  RAX               ; Get integer from stack
+  CMP  RAX, 0            ; Compare value with 0
+  JNE  %%nz
+  PUSH isTrue            ; If value is zero, push isTrue on stack ..
+  JMP  %%end
+%%nz:
+  PUSH isFalse           ; .. else, push isFalse on stack
+%%end:
+%endmacro
+
+; =============================================================================
+; Branch-free comparison and logical instructions, used by 'opal --branchless'
+; in place of the macros above. Results are the same, but are set from the
+; flags with SETcc instead of by a conditional jump, so they do not depend on
+; branch prediction.
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - Branch-free O_EQ: push (stack[-2] == stack[-1]) as isTrue/isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETEQ 0
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  SETE  AL               ; AL = (a == b)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETNEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - Branch-free O_NEQ: push (stack[-2] != stack[-1]) as isTrue/isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETNEQ 0
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  SETNE AL               ; AL = (a != b)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETLSS
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - Branch-free O_LSS: push (stack[-2] < stack[-1]) as isTrue/isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETLSS 0
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  SETL  AL               ; AL = (a < b)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETGTR
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - Branch-free O_GTR: push (stack[-2] > stack[-1]) as isTrue/isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETGTR 0
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  SETG  AL               ; AL = (a > b)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETLEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - Branch-free O_LEQ: push (stack[-2] <= stack[-1]) as isTrue/isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETLEQ 0
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  SETLE AL               ; AL = (a <= b)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETGEQ
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Integer comparison result on stack
+; Desc  - Branch-free O_GEQ: push (stack[-2] >= stack[-1]) as isTrue/isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETGEQ 0
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  SETGE AL               ; AL = (a >= b)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETAND
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Logical AND result of integers on stack
+; Desc  - Branch-free O_AND: push isTrue if (stack[-1] & stack[-2]) != 0
+; -----------------------------------------------------------------------------
+%macro O_SETAND 0
+  POP  RAX               ; Get 'a' from stack
+  POP  RBX               ; Get 'b' from stack
+  TEST RAX, RBX          ; a && b
+  SETNZ AL               ; AL = ((a & b) != 0)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETOR
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Logical OR result of integers on stack
+; Desc  - Branch-free O_OR: push isTrue if (stack[-1] | stack[-2]) != 0
+; -----------------------------------------------------------------------------
+%macro O_SETOR 0
+  POP  RAX               ; Get 'a' from stack
+  POP  RBX               ; Get 'b' from stack
+  OR   RAX, RBX          ; a || b
+  SETNZ AL               ; AL = ((a | b) != 0)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_SETNOT
+; Args  - None
+; Pre   - Operand integers on top of stack
+; Post  - Logical NOT result of integer on top of stack
+; Desc  - Branch-free O_NOT: push isTrue if stack[-1] is 0, else isFalse
+; -----------------------------------------------------------------------------
+%macro O_SETNOT 0
+  POP  RAX               ; Get integer from stack
+  TEST RAX, RAX          ; Compare value with 0
+  SETZ AL                ; AL = (value == 0)
+  MOVZX EAX, AL          ; Zero extend to RAX
+  PUSH RAX               ; Push isTrue/isFalse
+%endmacro
+
+; =============================================================================
+; Data operation instructions
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - _INPUT_
+; Args  - None
+; Pre   - Prompt string index on top of stack
+; Post  - User input integer on top of stack
+; Desc  - Reads a line from user and pushes the integer it starts with on top
+;         of stack. Lines are read from STDIN in blocks of up to IBUF_SIZE
+;         bytes into 'ibuf', and bytes after the line are kept there for the
+;         next _INPUT_. Output is flushed before each read, so the prompt
+;         appears before the program waits for input. A leading '-' negates,
+;         conversion stops at the first non digit, and the rest of the line
+;         is skipped. End of file ends the line.
+; -----------------------------------------------------------------------------
+%macro _INPUT_ 0
+  O_PRTS                 ; Print prompt string with macro
+
+  XOR  RAX, RAX          ; RAX will hold converted integer, starts off as 0
+  XOR  R8, R8            ; R8 will be the flag for negative value
+  XOR  R10, R10          ; R10 is 0 at start of line, 1 in digits, 2 after
+  MOV  RSI, [ipos]       ; RSI is index of next byte in buffer
+  MOV  R9, [iend]        ; R9 is number of bytes in buffer
+
+%%next:
+  CMP  RSI, R9           ; If bytes are left in buffer ..
+  JB   %%byte            ; .. process next one
+  PUSH RAX               ; .. else, save integer ..
+  _FLUSH_                ; .. write prompt and earlier output ..
+  MOV  RAX, SYS_READ     ; .. and read next block ..
+  MOV  RDI, STDIN        ; .. of user input from STDIN ..
+  MOV  RSI, ibuf         ; .. to start of buffer
+  MOV  RDX, IBUF_SIZE
+  SYSCALL                ; Call kernel
+  MOV  R9, RAX           ; Bytes read are new number of bytes in buffer
+  POP  RAX
+  XOR  RSI, RSI          ; Next byte is at start of buffer
+  CMP  R9, 0             ; If any bytes were read ..
+  JG   %%byte            ; .. process first one
+  XOR  R9, R9            ; .. else, end of file or error ends the line
+  JMP  %%end
+
+%%byte:
+  MOVZX EBX, BYTE [ibuf+RSI] ; Get next byte of line
+  INC  RSI
+  CMP  BL, 0ah           ; If byte is newline ..
+  JE   %%end             ; .. end reading user input
+  CMP  R10, 1            ; If past the digits ..
+  JA   %%next            ; .. skip rest of line
+  JE   %%digit           ; If in the digits, convert byte
+  MOV  R10, 1            ; At start of line ..
+  CMP  BL, 45            ; .. if byte is -ve sign ..
+  JNE  %%digit
+  MOV  R8, 1d            ; .. set negative integer flag
+  JMP  %%next
+
+%%digit:
+  SUB  EBX, 48           ; Get decimal value from ASCII
+  CMP  EBX, 9            ; If byte is not a digit ..
+  JA   %%past            ; .. conversion ends
+  IMUL RAX, RAX, 10      ; Multiply current value by 10 ..
+  ADD  RAX, RBX          ; .. and add digit to it
+  JMP  %%next
+%%past:
+  MOV  R10, 2            ; Skip rest of line
+  JMP  %%next
+
+%%end:
+  MOV  [ipos], RSI       ; Keep bytes after the line ..
+  MOV  [iend], R9        ; .. for next _INPUT_
+  CMP  R8, 1d            ; If negative integer flag is not set ..
+  JNE  %%push_val        ; .. jump to label push_val ..
+  NEG  RAX               ; .. else negate value
+
+; Push integer value on top of stack
+%%push_val:
+  PUSH RAX               ; Push result integer value to top of stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - _FETCH_
+; Args  - Array index
+; Pre   - None
+; Post  - Push value at data[index] on top of stack
+; Desc  - Gets integer from array 'data[index]' and pushes it on top of stack
+; -----------------------------------------------------------------------------
+%macro _FETCH_ 1
+  MOV  RAX,[data+(8*%1)] ; Get from [source] + (size) * index
+  PUSH RAX               ; Push integer on top of stack
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - _STORE_
+; Args  - Array index
+; Pre   - Integer to store on top of stack
+; Post  - data[index] = integer at top of stack
+; Desc  - Stores integer from top of stack into array 'data' at given index
+; -----------------------------------------------------------------------------
+%macro _STORE_ 1
+  POP  RAX               ; Get integer to store
+  MOV  [data+(8*%1)],RAX ; Store in [destination] + (size) * index
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - _TEE_
+; Args  - Array index
+; Pre   - Integer to store on top of stack
+; Post  - data[index] = integer at top of stack, integer left on stack
+; Desc  - Stores integer from top of stack into array 'data' at given index
+;         without popping it
+; -----------------------------------------------------------------------------
+%macro _TEE_ 1
+  MOV  RAX, [RSP]        ; Get integer to store, leave it on stack
+  MOV  [data+(8*%1)],RAX ; Store in [destination] + (size) * index
+%endmacro
+
+; =============================================================================
+; Logical instructions
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - O_JZ
+; Args  - Label to jump to
+; Pre   - Value to compare with 0 on top of stack
+; Post  - None
+; Desc  - If top of stack is 0, jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JZ 1
+  POP  RAX               ; Get value from top of stack ..
+  CMP  RAX, 0            ; .. and compare with zero
+  JE   %1                ; If value is zero, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JNZ
+; Args  - Label to jump to
+; Pre   - Value to compare with 0 on top of stack
+; Post  - None
+; Desc  - If top of stack is non-zero, jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JNZ 1
+  POP  RAX               ; Get value from top of stack ..
+  CMP  RAX, 0            ; .. and compare with zero
+  JNE  %1                ; If value is non-zero, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JEQ
+; Args  - Label to jump to
+; Pre   - Operand integers on top of stack
+; Post  - None
+; Desc  - Pop operands, if stack[-2] == stack[-1], jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JEQ 1
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  JE   %1                ; If a == b, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JNEQ
+; Args  - Label to jump to
+; Pre   - Operand integers on top of stack
+; Post  - None
+; Desc  - Pop operands, if stack[-2] != stack[-1], jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JNEQ 1
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  JNE  %1                ; If a != b, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JLSS
+; Args  - Label to jump to
+; Pre   - Operand integers on top of stack
+; Post  - None
+; Desc  - Pop operands, if stack[-2] < stack[-1], jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JLSS 1
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  JL   %1                ; If a < b, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JGTR
+; Args  - Label to jump to
+; Pre   - Operand integers on top of stack
+; Post  - None
+; Desc  - Pop operands, if stack[-2] > stack[-1], jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JGTR 1
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  JG   %1                ; If a > b, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JLEQ
+; Args  - Label to jump to
+; Pre   - Operand integers on top of stack
+; Post  - None
+; Desc  - Pop operands, if stack[-2] <= stack[-1], jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JLEQ 1
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  JLE  %1                ; If a <= b, jump to given label
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_JGEQ
+; Args  - Label to jump to
+; Pre   - Operand integers on top of stack
+; Post  - None
+; Desc  - Pop operands, if stack[-2] >= stack[-1], jump to given label
+; -----------------------------------------------------------------------------
+%macro O_JGEQ 1
+  POP  RBX               ; Get 'b' from stack
+  POP  RAX               ; Get 'a' from stack
+  CMP  RAX, RBX          ; a ?? b
+  JGE  %1                ; If a >= b, jump to given label
+%endmacro
+
+; =============================================================================
+; Print instructions
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - _FLUSH_
+; Args  - None
+; Pre   - None
+; Post  - Output buffer 'obuf' is empty
+; Desc  - Writes bytes buffered in 'obuf' by O_PRTS and O_PRTI to STDOUT
+; -----------------------------------------------------------------------------
+%macro _FLUSH_ 0
+  MOV  RDX, [olen]       ; Get number of bytes in output buffer
+  CMP  RDX, 0            ; If buffer is empty ..
+  JE   %%end             ; .. there is nothing to write
+  MOV  RSI, obuf         ; Write from start of buffer
+  MOV  RAX, SYS_WRITE    ; Use sys_write system call
+  MOV  RDI, STDOUT       ; Output to stdout
+  SYSCALL                ; Call kernel
+  CMP  RDX, RAX          ; If sys_write wrote expected number of bytes ..
+  JE   %%empty           ; .. empty the buffer
+  HALT RAX               ; .. else, exit with difference as code ..
+%%empty:
+  MOV  QWORD [olen], 0   ; Buffer holds no bytes
+%%end:
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_PRTS
+; Args  - None
+; Pre   - strs[index] to print on top of stack
+; Post  - None
+; Desc  - Appends string at 'strs[index]' to output buffer, flushing it to
+;         STDOUT whenever it fills up
+; -----------------------------------------------------------------------------
+%macro O_PRTS 0
+  POP  RAX               ; Get index of string to print from stack
+
+  MOV  RBX, 8d           ; Add (index*8) to array address ..
+  IMUL RBX               ; .. to get string address
+
+  MOV  RSI, [strs+RAX]   ; Get address of string to print
+  MOV  RDX, [lens+RAX]   ; Get length of string to print
+%%copy:
+  MOV  RCX, OBUF_SIZE    ; Free space in buffer is its size ..
+  SUB  RCX, [olen]       ; .. less number of bytes in it
+  JNZ  %%room            ; If buffer is full ..
+  PUSH RSI               ; .. save rest of string ..
+  PUSH RDX
+  _FLUSH_                ; .. and write buffer to stdout
+  POP  RDX
+  POP  RSI
+  JMP  %%copy
+%%room:
+  CMP  RCX, RDX          ; If rest of string does not fit ..
+  JBE  %%copy_n          ; .. copy as many bytes as fit ..
+  MOV  RCX, RDX          ; .. else copy all of it
+%%copy_n:
+  SUB  RDX, RCX          ; Bytes of string left after copy
+  MOV  RDI, obuf         ; RDI points past bytes in buffer
+  ADD  RDI, [olen]
+  ADD  [olen], RCX       ; Count bytes copied
+  REP  MOVSB             ; Copy RCX bytes from RSI to RDI
+  CMP  RDX, 0            ; If bytes of string are left ..
+  JNE  %%copy            ; .. flush full buffer and copy them
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - O_PRTI
+; Args  - None
+; Pre   - Integer to print on top of stack
+; Post  - None
+; Desc  - Appends integer on top of stack to output buffer as decimal digits,
+;         flushing buffer to STDOUT first if they may not fit. Digits are
+;         counted first, then stored from the last one back, two at a time
+;         from table 'pairs', dividing by 100 with a multiply by reciprocal
+; -----------------------------------------------------------------------------
+%macro O_PRTI 0
+  CMP  QWORD [olen], OBUF_SIZE - 20 ; If sign and 19 digits fit in buffer ..
+  JBE  %%room            ; .. append them
+  _FLUSH_                ; .. else, write buffer to stdout first
+%%room:
+  POP  RAX               ; Get integer from stack
+  MOV  RDI, obuf         ; RDI points past bytes in buffer
+  ADD  RDI, [olen]
+
+  CMP  RAX, 0            ; Check if number is negative
+  JGE  %%start           ; If number is positive, print number
+  MOV  BYTE [RDI], '-'   ; Append '-' sign
+  INC  RDI
+  NEG  RAX               ; If number is negative, get positive value
+%%start:
+  MOV  RCX, 1            ; RCX will hold number of digits
+  MOV  RDX, 10           ; RDX is least number with one more digit
+%%count:
+  CMP  RAX, RDX          ; If number is less than RDX ..
+  JB   %%counted         ; .. all digits are counted
+  INC  RCX
+  IMUL RDX, RDX, 10
+  JMP  %%count
+%%counted:
+  ADD  RDI, RCX          ; RDI points past last digit
+  MOV  R8, RDI           ; Which is new end of bytes in buffer
+%%pairs:
+  CMP  RAX, 100          ; If less than 3 digits are left ..
+  JB   %%last            ; .. store last ones
+  MOV  RBX, RAX          ; Keep number
+  SHR  RAX, 2            ; Quotient of number by 100 is (number / 4) ..
+  MOV  RDX, 0x28F5C28F5C28F5C3 ; .. times 2^68 / 100, rounded up ..
+  MUL  RDX
+  MOV  RAX, RDX          ; .. divided by 2^64 ..
+  SHR  RAX, 2            ; .. and by 4
+  IMUL RDX, RAX, 100     ; Remainder is number less quotient times 100
+  SUB  RBX, RDX
+  MOVZX EDX, WORD [pairs+RBX*2] ; Get two digits of remainder ..
+  SUB  RDI, 2
+  MOV  [RDI], DX         ; .. and store them before digits stored so far
+  JMP  %%pairs
+%%last:
+  CMP  RAX, 10           ; If one digit is left ..
+  JB   %%one             ; .. store it
+  MOVZX EDX, WORD [pairs+RAX*2] ; .. else store last two digits
+  MOV  [RDI-2], DX
+  JMP  %%end
+%%one:
+  ADD  AL, 48            ; Add 48 to convert decimal to ASCII
+  MOV  [RDI-1], AL
+%%end:
+  SUB  R8, obuf          ; Number of bytes in buffer is ..
+  MOV  [olen], R8        ; .. end of digits less start of buffer
+%endmacro
+
+; =============================================================================
+; Execution instructions
+; =============================================================================
+
+; -----------------------------------------------------------------------------
+; Macro - HALT
+; Args  - None
+; Pre   - None
+; Post  - None
+; Desc  - Writes buffered output, then runs SYS_EXIT system call with code - 0
+; -----------------------------------------------------------------------------
+%macro HALT 0
+  _FLUSH_                ; Write output left in buffer
+  MOV  RAX, SYS_EXIT     ; Use SYS_EXIT system call to exit ..
+  MOV  RDI, 0            ; .. with exit code 0
+  SYSCALL
+%endmacro
+
+; -----------------------------------------------------------------------------
+; Macro - HALT
+; Args  - Exit code
+; Pre   - None
+; Post  - None
+; Desc  - Runs SYS_EXIT system call with given code
+; -----------------------------------------------------------------------------
+%macro HALT 1
+  MOV  RAX, SYS_EXIT     ; Use SYS_EXIT system call to exit ..
+  MOV  RDI, %1           ; .. with given argument as exit code
+  SYSCALL
+%endmacro
+
+; =============================================================================
+; Program instructions
+; =============================================================================
+
+SECTION .text
+global _start
+  _start:
+
+  NOP
+  ;=== User code start ===;
+  PUSH	5
+  _TEE_	0
+  PUSH	2
+  O_MUL
+  _STORE_	1
+  _FETCH_	0
+  _FETCH_	1
+  O_JLSS		_else_8
+  PUSH	0
+  O_PRTS
+_else_8:
+  _FETCH_	0
+  _FETCH_	1
+  O_JEQ		_fi_19
+  PUSH	1
+  O_PRTS
+_fi_19:
+_while_loop_28:
+  _FETCH_	1
+  _FETCH_	0
+  O_JLEQ		_while_end_28
+  _FETCH_	1
+  PUSH	1
+  O_SUB
+  _STORE_	1
+  JMP		_while_loop_28
+_while_end_28:
+  _FETCH_	0
+  O_PRTI
+  PUSH	2
+  O_PRTS
+  _FETCH_	1
+  O_PRTI
+  PUSH	3
+  O_PRTS
+  HALT
+  ;=== User code end ===;
+
+SECTION .bss
+  olen RESQ 1            ; number of bytes in output buffer
+  ipos RESQ 1            ; index of next byte in input buffer
+  iend RESQ 1            ; number of bytes in input buffer
+  obuf RESB OBUF_SIZE    ; output buffer of O_PRTS and O_PRTI
+  ibuf RESB IBUF_SIZE    ; input buffer of _INPUT_
+
+SECTION .data
+  ; Two ASCII digits of each number from 0 to 99, used by O_PRTI
+  pairs DB "00010203040506070809"
+        DB "10111213141516171819"
+        DB "20212223242526272829"
+        DB "30313233343536373839"
+        DB "40414243444546474849"
+        DB "50515253545556575859"
+        DB "60616263646566676869"
+        DB "70717273747576777879"
+        DB "80818283848586878889"
+        DB "90919293949596979899"
+
+  ;=== User variables ===;
+  ; === Strings ===;
+  msg0: DB "a >= b", 13, 10, "", NULL
+  len0 EQU $ - msg0
+  msg1: DB "a != b", 13, 10, "", NULL
+  len1 EQU $ - msg1
+  msg2: DB " ", NULL
+  len2 EQU $ - msg2
+  msg3: DB "", 13, 10, "", NULL
+  len3 EQU $ - msg3
+  strs: DQ msg0, msg1, msg2, msg3, 
+  lens: DQ len0, len1, len2, len3, 
+  ; === Integers ===;
+  data  TIMES 2 DQ 0
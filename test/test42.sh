@@ -0,0 +1,36 @@
+printf "build/opal output/test42.opl, 5000 variables and strings\n";
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+
+## More commands, variables and strings than the old fixed tables held
+rm -f output/test42.opl
+for i in $(seq 0 4999) ; do
+  printf "v%d = %d;\n" $i $i >> output/test42.opl
+done
+printf "s = 0;\n" >> output/test42.opl
+for i in $(seq 0 4999) ; do
+  printf "s = s + v%d;\nprint(\"s%d \");\n" $i $i >> output/test42.opl
+done
+printf "print(s, \"\\\\n\");\n" >> output/test42.opl
+
+build/opal --quiet output/test42.opl -o output/test42.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+output/test42.bin < /dev/null | tr -d '\0' > output/test42.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+grep -q "s4999 12497500" output/test42.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal run output/test42.opl\n";
+build/opal run --quiet output/test42.opl < /dev/null | tr -d '\0' \
+  | cmp - output/test42.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+exit 0
@@ -0,0 +1,55 @@
+printf "build/opal --stream input/calc.opl\n";
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+
+## Parsing while lexing must give the same binary as the symbol table does
+build/opal --quiet input/calc.opl -o output/test43.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+build/opal --quiet --stream input/calc.opl -o output/test43s.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+cmp output/test43.bin output/test43s.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## The report says the symbol table was not built
+grep -q "tokens were streamed" report/oc_report.html
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal run --stream input/calc.opl < test/test35.in\n";
+build/opal run --stream input/calc.opl < test/test35.in | cmp - test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## With --report the symbol table is built to be listed
+printf "build/opal --stream --report=output/test43.html input/calc.opl\n";
+build/opal --quiet --stream --report=output/test43.html input/calc.opl \
+  -o output/test43s.bin 2> output/test43.err
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+grep -q "stream ignored with --report" output/test43.err
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+grep -q "tokens were streamed" output/test43.html
+if [[ $? -eq 0 ]] ; then
+  exit 1
+fi
+
+## Syntax errors are still reported
+printf "build/opal --stream output/test43.opl\n";
+printf "a = 1;\nif (a) { b = ; }\n" > output/test43.opl
+build/opal --quiet --stream output/test43.opl -o output/test43s.bin
+if [[ $? -eq 0 ]] ; then
+  exit 1
+fi
+exit 0
@@ -0,0 +1,32 @@
+printf "build/opal output/test44.opl, 120000 statements\n";
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+
+## A statement sequence far longer than the C stack could recurse down
+printf "s = 0;\n" > output/test44.opl
+for i in $(seq 0 59999) ; do
+  printf "a = %d;\ns = s + a;\n" $((i % 1000))
+done >> output/test44.opl
+printf "print(s, \"\\\\n\");\n" >> output/test44.opl
+
+build/opal --quiet output/test44.opl -o output/test44.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+output/test44.bin < /dev/null | tr -d '\0' > output/test44.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+grep -q "29970000" output/test44.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+printf "build/opal run output/test44.opl\n";
+build/opal run --quiet output/test44.opl < /dev/null | tr -d '\0' \
+  | cmp - output/test44.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+exit 0
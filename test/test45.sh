@@ -0,0 +1,45 @@
+printf "build/alex --ir, build/astro --ir, build/genie input/calc.opl\n";
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+
+## Save the tokens and the syntax tree as binary IR files
+build/alex input/calc.opl -i output/test45.otk -o output/test45.alex
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+build/astro output/test45.otk -i output/test45.oast -o output/test45.astro
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## The syntax tree built from saved tokens matches the one built from source
+build/astro input/calc.opl -o output/test45s.astro
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+cmp output/test45.astro output/test45s.astro
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## The code generated from source, tokens or syntax tree is the same
+for f in input/calc.opl output/test45.otk output/test45.oast ; do
+  build/genie -t -B $f -o output/test45.$(basename $f).asm
+  if [[ $? -ne 0 ]] ; then
+    exit 1
+  fi
+  cmp output/test45.calc.opl.asm output/test45.$(basename $f).asm
+  if [[ $? -ne 0 ]] ; then
+    exit 1
+  fi
+done
+
+## A damaged syntax tree file is rejected
+printf "build/genie output/test45bad.oast\n";
+head -c 100 output/test45.oast > output/test45bad.oast
+build/genie output/test45bad.oast -o output/test45bad.asm
+if [[ $? -eq 0 ]] ; then
+  exit 1
+fi
+exit 0
@@ -0,0 +1,76 @@
+printf "build/opal --cache=output/test46.cache input/calc.opl\n";
+
+export LD_LIBRARY_PATH=build/
+mkdir -p output
+rm -rf output/test46.cache
+
+## First compilation misses and saves the executable
+build/opal --cache=output/test46.cache input/calc.opl -o output/test46.bin \
+  | grep -q "saved to compilation cache"
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## Second compilation hits and links the same executable
+build/opal --cache=output/test46.cache input/calc.opl -o output/test46h.bin \
+  | grep -q "taken from compilation cache"
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+cmp output/test46.bin output/test46h.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+output/test46h.bin < test/test35.in | cmp - test/test35.out
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## Different code generation options miss
+build/opal --cache=output/test46.cache --tos-cache input/calc.opl \
+  -o output/test46t.bin | grep -q "saved to compilation cache"
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## Statistics count both hits and misses
+printf "build/opal --cache=output/test46.cache --cache-stats\n";
+build/opal --cache=output/test46.cache --cache-stats > output/test46.stats
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+grep -q "Cache hits:.1$" output/test46.stats \
+  && grep -q "Cache misses:.2$" output/test46.stats \
+  && grep -q "Cache entries:.2," output/test46.stats
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## Least recently used executable is evicted over the size limit
+printf "build/opal --cache=output/test46.cache --cache-size=30 input/Sequences.opl\n";
+build/opal --quiet --cache=output/test46.cache input/calc.opl \
+  -o output/test46h.bin
+build/opal --quiet --cache=output/test46.cache --cache-size=30 \
+  input/Sequences.opl -o output/test46s.bin
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+build/opal --cache=output/test46.cache --cache-stats > output/test46.stats
+grep -q "Cache evictions:.1$" output/test46.stats
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+build/opal --cache=output/test46.cache input/calc.opl -o output/test46h.bin \
+  | grep -q "taken from compilation cache"
+if [[ $? -ne 0 ]] ; then
+  exit 1
+fi
+
+## A cache directory whose entry names do not fit is refused
+long=output/$(printf 'd%.0s' {1..500})
+build/opal --quiet --cache=$long input/calc.opl -o output/test46l.bin \
+  2> /dev/null
+if [[ $? -ne 64 ]] || [[ -e $long ]] ; then
+  exit 1
+fi
+exit 0